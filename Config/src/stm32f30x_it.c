@@ -30,6 +30,8 @@
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f30x_it.h"
 #include "main.h"
+#include "irqMonitor.h"
+#include "ccm.h"
 
 /** @addtogroup STM32F3-Discovery_Demo
   * @{
@@ -142,7 +144,7 @@ void PendSV_Handler(void)
   * @param  None
   * @retval None
   */
-void SysTick_Handler(void)
+CCM_CODE void SysTick_Handler(void)
 {
     systemTime++;
 }
@@ -160,6 +162,8 @@ void SysTick_Handler(void)
   */
 void EXTI0_IRQHandler(void)
 { 
+  IRQ_ENTER(IrqExti0);
+
   if ((EXTI_GetITStatus(USER_BUTTON_EXTI_LINE) == SET)&&(STM_EVAL_PBGetState(BUTTON_USER) != RESET))
   {
     /* Delay */
@@ -175,6 +179,8 @@ void EXTI0_IRQHandler(void)
     /* Clear the EXTI line pending bit */
     EXTI_ClearITPendingBit(USER_BUTTON_EXTI_LINE);
   }
+
+  IRQ_EXIT(IrqExti0);
 }
 
 
@@ -0,0 +1,72 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef ACCELERATION_TRUST_H
+#define ACCELERATION_TRUST_H
+
+#include "math3d.h"
+
+#include <stdint.h>
+
+/*
+ * How much an accelerometer reading in g can be trusted as the gravity
+ * direction. Two cues lower the weight: the magnitude differs from 1 g and
+ * the reading jumped, the mean of the last window of samples against the
+ * window before it. Both are compared as squared norms, no square root is
+ * taken. Each cue maps linearly from full trust at its tolerance to no
+ * trust at its limit, the weight is their product.
+ */
+class AccelerationTrust
+{
+public:
+	static const uint8_t WindowLength = 4;
+
+	// Tolerances and limits in g
+	AccelerationTrust(float magnitudeTolerance, float magnitudeLimit, float jerkTolerance, float jerkLimit);
+
+	void reset();
+
+	// Weight in <0, 1> for a new reading. Zero reading means no new sample,
+	// it gets no trust and leaves the window untouched
+	float update(const math3d::Vector3<float>& reading);
+	float weight() const;
+
+private:
+	static float ramp(float value, float tolerance, float limit);
+
+	float _magnitudeTolerance;
+	float _magnitudeLimit;
+	float _jerkTolerance;
+	float _jerkLimit;
+
+	math3d::Vector3<float> _samples[2 * WindowLength];
+	math3d::Vector3<float> _recentSum;
+	math3d::Vector3<float> _previousSum;
+	uint8_t _next;
+	uint8_t _count;
+	float _weight;
+};
+
+#endif
@@ -27,8 +27,9 @@
 #define ACCELEROMETER_H
 
 #include "math3d.h"
+#include "calibration.h"
+#include "fixedQueue.h"
 
-#include <deque>
 #include <utility>
 
 #include <stm32f3_discovery_lsm303dlhc.h>
@@ -58,10 +59,30 @@ public:
 	/* Enable or disable high pass filter */
 	void useHighPassFilter(bool use);
 
+	/* Finishes pending configuration steps, true once samples are valid.
+	   Configuration changes do not wait for the sensor, reads return
+	   nothing until it settles */
+	bool ready();
+
+	/* System time when last configuration change settles */
+	uint64_t readyTime() const;
+
+	/* Bias and scale applied to every value read */
+	void correction(const SensorCorrection& correction);
+	const SensorCorrection& correction() const;
+
+	/* Die temperature in deg C, refreshed about once a second by reads */
+	float temperature() const;
+
 private:
+	/* Starts settling period after configuration change */
+	void settle();
+
+	/* Reads temperature registers when their period elapsed */
+	void sampleTemperature();
 
-	/* Retrieve all values stored in L3GD20 and store in buffers */
-	void retrieveValues();
+	/* Retrieve all values stored in L3GD20 and store in buffers, returns their count */
+	int retrieveValues();
 
 	// Clear all items from FIFO
 	void clearFifo();
@@ -69,17 +90,35 @@ private:
 	/* Reset FIFO to re-enable data collection */
 	void resetFifo();
 
+	// Whole sensor FIFO fits, oldest samples are dropped beyond it
+	static const uint16_t BufferCapacity = 32;
+	// Scale changes pending between two reads
+	static const uint16_t ScaleCapacity = 4;
+
 	/* Buffer for storing raw data */
-	std::deque<math3d::Vector3<int16_t> > _dataBuffer;
+	FixedQueue<math3d::Vector3<int16_t>, BufferCapacity> _dataBuffer;
 
 	/* Buffer for storing scale of _dataBuffer items - pair <scale, counter> */
-	std::deque<std::pair<uint8_t, uint16_t> > _scaleBuffer;
+	FixedQueue<std::pair<uint8_t, uint16_t>, ScaleCapacity> _scaleBuffer;
 
 	// Maximum buffer size
 	uint16_t _maxBufferSize;
 
 	// Sample time
 	float _deltaT;
+
+	// Reads are valid from this system time
+	uint64_t _readyTime;
+	// FIFO waits in bypass mode to be restarted
+	bool _restartFifo;
+	// Samples taken while settling are to be dropped
+	bool _clearFifo;
+
+	SensorCorrection _correction;
+
+	// Last temperature read and system time of the next read
+	float _temperature;
+	uint64_t _temperatureTime;
 };
 
 #endif
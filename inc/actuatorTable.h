@@ -0,0 +1,65 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef ACTUATORTABLE_H
+#define ACTUATORTABLE_H
+
+#include <stdint.h>
+
+/*
+ * Calibrated mapping from normalized command (thrust, angle) to pwm timer
+ * compare ticks. Points are equidistant over <0, 1>, values in between are
+ * linearly interpolated. Tables are generated by lutgen from calibration
+ * measurements, see calibration/.
+ */
+class ActuatorTable
+{
+public:
+	ActuatorTable(const uint16_t* ticks, uint16_t size) :
+	_ticks(ticks),
+	_last(size - 1)
+	{
+	}
+
+	// Called on every actuator update, kept inline
+	uint32_t ticks(float normalized) const
+	{
+		if(normalized <= 0.0f)
+			return _ticks[0];
+		if(normalized >= 1.0f)
+			return _ticks[_last];
+
+		float position = normalized * _last;
+		uint16_t index = (uint16_t)position;
+		float fraction = position - index;
+		return _ticks[index] + (int32_t)((_ticks[index + 1] - _ticks[index]) * fraction + 0.5f);
+	}
+
+private:
+	const uint16_t* _ticks;
+	uint16_t _last;
+};
+
+#endif
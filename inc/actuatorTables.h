@@ -0,0 +1,27 @@
+// Generated by tools/lutgen.cpp, do not edit by hand.
+// Regenerate with "make tables" after changing calibration data.
+
+#ifndef ACTUATORTABLES_H
+#define ACTUATORTABLES_H
+
+#include <stdint.h>
+
+// calibration/engine.csv, 21 samples, pwm timer at 2000000 Hz
+const uint16_t engineThrustTicks[33] = {
+	2000, 2350, 2500, 2612, 2707, 2790, 2865, 2934,
+	3000, 3060, 3117, 3172, 3224, 3274, 3322, 3369,
+	3414, 3457, 3500, 3540, 3581, 3620, 3658, 3696,
+	3731, 3767, 3803, 3837, 3870, 3904, 3936, 3968,
+	4000
+};
+
+// calibration/servo.csv, 13 samples, pwm timer at 2000000 Hz
+const uint16_t servoAngleTicks[33] = {
+	1800, 1875, 1950, 2025, 2100, 2175, 2250, 2325,
+	2400, 2475, 2550, 2625, 2700, 2775, 2850, 2925,
+	3000, 3075, 3150, 3225, 3300, 3375, 3450, 3525,
+	3600, 3675, 3750, 3825, 3900, 3975, 4050, 4125,
+	4200
+};
+
+#endif
@@ -0,0 +1,96 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef ATTITUDE_EKF_H
+#define ATTITUDE_EKF_H
+
+#include "math3d.h"
+#include "matrix.h"
+
+#include <stdint.h>
+
+/*
+ * Extended Kalman filter of attitude quaternion and gyroscope bias, the
+ * heavier alternative to ComplementaryFilter2. Quaternion turns gyroscope
+ * axes into the world, gyroscope rate minus bias drives the prediction and
+ * the accelerometer corrects it towards gravity, heading corrects yaw.
+ *
+ * Bias is a random walk, so the state transition has identity and zero
+ * blocks which are skipped, and only the upper triangle of the covariance
+ * is computed. Measurements touch the quaternion only. Sequential form
+ * applies them as scalars one by one, joint form inverts the 3x3
+ * innovation covariance. Both give the same result.
+ */
+class AttitudeEkf
+{
+public:
+	static const uint8_t StateN = 7;
+
+	enum UpdateForm {Sequential, Joint};
+
+	// Gyroscope noise in rad/s per sample, bias drift in rad/s per square
+	// root of second, accelerometer noise in g and heading noise in rad
+	AttitudeEkf(float gyroNoise, float biasDrift, float accNoise, float headingNoise, UpdateForm form = Sequential);
+
+	// Level, facing yaw zero, tilt and bias uncertain
+	void reset();
+	// Tilt taken from accelerometer reading of a craft standing still
+	void reset(const math3d::Vector3<float>& accReading);
+
+	// Gyroscope rate in rad/s held over deltaT in s
+	void predict(const math3d::Vector3<float>& rate, float deltaT);
+	// Accelerometer reading in its own axes, weight in <0, 1> scales the
+	// confidence and below 1 keeps the bias, false when nothing was corrected
+	bool correct(const math3d::Vector3<float>& accReading, float weight);
+	// Heading in radians, same sense as yaw
+	bool correctHeading(float heading, float weight);
+
+	// Pitch, roll and yaw in the convention of the accelerometer angles,
+	// yaw in <0, 2*Pi)
+	math3d::Vector3<float> angles() const;
+	// Quaternion w, x, y, z
+	const float* quaternion() const;
+	const math3d::Vector3<float>& bias() const;
+	const Matrix<float, StateN, StateN>& covariance() const;
+
+private:
+	// Scalar measurement with gradient h over the quaternion
+	bool scalarUpdate(const float h[4], float innovation, float variance, bool learnBias);
+	void resetCovariance(float tiltVariance);
+	void normalize();
+
+	float _gyroVariance;
+	float _biasVariance;
+	float _accVariance;
+	float _headingVariance;
+	UpdateForm _form;
+
+	// w, x, y, z
+	float _q[4];
+	math3d::Vector3<float> _bias;
+	Matrix<float, StateN, StateN> _covariance;
+};
+
+#endif
@@ -0,0 +1,147 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef BLACKBOX_H
+#define BLACKBOX_H
+
+#include <stdint.h>
+
+#include "math3d.h"
+
+/*
+ * Flight recorder. Every control loop a frame of sensor readings, attitude,
+ * setpoints, PID terms and outputs is quantized to integer fields and
+ * encoded into a RAM ring:
+ *
+ *   keyframe	0xBB 'I' field...	fields as zig-zag varints
+ *   delta		'P' field...		differences to previous record
+ *
+ * A keyframe every KeyframeInterval records lets the reader resync after
+ * the ring was overwritten or bytes were lost on the link.
+ */
+
+// Values of one control loop in physical units
+struct BlackboxFrame
+{
+	uint32_t time;	// microseconds
+	math3d::Vector3<float> gyro;	// rad/s
+	math3d::Vector3<float> acc;		// g
+	math3d::Vector3<float> attitude;	// rad
+	math3d::Vector3<float> setpoint;	// rad
+	math3d::Vector3<float> proportional;
+	math3d::Vector3<float> integral;
+	math3d::Vector3<float> derivative;
+	float throttle;
+	float motors[3];
+	float servo;
+};
+
+class BlackboxEncoder
+{
+public:
+	static const uint8_t FieldN = 27;
+	static const uint8_t KeyframeMarker = 0xBB;
+	static const uint8_t KeyframeTag = 'I';
+	static const uint8_t DeltaTag = 'P';
+	// Two tag bytes and up to 5 bytes per field
+	static const uint8_t MaxRecordSize = 2 + FieldN * 5;
+
+	BlackboxEncoder(uint8_t keyframeInterval);
+
+	// Writes record to out (MaxRecordSize bytes), returns its size
+	uint8_t encode(const int32_t* fields, uint8_t* out);
+	// Next record will be a keyframe
+	void reset();
+	bool lastKeyframe() const;
+
+	// Frame quantized to fields, see fieldName for order
+	static void quantize(const BlackboxFrame& frame, int32_t* fields);
+	static const char* fieldName(uint8_t field);
+	// Multiply field by it to get physical unit
+	static float fieldScale(uint8_t field);
+
+private:
+	uint8_t _keyframeInterval;
+	uint8_t _sinceKeyframe;
+	bool _lastKeyframe;
+	int32_t _previous[FieldN];
+};
+
+class BlackboxDecoder
+{
+public:
+	enum Result {Decoded, NeedMore, Skipped};
+
+	BlackboxDecoder();
+
+	// Decodes record at start of data, consumed is set to number of bytes
+	// used (or skipped while searching for keyframe)
+	Result decode(const uint8_t* data, uint32_t size, uint32_t& consumed);
+	const int32_t* fields() const;
+	uint32_t errors() const;
+
+private:
+	int32_t _fields[BlackboxEncoder::FieldN];
+	bool _synced;
+	uint32_t _errors;
+};
+
+class Blackbox
+{
+public:
+	static const uint16_t BufferSize = 8192;
+	static const uint8_t KeyframeInterval = 32;
+	// Remembered keyframe positions, must cover the whole buffer
+	static const uint8_t KeyframeSlots = 16;
+
+	Blackbox();
+
+	void record(const BlackboxFrame& frame);
+
+	// Copies up to size unread bytes to out. If unread data were
+	// overwritten, reading continues at the oldest complete keyframe.
+	uint16_t read(uint8_t* out, uint16_t size);
+	// Marks all data still in buffer as unread, for post-flight dump
+	void rewind();
+
+	uint32_t records() const;
+	// Bytes overwritten before they were read
+	uint32_t lost() const;
+
+private:
+	uint32_t oldestKeyframe(uint32_t from);
+
+	BlackboxEncoder _encoder;
+	uint8_t _buffer[BufferSize];
+	// Absolute byte positions, buffer index is position % BufferSize
+	uint32_t _written;
+	uint32_t _read;
+	uint32_t _keyframes[KeyframeSlots];
+	uint8_t _keyframeIndex;
+	uint32_t _records;
+	uint32_t _lost;
+};
+
+#endif
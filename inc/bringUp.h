@@ -0,0 +1,91 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef BRING_UP_H
+#define BRING_UP_H
+
+#include "gyroscope.h"
+#include "accelerometer.h"
+#include "model.h"
+#include "calibration.h"
+#include "configStore.h"
+
+#include <stdint.h>
+
+/*
+ * Start of all devices without blocking waits. Sensor constructors only
+ * write configuration and settle on their own, ESCs arm on minimum
+ * throttle meanwhile and gyroscope bias is calibrated once the sensor warms
+ * up, so boot takes as long as the slowest of them instead of their sum.
+ * Corrections stored by earlier boots are applied right away and kept
+ * when the craft does not stand still long enough to calibrate.
+ *
+ * poll() is called once per loop period until armed() holds. Ready times
+ * are system time since boot.
+ */
+class BringUp
+{
+public:
+	enum Device {Gyro, Accel, Escs, GyroCalibration, DeviceN};
+
+	// Stored corrections are applied at once, new ones are written back
+	BringUp(Gyroscope& gyro, Accelerometer& acc, Model& model, ConfigStore& store);
+
+	// Advances every device one step, returns armed()
+	bool poll();
+
+	bool ready(Device device) const;
+	// All devices ready, model may follow the pilot
+	bool armed() const;
+
+	// System time when device became ready, 0 while pending
+	uint64_t readyTime(Device device) const;
+	// System time when the last device became ready, 0 while pending
+	uint64_t armedTime() const;
+
+	// Stored corrections were found at start
+	bool loaded() const;
+	// Gyroscope bias was measured this boot, not taken over from storage
+	bool calibrated() const;
+	const Calibration& gyroCalibration() const;
+
+	static const char* name(Device device);
+
+private:
+	void markReady(Device device, uint64_t time);
+
+	Gyroscope& _gyro;
+	Accelerometer& _acc;
+	Model& _model;
+	ConfigStore& _store;
+
+	uint64_t _start;
+	uint64_t _readyTimes[DeviceN];
+
+	Calibration _gyroCalibration;
+	bool _loaded;
+};
+
+#endif
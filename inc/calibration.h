@@ -0,0 +1,133 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include "math3d.h"
+
+#include <stdint.h>
+#include <cmath>
+
+class ConfigStore;
+
+/*
+ * Streaming mean and variance of vector samples (Welford), two sets are
+ * merged exactly (Chan et al.), no samples are stored.
+ */
+class RunningStats
+{
+public:
+	RunningStats();
+
+	void reset();
+	void add(const math3d::Vector3<float>& sample);
+	void merge(const RunningStats& other);
+
+	uint32_t count() const;
+	const math3d::Vector3<float>& mean() const;
+	// Population variance per axis
+	math3d::Vector3<float> variance() const;
+
+private:
+	uint32_t _count;
+	math3d::Vector3<float> _mean;
+	math3d::Vector3<float> _m2;
+};
+
+/*
+ * Correction of a sensor axis triplet, output = raw * scale * sensitivity - bias.
+ * Bias is in output units so it holds for every full scale setting.
+ */
+struct SensorCorrection
+{
+	math3d::Vector3<float> bias;
+	math3d::Vector3<float> scale;
+
+	SensorCorrection() : bias(0, 0, 0), scale(1, 1, 1) {}
+
+	// Single multiply-add per axis on raw sample
+	math3d::Vector3<float> apply(const math3d::Vector3<int16_t>& raw, float sensitivity) const
+	{
+		return math3d::Vector3<float>(std::fma((float)raw[0], scale[0] * sensitivity, -bias[0]),
+									  std::fma((float)raw[1], scale[1] * sensitivity, -bias[1]),
+									  std::fma((float)raw[2], scale[2] * sensitivity, -bias[2]));
+	}
+
+	// Sample already in output units
+	math3d::Vector3<float> apply(const math3d::Vector3<float>& value) const
+	{
+		return math3d::Vector3<float>(std::fma(value[0], scale[0], -bias[0]),
+									  std::fma(value[1], scale[1], -bias[1]),
+									  std::fma(value[2], scale[2], -bias[2]));
+	}
+};
+
+/*
+ * Still period calibration. Corrected samples are collected in short
+ * windows, a window counts only when the sensor stayed still: deviation
+ * on every axis and drift of its mean from the already accepted windows
+ * are under the limit. Motion rejects the window, a moved mean restarts
+ * the collection. Results refine the correction the samples came from.
+ */
+class Calibration
+{
+public:
+	// Still limit is standard deviation in sample units
+	Calibration(uint16_t windowLength, uint8_t windowsNeeded, float stillLimit);
+
+	void reset();
+
+	// Returns true once enough still windows were collected
+	bool add(const math3d::Vector3<float>& sample);
+	bool done() const;
+
+	uint32_t rejectedWindows() const;
+	// Accepted still samples
+	const RunningStats& stats() const;
+
+	// Mean rate is gyroscope bias
+	void updateGyroscope(SensorCorrection& correction) const;
+	// Craft stands level: horizontal axes read zero and vertical 1 g
+	void updateAccelerometer(SensorCorrection& correction) const;
+
+	// Correction kept in configuration store under key, load is false
+	// when none is stored
+	static bool load(const ConfigStore& store, uint8_t key, SensorCorrection& correction);
+	static bool save(ConfigStore& store, uint8_t key, const SensorCorrection& correction);
+
+private:
+	uint16_t _windowLength;
+	uint8_t _windowsNeeded;
+	float _stillVariance;
+	float _stillLimit;
+
+	RunningStats _window;
+	RunningStats _accepted;
+	uint8_t _acceptedWindows;
+	uint32_t _rejectedWindows;
+};
+
+#endif
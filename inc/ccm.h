@@ -0,0 +1,83 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef CCM_H
+#define CCM_H
+
+/*
+ * Placement into the 8 kB core coupled RAM at 0x10000000. It is reached
+ * by the core with zero wait states and no contention with DMA, so the
+ * control hot path runs from it. DMA cannot access it, buffers used by
+ * DMA must stay in the main RAM.
+ *
+ *   CCM_CODE	function copied from flash at startup
+ *   CCM_DATA	initialized variable copied from flash at startup
+ *   CCM_BSS	zero initialized variable, also for objects constructed later
+ *
+ * Calls between flash and CCM are out of branch range, the linker inserts
+ * veneers for them. The simulator and NO_CCM builds leave everything in
+ * the default sections so the profiler can compare both layouts.
+ */
+#if defined(SIMULATION) || defined(NO_CCM)
+#define CCM_CODE
+#define CCM_DATA
+#define CCM_BSS
+#else
+#define CCM_CODE	__attribute__((section(".ccmram.text"), noinline))
+#define CCM_DATA	__attribute__((section(".ccmram.data")))
+#define CCM_BSS		__attribute__((section(".ccmbss")))
+#endif
+
+#ifdef __cplusplus
+
+#include <new>
+#include <stdint.h>
+#include <utility>
+
+/*
+ * Storage for an object constructed once initialization reaches it, for
+ * objects whose constructors need running hardware. Declared CCM_BSS it
+ * moves the object off the main stack into core coupled RAM:
+ *
+ *   CCM_BSS static CcmObject<Controller> pitchStorage;
+ *   Controller& pitch = pitchStorage.construct(...);
+ */
+template<typename T>
+class CcmObject
+{
+public:
+	template<typename... Args>
+	T& construct(Args&&... args)
+	{
+		return *new(_storage) T(std::forward<Args>(args)...);
+	}
+
+private:
+	alignas(T) uint8_t _storage[sizeof(T)];
+};
+
+#endif
+
+#endif
@@ -46,4 +46,11 @@ T limit(T val, U min, U max)
 	return val > min ? (val < max ? val : max) : min;
 }
 
+// Input angles from range <0, 2*Pi)
+// Output from range <-Pi, Pi>
+float interpolateAngle(float start, float end);
+
+// Normalizes angle into <0, 2*Pi) interval
+float normalizeAngle(float angle);
+
 #endif
@@ -27,8 +27,7 @@
 #define COMMUNICATOR_H_
 
 #include "uart.h"
-
-#include <string>
+#include "span.h"
 
 // TODO: base uart and bluetooth on the same base
 class Communicator
@@ -39,19 +38,23 @@ public:
 
 	Communicator(Source source);
 
-	void send(std::string s);
+	// Strings are limited to 255 characters
+	void send(Span<const char> s);
+	void send(const char* s);
 	void send(uint32_t ui);
 	void send(float f);
 
-	void sendRaw(std::string s);
+	void sendRaw(Span<const char> s);
+	void sendRaw(const char* s);
 
 	void discard();
 
 	bool empty();
 
 	bool receive(CommandId& commandId);
-	// On false, string content is undefined
-	bool receive(std::string& s);
+	// On false, string content is undefined. Longer strings are truncated
+	// to size of s, length is set to number of stored characters.
+	bool receive(Span<char> s, uint8_t& length);
 	bool receive(uint32_t& ui);
 	bool receive(float& f);
 
@@ -36,6 +36,10 @@ public:
 	void reset();
 
 	math3d::Vector3<float> addSample(math3d::Vector3<float> lowPassSample, math3d::Vector3<float> highPassSample);
+	// Low pass correction scaled by weight in <0, 1>, zero follows the high pass input only
+	math3d::Vector3<float> addSample(math3d::Vector3<float> lowPassSample, math3d::Vector3<float> highPassSample, float weight);
+	// Weight given per axis
+	math3d::Vector3<float> addSample(math3d::Vector3<float> lowPassSample, math3d::Vector3<float> highPassSample, math3d::Vector3<float> weight);
 	math3d::Vector3<float> readState();
 private:
 	math3d::Vector3<float> _state;
@@ -0,0 +1,109 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include "flashPage.h"
+
+#include <stdint.h>
+
+/*
+ * Settings kept over reboots as a log of key/value records in two flash
+ * pages. A write appends a record to the active page, a full page is
+ * compacted into the other one with the latest record of every key. Boot
+ * scans the active page once into a RAM index of latest record per key,
+ * reads are then O(1) and mount time is bounded by one page.
+ *
+ * Power may be lost at any point: a record is written tag last and counts
+ * only with a valid CRC, a compacted page gets its header last and until
+ * then the old page stays active.
+ */
+class ConfigStore
+{
+public:
+	// Record keys stored in flash, values must never be reused
+	enum Key {GyroCorrection = 1, AccCorrection, PitchGains, RollGains, YawGains,
+			  FilterTimeConst, ServoTrim, RcShaping, // + RC channel
+			  MagCorrection = 16, GyroThermalBias,
+			  KeyN = 32};
+
+	static const uint32_t FirstPage = 0x0803F000;
+	static const uint32_t SecondPage = 0x0803F800;
+	static const uint16_t MaxValueSize = 128;
+
+	ConfigStore(uint32_t firstPage = FirstPage, uint32_t secondPage = SecondPage);
+
+	// Builds index from the newest valid page, empty store when none
+	void mount();
+
+	// False when key is not stored or its value has other size
+	bool read(uint8_t key, void* value, uint16_t size) const;
+	// Identical value is not written again, false on flash failure
+	bool write(uint8_t key, const void* value, uint16_t size);
+
+	template<typename T>
+	bool read(uint8_t key, T& value) const { return read(key, &value, sizeof(T)); }
+	template<typename T>
+	bool write(uint8_t key, const T& value) { return write(key, &value, sizeof(T)); }
+
+	// Keys with a value
+	uint8_t count() const;
+	// Bytes used in active page, records of replaced values included
+	uint16_t used() const;
+	// Compactions of the store over its life, lower bound of page erases
+	uint32_t sequence() const;
+	// Records dropped while mounting as torn or corrupted
+	uint16_t damaged() const;
+
+private:
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t sequence;
+	};
+
+	static const uint16_t HeaderSize = sizeof(Header);
+	static const uint16_t NoRecord = 0;
+
+	static uint16_t recordSize(uint16_t valueSize);
+
+	bool append(uint8_t key, const void* value, uint16_t size);
+	bool compact(uint8_t key, const void* value, uint16_t size);
+	bool programRecord(FlashPage& page, uint16_t offset, uint8_t key, const void* value, uint16_t size);
+	bool erased(uint16_t offset, uint16_t size) const;
+
+	FlashPage _pages[2];
+	// Active page, -1 when the store is empty
+	int8_t _active;
+	uint32_t _sequence;
+	uint16_t _free;
+	uint16_t _damaged;
+
+	// Offset of latest record per key in active page
+	uint16_t _index[KeyN];
+};
+
+#endif
@@ -83,6 +83,11 @@ public:
 
 	float process(float input, float(*interpolate)(float, float) = nullptr);
 
+	// Contributions of last process() to the output, summing to it
+	float proportionalTerm();
+	float integralTerm();
+	float derivativeTerm();
+
 private:
 	float _setpoint;
 	float _manipulated;
@@ -90,6 +95,9 @@ private:
 	float _integralTerm;
 	float _previousInput;
 
+	float _proportionalOutput;
+	float _derivativeOutput;
+
 	// Controller gain constant K_p
 	float _proportional;
 
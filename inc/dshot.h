@@ -0,0 +1,80 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef DSHOT_H
+#define DSHOT_H
+
+#include <stdint.h>
+
+#include <stm32f30x.h>
+
+/*
+ * DShot output of one timer. Frames of all four channels are prepared as
+ * compare values in one buffer, timer update events then burst them by
+ * DMA into CCR1..CCR4, one bit per timer period.
+ */
+class Dshot
+{
+public:
+	enum Speed {Dshot150 = 150, Dshot300 = 300, Dshot600 = 600};
+
+	static const uint8_t ChannelN = 4;
+	static const uint8_t FrameBits = 16;
+	// Two empty slots after the frame keep the line low until next frame
+	static const uint8_t SlotN = FrameBits + 2;
+
+	static const uint16_t MinThrottle = 48;
+	static const uint16_t MaxThrottle = 2047;
+
+	// Output for given timer, nullptr when timer has no DMA burst wiring
+	static Dshot* output(TIM_TypeDef* timer);
+
+	// 11 bit value with telemetry request bit and 4 bit checksum
+	static uint16_t frame(uint16_t value, bool telemetry = false);
+	// Normalized throttle to DShot value, zero means motor stop
+	static uint16_t throttleValue(float throttle);
+
+	Dshot(TIM_TypeDef* timer, DMA_Channel_TypeDef* dma);
+
+	// Timer and DMA periphery must be enabled first
+	void configure(Speed speed);
+
+	// Channel 1..4, takes effect on next send()
+	void value(uint8_t channel, uint16_t value);
+	// Starts DMA transfer of the buffer
+	void send();
+
+	const uint16_t* buffer() const;
+
+private:
+	TIM_TypeDef* _timer;
+	DMA_Channel_TypeDef* _dma;
+	uint16_t _one;
+	uint16_t _zero;
+	// Slot major, CCR1..CCR4 of each slot are written by one burst
+	uint16_t _buffer[SlotN * ChannelN];
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef ELLIPSOID_CALIBRATION_H
+#define ELLIPSOID_CALIBRATION_H
+
+#include "calibration.h"
+#include "math3d.h"
+
+#include <stdint.h>
+
+/*
+ * Hard and soft iron calibration of a magnetometer by fitting an axis
+ * aligned ellipsoid to raw readings taken in many orientations:
+ *
+ *   x^2 + b y^2 + c z^2 + d x + e y + f z + g = 0
+ *
+ * Readings are accepted only when they moved far enough from the last
+ * accepted one, so dwelling in one orientation does not dominate. Each
+ * accepted reading adds to the normal equations of the least squares fit,
+ * nothing else is stored; past the sample limit all sums are halved, old
+ * readings fade out. The 6x6 system is solved by Cholesky in slices, one
+ * column per poll, on a copy of the sums so readings keep coming in.
+ *
+ * A fit is accepted when the system is well conditioned, the ellipsoid is
+ * real, the readings span at least its radius on every axis and their
+ * RMS distance from it is small relative to the field.
+ */
+class EllipsoidCalibration
+{
+public:
+	static const uint16_t MinSamples = 100;
+	static const uint16_t MaxSamples = 1024;
+	// New samples between fits
+	static const uint16_t SolveInterval = 25;
+
+	// Spacing between accepted readings in reading units, residual limit
+	// relative to squared field
+	EllipsoidCalibration(float spacing, float maxResidual);
+
+	void reset();
+
+	// Raw reading, true when accepted
+	bool add(const math3d::Vector3<float>& sample);
+	// Runs one slice of a pending fit, true when it completed and passed
+	bool poll();
+
+	// A fit passed since reset
+	bool done() const;
+	// Accepted samples weighted by fading
+	uint16_t samples() const;
+	// Relative RMS residual of the last passed fit
+	float residual() const;
+
+	// Correction mapping raw readings onto the unit sphere
+	void update(SensorCorrection& correction) const;
+
+private:
+	static const uint8_t N = 6;
+	enum {Idle = -1, Substitution = N, Finish};
+
+	void startFit();
+	bool finishFit();
+
+	float _spacing;
+	float _maxResidual;
+
+	// Upper triangle of sum of r r^T, sum of r x^2 and of x^4 for
+	// regressors r = (y^2, z^2, x, y, z, 1)
+	float _normal[N][N];
+	float _moment[N];
+	float _targetSquares;
+	float _count;
+	math3d::Vector3<float> _min;
+	math3d::Vector3<float> _max;
+	math3d::Vector3<float> _last;
+	uint16_t _sinceFit;
+
+	// Fit in progress, Cholesky factor overwrites the lower triangle
+	int8_t _step;
+	float _factor[N][N];
+	float _rhs[N];
+	float _solution[N];
+	float _fitSquares;
+	float _fitCount;
+	math3d::Vector3<float> _fitMin;
+	math3d::Vector3<float> _fitMax;
+
+	bool _done;
+	float _residual;
+	math3d::Vector3<float> _center;
+	math3d::Vector3<float> _scale;
+};
+
+#endif
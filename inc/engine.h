@@ -27,11 +27,21 @@
 #define ENGINE_H
 
 #include "pwm.h"
+#include "actuatorTable.h"
+
+class Dshot;
 
 class Engine
 {
 public:
+	// ESC signalling, all engines on one timer must use the same protocol
+	enum Protocol {StandardPwm, OneShot125, Multishot, Dshot150, Dshot300, Dshot600};
+
 	Engine(TIM_TypeDef* timer, uint8_t channel, float minPulseWidth = 1e-3, float maxPulseWidth = 2e-3, float throttle = 0);
+	// Throttle is mapped through calibrated table instead of linear pulse width range
+	Engine(TIM_TypeDef* timer, uint8_t channel, const ActuatorTable* table, float throttle = 0);
+	// Table still describes standard 1-2 ms pulses, they are converted to given protocol
+	Engine(TIM_TypeDef* timer, uint8_t channel, const ActuatorTable* table, Protocol protocol, float throttle = 0);
 
 	float throttle();
 	// Throttle in range <0, 1>
@@ -45,12 +55,27 @@ public:
 
 	void connect(GPIO_TypeDef* port, uint16_t pin, uint8_t altFunction);
 
-	void arm();
+	// Timer periphery (and DMA1 for DShot) must be enabled first
+	static void configureTimer(TIM_TypeDef* timer, Protocol protocol);
+	// Starts output of throttles set on all engines of the timer, needed
+	// once per control loop by all protocols except standard pwm
+	static void trigger(TIM_TypeDef* timer, Protocol protocol);
 
 private:
+	void updateTicks();
+
+	Protocol _protocol;
+	uint8_t _channel;
 	Pwm _pwm;
+	Dshot* _dshot;
+	const ActuatorTable* _table;
+	float _throttle;
 	float _minPulseWidth;
 	float _maxPulseWidth;
+	// Linear mapping in pwm timer ticks, precomputed from pulse widths
+	float _minTicks;
+	float _rangeTicks;
+	float _dshotScale;
 };
 
 #endif
@@ -0,0 +1,90 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef FIXED_QUEUE_H
+#define FIXED_QUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+/*
+ * Queue with capacity fixed at compile time, storage is part of the object.
+ * Drop-in for the subset of std::deque the drivers use. One producer and
+ * one consumer may run in different contexts (main loop and interrupt) as
+ * long as only the producer pushes and only the consumer pops. Counters
+ * are published with release and read with acquire ordering, so the other
+ * side never sees a counter move before the item it covers.
+ */
+template<typename T, uint16_t Capacity>
+class FixedQueue
+{
+	// Counters wrap around consistently with indexes only then
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be power of two");
+
+public:
+	FixedQueue() : _head(0), _tail(0) {}
+
+	bool empty() const { return head() == tail(); }
+	bool full() const { return size() >= Capacity; }
+	uint16_t size() const { return (uint16_t)(tail() - head()); }
+	static uint16_t capacity() { return Capacity; }
+
+	T& front() { return _items[head() % Capacity]; }
+	const T& front() const { return _items[head() % Capacity]; }
+	T& back() { return _items[(uint16_t)(tail() - 1) % Capacity]; }
+	const T& back() const { return _items[(uint16_t)(tail() - 1) % Capacity]; }
+
+	// False when queue is full, item is not stored
+	bool push_back(const T& item)
+	{
+		if(full())
+			return false;
+		uint16_t position = tail();
+		_items[position % Capacity] = item;
+		// Publish item only after it is stored
+		_tail.store((uint16_t)(position + 1), std::memory_order_release);
+		return true;
+	}
+
+	void pop_front()
+	{
+		// Free the slot only after the item was read
+		if(!empty())
+			_head.store((uint16_t)(head() + 1), std::memory_order_release);
+	}
+
+	void clear() { _head.store(tail(), std::memory_order_release); }
+
+private:
+	uint16_t head() const { return _head.load(std::memory_order_acquire); }
+	uint16_t tail() const { return _tail.load(std::memory_order_acquire); }
+
+	T _items[Capacity];
+	// Free running counters, difference is the size
+	std::atomic<uint16_t> _head;
+	std::atomic<uint16_t> _tail;
+};
+
+#endif
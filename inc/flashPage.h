@@ -0,0 +1,56 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef FLASH_PAGE_H
+#define FLASH_PAGE_H
+
+#include <stdint.h>
+
+/*
+ * One 2 kB page of the flash region kept out of the program by the linker
+ * script for settings surviving reboots. Erased bytes read 0xFF,
+ * programming goes by halfwords and only into erased ones.
+ */
+class FlashPage
+{
+public:
+	static const uint32_t Size = 2048;
+
+	FlashPage(uint32_t address);
+
+	const uint8_t* data() const;
+
+	bool erase();
+	// Offset and size must be even
+	bool program(uint32_t offset, const void* data, uint32_t size);
+
+	// CRC-16/CCITT of stored records, continues from crc of preceding data
+	static uint16_t checksum(const void* data, uint32_t size, uint16_t crc = 0xFFFF);
+
+private:
+	uint32_t _address;
+};
+
+#endif
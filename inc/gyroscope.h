@@ -28,9 +28,10 @@
 
 #include "main.h"
 #include "math3d.h"
+#include "calibration.h"
 #include "common.h"
+#include "fixedQueue.h"
 
-#include <deque>
 #include <utility>
 
 #include <stm32f3_discovery_l3gd20.h>
@@ -54,16 +55,47 @@ public:
     /* Select data storage mode */
     void selectMode(Mode mode);
     
-    /* Change scale of sensor */
+    /* Change scale of sensor, stored samples keep the scale they were taken with */
     void changeScale(uint8_t scale);
+
+    /* Full scale follows recent peak rate - 250 dps in hover, up to
+       2000 dps in aggressive manoeuvres */
+    void autoRange(bool enable);
+    bool autoRange() const;
+
+    /* Full scale of newest samples */
+    uint8_t scale() const;
     
     /* Enable or disable high pass filter */
     void useHighPassFilter(bool use);
 
+    /* Finishes pending configuration steps, true once samples are valid.
+       Configuration changes do not wait for the sensor, reads return
+       nothing until it settles */
+    bool ready();
+
+    /* System time when last configuration change settles */
+    uint64_t readyTime() const;
+
+    /* Bias and scale applied to every value read */
+    void correction(const SensorCorrection& correction);
+    const SensorCorrection& correction() const;
+
+    /* Die temperature in deg C, refreshed about once a second by reads */
+    float temperature() const;
+
+    /* FIFO samples dropped because they came during a scale write */
+    uint32_t droppedSamples() const;
+
 private:
+    /* Starts settling period after configuration change */
+    void settle();
 
-    /* Retrieve all values stored in L3GD20 and store in buffers */
-    void retrieveValues();
+    /* Reads temperature register when its period elapsed */
+    void sampleTemperature();
+
+    /* Retrieve all values stored in L3GD20 and store in buffers, returns their count */
+    int retrieveValues();
     
     // Clear all items from FIFO
     void clearFifo();
@@ -71,17 +103,62 @@ private:
     /* Reset FIFO to re-enable data collection */
     void resetFifo();
 
+    /* Sensor samples of old scale are gone, stored ones get the pending scale */
+    void flushPendingScale();
+
+    /* Picks full scale for peak rate, called with sensor FIFO drained */
+    void updateRange(bool fifoMode);
+
+    /* Writes full scale to sensor, samples taken from now on get it */
+    void writeScale(uint8_t scale, bool fifoMode);
+
+    /* Starts new run of samples with scale */
+    void tagScale(uint8_t scale);
+
+    // Whole sensor FIFO fits, oldest samples are dropped beyond it
+    static const uint16_t BufferCapacity = 32;
+    // Scale changes pending between two reads
+    static const uint16_t ScaleCapacity = 4;
+
     /* Buffer for storing raw data */
-    std::deque<math3d::Vector3<int16_t> > _dataBuffer;
+    FixedQueue<math3d::Vector3<int16_t>, BufferCapacity> _dataBuffer;
     
     /* Buffer for storing scale of _dataBuffer items - pair <scale, counter> */
-    std::deque<std::pair<uint8_t, uint16_t> > _scaleBuffer;
+    FixedQueue<std::pair<uint8_t, uint16_t>, ScaleCapacity> _scaleBuffer;
 
     // Maximum buffer size
     uint16_t _maxBufferSize;
 
     // Sample time
     float _deltaT;
+
+    // Reads are valid from this system time
+    uint64_t _readyTime;
+    // FIFO waits in bypass mode to be restarted
+    bool _restartFifo;
+    // Samples taken while settling are to be dropped
+    bool _clearFifo;
+
+    SensorCorrection _correction;
+
+    // Full scale follows peak rate
+    bool _autoRange;
+    // Highest rate in dps since last range decision and time of the next
+    // decision to lower the range
+    float _rangePeak;
+    uint64_t _rangeTime;
+    // Output registers hold sample of old scale until next one in bypass mode,
+    // in FIFO mode samples queued before the write keep the old scale and
+    // the ones that came during it are dropped
+    bool _scalePending;
+    uint8_t _pendingScale;
+    uint8_t _pendingSamples;
+    uint8_t _pendingDrops;
+    uint32_t _droppedSamples;
+
+    // Last temperature read and system time of the next read
+    float _temperature;
+    uint64_t _temperatureTime;
 };
 
 #endif
@@ -0,0 +1,81 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef IRQ_DISPATCH_H_
+#define IRQ_DISPATCH_H_
+
+#include <stdint.h>
+
+/*
+ * Compile time binding of peripheral interrupts to the objects serving
+ * them. Every peripheral instance has its own slot, a static pointer
+ * selected by template arguments, so the vector handler reaches its
+ * object with a single load and no search:
+ *
+ *   void USART1_IRQHandler(void) { IrqSlot<Uart, 1>::dispatch(); }
+ *
+ * Objects bind themselves before enabling their NVIC channel and unbind
+ * (bind nullptr) after disabling it. Dispatch to an empty slot returns,
+ * peripheral interrupts are disabled at that time.
+ */
+template<typename Handler, uint8_t Instance>
+class IrqSlot
+{
+public:
+	static void bind(Handler* handler)
+	{
+		_handler = handler;
+	}
+
+	static Handler* handler()
+	{
+		return _handler;
+	}
+
+	static void dispatch()
+	{
+		Handler* handler = _handler;
+		if(handler != nullptr)
+			handler->handleInterrupt();
+	}
+
+private:
+	static Handler* volatile _handler;
+};
+
+template<typename Handler, uint8_t Instance>
+Handler* volatile IrqSlot<Handler, Instance>::_handler = nullptr;
+
+// Bit index of the lowest pending flag, which is removed from the set.
+// Serves all flags from one status register read:
+//   while(pending) serve(nextPending(pending));
+inline uint8_t nextPending(uint32_t& pending)
+{
+	uint8_t bit = __builtin_ctz(pending);
+	pending &= pending - 1;
+	return bit;
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef IRQ_MONITOR_H
+#define IRQ_MONITOR_H
+
+#include <stdint.h>
+
+/*
+ * Interrupt handler accounting: activation count, exclusive cycles (time
+ * spent in nested handlers is subtracted), worst-case duration, shortest
+ * interval between activations and nesting depth. Cycles come from the
+ * profiler time base.
+ *
+ * SysTick is not instrumented, it runs at SYSTEM_TIME_RESOLUTION and the
+ * measurement would cost more than the handler itself.
+ *
+ * Handlers are written in both C and C++, so the entry points are plain
+ * functions. Like profiler markers they compile out when NDEBUG is defined,
+ * unless PROFILE is defined too.
+ */
+
+#if !defined(NDEBUG) || defined(PROFILE)
+#define IRQ_MONITOR_ENABLED
+#endif
+
+typedef enum {IrqExti0, IrqTim3, IrqUsart1, IrqUsart2, IrqUsart3, IrqUart4, IrqUart5, IrqSourceN} IrqSource;
+
+typedef struct
+{
+	uint32_t count;
+	uint64_t cycles;
+	uint32_t maxCycles;
+	// Zero until second activation
+	uint32_t minInterval;
+	uint32_t lastEntry;
+	uint8_t priority;
+	uint8_t maxNesting;
+} IrqStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t irqEnter(IrqSource source);
+void irqExit(IrqSource source, uint32_t start);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef IRQ_MONITOR_ENABLED
+#define IRQ_ENTER(source)	uint32_t irqStart = irqEnter(source)
+#define IRQ_EXIT(source)	irqExit(source, irqStart)
+#else
+#define IRQ_ENTER(source)
+#define IRQ_EXIT(source)
+#endif
+
+#ifdef __cplusplus
+
+class IrqMonitor
+{
+public:
+	// Deepest tracked nesting, deeper handlers are counted but not timed exclusively
+	static const uint8_t MaxNesting = 8;
+	// Response time estimate did not converge
+	static const uint32_t Unbounded = 0xFFFFFFFF;
+
+	static void reset();
+
+	// Preemption priority of source, called by Interrupt::enable
+	static void priority(IrqSource source, uint8_t priority);
+	// Source of NVIC channel, IrqSourceN when not monitored
+	static IrqSource source(uint8_t irq);
+
+	static const IrqStats& stats(IrqSource source);
+	static const char* name(IrqSource source);
+	static uint8_t maxNesting();
+
+	// Fraction of time spent in monitored handlers since reset
+	static float load();
+
+	// Worst-case response time in cycles of a handler at given preemption
+	// priority: its own worst case, blocking by one handler of the same
+	// priority and preemption by higher priorities at their shortest
+	// observed interval
+	static uint32_t responseTime(uint8_t priority);
+	// Worst-case cycles taken by all handlers from a loop period of given length
+	static uint32_t interference(uint32_t cycles);
+};
+
+#endif
+
+#endif
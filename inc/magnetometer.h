@@ -0,0 +1,78 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef MAGNETOMETER_H
+#define MAGNETOMETER_H
+
+#include "math3d.h"
+#include "calibration.h"
+
+#include <stdint.h>
+
+#include <stm32f3_discovery_lsm303dlhc.h>
+
+/*
+ * Magnetometer part of LSM303DLHC in continuous conversion. It has no
+ * FIFO, the output registers hold the latest conversion: one burst read
+ * of all axes per output period gives a consistent sample. Axes are those
+ * of the accelerometer in the same package, values in gauss.
+ */
+class Magnetometer
+{
+public:
+	Magnetometer(LSM303DLHCMag_InitTypeDef& magInit);
+
+	/* Reads a sample when a new one is due, false otherwise */
+	bool readValue(math3d::Vector3<float>& value);
+
+	/* Last sample without correction */
+	const math3d::Vector3<float>& raw() const;
+
+	/* Bias and scale applied to every value read */
+	void correction(const SensorCorrection& correction);
+	const SensorCorrection& correction() const;
+
+	/* Heading of field around the vertical in radians, pitch and roll in
+	   the convention of the accelerometer angles, see main.cpp */
+	static float heading(const math3d::Vector3<float>& field, float pitch, float roll);
+
+private:
+	/* Multi-byte read of magnetometer registers */
+	static bool burstRead(uint8_t address, uint8_t* buffer, uint8_t n);
+
+	// Output period in system time units
+	uint64_t _period;
+	// System time of the next sample
+	uint64_t _sampleTime;
+
+	// Gauss per LSB
+	float _sensitivityXy;
+	float _sensitivityZ;
+
+	math3d::Vector3<float> _raw;
+	SensorCorrection _correction;
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <stdint.h>
+
+/*
+ * Matrix with dimensions fixed at compile time, storage is part of the
+ * object, so temporaries live on the stack and members inside their owner.
+ * Dimensions of every product are checked by the compiler. Only what the
+ * estimators need is provided, loops are left for the compiler to unroll.
+ */
+template<typename T, uint8_t Rows, uint8_t Cols>
+class Matrix
+{
+public:
+	Matrix() { zero(); }
+
+	static uint8_t rows() { return Rows; }
+	static uint8_t cols() { return Cols; }
+
+	T& operator()(uint8_t row, uint8_t col) { return _m[row][col]; }
+	const T& operator()(uint8_t row, uint8_t col) const { return _m[row][col]; }
+
+	Matrix& zero()
+	{
+		for(uint8_t i = 0; i < Rows; i++)
+			for(uint8_t j = 0; j < Cols; j++)
+				_m[i][j] = 0;
+		return *this;
+	}
+
+	static Matrix identity()
+	{
+		static_assert(Rows == Cols, "identity of non-square matrix");
+		Matrix m;
+		for(uint8_t i = 0; i < Rows; i++)
+			m._m[i][i] = 1;
+		return m;
+	}
+
+	Matrix<T, Cols, Rows> transpose() const
+	{
+		Matrix<T, Cols, Rows> t;
+		for(uint8_t i = 0; i < Rows; i++)
+			for(uint8_t j = 0; j < Cols; j++)
+				t(j, i) = _m[i][j];
+		return t;
+	}
+
+	template<uint8_t N>
+	Matrix<T, Rows, N> operator*(const Matrix<T, Cols, N>& b) const
+	{
+		Matrix<T, Rows, N> p;
+		for(uint8_t i = 0; i < Rows; i++)
+			for(uint8_t j = 0; j < N; j++){
+				T sum = 0;
+				for(uint8_t k = 0; k < Cols; k++)
+					sum += _m[i][k] * b(k, j);
+				p(i, j) = sum;
+			}
+		return p;
+	}
+
+	Matrix operator*(T b) const
+	{
+		Matrix p;
+		for(uint8_t i = 0; i < Rows; i++)
+			for(uint8_t j = 0; j < Cols; j++)
+				p._m[i][j] = _m[i][j] * b;
+		return p;
+	}
+
+	Matrix operator+(const Matrix& b) const
+	{
+		Matrix s = *this;
+		return s += b;
+	}
+
+	Matrix operator-(const Matrix& b) const
+	{
+		Matrix s = *this;
+		return s -= b;
+	}
+
+	Matrix& operator+=(const Matrix& b)
+	{
+		for(uint8_t i = 0; i < Rows; i++)
+			for(uint8_t j = 0; j < Cols; j++)
+				_m[i][j] += b._m[i][j];
+		return *this;
+	}
+
+	Matrix& operator-=(const Matrix& b)
+	{
+		for(uint8_t i = 0; i < Rows; i++)
+			for(uint8_t j = 0; j < Cols; j++)
+				_m[i][j] -= b._m[i][j];
+		return *this;
+	}
+
+	// Sub-matrix of size R x C starting at row, col
+	template<uint8_t R, uint8_t C>
+	Matrix<T, R, C> block(uint8_t row, uint8_t col) const
+	{
+		Matrix<T, R, C> b;
+		for(uint8_t i = 0; i < R; i++)
+			for(uint8_t j = 0; j < C; j++)
+				b(i, j) = _m[row + i][col + j];
+		return b;
+	}
+
+	template<uint8_t R, uint8_t C>
+	void block(uint8_t row, uint8_t col, const Matrix<T, R, C>& b)
+	{
+		for(uint8_t i = 0; i < R; i++)
+			for(uint8_t j = 0; j < C; j++)
+				_m[row + i][col + j] = b(i, j);
+	}
+
+	// Copies the upper triangle over the lower one, covariances computed
+	// only above the diagonal stay exactly symmetric
+	void mirrorUpper()
+	{
+		static_assert(Rows == Cols, "mirror of non-square matrix");
+		for(uint8_t i = 1; i < Rows; i++)
+			for(uint8_t j = 0; j < i; j++)
+				_m[i][j] = _m[j][i];
+	}
+
+private:
+	T _m[Rows][Cols];
+};
+
+// Gauss-Jordan elimination with partial pivoting, false when m is singular
+template<typename T, uint8_t N>
+bool invert(const Matrix<T, N, N>& m, Matrix<T, N, N>& inverse)
+{
+	Matrix<T, N, N> a = m;
+	inverse = Matrix<T, N, N>::identity();
+	for(uint8_t col = 0; col < N; col++){
+		uint8_t pivot = col;
+		T best = 0;
+		for(uint8_t i = col; i < N; i++){
+			T value = a(i, col) < 0 ? -a(i, col) : a(i, col);
+			if(value > best){
+				best = value;
+				pivot = i;
+			}
+		}
+		if(best == 0)
+			return false;
+
+		if(pivot != col)
+			for(uint8_t j = 0; j < N; j++){
+				T t = a(col, j); a(col, j) = a(pivot, j); a(pivot, j) = t;
+				t = inverse(col, j); inverse(col, j) = inverse(pivot, j); inverse(pivot, j) = t;
+			}
+
+		T scale = 1 / a(col, col);
+		for(uint8_t j = 0; j < N; j++){
+			a(col, j) *= scale;
+			inverse(col, j) *= scale;
+		}
+
+		for(uint8_t i = 0; i < N; i++){
+			if(i == col)
+				continue;
+			T factor = a(i, col);
+			for(uint8_t j = 0; j < N; j++){
+				a(i, j) -= factor * a(col, j);
+				inverse(i, j) -= factor * inverse(col, j);
+			}
+		}
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,67 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef MEMORY_MONITOR_H
+#define MEMORY_MONITOR_H
+
+#include <stdint.h>
+
+/*
+ * RAM accounting of the firmware. Static data come from linker symbols,
+ * heap from the newlib arena and stack from a painted pattern, so the
+ * report shows peak use of each since start. Core coupled RAM holds only
+ * static sections and is accounted apart from SRAM.
+ *
+ * Every operator new is counted. Allocations after lockHeap() are counted
+ * separately and with HEAP_FREE defined they trap, so the control loop is
+ * guaranteed not to touch the heap. Direct malloc calls from the C
+ * library are not trapped, they still show up in the heap peak.
+ */
+class MemoryMonitor
+{
+public:
+	// Ends initialization, paints free stack for peak measurement
+	static void lockHeap();
+	static bool heapLocked();
+
+	// Bytes of .data and .bss in SRAM
+	static uint32_t staticSize();
+	// Bytes taken from system by malloc, never shrinks
+	static uint32_t heapPeak();
+	// Deepest stack use since lockHeap() in bytes
+	static uint32_t stackPeak();
+	// Sum of the above and size of SRAM
+	static uint32_t ramPeak();
+	static uint32_t ramSize();
+
+	// Bytes of .ccmram (hot path code and data) and .ccmbss, size of CCM
+	static uint32_t ccmStaticSize();
+	static uint32_t ccmSize();
+
+	static uint32_t allocations();
+	static uint32_t lockedAllocations();
+};
+
+#endif
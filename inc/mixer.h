@@ -0,0 +1,63 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <stdint.h>
+
+/*
+ * Maps collective throttle and pitch/roll commands to motor throttles.
+ * Mixing table is derived from motor positions once, in constructor.
+ * Attitude part of the output is scaled by throttle, so the motors stay
+ * off when throttle is zero. When outputs do not fit into <0, 1> the
+ * collective throttle is shifted first, attitude is reduced only when its
+ * own spread is larger than whole throttle range.
+ */
+class Mixer
+{
+public:
+	static const uint8_t MaxMotors = 4;
+
+	// Positions are [x, y] in body frame, X right and Y forward, any unit
+	Mixer(const float positions[][2], uint8_t motorN, float authority);
+
+	// Pitch and roll in range <-1, 1>, outputs in range <0, 1>
+	void mix(float throttle, float pitch, float roll, float* outputs) const;
+
+	uint8_t motorN() const;
+
+	// Fraction of throttle that full pitch or roll command changes on the most loaded motor
+	float authority() const;
+	void authority(float authority);
+
+private:
+	uint8_t _motorN;
+	float _authority;
+	float _pitch[MaxMotors];
+	float _roll[MaxMotors];
+};
+
+#endif
@@ -29,20 +29,38 @@
 #include "engine.h"
 #include "pwm.h"
 #include "servo.h"
+#include "mixer.h"
 #include "math3d.h"
 
 class Model
 {
 public:
-	Model();
+	// Engine timer must be configured for the protocol, for other than
+	// standard pwm also TIM4 (tail servo) at 50 Hz on enabled GPIOD
+	Model(Engine::Protocol protocol = Engine::StandardPwm);
 
 	// Updates model properties according to parameters
 	void update(float throttle, math3d::Vector3<float> rotation);
 
+	// Fraction of throttle that may be used for manoeuvring in one axis
+	float maneuverFraction();
+	void maneuverFraction(float fraction);
+
+	// Offset of normalized tail servo angle, levels yaw at centered stick
+	float tailTrim();
+	void tailTrim(float trim);
+
+	// Outputs set by last update, engine in order rear, right, left
+	float throttle(uint8_t engine);
+	float tailAngle();
+
 private:
 	enum Engines {Rear, Right, Left, EngineN};
+	Engine::Protocol protocol;
 	Engine engines[EngineN];
 	Servo servo;
+	Mixer mixer;
+	float trim;
 };
 
 #endif
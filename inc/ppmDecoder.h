@@ -0,0 +1,73 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef PPM_DECODER_H
+#define PPM_DECODER_H
+
+#include <stdint.h>
+
+/*
+ * Decoder of PPM sum signal from rising edge captures of a free-running
+ * 16 bit timer. Channel widths are the intervals between edges, frames
+ * are separated by a long sync gap.
+ */
+class PpmDecoder
+{
+public:
+	static const uint8_t MinChannels = 4;
+	static const uint8_t MaxChannels = 16;
+
+	PpmDecoder(uint32_t tickFrequency);
+
+	// Returns true when the capture completed a valid frame
+	bool push(uint16_t capture);
+
+	// Number of channels in last complete frame
+	uint8_t channelN() const;
+	// Channel width in timer ticks from last complete frame
+	uint16_t channel(uint8_t channel) const;
+
+	uint32_t frames() const;
+	uint32_t errors() const;
+
+private:
+	uint16_t _minTicks;
+	uint16_t _maxTicks;
+	uint16_t _syncTicks;
+
+	uint16_t _lastCapture;
+	bool _hasCapture;
+	bool _synced;
+	uint8_t _count;
+	uint16_t _pending[MaxChannels];
+
+	uint8_t _channelN;
+	uint16_t _channels[MaxChannels];
+
+	uint32_t _frames;
+	uint32_t _errors;
+};
+
+#endif
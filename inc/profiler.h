@@ -0,0 +1,106 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
+/*
+ * Cycle profiler of control loop stages. Scoped markers record the cycle
+ * count of each pass into fixed per-stage statistics with log2 histogram,
+ * nothing is allocated. On target the DWT cycle counter is used, on host
+ * nanoseconds of std::chrono steady clock.
+ *
+ * Markers compile out completely when NDEBUG is defined, unless PROFILE
+ * is defined too.
+ */
+
+#if !defined(NDEBUG) || defined(PROFILE)
+#define PROFILER_ENABLED
+#endif
+
+class Profiler
+{
+public:
+	// Telemetry is the blackbox record and stream, Debug the optional
+	// ANGLE_TEST/CTRL_TEST prints, so each stage is entered once per loop
+	enum Stage {Communication, GyroRead, AccelRead, MagRead, Fusion, Control, Mixing, Telemetry, Debug, StageN};
+
+	// Bucket i counts passes with cycles in <2^i, 2^(i+1)), zero goes to bucket 0
+	static const uint8_t BucketN = 32;
+
+	struct Stats
+	{
+		uint32_t count;
+		uint32_t min;
+		uint32_t max;
+		uint64_t total;
+		uint32_t histogram[BucketN];
+	};
+
+	// Enables cycle counter and clears statistics
+	static void start();
+	static void reset();
+
+	static uint32_t now();
+	static void record(Stage stage, uint32_t cycles);
+
+	static const Stats& stats(Stage stage);
+	static uint32_t mean(Stage stage);
+	static const char* name(Stage stage);
+	// Cycles per second of now()
+	static uint32_t frequency();
+};
+
+class ProfileScope
+{
+public:
+	ProfileScope(Profiler::Stage stage) :
+	_stage(stage),
+	_start(Profiler::now())
+	{
+	}
+
+	~ProfileScope()
+	{
+		Profiler::record(_stage, Profiler::now() - _start);
+	}
+
+private:
+	Profiler::Stage _stage;
+	uint32_t _start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef PROFILER_ENABLED
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(Profiler::stage)
+#else
+#define PROFILE_SCOPE(stage)
+#endif
+
+#endif
@@ -35,7 +35,12 @@
 class Pwm
 {
 public:
-	Pwm(TIM_TypeDef* timer, uint8_t channel);
+	// Leading edge pulses start at counter reset, trailing edge pulses end
+	// at counter overflow (needed for one pulse mode, where stopped counter
+	// would otherwise hold the output active)
+	enum Alignment {LeadingEdge, TrailingEdge};
+
+	Pwm(TIM_TypeDef* timer, uint8_t channel, Alignment alignment = LeadingEdge);
 
 	float dutyCycle();
 	void dutyCycle(float dc);
@@ -43,6 +48,19 @@ public:
 	float pulseWidth();
 	void pulseWidth(float pulseWidth);
 
+	// Raw compare value in pwm timer ticks
+	uint32_t compare();
+	void compare(uint32_t ticks);
+
+	// Number of pwm timer ticks in pulse width given in seconds
+	static float pulseTicks(float pulseWidth);
+
+	// Compare values of all channels written between beginFrame and
+	// commitFrame take effect together on the next update event, so one
+	// pwm period never mixes values of two control iterations
+	static void beginFrame(TIM_TypeDef* timer);
+	static void commitFrame(TIM_TypeDef* timer);
+
 	// Port must be enabled
 	void connect(GPIO_TypeDef* port, uint16_t pin, uint8_t altFunction);
 
@@ -51,9 +69,9 @@ public:
 	static void configureTimer(TIM_TypeDef* timer, uint32_t pwmFrequency);
 
 private:
-	float _dutyCycle;
 	TIM_TypeDef* _timer;
 	uint8_t _channel;
+	uint32_t _compare;
 };
 
 #endif
@@ -0,0 +1,96 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef RC_SHAPER_H
+#define RC_SHAPER_H
+
+#include <stdint.h>
+
+/*
+ * Conditioning of one RC channel before it becomes a controller setpoint:
+ * stick calibration, deadband, expo curve (lookup table), rate scaling and
+ * linear interpolation between RC frames up to the control rate, so the
+ * setpoint changes in small steps instead of a kick every RC frame.
+ */
+class RcShaper
+{
+public:
+	// Centered sticks give <-rate, rate>, unipolar (throttle) <0, rate>
+	enum Mode {Centered, Unipolar};
+
+	static const uint8_t CurvePoints = 17;
+
+	RcShaper(Mode mode, float loopPeriod, float framePeriod);
+
+	// Normalized readings <0, 1> at stick endpoints and center
+	void calibration(float min, float center, float max);
+	// Stick travel ignored around center (or bottom for unipolar), <0, 1)
+	void deadband(float deadband);
+	// 0 is linear, 1 is pure cubic
+	void expo(float expo);
+	// Output at full stick deflection
+	void rate(float rate);
+	// Expected time between RC frames in seconds
+	void framePeriod(float framePeriod);
+
+	float minimum();
+	float center();
+	float maximum();
+	float deadband();
+	float expo();
+	float rate();
+
+	// Reading corresponding to neutral stick, used when signal is lost
+	float neutral();
+
+	// Called once per control loop with normalized reading <0, 1>, returns setpoint
+	float process(float reading);
+
+	// Shaped value of reading without interpolation
+	float shape(float reading);
+
+private:
+	void updateCurve();
+	float curve(float stick);
+
+	Mode _mode;
+	float _loopPeriod;
+	float _framePeriod;
+
+	float _min;
+	float _center;
+	float _max;
+	float _deadband;
+	float _expo;
+	float _rate;
+	float _curve[CurvePoints];
+
+	float _lastReading;
+	float _target;
+	float _step;
+	float _output;
+};
+
+#endif
@@ -31,6 +31,21 @@
 
 #include <stdint.h>
 #include <stm32f30x_tim.h>
+#include <stm32f30x_usart.h>
+#include <stm32f30x_dma.h>
+
+#include "ppmDecoder.h"
+#include "sbusDecoder.h"
+#include "seqLock.h"
+
+// Readings of all channels, written by capture interrupt
+struct RcFrame
+{
+	uint32_t captures[CHANNEL_N];
+	uint64_t timeStamps[CHANNEL_N];
+	// Time of latest capture on any channel
+	uint64_t time;
+};
 
 class RcChannel
 {
@@ -59,6 +74,12 @@ public:
 	// Returns normalized reading of channel in range <0, 1>
 	float normalizedReading(uint8_t channel);
 
+	// Takes consistent snapshot of all channels captured by interrupt,
+	// readings stay the same until next call
+	void update();
+	// Time since latest capture in snapshot
+	uint64_t frameAge();
+
 	// Timer periphery must be enabled first e.g.
 	// RCC_APB2PeriphClockCmd(RCC_APB2Periph_TIM1, ENABLE);
 	static void configureTimer(TIM_TypeDef* timer);
@@ -67,6 +88,67 @@ public:
 
 private:
 	RcChannel* _channels[CHANNEL_N];
+	// Channels are constructed in place, no heap is used
+	alignas(RcChannel) uint8_t _channelStorage[CHANNEL_N][sizeof(RcChannel)];
+	RcFrame _frame;
+	uint64_t _frameTime;
+};
+
+// PPM sum signal on one capture channel. Edges are stored by circular DMA
+// and decoded in update(), so no interrupts are needed.
+class PpmReceiver
+{
+public:
+	static const uint8_t CaptureBufferSize = 64;
+
+	// Timer must be configured by RcReceiver::configureTimer, DMA channel
+	// must be the one serving the timer channel capture
+	PpmReceiver(TIM_TypeDef* timer, uint8_t timerChannel, DMA_Channel_TypeDef* dma);
+
+	void connect(GPIO_TypeDef* port, uint16_t pin, uint8_t altFunction);
+
+	// Decodes all edges captured since last call, once per control loop
+	void update();
+
+	uint8_t channelN();
+	float pulseWidth(uint8_t channel);
+	// Returns normalized reading of channel in range <0, 1>
+	float normalizedReading(uint8_t channel);
+
+private:
+	DMA_Channel_TypeDef* _dma;
+	PpmDecoder _decoder;
+	uint16_t _captures[CaptureBufferSize];
+	uint8_t _readIndex;
+	uint64_t _frameTime;
+};
+
+// SBUS receiver on UART RX, bytes are stored by circular DMA and decoded
+// in update()
+class SbusReceiver
+{
+public:
+	static const uint8_t RxBufferSize = 64;
+
+	// USART periphery must be enabled, DMA channel must be the one serving its RX
+	SbusReceiver(USART_TypeDef* uart, DMA_Channel_TypeDef* dma);
+
+	void connect(GPIO_TypeDef* rxPort, uint16_t rxPin, uint8_t rxAltFunction);
+
+	// Decodes all bytes received since last call, once per control loop
+	void update();
+
+	uint8_t channelN();
+	float pulseWidth(uint8_t channel);
+	// Returns normalized reading of channel in range <0, 1>
+	float normalizedReading(uint8_t channel);
+
+private:
+	DMA_Channel_TypeDef* _dma;
+	SbusDecoder _decoder;
+	uint8_t _rxBuffer[RxBufferSize];
+	uint8_t _readIndex;
+	uint64_t _frameTime;
 };
 
 // Interrupt handlers
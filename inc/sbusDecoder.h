@@ -0,0 +1,73 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef SBUS_DECODER_H
+#define SBUS_DECODER_H
+
+#include <stdint.h>
+
+/*
+ * Decoder of SBUS byte stream (100000 baud, 8E2, inverted). Frame is
+ * a header byte, 16 channels packed by 11 bits LSB first, flags and
+ * a footer byte.
+ */
+class SbusDecoder
+{
+public:
+	static const uint8_t ChannelN = 16;
+	static const uint8_t FrameSize = 25;
+
+	SbusDecoder();
+
+	// Returns true when the byte completed a valid frame
+	bool push(uint8_t byte);
+
+	// Raw 11 bit channel value from last complete frame
+	uint16_t channel(uint8_t channel) const;
+	// Receiver lost some frames from transmitter
+	bool frameLost() const;
+	// Receiver has no signal, channels hold failsafe values
+	bool failsafe() const;
+
+	uint32_t frames() const;
+	uint32_t errors() const;
+
+	// Equivalent servo pulse width in seconds of raw channel value
+	static float pulseWidth(uint16_t value);
+
+private:
+	void decode();
+
+	uint8_t _frame[FrameSize];
+	uint8_t _position;
+
+	uint16_t _channels[ChannelN];
+	uint8_t _flags;
+
+	uint32_t _frames;
+	uint32_t _errors;
+};
+
+#endif
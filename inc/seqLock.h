@@ -0,0 +1,84 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef SEQ_LOCK_H
+#define SEQ_LOCK_H
+
+#include <stdint.h>
+#include <atomic>
+
+/*
+ * Sequence lock for a value shared between one writer (interrupt handler)
+ * and readers (main loop). Writer never waits, reader retries the copy when
+ * a write overlapped it, so it always gets a value from one complete write.
+ */
+template<typename T>
+class SeqLock
+{
+public:
+	SeqLock() :
+	_sequence(0),
+	_value()
+	{
+	}
+
+	// Single writer only, returned value may be modified until endWrite
+	T& beginWrite()
+	{
+		_sequence.store(_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		return _value;
+	}
+
+	void endWrite()
+	{
+		_sequence.store(_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	T read() const
+	{
+		T copy;
+		uint32_t start;
+		do{
+			start = _sequence.load(std::memory_order_acquire);
+			copy = _value;
+			std::atomic_thread_fence(std::memory_order_acquire);
+		}while((start & 1) != 0 || start != _sequence.load(std::memory_order_relaxed));
+
+		return copy;
+	}
+
+	// Number of completed writes
+	uint32_t writes() const
+	{
+		return _sequence.load(std::memory_order_relaxed) / 2;
+	}
+
+private:
+	std::atomic<uint32_t> _sequence;
+	T _value;
+};
+
+#endif
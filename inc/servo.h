@@ -27,11 +27,14 @@
 #define SERVO_H
 
 #include "pwm.h"
+#include "actuatorTable.h"
 
 class Servo
 {
 public:
 	Servo(TIM_TypeDef* timer, uint8_t channel, float minPulseWidth = 1e-3, float maxPulseWidth = 2e-3, float maxAngle = 0, float angle = 0);
+	// Normalized angle is mapped through calibrated table instead of linear pulse width range
+	Servo(TIM_TypeDef* timer, uint8_t channel, const ActuatorTable* table, float maxAngle = 0, float angle = 0);
 
 	float angle();
 	// Angle in range <-Pi/2, Pi/2>, depends on maxAngle constant
@@ -50,10 +53,17 @@ public:
 	void connect(GPIO_TypeDef* port, uint16_t pin, uint8_t altFunction);
 
 private:
+	void updateTicks();
+
 	Pwm _pwm;
+	const ActuatorTable* _table;
+	float _normalizedAngle;
 	float _maxAngle;
 	float _minPulseWidth;
 	float _maxPulseWidth;
+	// Linear mapping in pwm timer ticks, precomputed from pulse widths
+	float _minTicks;
+	float _rangeTicks;
 };
 
 #endif
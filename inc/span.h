@@ -0,0 +1,59 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <stddef.h>
+
+// Non-owning view of contiguous items, replaces containers in interfaces
+template<typename T>
+class Span
+{
+public:
+	Span() : _data(nullptr), _size(0) {}
+	Span(T* data, size_t size) : _data(data), _size(size) {}
+	template<size_t N>
+	Span(T (&array)[N]) : _data(array), _size(N) {}
+	// Span of const items from span of mutable ones
+	template<typename U>
+	Span(const Span<U>& other) : _data(other.data()), _size(other.size()) {}
+
+	T* data() const { return _data; }
+	size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+
+	T& operator[](size_t i) const { return _data[i]; }
+	T* begin() const { return _data; }
+	T* end() const { return _data + _size; }
+
+	Span<T> first(size_t n) const { return Span<T>(_data, n < _size ? n : _size); }
+
+private:
+	T* _data;
+	size_t _size;
+};
+
+#endif
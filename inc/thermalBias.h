@@ -0,0 +1,95 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef THERMAL_BIAS_H
+#define THERMAL_BIAS_H
+
+#include "calibration.h"
+#include "configStore.h"
+#include "math3d.h"
+
+#include <stdint.h>
+
+/*
+ * Gyroscope bias over temperature, piecewise linear between evenly spaced
+ * nodes. Nodes are learned online: whenever the craft stands still long
+ * enough, the mean rate left over at the current temperature moves the two
+ * neighbouring nodes. Lookup interpolates between the nearest learned
+ * nodes and holds the outermost one beyond them, so an empty table leaves
+ * rates untouched.
+ */
+class ThermalBias
+{
+public:
+	static const uint8_t NodeN = 8;
+
+	// Nodes start at lowest temperature, maxWeight limits how many still
+	// periods a node remembers
+	ThermalBias(float lowestTemperature, float nodeSpacing, float maxWeight);
+
+	void reset();
+
+	// Bias expected at temperature
+	math3d::Vector3<float> bias(float temperature) const;
+	// Rate with expected bias removed
+	math3d::Vector3<float> apply(const math3d::Vector3<float>& rate, float temperature) const;
+
+	// Compensated rate of a craft that may stand still. Returns true when
+	// a still period completed and the table learned from it
+	bool observe(const math3d::Vector3<float>& rate, float temperature);
+	// Craft is moved on purpose, drops the still period in progress
+	void interrupt();
+
+	// Bias measured during a still period at temperature
+	void learn(float temperature, const math3d::Vector3<float>& bias);
+
+	// Nodes kept in configuration store under key, load is false and
+	// leaves the table untouched when nothing is stored. Nodes hold what
+	// the sensor correction left over, flash holds the full bias so the
+	// table follows a correction measured again at another temperature:
+	// corrected is the bias the current correction removes
+	bool load(const ConfigStore& store, uint8_t key, const math3d::Vector3<float>& corrected);
+	bool save(ConfigStore& store, uint8_t key, const math3d::Vector3<float>& corrected) const;
+
+	float nodeTemperature(uint8_t node) const;
+	const math3d::Vector3<float>& nodeBias(uint8_t node) const;
+	// Zero for nodes not learned yet
+	float nodeWeight(uint8_t node) const;
+
+private:
+	// Position in node units clamped to the table
+	float position(float temperature) const;
+
+	float _lowestTemperature;
+	float _nodeSpacing;
+	float _maxWeight;
+
+	math3d::Vector3<float> _bias[NodeN];
+	float _weight[NodeN];
+
+	Calibration _still;
+};
+
+#endif
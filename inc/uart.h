@@ -27,8 +27,9 @@
 #define UART_H_
 
 #include <stdint.h>
-#include <deque>
-#include <vector>
+
+#include "fixedQueue.h"
+#include "span.h"
 
 #include "stm32f30x_usart.h"
 
@@ -46,19 +47,26 @@ public:
 	uint8_t get();
 	void put(uint8_t byte);
 
-	std::vector<uint8_t> read(int num = 1);
-	int write(const std::vector<uint8_t>& vec);
+	// Waits until whole span is filled
+	int read(Span<uint8_t> data);
+	// Waits for free space when transmit buffer is full
+	int write(Span<const uint8_t> data);
+
+	// Serves all pending flags, called from the bound interrupt handler
+	void handleInterrupt();
 
-	// Internal service function for interrupt handling
+private:
 	void send();
-	// Internal service function for interrupt handling
 	void receive();
 
-private:
 	USART_TypeDef* _uart;
 
-	std::deque<uint8_t> _txBuffer;
-	std::deque<uint8_t> _rxBuffer;
+	// Sized for blackbox dump packets and a burst of received commands
+	static const uint16_t TxCapacity = 1024;
+	static const uint16_t RxCapacity = 256;
+
+	FixedQueue<uint8_t, TxCapacity> _txBuffer;
+	FixedQueue<uint8_t, RxCapacity> _rxBuffer;
 
 	bool _canSend;
 };
@@ -0,0 +1,256 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "stm32f3_discovery.h"
+#include "stm32f3_discovery_l3gd20.h"
+#include "stm32f3_discovery_lsm303dlhc.h"
+#include "simulation.h"
+
+// L3GD20 is on SPI1 clocked at 9 MHz, one address byte per transfer plus chip select
+static uint64_t spiTransferTime(uint16_t n)
+{
+	return 1 + ((n + 1) * 8 + 8) / 9;
+}
+
+// LSM303DLHC is on I2C1 at 100 kHz, 9 bit times per byte, device
+// address and register address (repeated for read) around the data
+static uint64_t i2cTransferTime(uint16_t n, bool read)
+{
+	return (n + (read ? 3 : 2)) * 90;
+}
+
+void STM_EVAL_PBInit(Button_TypeDef, ButtonMode_TypeDef)
+{
+}
+
+uint32_t STM_EVAL_PBGetState(Button_TypeDef)
+{
+	return 0;
+}
+
+// --- L3GD20 ---
+
+void L3GD20_Init(L3GD20_InitTypeDef* L3GD20_InitStruct)
+{
+	uint8_t ctrl1 = L3GD20_InitStruct->Output_DataRate | L3GD20_InitStruct->Band_Width |
+					L3GD20_InitStruct->Power_Mode | L3GD20_InitStruct->Axes_Enable;
+	uint8_t ctrl4 = L3GD20_InitStruct->BlockData_Update | L3GD20_InitStruct->Endianness |
+					L3GD20_InitStruct->Full_Scale;
+
+	L3GD20_Write(&ctrl1, L3GD20_CTRL_REG1_ADDR, 1);
+	L3GD20_Write(&ctrl4, L3GD20_CTRL_REG4_ADDR, 1);
+}
+
+void L3GD20_FilterConfig(L3GD20_FilterConfigTypeDef* L3GD20_FilterStruct)
+{
+	uint8_t ctrl2;
+	L3GD20_Read(&ctrl2, L3GD20_CTRL_REG2_ADDR, 1);
+	ctrl2 = (ctrl2 & 0xC0) | L3GD20_FilterStruct->HighPassFilter_Mode_Selection |
+			L3GD20_FilterStruct->HighPassFilter_CutOff_Frequency;
+	L3GD20_Write(&ctrl2, L3GD20_CTRL_REG2_ADDR, 1);
+}
+
+void L3GD20_FilterCmd(uint8_t HighPassFilterState)
+{
+	uint8_t ctrl5;
+	L3GD20_Read(&ctrl5, L3GD20_CTRL_REG5_ADDR, 1);
+	ctrl5 = (ctrl5 & 0xEF) | HighPassFilterState;
+	L3GD20_Write(&ctrl5, L3GD20_CTRL_REG5_ADDR, 1);
+}
+
+void L3GD20_Write(uint8_t* pBuffer, uint8_t WriteAddr, uint16_t NumByteToWrite)
+{
+	Simulation* simulation = Simulation::current();
+	simulation->gyroscope().write(pBuffer, WriteAddr & 0x3F, NumByteToWrite);
+	simulation->advance(spiTransferTime(NumByteToWrite));
+}
+
+void L3GD20_Read(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead)
+{
+	Simulation* simulation = Simulation::current();
+	simulation->gyroscope().read(pBuffer, ReadAddr & 0x3F, NumByteToRead);
+	simulation->advance(spiTransferTime(NumByteToRead));
+}
+
+// --- LSM303DLHC ---
+
+void LSM303DLHC_AccInit(LSM303DLHCAcc_InitTypeDef* LSM303DLHC_InitStruct)
+{
+	uint8_t ctrl1 = LSM303DLHC_InitStruct->Power_Mode | LSM303DLHC_InitStruct->AccOutput_DataRate |
+					LSM303DLHC_InitStruct->Axes_Enable;
+	uint8_t ctrl4 = LSM303DLHC_InitStruct->BlockData_Update | LSM303DLHC_InitStruct->Endianness |
+					LSM303DLHC_InitStruct->AccFull_Scale | LSM303DLHC_InitStruct->High_Resolution;
+
+	LSM303DLHC_Write(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG1_A, &ctrl1);
+	LSM303DLHC_Write(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG4_A, &ctrl4);
+}
+
+void LSM303DLHC_AccFilterConfig(LSM303DLHCAcc_FilterConfigTypeDef* LSM303DLHC_FilterStruct)
+{
+	uint8_t ctrl2;
+	LSM303DLHC_Read(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG2_A, &ctrl2, 1);
+	ctrl2 = (ctrl2 & 0x0C) | LSM303DLHC_FilterStruct->HighPassFilter_Mode_Selection |
+			LSM303DLHC_FilterStruct->HighPassFilter_CutOff_Frequency |
+			LSM303DLHC_FilterStruct->HighPassFilter_AOI1 | LSM303DLHC_FilterStruct->HighPassFilter_AOI2;
+	LSM303DLHC_Write(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG2_A, &ctrl2);
+}
+
+void LSM303DLHC_AccFilterCmd(uint8_t HighPassFilterState)
+{
+	uint8_t ctrl2;
+	LSM303DLHC_Read(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG2_A, &ctrl2, 1);
+	ctrl2 = (ctrl2 & 0xF7) | HighPassFilterState;
+	LSM303DLHC_Write(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG2_A, &ctrl2);
+}
+
+void LSM303DLHC_MagInit(LSM303DLHCMag_InitTypeDef* LSM303DLHC_InitStruct)
+{
+	uint8_t cra = LSM303DLHC_InitStruct->Temperature_Sensor | LSM303DLHC_InitStruct->MagOutput_DataRate;
+	uint8_t crb = LSM303DLHC_InitStruct->MagFull_Scale;
+	uint8_t mr = LSM303DLHC_InitStruct->Working_Mode;
+
+	LSM303DLHC_Write(MAG_I2C_ADDRESS, LSM303DLHC_CRA_REG_M, &cra);
+	LSM303DLHC_Write(MAG_I2C_ADDRESS, LSM303DLHC_CRB_REG_M, &crb);
+	LSM303DLHC_Write(MAG_I2C_ADDRESS, LSM303DLHC_MR_REG_M, &mr);
+}
+
+// Accelerometer increments the register address only with its top bit
+// set, magnetometer always does it by itself
+static void deviceWrite(uint8_t device, uint8_t address, uint8_t* buffer, uint16_t n)
+{
+	Simulation* simulation = Simulation::current();
+	if(device == ACC_I2C_ADDRESS)
+		simulation->accelerometer().write(buffer, address & 0x7F, n);
+	else
+		simulation->magnetometer().write(buffer, address, n);
+}
+
+static void deviceRead(uint8_t device, uint8_t address, uint8_t* buffer, uint16_t n)
+{
+	Simulation* simulation = Simulation::current();
+	if(device == ACC_I2C_ADDRESS)
+		simulation->accelerometer().read(buffer, address & 0x7F, n);
+	else
+		simulation->magnetometer().read(buffer, address, n);
+}
+
+uint16_t LSM303DLHC_Write(uint8_t DeviceAddr, uint8_t RegAddr, uint8_t* pBuffer)
+{
+	deviceWrite(DeviceAddr, RegAddr, pBuffer, 1);
+	Simulation::current()->advance(i2cTransferTime(1, false));
+	return 0;
+}
+
+uint16_t LSM303DLHC_Read(uint8_t DeviceAddr, uint8_t RegAddr, uint8_t* pBuffer, uint16_t NumByteToRead)
+{
+	// Board driver sets the auto increment bit on multi-byte reads
+	if(NumByteToRead > 1)
+		RegAddr |= 0x80;
+	deviceRead(DeviceAddr, RegAddr, pBuffer, NumByteToRead);
+	Simulation::current()->advance(i2cTransferTime(NumByteToRead, true));
+	return 0;
+}
+
+// --- I2C1 ---
+
+// Transfer in progress on the LSM303DLHC bus. First byte written is the
+// register address, a read transfers everything at its start.
+static struct
+{
+	uint8_t device;
+	uint8_t address;
+	bool addressSent;
+	bool autoEnd;
+	uint8_t remaining;
+	uint8_t buffer[255];
+	uint8_t index;
+} i2cTransfer;
+
+static void i2cEnd(I2C_TypeDef* I2Cx)
+{
+	I2Cx->ISR &= ~(I2C_ISR_TXIS | I2C_ISR_RXNE);
+	I2Cx->ISR |= i2cTransfer.autoEnd ? I2C_ISR_STOPF : I2C_ISR_TC;
+}
+
+void I2C_TransferHandling(I2C_TypeDef* I2Cx, uint16_t Address, uint8_t Number, uint32_t ReloadEndMode,
+						  uint32_t StartStopMode)
+{
+	i2cTransfer.device = (uint8_t)Address;
+	i2cTransfer.autoEnd = ReloadEndMode == I2C_AutoEnd_Mode;
+	i2cTransfer.remaining = Number;
+	i2cTransfer.index = 0;
+	I2Cx->ISR &= ~I2C_ISR_TC;
+
+	if(StartStopMode == I2C_Generate_Start_Write){
+		i2cTransfer.addressSent = false;
+		I2Cx->ISR |= I2C_ISR_TXIS;
+	}
+	else if(StartStopMode == I2C_Generate_Start_Read){
+		// Repeated start, time covers the address write before it
+		deviceRead(i2cTransfer.device, i2cTransfer.address, i2cTransfer.buffer, Number);
+		Simulation::current()->advance(i2cTransferTime(Number, true));
+		I2Cx->ISR |= I2C_ISR_RXNE;
+	}
+}
+
+FlagStatus I2C_GetFlagStatus(I2C_TypeDef* I2Cx, uint32_t I2C_FLAG)
+{
+	return (I2Cx->ISR & I2C_FLAG) != 0 ? SET : RESET;
+}
+
+void I2C_ClearFlag(I2C_TypeDef* I2Cx, uint32_t I2C_FLAG)
+{
+	I2Cx->ISR &= ~I2C_FLAG;
+}
+
+void I2C_SendData(I2C_TypeDef* I2Cx, uint8_t Data)
+{
+	if(i2cTransfer.remaining == 0)
+		return;
+
+	if(!i2cTransfer.addressSent){
+		i2cTransfer.address = Data;
+		i2cTransfer.addressSent = true;
+	}
+	else
+		deviceWrite(i2cTransfer.device, i2cTransfer.address + i2cTransfer.index++, &Data, 1);
+
+	if(--i2cTransfer.remaining == 0){
+		if(i2cTransfer.index > 0)
+			Simulation::current()->advance(i2cTransferTime(i2cTransfer.index, false));
+		i2cEnd(I2Cx);
+	}
+}
+
+uint8_t I2C_ReceiveData(I2C_TypeDef* I2Cx)
+{
+	if(i2cTransfer.remaining == 0)
+		return 0;
+
+	uint8_t data = i2cTransfer.buffer[i2cTransfer.index++];
+	if(--i2cTransfer.remaining == 0)
+		i2cEnd(I2Cx);
+	return data;
+}
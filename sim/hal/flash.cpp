@@ -0,0 +1,170 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Host flash of the top pages used for settings, mapped at the address
+ * they have on the chip. Erase and program follow the hardware: locked
+ * flash refuses both, programming needs an erased halfword. Power loss
+ * and program errors are injected on request.
+ */
+
+#include "stm32f30x_flash.h"
+
+#include <sys/mman.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const uint32_t flashPageSize = 2048;
+static const uint32_t flashBase = 0x0803F000;
+static const uint32_t flashSize = 2 * flashPageSize;
+
+// Address is below anything the host loader uses, a clash is reported
+static uint8_t* mapFlash()
+{
+	void* memory = mmap((void*)(uintptr_t)flashBase, flashSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(memory != (void*)(uintptr_t)flashBase){
+		std::fprintf(stderr, "flash: cannot map settings pages at 0x%08X\n", flashBase);
+		std::abort();
+	}
+
+	std::memset(memory, 0xFF, flashSize);
+	return (uint8_t*)memory;
+}
+
+static uint8_t* const flashMemory = mapFlash();
+static bool flashLocked = true;
+
+static uint32_t operations = 0;
+static uint32_t powerLossAt = 0;
+static uint32_t powerLossState = 0;
+static bool poweredDown = false;
+static bool programErrors = false;
+
+static uint8_t* flashData(uint32_t address)
+{
+	if(address < flashBase || address >= flashBase + flashSize)
+		return nullptr;
+	return flashMemory + (address - flashBase);
+}
+
+// Deterministic bits for torn operations
+static uint32_t powerLossRandom()
+{
+	powerLossState = powerLossState * 1664525u + 1013904223u;
+	return powerLossState >> 8;
+}
+
+// Counts the operation, true when power is lost during it
+static bool losePower()
+{
+	operations++;
+	if(powerLossAt == 0 || operations < powerLossAt)
+		return false;
+
+	poweredDown = true;
+	powerLossAt = 0;
+	return true;
+}
+
+void simFlashPowerLoss(uint32_t operation, uint32_t seed)
+{
+	powerLossAt = operation > 0 ? operations + operation : 0;
+	powerLossState = seed;
+}
+
+void simFlashPowerUp()
+{
+	poweredDown = false;
+	powerLossAt = 0;
+	flashLocked = true;
+}
+
+void simFlashProgramErrors(bool enable)
+{
+	programErrors = enable;
+}
+
+uint32_t simFlashOperations()
+{
+	return operations;
+}
+
+void simFlashReset()
+{
+	std::memset(flashMemory, 0xFF, flashSize);
+	simFlashPowerUp();
+	programErrors = false;
+}
+
+void FLASH_Unlock(void)
+{
+	flashLocked = false;
+}
+
+void FLASH_Lock(void)
+{
+	flashLocked = true;
+}
+
+void FLASH_ClearFlag(uint32_t FLASH_FLAG)
+{
+}
+
+FLASH_Status FLASH_ErasePage(uint32_t Page_Address)
+{
+	uint8_t* page = flashData(Page_Address - Page_Address % flashPageSize);
+	if(poweredDown)
+		return FLASH_TIMEOUT;
+	if(flashLocked || page == nullptr)
+		return FLASH_ERROR_WRP;
+
+	if(losePower()){
+		std::memset(page, 0xFF, powerLossRandom() % flashPageSize);
+		return FLASH_TIMEOUT;
+	}
+
+	std::memset(page, 0xFF, flashPageSize);
+	return FLASH_COMPLETE;
+}
+
+FLASH_Status FLASH_ProgramHalfWord(uint32_t Address, uint16_t Data)
+{
+	uint8_t* halfWord = flashData(Address);
+	if(poweredDown)
+		return FLASH_TIMEOUT;
+	if(flashLocked || halfWord == nullptr || Address % 2 != 0)
+		return FLASH_ERROR_WRP;
+	if(halfWord[0] != 0xFF || halfWord[1] != 0xFF || programErrors)
+		return FLASH_ERROR_PROGRAM;
+
+	// Programming only clears bits, torn one leaves some of them set
+	if(losePower())
+		Data |= powerLossRandom();
+
+	halfWord[0] = Data & 0xFF;
+	halfWord[1] = Data >> 8;
+	return poweredDown ? FLASH_TIMEOUT : FLASH_COMPLETE;
+}
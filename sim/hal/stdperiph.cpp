@@ -0,0 +1,474 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "stm32f30x.h"
+#include "simHal.h"
+
+#include <cstring>
+
+#define CCMR_OC1PE		((uint32_t)0x0008)
+#define CCMR_OC2PE		((uint32_t)0x0800)
+
+uint32_t SystemCoreClock = 72000000;
+
+TIM_TypeDef simTIM1, simTIM2, simTIM3, simTIM4, simTIM8;
+GPIO_TypeDef simGPIOA, simGPIOB, simGPIOC, simGPIOD, simGPIOE, simGPIOF;
+DMA_Channel_TypeDef simDMA1_Channel3, simDMA1_Channel5, simDMA1_Channel6;
+USART_TypeDef simUSART1, simUSART2, simUSART3, simUART4, simUART5;
+I2C_TypeDef simI2C1;
+
+static void (*timerWriteHook)(TIM_TypeDef* timer) = nullptr;
+
+static __IO uint32_t* compareRegister(TIM_TypeDef* timer, uint8_t channel)
+{
+	switch(channel){
+	case 1:  return &timer->CCR1;
+	case 2:  return &timer->CCR2;
+	case 3:  return &timer->CCR3;
+	default: return &timer->CCR4;
+	}
+}
+
+static bool comparePreloaded(TIM_TypeDef* timer, uint8_t channel)
+{
+	uint32_t ccmr = channel <= 2 ? timer->CCMR1 : timer->CCMR2;
+	return (ccmr & (channel % 2 ? CCMR_OC1PE : CCMR_OC2PE)) != 0;
+}
+
+static void setCompare(TIM_TypeDef* timer, uint8_t channel, uint32_t compare)
+{
+	*compareRegister(timer, channel) = compare;
+	if(!comparePreloaded(timer, channel))
+		timer->activeCCR[channel - 1] = compare;
+	if(timerWriteHook != nullptr)
+		timerWriteHook(timer);
+}
+
+static void preloadConfig(TIM_TypeDef* timer, uint8_t channel, uint16_t preload)
+{
+	__IO uint32_t& ccmr = channel <= 2 ? timer->CCMR1 : timer->CCMR2;
+	uint32_t bit = channel % 2 ? CCMR_OC1PE : CCMR_OC2PE;
+	ccmr = preload == TIM_OCPreload_Enable ? ccmr | bit : ccmr & ~bit;
+}
+
+static void ocInit(TIM_TypeDef* timer, uint8_t channel, TIM_OCInitTypeDef* init)
+{
+	timer->CCER |= (uint32_t)init->TIM_OutputState << (4 * (channel - 1));
+	*compareRegister(timer, channel) = init->TIM_Pulse;
+	timer->activeCCR[channel - 1] = init->TIM_Pulse;
+}
+
+// SR bits are cleared by writing zero, the write takes effect here
+static void applyStatusWrite(TIM_TypeDef* timer)
+{
+	timer->statusFlags &= timer->SR;
+	timer->SR = timer->statusFlags;
+}
+
+// ICR bits clear the same ISR bits, the write takes effect here
+static void applyFlagClear(USART_TypeDef* uart)
+{
+	uart->ISR &= ~uart->ICR;
+	uart->ICR = 0;
+}
+
+// --- Simulation hooks ---
+
+void simTimerUpdateEvent(TIM_TypeDef* timer)
+{
+	if(timer->CR1 & TIM_CR1_UDIS)
+		return;
+
+	for(uint8_t channel = 1; channel <= 4; channel++)
+		if(comparePreloaded(timer, channel))
+			timer->activeCCR[channel - 1] = *compareRegister(timer, channel);
+
+	// One pulse mode stops the counter at update event
+	if(timer->CR1 & TIM_CR1_OPM)
+		timer->CR1 &= ~TIM_CR1_CEN;
+}
+
+double simTimerPulseWidth(TIM_TypeDef* timer, uint8_t channel)
+{
+	if((timer->CCER & (1 << (4 * (channel - 1)))) == 0)
+		return 0;
+
+	uint32_t compare = timer->activeCCR[channel - 1];
+	if(compare > timer->ARR + 1)
+		compare = timer->ARR + 1;
+	return (double)compare * (timer->PSC + 1) / SystemCoreClock;
+}
+
+void simTimerWriteHook(void (*hook)(TIM_TypeDef* timer))
+{
+	timerWriteHook = hook;
+}
+
+double simTimerPeriod(TIM_TypeDef* timer)
+{
+	if((timer->CR1 & TIM_CR1_CEN) == 0)
+		return 0;
+	return (double)(timer->ARR + 1) * (timer->PSC + 1) / SystemCoreClock;
+}
+
+void simTimerCapture(TIM_TypeDef* timer, uint8_t channel, uint16_t capture)
+{
+	applyStatusWrite(timer);
+	*compareRegister(timer, channel) = capture;
+
+	// Capture over an unread one sets overcapture flag CCxOF
+	uint32_t flag = 1 << channel;
+	if(timer->statusFlags & flag)
+		timer->statusFlags |= flag << 8;
+	timer->statusFlags |= flag;
+	timer->SR = timer->statusFlags;
+}
+
+uint32_t simTimerStatus(TIM_TypeDef* timer)
+{
+	applyStatusWrite(timer);
+	return timer->statusFlags;
+}
+
+void simUartReceive(USART_TypeDef* uart, uint8_t byte)
+{
+	applyFlagClear(uart);
+
+	// Unread byte is kept, the new one is lost
+	if(uart->ISR & USART_ISR_RXNE)
+		uart->ISR |= USART_ISR_ORE;
+	else{
+		uart->RDR = byte;
+		uart->ISR |= USART_ISR_RXNE;
+	}
+}
+
+bool simUartTransmit(USART_TypeDef* uart, uint8_t& byte)
+{
+	applyFlagClear(uart);
+	if(uart->ISR & USART_ISR_TXE)
+		return false;
+
+	byte = uart->TDR;
+	uart->ISR |= USART_ISR_TXE | USART_ISR_TC;
+	return true;
+}
+
+uint32_t simUartStatus(USART_TypeDef* uart)
+{
+	applyFlagClear(uart);
+	return uart->ISR;
+}
+
+void simDmaTransfer(DMA_Channel_TypeDef* channel, uint16_t value)
+{
+	if((channel->CCR & DMA_CCR_EN) == 0 || channel->CNDTR == 0)
+		return;
+
+	uint16_t index = channel->bufferSize - channel->CNDTR;
+	if(channel->CCR & DMA_MemoryDataSize_HalfWord)
+		((uint16_t*)channel->CMAR)[index] = value;
+	else
+		((uint8_t*)channel->CMAR)[index] = value;
+
+	if(--channel->CNDTR == 0 && (channel->CCR & DMA_Mode_Circular))
+		channel->CNDTR = channel->bufferSize;
+}
+
+// --- GPIO ---
+
+void GPIO_StructInit(GPIO_InitTypeDef* GPIO_InitStruct)
+{
+	GPIO_InitStruct->GPIO_Pin = GPIO_Pin_All;
+	GPIO_InitStruct->GPIO_Mode = GPIO_Mode_IN;
+	GPIO_InitStruct->GPIO_Speed = GPIO_Speed_Level_2;
+	GPIO_InitStruct->GPIO_OType = GPIO_OType_PP;
+	GPIO_InitStruct->GPIO_PuPd = GPIO_PuPd_NOPULL;
+}
+
+void GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_InitStruct)
+{
+	for(uint32_t pin = 0; pin < 16; pin++){
+		if((GPIO_InitStruct->GPIO_Pin & (1 << pin)) == 0)
+			continue;
+		GPIOx->MODER = (GPIOx->MODER & ~(3 << (2 * pin))) | (GPIO_InitStruct->GPIO_Mode << (2 * pin));
+	}
+}
+
+void GPIO_PinAFConfig(GPIO_TypeDef* GPIOx, uint16_t GPIO_PinSource, uint8_t GPIO_AF)
+{
+	uint32_t shift = 4 * (GPIO_PinSource & 7);
+	__IO uint32_t& afr = GPIOx->AFR[GPIO_PinSource >> 3];
+	afr = (afr & ~(0xF << shift)) | ((uint32_t)GPIO_AF << shift);
+}
+
+// --- RCC ---
+
+void RCC_GetClocksFreq(RCC_ClocksTypeDef* RCC_Clocks)
+{
+	RCC_Clocks->SYSCLK_Frequency = SystemCoreClock;
+	RCC_Clocks->HCLK_Frequency = SystemCoreClock;
+	RCC_Clocks->PCLK1_Frequency = SystemCoreClock / 2;
+	RCC_Clocks->PCLK2_Frequency = SystemCoreClock;
+}
+
+void RCC_AHBPeriphClockCmd(uint32_t, FunctionalState)
+{
+}
+
+void RCC_APB2PeriphClockCmd(uint32_t, FunctionalState)
+{
+}
+
+void RCC_APB1PeriphClockCmd(uint32_t, FunctionalState)
+{
+}
+
+// --- NVIC ---
+
+void NVIC_Init(NVIC_InitTypeDef*)
+{
+}
+
+// --- TIM ---
+
+void TIM_DeInit(TIM_TypeDef* TIMx)
+{
+	std::memset((void*)TIMx, 0, sizeof(TIM_TypeDef));
+}
+
+void TIM_TimeBaseInit(TIM_TypeDef* TIMx, TIM_TimeBaseInitTypeDef* TIM_TimeBaseInitStruct)
+{
+	TIMx->PSC = TIM_TimeBaseInitStruct->TIM_Prescaler;
+	TIMx->ARR = TIM_TimeBaseInitStruct->TIM_Period;
+	TIMx->RCR = TIM_TimeBaseInitStruct->TIM_RepetitionCounter;
+
+	// Initialization generates update event to load prescaler
+	TIMx->EGR = TIM_EventSource_Update;
+	simTimerUpdateEvent(TIMx);
+}
+
+void TIM_TimeBaseStructInit(TIM_TimeBaseInitTypeDef* TIM_TimeBaseInitStruct)
+{
+	TIM_TimeBaseInitStruct->TIM_Period = 0xFFFFFFFF;
+	TIM_TimeBaseInitStruct->TIM_Prescaler = 0;
+	TIM_TimeBaseInitStruct->TIM_ClockDivision = 0;
+	TIM_TimeBaseInitStruct->TIM_CounterMode = TIM_CounterMode_Up;
+	TIM_TimeBaseInitStruct->TIM_RepetitionCounter = 0;
+}
+
+void TIM_ARRPreloadConfig(TIM_TypeDef* TIMx, FunctionalState NewState)
+{
+	TIMx->CR1 = NewState ? TIMx->CR1 | TIM_CR1_ARPE : TIMx->CR1 & ~TIM_CR1_ARPE;
+}
+
+void TIM_Cmd(TIM_TypeDef* TIMx, FunctionalState NewState)
+{
+	TIMx->CR1 = NewState ? TIMx->CR1 | TIM_CR1_CEN : TIMx->CR1 & ~TIM_CR1_CEN;
+}
+
+void TIM_CtrlPWMOutputs(TIM_TypeDef* TIMx, FunctionalState NewState)
+{
+	TIMx->BDTR = NewState ? TIMx->BDTR | TIM_BDTR_MOE : TIMx->BDTR & ~TIM_BDTR_MOE;
+}
+
+void TIM_UpdateDisableConfig(TIM_TypeDef* TIMx, FunctionalState NewState)
+{
+	TIMx->CR1 = NewState ? TIMx->CR1 | TIM_CR1_UDIS : TIMx->CR1 & ~TIM_CR1_UDIS;
+	if(timerWriteHook != nullptr)
+		timerWriteHook(TIMx);
+}
+
+void TIM_GenerateEvent(TIM_TypeDef* TIMx, uint16_t TIM_EventSource)
+{
+	TIMx->EGR = TIM_EventSource;
+	if(TIM_EventSource & TIM_EventSource_Update)
+		simTimerUpdateEvent(TIMx);
+}
+
+void TIM_SelectOnePulseMode(TIM_TypeDef* TIMx, uint16_t TIM_OPMode)
+{
+	TIMx->CR1 = (TIMx->CR1 & ~TIM_CR1_OPM) | TIM_OPMode;
+}
+
+void TIM_DMAConfig(TIM_TypeDef* TIMx, uint16_t TIM_DMABase, uint16_t TIM_DMABurstLength)
+{
+	TIMx->DCR = TIM_DMABase | TIM_DMABurstLength;
+}
+
+void TIM_DMACmd(TIM_TypeDef* TIMx, uint16_t TIM_DMASource, FunctionalState NewState)
+{
+	TIMx->DIER = NewState ? TIMx->DIER | TIM_DMASource : TIMx->DIER & ~TIM_DMASource;
+}
+
+void TIM_OCStructInit(TIM_OCInitTypeDef* TIM_OCInitStruct)
+{
+	TIM_OCInitStruct->TIM_OCMode = TIM_OCMode_Timing;
+	TIM_OCInitStruct->TIM_OutputState = TIM_OutputState_Disable;
+	TIM_OCInitStruct->TIM_OutputNState = TIM_OutputNState_Disable;
+	TIM_OCInitStruct->TIM_Pulse = 0;
+	TIM_OCInitStruct->TIM_OCPolarity = TIM_OCPolarity_High;
+	TIM_OCInitStruct->TIM_OCNPolarity = TIM_OCNPolarity_High;
+	TIM_OCInitStruct->TIM_OCIdleState = TIM_OCIdleState_Reset;
+	TIM_OCInitStruct->TIM_OCNIdleState = TIM_OCNIdleState_Reset;
+}
+
+void TIM_OC1Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct) { ocInit(TIMx, 1, TIM_OCInitStruct); }
+void TIM_OC2Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct) { ocInit(TIMx, 2, TIM_OCInitStruct); }
+void TIM_OC3Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct) { ocInit(TIMx, 3, TIM_OCInitStruct); }
+void TIM_OC4Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct) { ocInit(TIMx, 4, TIM_OCInitStruct); }
+
+void TIM_ICStructInit(TIM_ICInitTypeDef* TIM_ICInitStruct)
+{
+	TIM_ICInitStruct->TIM_Channel = TIM_Channel_1;
+	TIM_ICInitStruct->TIM_ICPolarity = TIM_ICPolarity_Rising;
+	TIM_ICInitStruct->TIM_ICSelection = TIM_ICSelection_DirectTI;
+	TIM_ICInitStruct->TIM_ICPrescaler = TIM_ICPSC_DIV1;
+	TIM_ICInitStruct->TIM_ICFilter = 0;
+}
+
+void TIM_ICInit(TIM_TypeDef* TIMx, TIM_ICInitTypeDef* TIM_ICInitStruct)
+{
+	uint8_t index = TIM_ICInitStruct->TIM_Channel / 4;
+	__IO uint32_t& ccmr = index < 2 ? TIMx->CCMR1 : TIMx->CCMR2;
+	uint32_t shift = 8 * (index % 2);
+	uint32_t mode = TIM_ICInitStruct->TIM_ICSelection | TIM_ICInitStruct->TIM_ICPrescaler |
+					TIM_ICInitStruct->TIM_ICFilter << 4;
+	ccmr = (ccmr & ~(0xFF << shift)) | mode << shift;
+	TIMx->CCER |= (uint32_t)(1 | TIM_ICInitStruct->TIM_ICPolarity) << (4 * index);
+}
+
+void TIM_ITConfig(TIM_TypeDef* TIMx, uint16_t TIM_IT, FunctionalState NewState)
+{
+	TIMx->DIER = NewState ? TIMx->DIER | TIM_IT : TIMx->DIER & ~TIM_IT;
+}
+
+void TIM_ClearITPendingBit(TIM_TypeDef* TIMx, uint16_t TIM_IT)
+{
+	TIMx->SR = ~(uint32_t)TIM_IT;
+}
+
+uint32_t TIM_GetCapture1(TIM_TypeDef* TIMx) { return TIMx->CCR1; }
+uint32_t TIM_GetCapture2(TIM_TypeDef* TIMx) { return TIMx->CCR2; }
+uint32_t TIM_GetCapture3(TIM_TypeDef* TIMx) { return TIMx->CCR3; }
+uint32_t TIM_GetCapture4(TIM_TypeDef* TIMx) { return TIMx->CCR4; }
+
+void TIM_OC1PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload) { preloadConfig(TIMx, 1, TIM_OCPreload); }
+void TIM_OC2PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload) { preloadConfig(TIMx, 2, TIM_OCPreload); }
+void TIM_OC3PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload) { preloadConfig(TIMx, 3, TIM_OCPreload); }
+void TIM_OC4PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload) { preloadConfig(TIMx, 4, TIM_OCPreload); }
+
+void TIM_SetCompare1(TIM_TypeDef* TIMx, uint32_t Compare1) { setCompare(TIMx, 1, Compare1); }
+void TIM_SetCompare2(TIM_TypeDef* TIMx, uint32_t Compare2) { setCompare(TIMx, 2, Compare2); }
+void TIM_SetCompare3(TIM_TypeDef* TIMx, uint32_t Compare3) { setCompare(TIMx, 3, Compare3); }
+void TIM_SetCompare4(TIM_TypeDef* TIMx, uint32_t Compare4) { setCompare(TIMx, 4, Compare4); }
+
+// --- DMA ---
+// Transfers are made by simDmaTransfer
+
+void DMA_DeInit(DMA_Channel_TypeDef* DMAy_Channelx)
+{
+	std::memset((void*)DMAy_Channelx, 0, sizeof(DMA_Channel_TypeDef));
+}
+
+void DMA_Init(DMA_Channel_TypeDef* DMAy_Channelx, DMA_InitTypeDef* DMA_InitStruct)
+{
+	DMAy_Channelx->CCR = DMA_InitStruct->DMA_DIR | DMA_InitStruct->DMA_Mode | DMA_InitStruct->DMA_PeripheralInc |
+						 DMA_InitStruct->DMA_MemoryInc | DMA_InitStruct->DMA_PeripheralDataSize |
+						 DMA_InitStruct->DMA_MemoryDataSize | DMA_InitStruct->DMA_Priority | DMA_InitStruct->DMA_M2M;
+	DMAy_Channelx->CNDTR = DMA_InitStruct->DMA_BufferSize;
+	DMAy_Channelx->bufferSize = DMA_InitStruct->DMA_BufferSize;
+	DMAy_Channelx->CPAR = DMA_InitStruct->DMA_PeripheralBaseAddr;
+	DMAy_Channelx->CMAR = DMA_InitStruct->DMA_MemoryBaseAddr;
+}
+
+void DMA_StructInit(DMA_InitTypeDef* DMA_InitStruct)
+{
+	std::memset(DMA_InitStruct, 0, sizeof(DMA_InitTypeDef));
+}
+
+void DMA_Cmd(DMA_Channel_TypeDef* DMAy_Channelx, FunctionalState NewState)
+{
+	DMAy_Channelx->CCR = NewState ? DMAy_Channelx->CCR | DMA_CCR_EN : DMAy_Channelx->CCR & ~DMA_CCR_EN;
+}
+
+void DMA_SetCurrDataCounter(DMA_Channel_TypeDef* DMAy_Channelx, uint16_t DataNumber)
+{
+	DMAy_Channelx->CNDTR = DataNumber;
+}
+
+uint16_t DMA_GetCurrDataCounter(DMA_Channel_TypeDef* DMAy_Channelx)
+{
+	return DMAy_Channelx->CNDTR;
+}
+
+// --- USART ---
+// Bytes are moved by simUartReceive and simUartTransmit
+
+void USART_Init(USART_TypeDef* USARTx, USART_InitTypeDef* USART_InitStruct)
+{
+	USARTx->CR1 = (USARTx->CR1 & USART_CR1_UE) | USART_InitStruct->USART_WordLength | USART_InitStruct->USART_Parity |
+				  USART_InitStruct->USART_Mode;
+	USARTx->CR2 = (USARTx->CR2 & ~USART_StopBits_2) | USART_InitStruct->USART_StopBits;
+	USARTx->BRR = SystemCoreClock / USART_InitStruct->USART_BaudRate;
+	// Transmitter is idle
+	USARTx->ISR |= USART_ISR_TXE | USART_ISR_TC;
+}
+
+void USART_Cmd(USART_TypeDef* USARTx, FunctionalState NewState)
+{
+	USARTx->CR1 = NewState ? USARTx->CR1 | USART_CR1_UE : USARTx->CR1 & ~USART_CR1_UE;
+}
+
+void USART_ITConfig(USART_TypeDef* USARTx, uint32_t USART_IT, FunctionalState NewState)
+{
+	__IO uint32_t* control[] = {&USARTx->CR1, &USARTx->CR2, &USARTx->CR3};
+	__IO uint32_t& reg = *control[((USART_IT >> 8) & 0x3) - 1];
+	uint32_t bit = 1 << (USART_IT & 0x1F);
+	reg = NewState ? reg | bit : reg & ~bit;
+}
+
+void USART_DMACmd(USART_TypeDef* USARTx, uint32_t USART_DMAReq, FunctionalState NewState)
+{
+	USARTx->CR3 = NewState ? USARTx->CR3 | USART_DMAReq : USARTx->CR3 & ~USART_DMAReq;
+}
+
+void USART_InvPinCmd(USART_TypeDef* USARTx, uint32_t USART_InvPin, FunctionalState NewState)
+{
+	USARTx->CR2 = NewState ? USARTx->CR2 | USART_InvPin : USARTx->CR2 & ~USART_InvPin;
+}
+
+void USART_SendData(USART_TypeDef* USARTx, uint16_t Data)
+{
+	USARTx->TDR = Data & 0x1FF;
+	USARTx->ISR &= ~(USART_ISR_TXE | USART_ISR_TC);
+}
+
+uint16_t USART_ReceiveData(USART_TypeDef* USARTx)
+{
+	// Reading RDR clears RXNE
+	USARTx->ISR &= ~USART_ISR_RXNE;
+	return USARTx->RDR & 0x1FF;
+}
@@ -0,0 +1,210 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Host replacement of the CMSIS device header. Only the parts used by the
+ * firmware modules compiled into the simulator are provided. Peripheral
+ * instances are plain structures in host memory, the simulation samples
+ * them the same way the hardware would.
+ */
+
+#ifndef __STM32F30x_H
+#define __STM32F30x_H
+
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef enum {RESET = 0, SET = !RESET} FlagStatus, ITStatus;
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+typedef enum {ERROR = 0, SUCCESS = !ERROR} ErrorStatus;
+
+typedef enum
+{
+	SysTick_IRQn	= -1,
+	EXTI0_IRQn		= 6,
+	TIM3_IRQn		= 29,
+	USART1_IRQn		= 37,
+	USART2_IRQn		= 38,
+	USART3_IRQn		= 39,
+	UART4_IRQn		= 52,
+	UART5_IRQn		= 53
+} IRQn_Type;
+
+typedef struct
+{
+	__IO uint32_t CR1;
+	__IO uint32_t CR2;
+	__IO uint32_t SMCR;
+	__IO uint32_t DIER;
+	__IO uint32_t SR;
+	__IO uint32_t EGR;
+	__IO uint32_t CCMR1;
+	__IO uint32_t CCMR2;
+	__IO uint32_t CCER;
+	__IO uint32_t CNT;
+	__IO uint32_t PSC;
+	__IO uint32_t ARR;
+	__IO uint32_t RCR;
+	__IO uint32_t CCR1;
+	__IO uint32_t CCR2;
+	__IO uint32_t CCR3;
+	__IO uint32_t CCR4;
+	__IO uint32_t BDTR;
+	__IO uint32_t DCR;
+	__IO uint32_t DMAR;
+
+	// Not a register - compare values currently driving the outputs.
+	// Preloaded CCRx are copied here on update event by the simulation.
+	uint32_t activeCCR[4];
+	// Not a register - status flags as hardware holds them. SR bits written
+	// as zero are cleared from here at the next simulated event.
+	uint32_t statusFlags;
+} TIM_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t MODER;
+	__IO uint16_t OTYPER;
+	__IO uint32_t OSPEEDR;
+	__IO uint32_t PUPDR;
+	__IO uint16_t IDR;
+	__IO uint16_t ODR;
+	__IO uint32_t AFR[2];
+} GPIO_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t CCR;
+	__IO uint32_t CNDTR;
+	__IO uintptr_t CPAR;
+	__IO uintptr_t CMAR;
+
+	// Not a register - transfer count reloaded in circular mode
+	uint16_t bufferSize;
+} DMA_Channel_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t CR1;
+	__IO uint32_t CR2;
+	__IO uint32_t CR3;
+	__IO uint32_t BRR;
+	__IO uint32_t GTPR;
+	__IO uint32_t RTOR;
+	__IO uint32_t RQR;
+	__IO uint32_t ISR;
+	__IO uint32_t ICR;
+	__IO uint32_t RDR;
+	__IO uint32_t TDR;
+} USART_TypeDef;
+
+typedef struct
+{
+	__IO uint32_t CR1;
+	__IO uint32_t CR2;
+	__IO uint32_t OAR1;
+	__IO uint32_t OAR2;
+	__IO uint32_t TIMINGR;
+	__IO uint32_t TIMEOUTR;
+	__IO uint32_t ISR;
+	__IO uint32_t ICR;
+	__IO uint32_t PECR;
+	__IO uint32_t RXDR;
+	__IO uint32_t TXDR;
+} I2C_TypeDef;
+
+extern uint32_t SystemCoreClock;
+
+extern TIM_TypeDef simTIM1, simTIM2, simTIM3, simTIM4, simTIM8;
+extern GPIO_TypeDef simGPIOA, simGPIOB, simGPIOC, simGPIOD, simGPIOE, simGPIOF;
+extern DMA_Channel_TypeDef simDMA1_Channel3, simDMA1_Channel5, simDMA1_Channel6;
+extern USART_TypeDef simUSART1, simUSART2, simUSART3, simUART4, simUART5;
+extern I2C_TypeDef simI2C1;
+
+#define TIM1	(&simTIM1)
+#define TIM2	(&simTIM2)
+#define TIM3	(&simTIM3)
+#define TIM4	(&simTIM4)
+#define TIM8	(&simTIM8)
+
+#define GPIOA	(&simGPIOA)
+#define GPIOB	(&simGPIOB)
+#define GPIOC	(&simGPIOC)
+#define GPIOD	(&simGPIOD)
+#define GPIOE	(&simGPIOE)
+#define GPIOF	(&simGPIOF)
+
+#define DMA1_Channel3	(&simDMA1_Channel3)
+#define DMA1_Channel5	(&simDMA1_Channel5)
+#define DMA1_Channel6	(&simDMA1_Channel6)
+
+#define USART1	(&simUSART1)
+#define USART2	(&simUSART2)
+#define USART3	(&simUSART3)
+#define UART4	(&simUART4)
+#define UART5	(&simUART5)
+
+#define I2C1	(&simI2C1)
+
+#define TIM_CR1_CEN		((uint16_t)0x0001)
+#define TIM_CR1_UDIS	((uint16_t)0x0002)
+#define TIM_CR1_OPM		((uint16_t)0x0008)
+#define TIM_CR1_ARPE	((uint16_t)0x0080)
+#define TIM_BDTR_MOE	((uint32_t)0x00008000)
+#define TIM_EGR_UG		((uint16_t)0x0001)
+#define DMA_CCR_EN		((uint32_t)0x00000001)
+
+#define USART_CR1_UE		((uint32_t)0x00000001)
+#define USART_CR1_RXNEIE	((uint32_t)0x00000020)
+#define USART_CR1_TXEIE		((uint32_t)0x00000080)
+#define USART_ISR_ORE		((uint32_t)0x00000008)
+#define USART_ISR_RXNE		((uint32_t)0x00000020)
+#define USART_ISR_TC		((uint32_t)0x00000040)
+#define USART_ISR_TXE		((uint32_t)0x00000080)
+#define USART_ICR_ORECF		((uint32_t)0x00000008)
+
+#define I2C_ISR_TXIS		((uint32_t)0x00000002)
+#define I2C_ISR_RXNE		((uint32_t)0x00000004)
+#define I2C_ISR_STOPF		((uint32_t)0x00000020)
+#define I2C_ISR_TC			((uint32_t)0x00000040)
+#define I2C_ISR_BUSY		((uint32_t)0x00008000)
+#define I2C_ICR_STOPCF		((uint32_t)0x00000020)
+
+// Host code has no interrupts to mask
+inline uint32_t __get_PRIMASK(void) { return 0; }
+inline void __set_PRIMASK(uint32_t) {}
+inline void __disable_irq(void) {}
+
+#include "stm32f30x_gpio.h"
+#include "stm32f30x_rcc.h"
+#include "stm32f30x_tim.h"
+#include "stm32f30x_misc.h"
+#include "stm32f30x_dma.h"
+#include "stm32f30x_usart.h"
+#include "stm32f30x_i2c.h"
+#include "stm32f30x_flash.h"
+
+#endif
@@ -0,0 +1,73 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef __STM32F30x_DMA_H
+#define __STM32F30x_DMA_H
+
+#include "stm32f30x.h"
+
+typedef struct
+{
+	// Addresses are pointer sized on the host
+	uintptr_t DMA_PeripheralBaseAddr;
+	uintptr_t DMA_MemoryBaseAddr;
+	uint32_t DMA_DIR;
+	uint16_t DMA_BufferSize;
+	uint32_t DMA_PeripheralInc;
+	uint32_t DMA_MemoryInc;
+	uint32_t DMA_PeripheralDataSize;
+	uint32_t DMA_MemoryDataSize;
+	uint32_t DMA_Mode;
+	uint32_t DMA_Priority;
+	uint32_t DMA_M2M;
+} DMA_InitTypeDef;
+
+#define DMA_DIR_PeripheralSRC				((uint32_t)0x00000000)
+#define DMA_DIR_PeripheralDST				((uint32_t)0x00000010)
+#define DMA_Mode_Normal						((uint32_t)0x00000000)
+#define DMA_Mode_Circular					((uint32_t)0x00000020)
+#define DMA_PeripheralInc_Disable			((uint32_t)0x00000000)
+#define DMA_PeripheralInc_Enable			((uint32_t)0x00000040)
+#define DMA_MemoryInc_Disable				((uint32_t)0x00000000)
+#define DMA_MemoryInc_Enable				((uint32_t)0x00000080)
+#define DMA_PeripheralDataSize_Byte			((uint32_t)0x00000000)
+#define DMA_PeripheralDataSize_HalfWord		((uint32_t)0x00000100)
+#define DMA_PeripheralDataSize_Word			((uint32_t)0x00000200)
+#define DMA_MemoryDataSize_Byte				((uint32_t)0x00000000)
+#define DMA_MemoryDataSize_HalfWord			((uint32_t)0x00000400)
+#define DMA_MemoryDataSize_Word				((uint32_t)0x00000800)
+#define DMA_Priority_Medium					((uint32_t)0x00001000)
+#define DMA_Priority_High					((uint32_t)0x00002000)
+#define DMA_Priority_VeryHigh				((uint32_t)0x00003000)
+#define DMA_M2M_Disable						((uint32_t)0x00000000)
+
+void DMA_DeInit(DMA_Channel_TypeDef* DMAy_Channelx);
+void DMA_Init(DMA_Channel_TypeDef* DMAy_Channelx, DMA_InitTypeDef* DMA_InitStruct);
+void DMA_StructInit(DMA_InitTypeDef* DMA_InitStruct);
+void DMA_Cmd(DMA_Channel_TypeDef* DMAy_Channelx, FunctionalState NewState);
+void DMA_SetCurrDataCounter(DMA_Channel_TypeDef* DMAy_Channelx, uint16_t DataNumber);
+uint16_t DMA_GetCurrDataCounter(DMA_Channel_TypeDef* DMAy_Channelx);
+
+#endif
@@ -0,0 +1,68 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef __STM32F30x_FLASH_H
+#define __STM32F30x_FLASH_H
+
+#include "stm32f30x.h"
+
+typedef enum
+{
+	FLASH_BUSY = 1,
+	FLASH_ERROR_WRP,
+	FLASH_ERROR_PROGRAM,
+	FLASH_COMPLETE,
+	FLASH_TIMEOUT
+} FLASH_Status;
+
+#define FLASH_FLAG_BSY		((uint32_t)0x00000001)
+#define FLASH_FLAG_PGERR	((uint32_t)0x00000004)
+#define FLASH_FLAG_WRPERR	((uint32_t)0x00000010)
+#define FLASH_FLAG_EOP		((uint32_t)0x00000020)
+
+void FLASH_Unlock(void);
+void FLASH_Lock(void);
+void FLASH_ClearFlag(uint32_t FLASH_FLAG);
+FLASH_Status FLASH_ErasePage(uint32_t Page_Address);
+FLASH_Status FLASH_ProgramHalfWord(uint32_t Address, uint16_t Data);
+
+// Top pages of simulated flash are host memory mapped at their target
+// address, firmware reads them through plain pointers. Flash starts
+// erased on every run.
+
+// Fault injection. Power is lost during the given erase or program
+// operation counted from now: an erase leaves part of the page erased, a
+// halfword keeps some of its bits unprogrammed and every later operation
+// times out until simFlashPowerUp(). Zero disables the injection.
+void simFlashPowerLoss(uint32_t operation, uint32_t seed);
+void simFlashPowerUp();
+// Makes program operations fail with FLASH_ERROR_PROGRAM while set
+void simFlashProgramErrors(bool enable);
+// Operations performed so far
+uint32_t simFlashOperations();
+// Erases whole simulated flash, as a new chip
+void simFlashReset();
+
+#endif
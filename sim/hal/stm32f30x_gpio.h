@@ -0,0 +1,78 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef __STM32F30x_GPIO_H
+#define __STM32F30x_GPIO_H
+
+#include "stm32f30x.h"
+
+typedef enum
+{
+	GPIO_Mode_IN	= 0x00,
+	GPIO_Mode_OUT	= 0x01,
+	GPIO_Mode_AF	= 0x02,
+	GPIO_Mode_AN	= 0x03
+} GPIOMode_TypeDef;
+
+typedef enum
+{
+	GPIO_OType_PP	= 0x00,
+	GPIO_OType_OD	= 0x01
+} GPIOOType_TypeDef;
+
+typedef enum
+{
+	GPIO_Speed_Level_1	= 0x01,
+	GPIO_Speed_Level_2	= 0x02,
+	GPIO_Speed_Level_3	= 0x03
+} GPIOSpeed_TypeDef;
+
+#define GPIO_Speed_10MHz	GPIO_Speed_Level_1
+#define GPIO_Speed_2MHz		GPIO_Speed_Level_2
+#define GPIO_Speed_50MHz	GPIO_Speed_Level_3
+
+typedef enum
+{
+	GPIO_PuPd_NOPULL	= 0x00,
+	GPIO_PuPd_UP		= 0x01,
+	GPIO_PuPd_DOWN		= 0x02
+} GPIOPuPd_TypeDef;
+
+typedef struct
+{
+	uint32_t GPIO_Pin;
+	GPIOMode_TypeDef GPIO_Mode;
+	GPIOSpeed_TypeDef GPIO_Speed;
+	GPIOOType_TypeDef GPIO_OType;
+	GPIOPuPd_TypeDef GPIO_PuPd;
+} GPIO_InitTypeDef;
+
+#define GPIO_Pin_All	((uint16_t)0xFFFF)
+
+void GPIO_StructInit(GPIO_InitTypeDef* GPIO_InitStruct);
+void GPIO_Init(GPIO_TypeDef* GPIOx, GPIO_InitTypeDef* GPIO_InitStruct);
+void GPIO_PinAFConfig(GPIO_TypeDef* GPIOx, uint16_t GPIO_PinSource, uint8_t GPIO_AF);
+
+#endif
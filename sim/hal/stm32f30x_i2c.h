@@ -0,0 +1,48 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef __STM32F30x_I2C_H
+#define __STM32F30x_I2C_H
+
+#include "stm32f30x.h"
+
+#define I2C_Reload_Mode					((uint32_t)0x01000000)
+#define I2C_AutoEnd_Mode				((uint32_t)0x02000000)
+#define I2C_SoftEnd_Mode				((uint32_t)0x00000000)
+
+#define I2C_No_StartStop				((uint32_t)0x00000000)
+#define I2C_Generate_Stop				((uint32_t)0x00004000)
+#define I2C_Generate_Start_Read			((uint32_t)0x00002400)
+#define I2C_Generate_Start_Write		((uint32_t)0x00002000)
+
+// Transfers complete within the call, the bus is never busy in between
+void I2C_TransferHandling(I2C_TypeDef* I2Cx, uint16_t Address, uint8_t Number, uint32_t ReloadEndMode,
+						  uint32_t StartStopMode);
+FlagStatus I2C_GetFlagStatus(I2C_TypeDef* I2Cx, uint32_t I2C_FLAG);
+void I2C_ClearFlag(I2C_TypeDef* I2Cx, uint32_t I2C_FLAG);
+void I2C_SendData(I2C_TypeDef* I2Cx, uint8_t Data);
+uint8_t I2C_ReceiveData(I2C_TypeDef* I2Cx);
+
+#endif
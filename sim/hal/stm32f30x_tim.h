@@ -0,0 +1,151 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef __STM32F30x_TIM_H
+#define __STM32F30x_TIM_H
+
+#include "stm32f30x.h"
+
+typedef struct
+{
+	uint16_t TIM_Prescaler;
+	uint16_t TIM_CounterMode;
+	uint32_t TIM_Period;
+	uint16_t TIM_ClockDivision;
+	uint8_t TIM_RepetitionCounter;
+} TIM_TimeBaseInitTypeDef;
+
+typedef struct
+{
+	uint32_t TIM_OCMode;
+	uint16_t TIM_OutputState;
+	uint16_t TIM_OutputNState;
+	uint32_t TIM_Pulse;
+	uint16_t TIM_OCPolarity;
+	uint16_t TIM_OCNPolarity;
+	uint16_t TIM_OCIdleState;
+	uint16_t TIM_OCNIdleState;
+} TIM_OCInitTypeDef;
+
+typedef struct
+{
+	uint16_t TIM_Channel;
+	uint16_t TIM_ICPolarity;
+	uint16_t TIM_ICSelection;
+	uint16_t TIM_ICPrescaler;
+	uint16_t TIM_ICFilter;
+} TIM_ICInitTypeDef;
+
+#define IS_TIM_LIST6_PERIPH(PERIPH)	(((PERIPH) == TIM1) || ((PERIPH) == TIM8))
+
+#define TIM_CounterMode_Up			((uint16_t)0x0000)
+
+#define TIM_OCMode_Timing			((uint32_t)0x00000)
+#define TIM_OCMode_PWM1				((uint32_t)0x00060)
+#define TIM_OCMode_PWM2				((uint32_t)0x00070)
+
+#define TIM_OutputState_Disable		((uint16_t)0x0000)
+#define TIM_OutputState_Enable		((uint16_t)0x0001)
+#define TIM_OutputNState_Disable	((uint16_t)0x0000)
+
+#define TIM_OCPolarity_High			((uint16_t)0x0000)
+#define TIM_OCPolarity_Low			((uint16_t)0x0002)
+#define TIM_OCNPolarity_High		((uint16_t)0x0000)
+
+#define TIM_OCIdleState_Set			((uint16_t)0x0100)
+#define TIM_OCIdleState_Reset		((uint16_t)0x0000)
+#define TIM_OCNIdleState_Reset		((uint16_t)0x0000)
+
+#define TIM_OCPreload_Enable		((uint16_t)0x0008)
+#define TIM_OCPreload_Disable		((uint16_t)0x0000)
+
+#define TIM_EventSource_Update		((uint16_t)0x0001)
+
+#define TIM_OPMode_Single			((uint16_t)0x0008)
+#define TIM_OPMode_Repetitive		((uint16_t)0x0000)
+
+#define TIM_Channel_1				((uint16_t)0x0000)
+#define TIM_Channel_2				((uint16_t)0x0004)
+#define TIM_Channel_3				((uint16_t)0x0008)
+#define TIM_Channel_4				((uint16_t)0x000C)
+
+#define TIM_ICPolarity_Rising		((uint16_t)0x0000)
+#define TIM_ICPolarity_BothEdge		((uint16_t)0x000A)
+#define TIM_ICSelection_DirectTI	((uint16_t)0x0001)
+#define TIM_ICPSC_DIV1				((uint16_t)0x0000)
+
+// Interrupt enable bits of DIER, same positions as flags of SR
+#define TIM_IT_Update				((uint16_t)0x0001)
+#define TIM_IT_CC1					((uint16_t)0x0002)
+#define TIM_IT_CC2					((uint16_t)0x0004)
+#define TIM_IT_CC3					((uint16_t)0x0008)
+#define TIM_IT_CC4					((uint16_t)0x0010)
+
+#define TIM_DMA_Update				((uint16_t)0x0100)
+#define TIM_DMA_CC1					((uint16_t)0x0200)
+#define TIM_DMA_CC2					((uint16_t)0x0400)
+#define TIM_DMA_CC3					((uint16_t)0x0800)
+#define TIM_DMA_CC4					((uint16_t)0x1000)
+#define TIM_DMABase_CCR1			((uint16_t)0x000D)
+#define TIM_DMABurstLength_1Transfer	((uint16_t)0x0000)
+#define TIM_DMABurstLength_3Transfers	((uint16_t)0x0200)
+#define TIM_DMABurstLength_4Transfers	((uint16_t)0x0300)
+
+void TIM_DeInit(TIM_TypeDef* TIMx);
+void TIM_TimeBaseInit(TIM_TypeDef* TIMx, TIM_TimeBaseInitTypeDef* TIM_TimeBaseInitStruct);
+void TIM_TimeBaseStructInit(TIM_TimeBaseInitTypeDef* TIM_TimeBaseInitStruct);
+void TIM_ARRPreloadConfig(TIM_TypeDef* TIMx, FunctionalState NewState);
+void TIM_Cmd(TIM_TypeDef* TIMx, FunctionalState NewState);
+void TIM_CtrlPWMOutputs(TIM_TypeDef* TIMx, FunctionalState NewState);
+void TIM_UpdateDisableConfig(TIM_TypeDef* TIMx, FunctionalState NewState);
+void TIM_GenerateEvent(TIM_TypeDef* TIMx, uint16_t TIM_EventSource);
+void TIM_SelectOnePulseMode(TIM_TypeDef* TIMx, uint16_t TIM_OPMode);
+void TIM_DMAConfig(TIM_TypeDef* TIMx, uint16_t TIM_DMABase, uint16_t TIM_DMABurstLength);
+void TIM_DMACmd(TIM_TypeDef* TIMx, uint16_t TIM_DMASource, FunctionalState NewState);
+
+void TIM_OCStructInit(TIM_OCInitTypeDef* TIM_OCInitStruct);
+void TIM_OC1Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct);
+void TIM_OC2Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct);
+void TIM_OC3Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct);
+void TIM_OC4Init(TIM_TypeDef* TIMx, TIM_OCInitTypeDef* TIM_OCInitStruct);
+void TIM_OC1PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload);
+void TIM_OC2PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload);
+void TIM_OC3PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload);
+void TIM_OC4PreloadConfig(TIM_TypeDef* TIMx, uint16_t TIM_OCPreload);
+void TIM_SetCompare1(TIM_TypeDef* TIMx, uint32_t Compare1);
+void TIM_SetCompare2(TIM_TypeDef* TIMx, uint32_t Compare2);
+void TIM_SetCompare3(TIM_TypeDef* TIMx, uint32_t Compare3);
+void TIM_SetCompare4(TIM_TypeDef* TIMx, uint32_t Compare4);
+
+void TIM_ICStructInit(TIM_ICInitTypeDef* TIM_ICInitStruct);
+void TIM_ICInit(TIM_TypeDef* TIMx, TIM_ICInitTypeDef* TIM_ICInitStruct);
+void TIM_ITConfig(TIM_TypeDef* TIMx, uint16_t TIM_IT, FunctionalState NewState);
+void TIM_ClearITPendingBit(TIM_TypeDef* TIMx, uint16_t TIM_IT);
+uint32_t TIM_GetCapture1(TIM_TypeDef* TIMx);
+uint32_t TIM_GetCapture2(TIM_TypeDef* TIMx);
+uint32_t TIM_GetCapture3(TIM_TypeDef* TIMx);
+uint32_t TIM_GetCapture4(TIM_TypeDef* TIMx);
+
+#endif
@@ -0,0 +1,69 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef __STM32F30x_USART_H
+#define __STM32F30x_USART_H
+
+#include "stm32f30x.h"
+
+typedef struct
+{
+	uint32_t USART_BaudRate;
+	uint32_t USART_WordLength;
+	uint32_t USART_StopBits;
+	uint32_t USART_Parity;
+	uint32_t USART_Mode;
+	uint32_t USART_HardwareFlowControl;
+} USART_InitTypeDef;
+
+#define USART_WordLength_8b				((uint32_t)0x00000000)
+#define USART_WordLength_9b				((uint32_t)0x00001000)
+#define USART_StopBits_1				((uint32_t)0x00000000)
+#define USART_StopBits_2				((uint32_t)0x00002000)
+#define USART_Parity_No					((uint32_t)0x00000000)
+#define USART_Parity_Even				((uint32_t)0x00000400)
+#define USART_Parity_Odd				((uint32_t)0x00000600)
+#define USART_Mode_Rx					((uint32_t)0x00000004)
+#define USART_Mode_Tx					((uint32_t)0x00000008)
+#define USART_HardwareFlowControl_None	((uint32_t)0x00000000)
+
+// Register index in bits 8-9 (1 is CR1), enable bit position in bits 0-4
+#define USART_IT_RXNE					((uint32_t)0x00050105)
+#define USART_IT_TXE					((uint32_t)0x00070107)
+
+#define USART_DMAReq_Rx					((uint32_t)0x00000040)
+#define USART_DMAReq_Tx					((uint32_t)0x00000080)
+#define USART_InvPin_Rx					((uint32_t)0x00010000)
+#define USART_InvPin_Tx					((uint32_t)0x00020000)
+
+void USART_Init(USART_TypeDef* USARTx, USART_InitTypeDef* USART_InitStruct);
+void USART_Cmd(USART_TypeDef* USARTx, FunctionalState NewState);
+void USART_ITConfig(USART_TypeDef* USARTx, uint32_t USART_IT, FunctionalState NewState);
+void USART_DMACmd(USART_TypeDef* USARTx, uint32_t USART_DMAReq, FunctionalState NewState);
+void USART_InvPinCmd(USART_TypeDef* USARTx, uint32_t USART_InvPin, FunctionalState NewState);
+void USART_SendData(USART_TypeDef* USARTx, uint16_t Data);
+uint16_t USART_ReceiveData(USART_TypeDef* USARTx);
+
+#endif
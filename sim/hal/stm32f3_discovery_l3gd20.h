@@ -0,0 +1,116 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Host replacement of the L3GD20 board support driver. Register accesses
+ * are served by the simulated sensor (see sim/inc/l3gd20Model.h).
+ */
+
+#ifndef __STM32F3_DISCOVERY_L3GD20_H
+#define __STM32F3_DISCOVERY_L3GD20_H
+
+#include "stm32f30x.h"
+
+typedef struct
+{
+	uint8_t Power_Mode;
+	uint8_t Output_DataRate;
+	uint8_t Axes_Enable;
+	uint8_t Band_Width;
+	uint8_t BlockData_Update;
+	uint8_t Endianness;
+	uint8_t Full_Scale;
+} L3GD20_InitTypeDef;
+
+typedef struct
+{
+	uint8_t HighPassFilter_Mode_Selection;
+	uint8_t HighPassFilter_CutOff_Frequency;
+} L3GD20_FilterConfigTypeDef;
+
+#define L3GD20_WHO_AM_I_ADDR			0x0F
+#define L3GD20_CTRL_REG1_ADDR			0x20
+#define L3GD20_CTRL_REG2_ADDR			0x21
+#define L3GD20_CTRL_REG3_ADDR			0x22
+#define L3GD20_CTRL_REG4_ADDR			0x23
+#define L3GD20_CTRL_REG5_ADDR			0x24
+#define L3GD20_REFERENCE_REG_ADDR		0x25
+#define L3GD20_OUT_TEMP_ADDR			0x26
+#define L3GD20_STATUS_REG_ADDR			0x27
+#define L3GD20_OUT_X_L_ADDR				0x28
+#define L3GD20_OUT_X_H_ADDR				0x29
+#define L3GD20_OUT_Y_L_ADDR				0x2A
+#define L3GD20_OUT_Y_H_ADDR				0x2B
+#define L3GD20_OUT_Z_L_ADDR				0x2C
+#define L3GD20_OUT_Z_H_ADDR				0x2D
+#define L3GD20_FIFO_CTRL_REG_ADDR		0x2E
+#define L3GD20_FIFO_SRC_REG_ADDR		0x2F
+
+#define I_AM_L3GD20						((uint8_t)0xD4)
+
+#define L3GD20_MODE_POWERDOWN			((uint8_t)0x00)
+#define L3GD20_MODE_ACTIVE				((uint8_t)0x08)
+
+#define L3GD20_OUTPUT_DATARATE_1		((uint8_t)0x00)
+#define L3GD20_OUTPUT_DATARATE_2		((uint8_t)0x40)
+#define L3GD20_OUTPUT_DATARATE_3		((uint8_t)0x80)
+#define L3GD20_OUTPUT_DATARATE_4		((uint8_t)0xC0)
+
+#define L3GD20_AXES_ENABLE				((uint8_t)0x07)
+
+#define L3GD20_BANDWIDTH_1				((uint8_t)0x00)
+#define L3GD20_BANDWIDTH_2				((uint8_t)0x10)
+#define L3GD20_BANDWIDTH_3				((uint8_t)0x20)
+#define L3GD20_BANDWIDTH_4				((uint8_t)0x30)
+
+#define L3GD20_FULLSCALE_250			((uint8_t)0x00)
+#define L3GD20_FULLSCALE_500			((uint8_t)0x10)
+#define L3GD20_FULLSCALE_2000			((uint8_t)0x20)
+
+#define L3GD20_BlockDataUpdate_Continous	((uint8_t)0x00)
+#define L3GD20_BlockDataUpdate_Single		((uint8_t)0x80)
+
+#define L3GD20_BLE_LSB					((uint8_t)0x00)
+#define L3GD20_BLE_MSB					((uint8_t)0x40)
+
+#define L3GD20_HPM_NORMAL_MODE_RES		((uint8_t)0x00)
+#define L3GD20_HPM_REF_SIGNAL			((uint8_t)0x10)
+#define L3GD20_HPM_NORMAL_MODE			((uint8_t)0x20)
+#define L3GD20_HPM_AUTORESET_INT		((uint8_t)0x30)
+
+#define L3GD20_HPFCF_0					0x00
+#define L3GD20_HPFCF_1					0x01
+#define L3GD20_HPFCF_2					0x02
+
+#define L3GD20_HIGHPASSFILTER_DISABLE	((uint8_t)0x00)
+#define L3GD20_HIGHPASSFILTER_ENABLE	((uint8_t)0x10)
+
+void L3GD20_Init(L3GD20_InitTypeDef* L3GD20_InitStruct);
+void L3GD20_FilterConfig(L3GD20_FilterConfigTypeDef* L3GD20_FilterStruct);
+void L3GD20_FilterCmd(uint8_t HighPassFilterState);
+void L3GD20_Write(uint8_t* pBuffer, uint8_t WriteAddr, uint16_t NumByteToWrite);
+void L3GD20_Read(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead);
+
+#endif
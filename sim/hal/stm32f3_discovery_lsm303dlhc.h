@@ -0,0 +1,177 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Host replacement of the LSM303DLHC board support driver. Register
+ * accesses are served by the simulated sensor (see sim/inc/lsm303dlhcModel.h),
+ * same as direct transfers on LSM303DLHC_I2C (see sim/hal/bsp.cpp).
+ */
+
+#ifndef __STM32F3_DISCOVERY_LSM303DLHC_H
+#define __STM32F3_DISCOVERY_LSM303DLHC_H
+
+#include "stm32f30x.h"
+
+typedef struct
+{
+	uint8_t Power_Mode;
+	uint8_t AccOutput_DataRate;
+	uint8_t Axes_Enable;
+	uint8_t High_Resolution;
+	uint8_t BlockData_Update;
+	uint8_t Endianness;
+	uint8_t AccFull_Scale;
+} LSM303DLHCAcc_InitTypeDef;
+
+typedef struct
+{
+	uint8_t HighPassFilter_Mode_Selection;
+	uint8_t HighPassFilter_CutOff_Frequency;
+	uint8_t HighPassFilter_AOI1;
+	uint8_t HighPassFilter_AOI2;
+} LSM303DLHCAcc_FilterConfigTypeDef;
+
+typedef struct
+{
+	uint8_t Temperature_Sensor;
+	uint8_t MagOutput_DataRate;
+	uint8_t Working_Mode;
+	uint8_t MagFull_Scale;
+} LSM303DLHCMag_InitTypeDef;
+
+#define LSM303DLHC_I2C					I2C1
+#define LSM303DLHC_FLAG_TIMEOUT			((uint32_t)0x1000)
+#define LSM303DLHC_LONG_TIMEOUT			((uint32_t)(10 * LSM303DLHC_FLAG_TIMEOUT))
+
+#define ACC_I2C_ADDRESS					0x32
+#define MAG_I2C_ADDRESS					0x3C
+
+#define LSM303DLHC_CTRL_REG1_A			0x20
+#define LSM303DLHC_CTRL_REG2_A			0x21
+#define LSM303DLHC_CTRL_REG3_A			0x22
+#define LSM303DLHC_CTRL_REG4_A			0x23
+#define LSM303DLHC_CTRL_REG5_A			0x24
+#define LSM303DLHC_CTRL_REG6_A			0x25
+#define LSM303DLHC_REFERENCE_A			0x26
+#define LSM303DLHC_STATUS_REG_A			0x27
+#define LSM303DLHC_OUT_X_L_A			0x28
+#define LSM303DLHC_OUT_X_H_A			0x29
+#define LSM303DLHC_OUT_Y_L_A			0x2A
+#define LSM303DLHC_OUT_Y_H_A			0x2B
+#define LSM303DLHC_OUT_Z_L_A			0x2C
+#define LSM303DLHC_OUT_Z_H_A			0x2D
+#define LSM303DLHC_FIFO_CTRL_REG_A		0x2E
+#define LSM303DLHC_FIFO_SRC_REG_A		0x2F
+
+#define LSM303DLHC_NORMAL_MODE			((uint8_t)0x00)
+#define LSM303DLHC_LOWPOWER_MODE		((uint8_t)0x08)
+
+#define LSM303DLHC_ODR_1_HZ				((uint8_t)0x10)
+#define LSM303DLHC_ODR_10_HZ			((uint8_t)0x20)
+#define LSM303DLHC_ODR_25_HZ			((uint8_t)0x30)
+#define LSM303DLHC_ODR_50_HZ			((uint8_t)0x40)
+#define LSM303DLHC_ODR_100_HZ			((uint8_t)0x50)
+#define LSM303DLHC_ODR_200_HZ			((uint8_t)0x60)
+#define LSM303DLHC_ODR_400_HZ			((uint8_t)0x70)
+#define LSM303DLHC_ODR_1620_HZ_LP		((uint8_t)0x80)
+#define LSM303DLHC_ODR_1344_HZ			((uint8_t)0x90)
+
+#define LSM303DLHC_AXES_ENABLE			((uint8_t)0x07)
+
+#define LSM303DLHC_HR_ENABLE			((uint8_t)0x08)
+#define LSM303DLHC_HR_DISABLE			((uint8_t)0x00)
+
+#define LSM303DLHC_FULLSCALE_2G			((uint8_t)0x00)
+#define LSM303DLHC_FULLSCALE_4G			((uint8_t)0x10)
+#define LSM303DLHC_FULLSCALE_8G			((uint8_t)0x20)
+#define LSM303DLHC_FULLSCALE_16G		((uint8_t)0x30)
+
+#define LSM303DLHC_BlockUpdate_Continous	((uint8_t)0x00)
+#define LSM303DLHC_BlockUpdate_Single		((uint8_t)0x80)
+
+#define LSM303DLHC_BLE_LSB				((uint8_t)0x00)
+#define LSM303DLHC_BLE_MSB				((uint8_t)0x40)
+
+#define LSM303DLHC_HPM_NORMAL_MODE_RES	((uint8_t)0x00)
+#define LSM303DLHC_HPM_REF_SIGNAL		((uint8_t)0x40)
+#define LSM303DLHC_HPM_NORMAL_MODE		((uint8_t)0x80)
+#define LSM303DLHC_HPM_AUTORESET_INT	((uint8_t)0xC0)
+
+#define LSM303DLHC_HPFCF_8				((uint8_t)0x00)
+#define LSM303DLHC_HPFCF_16				((uint8_t)0x10)
+#define LSM303DLHC_HPFCF_32				((uint8_t)0x20)
+#define LSM303DLHC_HPFCF_64				((uint8_t)0x30)
+
+#define LSM303DLHC_HPF_AOI1_DISABLE		((uint8_t)0x00)
+#define LSM303DLHC_HPF_AOI2_DISABLE		((uint8_t)0x00)
+
+#define LSM303DLHC_HIGHPASSFILTER_DISABLE	((uint8_t)0x00)
+#define LSM303DLHC_HIGHPASSFILTER_ENABLE	((uint8_t)0x08)
+
+#define LSM303DLHC_CRA_REG_M			0x00
+#define LSM303DLHC_CRB_REG_M			0x01
+#define LSM303DLHC_MR_REG_M				0x02
+#define LSM303DLHC_OUT_X_H_M			0x03
+#define LSM303DLHC_OUT_X_L_M			0x04
+#define LSM303DLHC_OUT_Z_H_M			0x05
+#define LSM303DLHC_OUT_Z_L_M			0x06
+#define LSM303DLHC_OUT_Y_H_M			0x07
+#define LSM303DLHC_OUT_Y_L_M			0x08
+#define LSM303DLHC_SR_REG_Mg			0x09
+#define LSM303DLHC_TEMP_OUT_H_M			0x31
+#define LSM303DLHC_TEMP_OUT_L_M			0x32
+
+#define LSM303DLHC_TEMPSENSOR_ENABLE	((uint8_t)0x80)
+#define LSM303DLHC_TEMPSENSOR_DISABLE	((uint8_t)0x00)
+
+#define LSM303DLHC_ODR_0_75_HZ			((uint8_t)0x00)
+#define LSM303DLHC_ODR_1_5_HZ			((uint8_t)0x04)
+#define LSM303DLHC_ODR_3_0_HZ			((uint8_t)0x08)
+#define LSM303DLHC_ODR_7_5_HZ			((uint8_t)0x0C)
+#define LSM303DLHC_ODR_15_HZ			((uint8_t)0x10)
+#define LSM303DLHC_ODR_30_HZ			((uint8_t)0x14)
+#define LSM303DLHC_ODR_75_HZ			((uint8_t)0x18)
+#define LSM303DLHC_ODR_220_HZ			((uint8_t)0x1C)
+
+#define LSM303DLHC_FS_1_3_GA			((uint8_t)0x20)
+#define LSM303DLHC_FS_1_9_GA			((uint8_t)0x40)
+#define LSM303DLHC_FS_2_5_GA			((uint8_t)0x60)
+#define LSM303DLHC_FS_4_0_GA			((uint8_t)0x80)
+#define LSM303DLHC_FS_4_7_GA			((uint8_t)0xA0)
+#define LSM303DLHC_FS_5_6_GA			((uint8_t)0xC0)
+#define LSM303DLHC_FS_8_1_GA			((uint8_t)0xE0)
+
+#define LSM303DLHC_CONTINUOS_CONVERSION	((uint8_t)0x00)
+#define LSM303DLHC_SINGLE_CONVERSION	((uint8_t)0x01)
+#define LSM303DLHC_SLEEP				((uint8_t)0x02)
+
+void LSM303DLHC_AccInit(LSM303DLHCAcc_InitTypeDef* LSM303DLHC_InitStruct);
+void LSM303DLHC_AccFilterConfig(LSM303DLHCAcc_FilterConfigTypeDef* LSM303DLHC_FilterStruct);
+void LSM303DLHC_AccFilterCmd(uint8_t HighPassFilterState);
+void LSM303DLHC_MagInit(LSM303DLHCMag_InitTypeDef* LSM303DLHC_InitStruct);
+uint16_t LSM303DLHC_Write(uint8_t DeviceAddr, uint8_t RegAddr, uint8_t* pBuffer);
+uint16_t LSM303DLHC_Read(uint8_t DeviceAddr, uint8_t RegAddr, uint8_t* pBuffer, uint16_t NumByteToRead);
+
+#endif
@@ -0,0 +1,45 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef SIM_L3GD20_MODEL_H
+#define SIM_L3GD20_MODEL_H
+
+#include "memsModel.h"
+
+// Gyroscope, samples are angular rates in rad/s
+class L3gd20Model : public MemsModel
+{
+public:
+	L3gd20Model(Random& random);
+
+	virtual double dataRate() const;
+
+protected:
+	virtual FifoMode fifoMode() const;
+	virtual int16_t quantize(double value) const;
+	virtual void latchTemperature();
+};
+
+#endif
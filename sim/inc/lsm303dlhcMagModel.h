@@ -0,0 +1,74 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef SIM_LSM303DLHC_MAG_MODEL_H
+#define SIM_LSM303DLHC_MAG_MODEL_H
+
+#include "memsModel.h"
+
+/*
+ * Register level model of the LSM303DLHC magnetometer and its temperature
+ * sensor. Output registers hold the latest conversion, big endian in X, Z,
+ * Y order; there is no FIFO. Samples are fields in gauss, errors are hard
+ * iron offsets (bias), soft iron as relative scale per axis and noise.
+ */
+class Lsm303dlhcMagModel
+{
+public:
+	Lsm303dlhcMagModel(Random& random);
+
+	void errors(const MemsErrors& errors);
+	// Die temperature in deg C
+	void temperature(double celsius);
+
+	// Register address increments by itself, addresses with the auto
+	// increment bit of the accelerometer read as zero
+	void read(uint8_t* buffer, uint8_t address, uint16_t n);
+	void write(const uint8_t* buffer, uint8_t address, uint16_t n);
+
+	// Output data rate in Hz, zero unless in continuous conversion
+	double dataRate() const;
+
+	// Produces new output sample from true field in sensor frame
+	void sample(const math3d::Vector3<double>& field);
+	// Stores output sample as produced by the sensor, for replay
+	void push(const int16_t* raw);
+	// Last sample produced or pushed, X Y Z
+	const int16_t* lastSample() const;
+
+private:
+	static const uint8_t RegisterN = 0x40;
+
+	// Output value of one axis for current gain
+	int16_t quantize(double field, bool z) const;
+
+	uint8_t _registers[RegisterN];
+	int16_t _lastSample[3];
+
+	Random& _random;
+	MemsErrors _errors;
+};
+
+#endif
@@ -0,0 +1,107 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef SIM_MEMS_MODEL_H
+#define SIM_MEMS_MODEL_H
+
+#include "math3d.h"
+#include "random.h"
+
+#include <stdint.h>
+
+// Sensor imperfections in physical units of the sensor
+struct MemsErrors
+{
+	MemsErrors();
+
+	// Bias at 25 deg C and its change per deg C
+	math3d::Vector3<double> bias;
+	math3d::Vector3<double> thermalDrift;
+	// Relative scale factor error, 0 is ideal
+	math3d::Vector3<double> scale;
+	// Standard deviation of white noise per sample
+	double noise;
+};
+
+/*
+ * Register level model of ST MEMS sensors with 32 level FIFO.
+ * L3GD20 and LSM303DLHC accelerometer share the layout of control
+ * registers 4 and 5, output registers and FIFO registers.
+ */
+class MemsModel
+{
+public:
+	MemsModel(Random& random);
+	virtual ~MemsModel();
+
+	void errors(const MemsErrors& errors);
+	// Die temperature in deg C, moves bias and temperature registers
+	void temperature(double celsius);
+
+	void read(uint8_t* buffer, uint8_t address, uint16_t n);
+	void write(const uint8_t* buffer, uint8_t address, uint16_t n);
+
+	// Output data rate in Hz, zero when powered down
+	virtual double dataRate() const = 0;
+
+	// Produces new output sample from true value in sensor frame
+	void sample(const math3d::Vector3<double>& value);
+	// Stores output sample as produced by the sensor, for replay
+	void push(const int16_t* raw);
+	// Last sample produced or pushed
+	const int16_t* lastSample() const;
+
+protected:
+	enum FifoMode {Bypass, Fifo, Stream};
+
+	static const uint8_t RegisterN = 0x40;
+	static const uint8_t FifoSize = 32;
+
+	virtual FifoMode fifoMode() const = 0;
+
+	// Converts physical value to output register value for current scale
+	virtual int16_t quantize(double value) const = 0;
+	// Stores die temperature to registers of sensors having them
+	virtual void latchTemperature();
+
+	uint8_t _registers[RegisterN];
+	double _temperature;
+
+private:
+	void resetFifo();
+	void latch(const int16_t* sample);
+
+	Random& _random;
+	MemsErrors _errors;
+
+	int16_t _fifo[FifoSize][3];
+	int16_t _lastSample[3];
+	uint8_t _fifoHead;
+	uint8_t _fifoLevel;
+	bool _overrun;
+	bool _dataReady;
+};
+
+#endif
@@ -0,0 +1,55 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef SIM_QUATERNION_H
+#define SIM_QUATERNION_H
+
+#include "math3d.h"
+
+// Unit quaternion describing rotation from body to world frame
+class Quaternion
+{
+public:
+	Quaternion();
+	Quaternion(double w, double x, double y, double z);
+
+	static Quaternion fromAxisAngle(const math3d::Vector3<double>& axis, double angle);
+
+	Quaternion operator *(const Quaternion& b) const;
+	Quaternion conjugate() const;
+
+	// Rotates body frame vector into world frame
+	math3d::Vector3<double> rotate(const math3d::Vector3<double>& v) const;
+	// Rotates world frame vector into body frame
+	math3d::Vector3<double> rotateInverse(const math3d::Vector3<double>& v) const;
+
+	// Applies body angular rate for time step dt
+	void integrate(const math3d::Vector3<double>& rate, double dt);
+	void normalize();
+
+	double w, x, y, z;
+};
+
+#endif
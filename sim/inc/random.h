@@ -0,0 +1,54 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef SIM_RANDOM_H
+#define SIM_RANDOM_H
+
+#include <stdint.h>
+
+// Deterministic pseudo random generator (xorshift64*). Standard library
+// distributions are implementation defined, this one gives the same
+// sequence on every host for the same seed.
+class Random
+{
+public:
+	Random(uint64_t seed);
+
+	uint64_t next();
+
+	// Uniform value in range <0, 1)
+	double uniform();
+	double uniform(double min, double max);
+
+	// Normally distributed value with zero mean
+	double gaussian(double sigma = 1.0);
+
+private:
+	uint64_t _state;
+	double _spare;
+	bool _hasSpare;
+};
+
+#endif
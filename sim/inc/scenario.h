@@ -0,0 +1,61 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef SIM_SCENARIO_H
+#define SIM_SCENARIO_H
+
+#include "tricopter.h"
+
+// Stick positions as returned by RcReceiver::normalizedReading, range <0, 1>
+struct RcSticks
+{
+	float pitch;
+	float roll;
+	float throttle;
+	float yaw;
+};
+
+/*
+ * Virtual pilot. Throttle is driven by altitude hold so the attitude loop
+ * can be observed in flight, the other sticks follow scripted manoeuvres.
+ */
+class Scenario
+{
+public:
+	enum Type {Hover, Steps};
+
+	Scenario(Type type, double altitude = 2.0);
+
+	static bool parse(const char* name, Type& type);
+
+	RcSticks sticks(double time, double deltaT, const Tricopter& tricopter);
+
+private:
+	Type _type;
+	double _altitude;
+	double _integral;
+};
+
+#endif
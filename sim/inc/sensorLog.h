@@ -0,0 +1,76 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef SIM_SENSOR_LOG_H
+#define SIM_SENSOR_LOG_H
+
+#include <stdint.h>
+#include <cstdio>
+
+// One raw sample, values are output register contents for sensors and
+// pulse widths in microseconds for RC channels
+struct SensorRecord
+{
+	enum Source {Gyroscope = 'G', Accelerometer = 'A', Magnetometer = 'M', Rc = 'R'};
+	static const uint8_t ValueN = 4;
+
+	Source source;
+	// Microseconds since start
+	uint64_t time;
+	int16_t values[ValueN];
+};
+
+/*
+ * Text log of raw sensor and RC streams, one record per line:
+ *
+ *   G time x y z
+ *   A time x y z
+ *   M time x y z
+ *   R time pitch roll throttle yaw
+ *
+ * Records are ordered by time. Lines starting with # are comments.
+ */
+class SensorLog
+{
+public:
+	SensorLog();
+	~SensorLog();
+
+	bool create(const char* path);
+	bool open(const char* path);
+	void close();
+
+	void write(const SensorRecord& record);
+	// False at end of log, malformed lines are skipped
+	bool read(SensorRecord& record);
+
+	uint64_t records() const;
+
+private:
+	FILE* _file;
+	uint64_t _records;
+};
+
+#endif
@@ -0,0 +1,64 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <stm32f30x.h>
+
+// Hooks of the peripheral replacements used by the simulation
+
+// Performs update event of timer - preloaded compare values become active
+void simTimerUpdateEvent(TIM_TypeDef* timer);
+
+// Pulse width currently generated on timer channel in seconds
+double simTimerPulseWidth(TIM_TypeDef* timer, uint8_t channel);
+
+// Period of timer in seconds, zero when timer is stopped
+double simTimerPeriod(TIM_TypeDef* timer);
+
+// Called after every compare value or update disable write to a timer,
+// lets host checks place update events between any two writes
+void simTimerWriteHook(void (*hook)(TIM_TypeDef* timer));
+
+// Input capture on timer channel, sets CCxIF (and CCxOF over an unread one)
+void simTimerCapture(TIM_TypeDef* timer, uint8_t channel, uint16_t capture);
+
+// Status flags of timer after the clears written to SR
+uint32_t simTimerStatus(TIM_TypeDef* timer);
+
+// Byte arrives on UART RX, sets RXNE or ORE when previous byte is unread
+void simUartReceive(USART_TypeDef* uart, uint8_t byte);
+
+// Takes byte written to TDR, false when transmitter is idle
+bool simUartTransmit(USART_TypeDef* uart, uint8_t& byte);
+
+// Status flags of UART after the clears written to ICR
+uint32_t simUartStatus(USART_TypeDef* uart);
+
+// One peripheral to memory transfer of enabled DMA channel
+void simDmaTransfer(DMA_Channel_TypeDef* channel, uint16_t value);
+
+#endif
@@ -0,0 +1,151 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef SIM_SIMULATION_H
+#define SIM_SIMULATION_H
+
+#include "tricopter.h"
+#include "l3gd20Model.h"
+#include "lsm303dlhcModel.h"
+#include "lsm303dlhcMagModel.h"
+#include "random.h"
+#include "sensorLog.h"
+
+#include <stdint.h>
+
+#include <stm32f30x.h>
+
+struct SimulationConfig
+{
+	SimulationConfig();
+
+	TricopterConfig tricopter;
+
+	// Gyroscope errors in rad/s, accelerometer errors in m/s^2
+	MemsErrors gyroErrors;
+	MemsErrors accErrors;
+	// Magnetometer errors in gauss, bias is hard iron and scale soft iron
+	MemsErrors magErrors;
+
+	// Earth magnetic field in world frame in gauss
+	math3d::Vector3<double> magneticField;
+
+	uint64_t seed;
+
+	// Rigid body integration rate in Hz
+	double physicsRate;
+
+	// Board temperature at start in deg C and its change in deg C/s
+	double temperature;
+	double temperatureRate;
+
+	// Mean wind in world frame and standard deviation of gusts in m/s
+	math3d::Vector3<double> wind;
+	double gust;
+
+	// Wiring of actuators to timer channels, same as in Model
+	TIM_TypeDef* escTimer;
+	uint8_t escChannels[Tricopter::MotorN];
+	TIM_TypeDef* servoTimer;
+	uint8_t servoChannel;
+};
+
+/*
+ * Discrete event simulation of the tricopter and the board peripherals.
+ * Simulated time moves only when the firmware waits - through sleep() or
+ * by transferring data over sensor buses - so the control code runs as
+ * fast as the host allows while seeing real timing of the hardware.
+ */
+class Simulation
+{
+public:
+	Simulation(const SimulationConfig& config);
+	~Simulation();
+
+	// Simulation the HAL replacements are connected to
+	static Simulation* current();
+
+	void advance(uint64_t microseconds);
+
+	// Writes every sensor sample to log
+	void record(SensorLog* log);
+	// Sensors output samples from log instead of the modelled ones
+	void replay(SensorLog* log);
+	bool replayEnded() const;
+	// Last replayed RC pulse width in seconds, zero before first RC record
+	double rcPulseWidth(uint8_t channel) const;
+
+	// Time since simulation start in microseconds
+	uint64_t time() const;
+	// Board temperature in deg C
+	double temperature() const;
+
+	Tricopter& tricopter();
+	L3gd20Model& gyroscope();
+	Lsm303dlhcModel& accelerometer();
+	Lsm303dlhcMagModel& magnetometer();
+
+private:
+	struct TimerState
+	{
+		TIM_TypeDef* timer;
+		double nextUpdate;
+	};
+
+	void physicsStep();
+	void sampleGyroscope();
+	void sampleAccelerometer();
+	void sampleMagnetometer();
+	void timerUpdate(TimerState& state);
+	void recordSample(SensorRecord::Source source, double time, const int16_t* values);
+	void replayRecord();
+
+	SimulationConfig _config;
+	Random _random;
+	Tricopter _tricopter;
+	L3gd20Model _gyroscope;
+	Lsm303dlhcModel _accelerometer;
+	Lsm303dlhcMagModel _magnetometer;
+
+	uint64_t _time;
+	double _nextPhysics;
+	double _nextGyroscope;
+	double _nextAccelerometer;
+	double _nextMagnetometer;
+
+	TimerState _timers[2];
+	uint8_t _timerN;
+
+	math3d::Vector3<double> _gust;
+	double _temperature;
+
+	SensorLog* _recordLog;
+	SensorLog* _replayLog;
+	SensorRecord _replayNext;
+	double _nextReplay;
+	int16_t _rcPulseWidths[SensorRecord::ValueN];
+};
+
+#endif
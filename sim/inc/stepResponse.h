@@ -0,0 +1,73 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef SIM_STEPRESPONSE_H
+#define SIM_STEPRESPONSE_H
+
+/*
+ * Measures step response of one attitude axis. New step starts whenever
+ * setpoint jumps by more than threshold between two samples. Overshoot is
+ * relative to step size, settling time is measured from the step until the
+ * response enters and stays in the settling band.
+ */
+class StepResponse
+{
+public:
+	StepResponse(double threshold = 0.02, double band = 0.1);
+
+	void add(double time, double setpoint, double value);
+	// Closes the last step, call once after the final sample
+	void finish();
+
+	int steps() const;
+	double meanOvershoot() const;
+	double maxOvershoot() const;
+	// Steps that never settled count with their whole duration
+	double meanSettlingTime() const;
+	double maxSettlingTime() const;
+
+private:
+	void close();
+
+	double _threshold;
+	double _band;
+
+	bool _active;
+	double _lastSetpoint;
+	double _lastTime;
+	double _start;
+	double _initial;
+	double _target;
+	double _overshoot;
+	double _leftBand;
+
+	int _steps;
+	double _overshootSum;
+	double _overshootMax;
+	double _settlingSum;
+	double _settlingMax;
+};
+
+#endif
@@ -0,0 +1,125 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef SIM_TRICOPTER_H
+#define SIM_TRICOPTER_H
+
+#include "math3d.h"
+#include "quaternion.h"
+
+/*
+ * Rigid body model of the frame in doc/layout.pdf.
+ *
+ * Body frame matches the gyroscope axes: X points to the right, Y forward
+ * and Z up. Front motors sit on arms rotated by frontArmAngle from the
+ * forward axis, rear motor is on the boom along -Y and is tilted around
+ * the boom by the yaw servo. World frame is X east, Y north, Z up.
+ */
+struct TricopterConfig
+{
+	TricopterConfig();
+
+	// Total mass in kg
+	double mass;
+	// Principal moments of inertia in kg*m^2
+	math3d::Vector3<double> inertia;
+	// Distance of motors from centre of mass in m
+	double armLength;
+	// Angle between front arms and forward axis in radians
+	double frontArmAngle;
+	// Thrust of one motor at full throttle in N, thrust is quadratic in speed
+	double maxThrust;
+	// Time constant of rotor speed response in s
+	double motorTimeConstant;
+	// Rotor drag torque to thrust ratio in m
+	double torqueRatio;
+	// ESC and servo pulse widths in s
+	double minEscPulse, maxEscPulse;
+	double minServoPulse, maxServoPulse;
+	// Tail tilt at the servo end stops in rad and servo speed in rad/s
+	double maxTilt;
+	double servoRate;
+	// Aerodynamic damping in N/(m/s) and N*m/(rad/s)
+	double linearDrag;
+	double angularDrag;
+};
+
+class Tricopter
+{
+public:
+	enum Motors {Rear, Right, Left, MotorN};
+
+	Tricopter(const TricopterConfig& config);
+
+	// Commands as seen on the ESC and servo signal wires
+	void escPulse(Motors motor, double pulseWidth);
+	void servoPulse(double pulseWidth);
+
+	// Air velocity in world frame and external torque in body frame
+	void wind(const math3d::Vector3<double>& wind);
+	void disturbance(const math3d::Vector3<double>& torque);
+
+	void step(double dt);
+
+	const math3d::Vector3<double>& position() const;
+	const math3d::Vector3<double>& velocity() const;
+	const Quaternion& attitude() const;
+	// Body angular rate in rad/s
+	const math3d::Vector3<double>& angularRate() const;
+	// Acceleration measured by ideal accelerometer in body frame, m/s^2
+	math3d::Vector3<double> specificForce() const;
+	// Pitch (X rot), Roll (Y rot) and Yaw (Z rot) as used by firmware
+	math3d::Vector3<double> angles() const;
+
+	// Normalized throttle <0, 1> requested by ESC and current rotor speed
+	double motorCommand(Motors motor) const;
+	double motorSpeed(Motors motor) const;
+	double servoTilt() const;
+
+	bool landed() const;
+
+	const TricopterConfig& config() const;
+
+private:
+	TricopterConfig _config;
+
+	math3d::Vector3<double> _position;
+	math3d::Vector3<double> _velocity;
+	math3d::Vector3<double> _acceleration;
+	math3d::Vector3<double> _rate;
+	Quaternion _attitude;
+
+	math3d::Vector3<double> _wind;
+	math3d::Vector3<double> _disturbance;
+
+	double _command[MotorN];
+	double _speed[MotorN];
+	double _servoTarget;
+	double _tilt;
+
+	bool _landed;
+};
+
+#endif
@@ -0,0 +1,83 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "l3gd20Model.h"
+
+#include <stm32f3_discovery_l3gd20.h>
+
+#include <cmath>
+
+L3gd20Model::L3gd20Model(Random& random) :
+MemsModel(random)
+{
+	_registers[L3GD20_WHO_AM_I_ADDR] = I_AM_L3GD20;
+	// Power down with all axes enabled after boot
+	_registers[L3GD20_CTRL_REG1_ADDR] = L3GD20_AXES_ENABLE;
+	latchTemperature();
+}
+
+double L3gd20Model::dataRate() const
+{
+	uint8_t ctrl1 = _registers[L3GD20_CTRL_REG1_ADDR];
+	if((ctrl1 & L3GD20_MODE_ACTIVE) == 0)
+		return 0;
+
+	switch(ctrl1 & 0xC0){
+	case L3GD20_OUTPUT_DATARATE_1: return 95;
+	case L3GD20_OUTPUT_DATARATE_2: return 190;
+	case L3GD20_OUTPUT_DATARATE_3: return 380;
+	default:					   return 760;
+	}
+}
+
+MemsModel::FifoMode L3gd20Model::fifoMode() const
+{
+	switch(_registers[L3GD20_FIFO_CTRL_REG_ADDR] & 0xE0){
+	case 0x20: return Fifo;
+	case 0x40: return Stream;
+	default:   return Bypass;
+	}
+}
+
+int16_t L3gd20Model::quantize(double value) const
+{
+	// Digits per dps for each full scale
+	double sensitivity;
+	switch(_registers[L3GD20_CTRL_REG4_ADDR] & 0x30){
+	case L3GD20_FULLSCALE_250: sensitivity = 1 / 8.75e-3; break;
+	case L3GD20_FULLSCALE_500: sensitivity = 1 / 17.5e-3; break;
+	default:				   sensitivity = 1 / 70e-3;   break;
+	}
+
+	double digits = std::floor(math3d::Degrees(value) * sensitivity + 0.5);
+	return (int16_t)(digits > 32767 ? 32767 : digits < -32768 ? -32768 : digits);
+}
+
+void L3gd20Model::latchTemperature()
+{
+	// Counts down 1 LSB/deg, zero at 25 deg C on this part
+	double digits = std::floor(25 - _temperature + 0.5);
+	_registers[L3GD20_OUT_TEMP_ADDR] = (uint8_t)(int8_t)(digits > 127 ? 127 : digits < -128 ? -128 : digits);
+}
@@ -0,0 +1,143 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "lsm303dlhcMagModel.h"
+
+#include <stm32f3_discovery_lsm303dlhc.h>
+
+#include <cmath>
+#include <cstring>
+
+#define DRDY_BIT		0x01
+
+// Output value of an axis out of range
+static const int16_t overflow = -4096;
+
+Lsm303dlhcMagModel::Lsm303dlhcMagModel(Random& random) :
+_random(random)
+{
+	std::memset(_registers, 0, sizeof(_registers));
+	std::memset(_lastSample, 0, sizeof(_lastSample));
+
+	// Defaults after boot: 15 Hz, 1.3 gauss, sleep mode
+	_registers[LSM303DLHC_CRA_REG_M] = LSM303DLHC_ODR_15_HZ;
+	_registers[LSM303DLHC_CRB_REG_M] = LSM303DLHC_FS_1_3_GA;
+	_registers[LSM303DLHC_MR_REG_M] = 0x03;
+	temperature(25);
+}
+
+void Lsm303dlhcMagModel::errors(const MemsErrors& errors)
+{
+	_errors = errors;
+}
+
+void Lsm303dlhcMagModel::temperature(double celsius)
+{
+	// 12 bits left aligned at 8 LSB/deg, zero at 20 deg C on this part
+	double digits = std::floor((celsius - 20) * 8 + 0.5);
+	int16_t raw = (int16_t)(digits > 2047 ? 2047 : digits < -2048 ? -2048 : digits) * 16;
+	_registers[LSM303DLHC_TEMP_OUT_H_M] = (uint16_t)raw >> 8;
+	_registers[LSM303DLHC_TEMP_OUT_L_M] = raw & 0xFF;
+}
+
+void Lsm303dlhcMagModel::read(uint8_t* buffer, uint8_t address, uint16_t n)
+{
+	for(uint16_t i = 0; i < n; i++){
+		uint8_t a = address + i;
+		buffer[i] = a < RegisterN ? _registers[a] : 0;
+		if(a == LSM303DLHC_OUT_Y_L_M)
+			_registers[LSM303DLHC_SR_REG_Mg] &= ~DRDY_BIT;
+	}
+}
+
+void Lsm303dlhcMagModel::write(const uint8_t* buffer, uint8_t address, uint16_t n)
+{
+	for(uint16_t i = 0; i < n; i++){
+		uint8_t a = address + i;
+		if(a <= LSM303DLHC_MR_REG_M)
+			_registers[a] = buffer[i];
+	}
+}
+
+double Lsm303dlhcMagModel::dataRate() const
+{
+	if((_registers[LSM303DLHC_MR_REG_M] & 0x03) != LSM303DLHC_CONTINUOS_CONVERSION)
+		return 0;
+
+	switch(_registers[LSM303DLHC_CRA_REG_M] & 0x1C){
+	case LSM303DLHC_ODR_0_75_HZ: return 0.75;
+	case LSM303DLHC_ODR_1_5_HZ:	 return 1.5;
+	case LSM303DLHC_ODR_3_0_HZ:	 return 3;
+	case LSM303DLHC_ODR_7_5_HZ:	 return 7.5;
+	case LSM303DLHC_ODR_15_HZ:	 return 15;
+	case LSM303DLHC_ODR_30_HZ:	 return 30;
+	case LSM303DLHC_ODR_75_HZ:	 return 75;
+	default:					 return 220;
+	}
+}
+
+void Lsm303dlhcMagModel::sample(const math3d::Vector3<double>& field)
+{
+	int16_t raw[3];
+	for(int i = 0; i < 3; i++)
+		raw[i] = quantize(field[i] * (1 + _errors.scale[i]) + _errors.bias[i] + _random.gaussian(_errors.noise), i == 2);
+
+	push(raw);
+}
+
+void Lsm303dlhcMagModel::push(const int16_t* raw)
+{
+	std::memcpy(_lastSample, raw, sizeof(_lastSample));
+
+	static const uint8_t outputs[3] = {LSM303DLHC_OUT_X_H_M, LSM303DLHC_OUT_Y_H_M, LSM303DLHC_OUT_Z_H_M};
+	for(int i = 0; i < 3; i++){
+		_registers[outputs[i]] = (uint16_t)raw[i] >> 8;
+		_registers[outputs[i] + 1] = raw[i] & 0xFF;
+	}
+	_registers[LSM303DLHC_SR_REG_Mg] |= DRDY_BIT;
+}
+
+const int16_t* Lsm303dlhcMagModel::lastSample() const
+{
+	return _lastSample;
+}
+
+int16_t Lsm303dlhcMagModel::quantize(double field, bool z) const
+{
+	// LSB per gauss of X/Y and Z for each gain
+	double lsbXy, lsbZ;
+	switch(_registers[LSM303DLHC_CRB_REG_M] & 0xE0){
+	case LSM303DLHC_FS_1_3_GA: lsbXy = 1100; lsbZ = 980; break;
+	case LSM303DLHC_FS_1_9_GA: lsbXy = 855;  lsbZ = 760; break;
+	case LSM303DLHC_FS_2_5_GA: lsbXy = 670;  lsbZ = 600; break;
+	case LSM303DLHC_FS_4_0_GA: lsbXy = 450;  lsbZ = 400; break;
+	case LSM303DLHC_FS_4_7_GA: lsbXy = 400;  lsbZ = 355; break;
+	case LSM303DLHC_FS_5_6_GA: lsbXy = 330;  lsbZ = 295; break;
+	default:				   lsbXy = 230;  lsbZ = 205; break;
+	}
+
+	double digits = std::floor(field * (z ? lsbZ : lsbXy) + 0.5);
+	return digits > 2047 || digits < -2048 ? overflow : (int16_t)digits;
+}
@@ -0,0 +1,79 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "lsm303dlhcModel.h"
+
+#include <stm32f3_discovery_lsm303dlhc.h>
+
+#include <cmath>
+
+static const double gravity = 9.80665;
+
+Lsm303dlhcModel::Lsm303dlhcModel(Random& random) :
+MemsModel(random)
+{
+	// Power down with all axes enabled after boot
+	_registers[LSM303DLHC_CTRL_REG1_A] = LSM303DLHC_AXES_ENABLE;
+}
+
+double Lsm303dlhcModel::dataRate() const
+{
+	switch(_registers[LSM303DLHC_CTRL_REG1_A] & 0xF0){
+	case LSM303DLHC_ODR_1_HZ:	 return 1;
+	case LSM303DLHC_ODR_10_HZ:	 return 10;
+	case LSM303DLHC_ODR_25_HZ:	 return 25;
+	case LSM303DLHC_ODR_50_HZ:	 return 50;
+	case LSM303DLHC_ODR_100_HZ:	 return 100;
+	case LSM303DLHC_ODR_200_HZ:	 return 200;
+	case LSM303DLHC_ODR_400_HZ:	 return 400;
+	case LSM303DLHC_ODR_1344_HZ: return 1344;
+	default:					 return 0;
+	}
+}
+
+MemsModel::FifoMode Lsm303dlhcModel::fifoMode() const
+{
+	switch(_registers[LSM303DLHC_FIFO_CTRL_REG_A] & 0xC0){
+	case 0x40: return Fifo;
+	case 0x80: return Stream;
+	default:   return Bypass;
+	}
+}
+
+int16_t Lsm303dlhcModel::quantize(double value) const
+{
+	// mg per digit of 12 bit left aligned output for each full scale
+	double mgPerDigit;
+	switch(_registers[LSM303DLHC_CTRL_REG4_A] & 0x30){
+	case LSM303DLHC_FULLSCALE_2G: mgPerDigit = 1;  break;
+	case LSM303DLHC_FULLSCALE_4G: mgPerDigit = 2;  break;
+	case LSM303DLHC_FULLSCALE_8G: mgPerDigit = 4;  break;
+	default:					  mgPerDigit = 12; break;
+	}
+
+	double digits = std::floor(value / gravity * 1000 / mgPerDigit + 0.5);
+	digits = digits > 2047 ? 2047 : digits < -2048 ? -2048 : digits;
+	return (int16_t)(digits * 16);
+}
@@ -0,0 +1,748 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Software in the loop simulator. Runs the flight loop of src/main.cpp
+ * with the firmware sensor drivers, filter, controllers and model on top
+ * of simulated peripherals.
+ *
+ * Usage: f3sim [-t seconds] [-s seed] [-c hover|steps] [-o trace.csv]
+ *              [-d decimation] [-p name=value]... [-P] [-b blackbox.bin]
+ *              [-r sensors.log | -R sensors.log]
+ *
+ * Summary is printed as single line of name=value pairs. Errors are in
+ * radians and measured only while airborne, step response is evaluated on
+ * pitch and roll setpoint steps. Blackbox output is the firmware recorder
+ * stream drained every loop, decode it with bbdecode.
+ *
+ * Sensor log (-r) holds raw gyroscope, accelerometer and magnetometer
+ * samples and RC pulse widths. Replaying it (-R) feeds the samples through
+ * the sensor register models into the firmware drivers and runs the flight
+ * loop on them instead of the modelled world, until the log ends. Replay trace
+ * holds the firmware outputs with all digits, so traces of two builds can
+ * be diffed directly; stage timings are printed by -P.
+ *
+ * Flight starts once device bring-up arms the craft, its duration and the
+ * trace time are counted from then. Boot-to-armed time is in the summary,
+ * ready times of single devices are printed by -P.
+ */
+
+#include "simulation.h"
+#include "scenario.h"
+#include "stepResponse.h"
+
+#include "common.h"
+#include "gyroscope.h"
+#include "accelerometer.h"
+#include "magnetometer.h"
+#include "math3d.h"
+#include "complementaryFilter2.h"
+#include "attitudeEkf.h"
+#include "accelerationTrust.h"
+#include "controller.h"
+#include "stopwatch.h"
+#include "model.h"
+#include "systime.h"
+#include "profiler.h"
+#include "blackbox.h"
+#include "sensorLog.h"
+#include "bringUp.h"
+#include "thermalBias.h"
+#include "calibration.h"
+#include "ellipsoidCalibration.h"
+#include "configStore.h"
+#include "main.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using math3d::Vector3;
+
+// Same defaults as the firmware
+static double sensorUpdateTime = 0.01;
+static double filterTimeConst = 0.49;
+// Zero keeps the fixed fusion gain for comparison
+static double fusionTrust = 1;
+static double headingWeight = 0.25;
+// Nonzero replaces the complementary filter by the attitude EKF
+static double fusionEkf = 0;
+// Nonzero lets gyroscope full scale follow peak rate as in the firmware,
+// sensor logs hold raw samples without scale so record and replay keep it fixed
+static double gyroAutoRange = 1;
+
+static double pitchProportional = 0.3;
+static double pitchIntegral = 0.01;
+static double pitchDerivative = 0.0;
+static double rollProportional = 0.3;
+static double rollIntegral = 0.01;
+static double rollDerivative = 0.0;
+static double yawProportional = 0.3;
+static double yawIntegral = 0.01;
+static double yawDerivative = 0.0;
+
+static double maxPitchAngle = 0.7;
+static double maxRollAngle = 0.7;
+static double maxYawAngularSpeed = math3d::Pi;
+static double maneuverFraction = 0.25;
+
+// Simulated world
+static SimulationConfig config;
+static double gyroBias = math3d::Radians(1.0);
+static double accBias = 0.05;
+static double gyroThermalDrift = 0;
+// Hard iron in gauss, soft iron as relative scale error
+static double magBias = 0.1;
+static double magScale = 0.05;
+
+struct Parameter
+{
+	const char* name;
+	double* value;
+};
+
+static Parameter parameters[] = {
+	{"sensorUpdateTime", &sensorUpdateTime},
+	{"filterTimeConst", &filterTimeConst},
+	{"fusionTrust", &fusionTrust},
+	{"headingWeight", &headingWeight},
+	{"fusionEkf", &fusionEkf},
+	{"gyroAutoRange", &gyroAutoRange},
+	{"pitchProportional", &pitchProportional},
+	{"pitchIntegral", &pitchIntegral},
+	{"pitchDerivative", &pitchDerivative},
+	{"rollProportional", &rollProportional},
+	{"rollIntegral", &rollIntegral},
+	{"rollDerivative", &rollDerivative},
+	{"yawProportional", &yawProportional},
+	{"yawIntegral", &yawIntegral},
+	{"yawDerivative", &yawDerivative},
+	{"maxPitchAngle", &maxPitchAngle},
+	{"maxRollAngle", &maxRollAngle},
+	{"maxYawAngularSpeed", &maxYawAngularSpeed},
+	{"maneuverFraction", &maneuverFraction},
+	{"mass", &config.tricopter.mass},
+	{"armLength", &config.tricopter.armLength},
+	{"maxThrust", &config.tricopter.maxThrust},
+	{"motorTimeConstant", &config.tricopter.motorTimeConstant},
+	{"gyroNoise", &config.gyroErrors.noise},
+	{"gyroBias", &gyroBias},
+	{"accNoise", &config.accErrors.noise},
+	{"accBias", &accBias},
+	{"gyroThermalDrift", &gyroThermalDrift},
+	{"magNoise", &config.magErrors.noise},
+	{"magBias", &magBias},
+	{"magScale", &magScale},
+	{"temperature", &config.temperature},
+	{"temperatureRate", &config.temperatureRate},
+	{"windX", &config.wind[0]},
+	{"windY", &config.wind[1]},
+	{"gust", &config.gust}
+};
+
+static const int parameterN = sizeof(parameters) / sizeof(parameters[0]);
+
+static Blackbox blackbox;
+
+// Gyroscope bias over temperature, same as in src/main.cpp
+static ThermalBias thermalBias(-10, 10, 256);
+static const uint8_t thermalSaveInterval = 60;
+
+// Same as in src/main.cpp
+static EllipsoidCalibration magCalibration(0.05f, 0.05f);
+
+// Simulated flash starts erased, corrections measured at bring-up are stored
+static ConfigStore configStore;
+
+// Accumulates mean square and maximum of an error signal
+class ErrorStats
+{
+public:
+	ErrorStats() : _sum(0), _max(0), _n(0) {}
+
+	void add(double e)
+	{
+		_sum += e * e;
+		_max = std::fabs(e) > _max ? std::fabs(e) : _max;
+		_n++;
+	}
+
+	double rms() const { return _n ? std::sqrt(_sum / _n) : 0; }
+	double max() const { return _max; }
+
+private:
+	double _sum;
+	double _max;
+	long _n;
+};
+
+static bool setParameter(const char* assignment)
+{
+	const char* eq = std::strchr(assignment, '=');
+	if(eq == nullptr)
+		return false;
+
+	for(int i = 0; i < parameterN; i++){
+		if(std::strncmp(parameters[i].name, assignment, eq - assignment) == 0 &&
+		   parameters[i].name[eq - assignment] == '\0'){
+			*parameters[i].value = std::atof(eq + 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Simulated bus never stalls, a timeout is a fault of the replacement
+uint32_t LSM303DLHC_TIMEOUT_UserCallback(void)
+{
+	std::fprintf(stderr, "LSM303DLHC bus timed out\n");
+	std::abort();
+}
+
+static void usage()
+{
+	std::fprintf(stderr, "usage: f3sim [-t seconds] [-s seed] [-c hover|steps] [-o trace.csv] [-d decimation] [-p name=value]... [-P] [-b blackbox.bin] [-r|-R sensors.log]\nparameters:");
+	for(int i = 0; i < parameterN; i++)
+		std::fprintf(stderr, " %s", parameters[i].name);
+	std::fprintf(stderr, "\n");
+}
+
+// Seconds from boot to ready of every device
+static void printBringUp(const BringUp& bringUp)
+{
+	std::fprintf(stderr, "bringUp");
+	for(int i = 0; i < BringUp::DeviceN; i++){
+		BringUp::Device device = (BringUp::Device)i;
+		std::fprintf(stderr, " %s=%.3f", BringUp::name(device), bringUp.readyTime(device) / (double)SYSTEM_TIME_RESOLUTION);
+	}
+	std::fprintf(stderr, "\n");
+}
+
+// Learned nodes of the thermal bias table, temperature and bias in deg/s
+static void printThermal()
+{
+	std::fprintf(stderr, "thermal");
+	for(uint8_t i = 0; i < ThermalBias::NodeN; i++){
+		if(thermalBias.nodeWeight(i) <= 0)
+			continue;
+		math3d::Vector3<float> bias = thermalBias.nodeBias(i);
+		std::fprintf(stderr, " %.0f=%.4f/%.4f/%.4f", thermalBias.nodeTemperature(i),
+					 math3d::Degrees(bias[0]), math3d::Degrees(bias[1]), math3d::Degrees(bias[2]));
+	}
+	std::fprintf(stderr, "\n");
+}
+
+// Magnetometer fit against the drawn errors, bias in gauss, scale relative
+// to the field strength
+static void printHeading(const Magnetometer& mag)
+{
+	const SensorCorrection& correction = mag.correction();
+	double field = std::sqrt(config.magneticField.dotProduct(config.magneticField));
+	std::fprintf(stderr, "heading done=%d samples=%u residual=%.4f", magCalibration.done(),
+				 magCalibration.samples(), magCalibration.residual());
+	for(uint8_t i = 0; i < 3; i++)
+		std::fprintf(stderr, " bias%c=%.4f/%.4f scale%c=%.4f/%.4f", 'X' + i, correction.bias[i] / correction.scale[i],
+					 config.magErrors.bias[i], 'X' + i, 1 / (correction.scale[i] * field) - 1, config.magErrors.scale[i]);
+	std::fprintf(stderr, "\n");
+}
+
+// Host stage timings of the flight loop, in nanoseconds
+static void printProfile()
+{
+	for(int i = 0; i < Profiler::StageN; i++){
+		Profiler::Stage stage = (Profiler::Stage)i;
+		const Profiler::Stats& stats = Profiler::stats(stage);
+		if(stats.count == 0)
+			continue;
+
+		std::fprintf(stderr, "%-13s count=%u min=%u max=%u mean=%u log2:", Profiler::name(stage),
+					 stats.count, stats.min, stats.max, Profiler::mean(stage));
+		for(int j = 0; j < Profiler::BucketN; j++)
+			if(stats.histogram[j] > 0)
+				std::fprintf(stderr, " %d:%u", j, stats.histogram[j]);
+		std::fprintf(stderr, "\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	double duration = 60;
+	Scenario::Type scenarioType = Scenario::Steps;
+	const char* tracePath = nullptr;
+	int decimation = 1;
+	bool profile = false;
+	const char* blackboxPath = nullptr;
+	const char* recordPath = nullptr;
+	const char* replayPath = nullptr;
+	bool durationSet = false;
+
+	config.gyroErrors.noise = math3d::Radians(0.3);
+	config.accErrors.noise = 0.05;
+	config.magErrors.noise = 0.003;
+
+	for(int i = 1; i < argc; i++){
+		bool hasValue = i + 1 < argc;
+		if(std::strcmp(argv[i], "-t") == 0 && hasValue){
+			duration = std::atof(argv[++i]);
+			durationSet = true;
+		}
+		else if(std::strcmp(argv[i], "-s") == 0 && hasValue)
+			config.seed = std::strtoull(argv[++i], nullptr, 10);
+		else if(std::strcmp(argv[i], "-c") == 0 && hasValue && Scenario::parse(argv[i + 1], scenarioType))
+			i++;
+		else if(std::strcmp(argv[i], "-o") == 0 && hasValue)
+			tracePath = argv[++i];
+		else if(std::strcmp(argv[i], "-d") == 0 && hasValue)
+			decimation = std::atoi(argv[++i]) > 0 ? std::atoi(argv[i]) : 1;
+		else if(std::strcmp(argv[i], "-p") == 0 && hasValue && setParameter(argv[i + 1]))
+			i++;
+		else if(std::strcmp(argv[i], "-P") == 0)
+			profile = true;
+		else if(std::strcmp(argv[i], "-b") == 0 && hasValue)
+			blackboxPath = argv[++i];
+		else if(std::strcmp(argv[i], "-r") == 0 && hasValue)
+			recordPath = argv[++i];
+		else if(std::strcmp(argv[i], "-R") == 0 && hasValue)
+			replayPath = argv[++i];
+		else{
+			usage();
+			return 1;
+		}
+	}
+
+	// Constant sensor offsets drawn from seed, independent of noise stream
+	Random errorRandom(config.seed ^ 0x5DEECE66Dull);
+	for(int i = 0; i < 3; i++){
+		config.gyroErrors.bias[i] = errorRandom.gaussian(gyroBias);
+		config.accErrors.bias[i] = errorRandom.gaussian(accBias);
+	}
+	for(int i = 0; i < 3; i++)
+		config.gyroErrors.thermalDrift[i] = errorRandom.gaussian(gyroThermalDrift);
+	for(int i = 0; i < 3; i++){
+		config.magErrors.bias[i] = errorRandom.gaussian(magBias);
+		config.magErrors.scale[i] = errorRandom.gaussian(magScale);
+	}
+
+	SensorLog sensorLog;
+	if((recordPath != nullptr && !sensorLog.create(recordPath)) ||
+	   (replayPath != nullptr && !sensorLog.open(replayPath))){
+		std::perror(recordPath != nullptr ? recordPath : replayPath);
+		return 1;
+	}
+	bool replaying = replayPath != nullptr;
+	// Replay runs until the log ends unless told otherwise
+	if(replaying && !durationSet)
+		duration = 1e9;
+
+	FILE* trace = nullptr;
+	if(tracePath != nullptr){
+		trace = std::fopen(tracePath, "w");
+		if(trace == nullptr){
+			std::perror(tracePath);
+			return 1;
+		}
+		if(replaying)
+			std::fprintf(trace, "time,estPitch,estRoll,estYaw,spPitch,spRoll,spYaw,outPitch,outRoll,outYaw,rear,right,left,servo\n");
+		else
+			std::fprintf(trace, "time,pitch,roll,yaw,estPitch,estRoll,estYaw,spPitch,spRoll,spYaw,rear,right,left,tilt,altitude\n");
+	}
+
+	FILE* blackboxFile = nullptr;
+	if(blackboxPath != nullptr){
+		blackboxFile = std::fopen(blackboxPath, "wb");
+		if(blackboxFile == nullptr){
+			std::perror(blackboxPath);
+			return 1;
+		}
+	}
+
+	auto wallStart = std::chrono::steady_clock::now();
+
+	Simulation simulation(config);
+	restartSystemTime();
+	if(recordPath != nullptr)
+		simulation.record(&sensorLog);
+	if(replaying)
+		simulation.replay(&sensorLog);
+
+	// --- Firmware setup, same as in src/main.cpp ---
+	L3GD20_InitTypeDef gyroInit;
+	L3GD20_FilterConfigTypeDef gyroFilterConfig;
+	LSM303DLHCAcc_InitTypeDef accInit;
+	LSM303DLHCAcc_FilterConfigTypeDef accFilterConfig;
+	LSM303DLHCMag_InitTypeDef magInit;
+
+	gyroInit.Power_Mode         = L3GD20_MODE_ACTIVE;
+	gyroInit.Output_DataRate    = L3GD20_OUTPUT_DATARATE_4;
+	gyroInit.Axes_Enable        = L3GD20_AXES_ENABLE;
+	gyroInit.Band_Width         = L3GD20_BANDWIDTH_4;
+	gyroInit.BlockData_Update   = L3GD20_BlockDataUpdate_Continous;
+	gyroInit.Endianness         = L3GD20_BLE_LSB;
+	gyroInit.Full_Scale         = L3GD20_FULLSCALE_500;
+
+	gyroFilterConfig.HighPassFilter_Mode_Selection      = L3GD20_HPM_NORMAL_MODE_RES;
+	gyroFilterConfig.HighPassFilter_CutOff_Frequency    = L3GD20_HPFCF_0;
+
+	accInit.Power_Mode 			= LSM303DLHC_NORMAL_MODE;
+	accInit.AccOutput_DataRate 	= LSM303DLHC_ODR_50_HZ;
+	accInit.Axes_Enable 		= LSM303DLHC_AXES_ENABLE;
+	accInit.AccFull_Scale 		= LSM303DLHC_FULLSCALE_2G;
+	accInit.BlockData_Update 	= LSM303DLHC_BlockUpdate_Continous;
+	accInit.Endianness 			= LSM303DLHC_BLE_LSB;
+	accInit.High_Resolution 	= LSM303DLHC_HR_ENABLE;
+
+	accFilterConfig.HighPassFilter_Mode_Selection 	= LSM303DLHC_HPM_NORMAL_MODE;
+	accFilterConfig.HighPassFilter_CutOff_Frequency	= LSM303DLHC_HPFCF_16;
+	accFilterConfig.HighPassFilter_AOI1 			= LSM303DLHC_HPF_AOI1_DISABLE;
+	accFilterConfig.HighPassFilter_AOI2 			= LSM303DLHC_HPF_AOI2_DISABLE;
+
+	magInit.Temperature_Sensor 	= LSM303DLHC_TEMPSENSOR_ENABLE;
+	magInit.MagOutput_DataRate 	= LSM303DLHC_ODR_30_HZ;
+	magInit.Working_Mode 		= LSM303DLHC_CONTINUOS_CONVERSION;
+	magInit.MagFull_Scale 		= LSM303DLHC_FS_1_3_GA;
+
+	Gyroscope gyro(gyroInit, gyroFilterConfig, 0);
+	gyro.autoRange(gyroAutoRange != 0 && recordPath == nullptr && !replaying);
+	Accelerometer acc(accInit, accFilterConfig, 0);
+	Magnetometer mag(magInit);
+	ComplementaryFilter2 cmplFilter(sensorUpdateTime, filterTimeConst);
+	// Same trust limits as src/main.cpp
+	AccelerationTrust accTrust(0.05f, 0.15f, 0.1f, 0.3f);
+	AttitudeEkf ekf(math3d::Radians(0.3f), math3d::Radians(0.01f), 0.3f, math3d::Radians(5.0f));
+
+	Controller pitchController(pitchProportional, pitchIntegral, pitchDerivative, sensorUpdateTime);
+	pitchController.limitOutput(true, -1, 1);
+	Controller rollController(rollProportional, rollIntegral, rollDerivative, sensorUpdateTime);
+	rollController.limitOutput(true, -1, 1);
+	Controller yawController(yawProportional, yawIntegral, yawDerivative, sensorUpdateTime);
+	yawController.limitOutput(true, -1, 1);
+
+	Engine::configureTimer(TIM1, Engine::StandardPwm);
+	Model model;
+	model.maneuverFraction(maneuverFraction);
+
+	Scenario scenario(scenarioType);
+
+	Vector3<float> gyroRate, accReading, accAngle, gyroAngle, angle, controllerOutput, magField;
+	bool headingValid = false, headingAligned = false;
+	float headingOffset = 0;
+	Stopwatch watch;
+	uint64_t elapsed;
+	uint64_t overruns = 0;
+	long iteration = 0;
+
+	ErrorStats estimationError[3], trackingError[3];
+	StepResponse stepResponse[2];
+	long airborne = 0;
+	long controllerSaturated = 0;
+	long motorSaturated = 0;
+	int touchdowns = 0;
+	bool wasLanded = true;
+	bool tookOff = false;
+	bool flying = false;
+	uint8_t thermalLearned = 0;
+	bool magSavePending = false;
+
+	// --- Device bring-up, same as in src/main.cpp ---
+	configStore.mount();
+	{
+		SensorCorrection correction;
+		if(Calibration::load(configStore, ConfigStore::MagCorrection, correction)){
+			mag.correction(correction);
+			headingValid = true;
+		}
+	}
+	BringUp bringUp(gyro, acc, model, configStore);
+	while(!simulation.replayEnded()){
+		watch.restart();
+		if(bringUp.poll())
+			break;
+
+		elapsed = watch.elapsed(microsecond);
+		if(elapsed < sensorUpdateTime * microsecond)
+			sleep(sensorUpdateTime * microsecond - elapsed, microsecond);
+	}
+	thermalBias.load(configStore, ConfigStore::GyroThermalBias, gyro.correction().bias);
+	uint64_t flightStart = simulation.time();
+	ekf.reset(acc.readValue());
+
+	Profiler::start();
+
+	while(simulation.time() - flightStart < duration * SYSTEM_TIME_RESOLUTION && !simulation.replayEnded()){
+		watch.restart();
+		double time = (simulation.time() - flightStart) / (double)SYSTEM_TIME_RESOLUTION;
+
+		// --- Flight loop, same as in src/main.cpp ---
+		{
+			PROFILE_SCOPE(GyroRead);
+			gyroRate = gyro.readValue();
+			gyroRate = thermalBias.apply(gyroRate, gyro.temperature());
+			gyroAngle = gyroRate * sensorUpdateTime;
+		}
+
+		{
+			PROFILE_SCOPE(AccelRead);
+			accReading = acc.readValue();
+
+			accAngle = Vector3<float>(std::atan2(-accReading[0], std::sqrt(accReading[1] * accReading[1] + accReading[2] * accReading[2])),
+									  -std::atan2(accReading[1], std::sqrt(accReading[0] * accReading[0] + accReading[2] * accReading[2])),
+									  angle[2]);
+		}
+
+		bool magUpdate;
+		{
+			PROFILE_SCOPE(MagRead);
+			magUpdate = mag.readValue(magField);
+			if(magUpdate)
+				magCalibration.add(mag.raw());
+
+			if(magCalibration.poll()){
+				SensorCorrection correction = mag.correction();
+				magCalibration.update(correction);
+				Vector3<float> change = correction.bias - mag.correction().bias;
+				if(!headingValid || change.dotProduct(change) > 1e-4f){
+					mag.correction(correction);
+					magSavePending = true;
+					headingAligned = false;
+				}
+				headingValid = true;
+			}
+
+			if(magSavePending && !flying){
+				Calibration::save(configStore, ConfigStore::MagCorrection, mag.correction());
+				magSavePending = false;
+			}
+		}
+
+		{
+			PROFILE_SCOPE(Fusion);
+			float trust = fusionTrust != 0 ? accTrust.update(accReading) : 1;
+			bool headingUpdate = magUpdate && headingValid && headingWeight > 0;
+			float heading = 0;
+			if(headingUpdate){
+				float magHeading = Magnetometer::heading(magField, angle[0], angle[1]);
+				if(!headingAligned){
+					headingOffset = magHeading - angle[2];
+					headingAligned = true;
+				}
+				heading = normalizeAngle(magHeading - headingOffset);
+			}
+
+			if(fusionEkf != 0){
+				ekf.predict(gyroRate, sensorUpdateTime);
+				ekf.correct(accReading, trust);
+				if(headingUpdate)
+					ekf.correctHeading(heading, 1);
+				angle = ekf.angles();
+			}
+			else{
+				Vector3<float> weight(trust, trust, 0);
+				if(headingUpdate){
+					float predicted = cmplFilter.readState()[2] + gyroAngle[2];
+					accAngle[2] = predicted + interpolateAngle(predicted, heading);
+					weight[2] = headingWeight;
+				}
+				angle = cmplFilter.addSample(accAngle, gyroAngle, weight);
+				angle[2] = normalizeAngle(angle[2]);
+			}
+		}
+
+		RcSticks sticks;
+		if(replaying){
+			// Receiver normalization of 1-2 ms pulses, neutral before first record
+			float* channels[4] = {&sticks.pitch, &sticks.roll, &sticks.throttle, &sticks.yaw};
+			for(uint8_t i = 0; i < 4; i++){
+				double width = simulation.rcPulseWidth(i);
+				*channels[i] = width > 0 ? (width - 1e-3) * 1e3 : (i == 2 ? 0 : 0.5f);
+			}
+		}
+		else{
+			sticks = scenario.sticks(time, sensorUpdateTime, simulation.tricopter());
+			if(recordPath != nullptr){
+				SensorRecord record = {SensorRecord::Rc, simulation.time(),
+									   {(int16_t)std::lround(1000 + sticks.pitch * 1000), (int16_t)std::lround(1000 + sticks.roll * 1000),
+										(int16_t)std::lround(1000 + sticks.throttle * 1000), (int16_t)std::lround(1000 + sticks.yaw * 1000)}};
+				sensorLog.write(record);
+			}
+		}
+		float rcPitch = (sticks.pitch - 0.5) * 2 * maxPitchAngle;
+		float rcRoll = (sticks.roll - 0.5) * 2 * maxRollAngle;
+		float rcThrottle = sticks.throttle;
+		float rcYaw = (sticks.yaw - 0.5) * 2 * maxYawAngularSpeed;
+
+		float yawAngle;
+		{
+			PROFILE_SCOPE(Control);
+			yawAngle = normalizeAngle(yawController.setpoint() + rcYaw * sensorUpdateTime);
+
+			pitchController.setpoint(rcPitch);
+			rollController.setpoint(rcRoll);
+			yawController.setpoint(yawAngle);
+
+			controllerOutput = Vector3<float>(pitchController.process(angle[0]),
+											  rollController.process(angle[1]),
+											  yawController.process(angle[2], interpolateAngle));
+		}
+
+		{
+			PROFILE_SCOPE(Mixing);
+			model.update(rcThrottle, controllerOutput);
+		}
+
+		flying = rcThrottle > 0;
+		if(flying)
+			thermalBias.interrupt();
+		else if(thermalBias.observe(gyroRate, gyro.temperature()) && ++thermalLearned >= thermalSaveInterval){
+			thermalBias.save(configStore, ConfigStore::GyroThermalBias, gyro.correction().bias);
+			thermalLearned = 0;
+		}
+
+		if(blackboxFile != nullptr){
+			PROFILE_SCOPE(Telemetry);
+			BlackboxFrame frame;
+			frame.time = (uint32_t)getSystemTime();
+			frame.gyro = gyroRate;
+			frame.acc = accReading;
+			frame.attitude = angle;
+			frame.setpoint = Vector3<float>(pitchController.setpoint(), rollController.setpoint(), yawController.setpoint());
+			frame.proportional = Vector3<float>(pitchController.proportionalTerm(), rollController.proportionalTerm(), yawController.proportionalTerm());
+			frame.integral = Vector3<float>(pitchController.integralTerm(), rollController.integralTerm(), yawController.integralTerm());
+			frame.derivative = Vector3<float>(pitchController.derivativeTerm(), rollController.derivativeTerm(), yawController.derivativeTerm());
+			frame.throttle = rcThrottle;
+			for(uint8_t i = 0; i < 3; i++)
+				frame.motors[i] = model.throttle(i);
+			frame.servo = model.tailAngle();
+			blackbox.record(frame);
+
+			uint8_t chunk[256];
+			uint16_t size;
+			while((size = blackbox.read(chunk, sizeof(chunk))) > 0)
+				std::fwrite(chunk, 1, size, blackboxFile);
+		}
+
+		// --- Evaluation ---
+		const Tricopter& tricopter = simulation.tricopter();
+		Vector3<double> truth = tricopter.angles();
+		Vector3<double> setpoint(rcPitch, rcRoll, yawAngle);
+
+		if(tricopter.landed() && !wasLanded)
+			touchdowns++;
+		wasLanded = tricopter.landed();
+		tookOff = tookOff || !wasLanded;
+
+		if(!tricopter.landed()){
+			for(int i = 0; i < 2; i++){
+				estimationError[i].add(angle[i] - truth[i]);
+				trackingError[i].add(setpoint[i] - truth[i]);
+				stepResponse[i].add(time, setpoint[i], truth[i]);
+			}
+			estimationError[2].add(interpolateAngle(truth[2], angle[2]));
+			trackingError[2].add(interpolateAngle(truth[2], setpoint[2]));
+
+			airborne++;
+			if(std::fabs(controllerOutput[0]) >= 1 || std::fabs(controllerOutput[1]) >= 1 || std::fabs(controllerOutput[2]) >= 1)
+				controllerSaturated++;
+			for(int i = 0; i < Tricopter::MotorN; i++){
+				double command = tricopter.motorCommand((Tricopter::Motors)i);
+				if(command <= 0 || command >= 1){
+					motorSaturated++;
+					break;
+				}
+			}
+		}
+
+		if(replaying){
+			if(trace != nullptr && iteration % decimation == 0)
+				std::fprintf(trace, "%.6f,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g\n",
+							 time, angle[0], angle[1], angle[2], setpoint[0], setpoint[1], setpoint[2],
+							 controllerOutput[0], controllerOutput[1], controllerOutput[2],
+							 model.throttle(0), model.throttle(1), model.throttle(2), model.tailAngle());
+		}
+		else if(trace != nullptr && iteration % decimation == 0)
+			std::fprintf(trace, "%.3f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.5f,%.4f,%.4f,%.4f,%.5f,%.4f\n",
+						 time, truth[0], truth[1], truth[2], angle[0], angle[1], angle[2],
+						 setpoint[0], setpoint[1], setpoint[2],
+						 tricopter.motorCommand(Tricopter::Rear),
+						 tricopter.motorCommand(Tricopter::Right),
+						 tricopter.motorCommand(Tricopter::Left),
+						 tricopter.servoTilt(), tricopter.position()[2]);
+		iteration++;
+
+		elapsed = watch.elapsed(microsecond);
+		if(elapsed < sensorUpdateTime * microsecond)
+			sleep(sensorUpdateTime * microsecond - elapsed, microsecond);
+		else
+			overruns++;
+	}
+
+	if(trace != nullptr)
+		std::fclose(trace);
+	if(blackboxFile != nullptr)
+		std::fclose(blackboxFile);
+
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+	// Errors against the modelled world mean nothing when sensors come from log
+	if(replaying){
+		std::printf("replayed=%llu simulated=%.2f iterations=%ld overruns=%llu bootToArmed=%.3f\n",
+					(unsigned long long)sensorLog.records(), simulation.time() / (double)SYSTEM_TIME_RESOLUTION,
+					iteration, (unsigned long long)overruns, bringUp.armedTime() / (double)SYSTEM_TIME_RESOLUTION);
+		if(profile){
+			printBringUp(bringUp);
+			printThermal();
+			printProfile();
+		}
+		return 0;
+	}
+
+	std::printf("simulated=%.1f realtime=%.0f iterations=%ld overruns=%llu bootToArmed=%.3f altitude=%.3f airborne=%.2f touchdowns=%d",
+				duration, wall > 0 ? duration / wall : 0, iteration, (unsigned long long)overruns,
+				bringUp.armedTime() / (double)SYSTEM_TIME_RESOLUTION,
+				simulation.tricopter().position()[2], airborne * sensorUpdateTime, tookOff ? touchdowns : -1);
+	std::printf(" saturation=%.4f motorSaturation=%.4f",
+				airborne ? (double)controllerSaturated / airborne : 0, airborne ? (double)motorSaturated / airborne : 0);
+	const char* axes[3] = {"Pitch", "Roll", "Yaw"};
+	for(int i = 0; i < 3; i++)
+		std::printf(" est%sRms=%.5f track%sRms=%.5f track%sMax=%.5f",
+					axes[i], estimationError[i].rms(), axes[i], trackingError[i].rms(), axes[i], trackingError[i].max());
+	for(int i = 0; i < 2; i++){
+		stepResponse[i].finish();
+		std::printf(" steps%s=%d overshoot%s=%.4f overshoot%sMax=%.4f settling%s=%.3f settling%sMax=%.3f",
+					axes[i], stepResponse[i].steps(), axes[i], stepResponse[i].meanOvershoot(), axes[i], stepResponse[i].maxOvershoot(),
+					axes[i], stepResponse[i].meanSettlingTime(), axes[i], stepResponse[i].maxSettlingTime());
+	}
+	std::printf("\n");
+
+	if(profile){
+		printBringUp(bringUp);
+		printThermal();
+		printHeading(mag);
+		printProfile();
+	}
+
+	return 0;
+}
@@ -0,0 +1,185 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "memsModel.h"
+
+#include <cstring>
+
+// Registers shared by L3GD20 and LSM303DLHC accelerometer
+#define STATUS_REG		0x27
+#define CTRL_REG4		0x23
+#define CTRL_REG5		0x24
+#define OUT_X_L			0x28
+#define FIFO_CTRL_REG	0x2E
+#define FIFO_SRC_REG	0x2F
+
+#define BLE_BIT			0x40
+#define FIFO_EN_BIT		0x40
+#define ZYXDA_BIT		0x08
+#define WTM_BIT			0x80
+#define OVRN_BIT		0x40
+#define EMPTY_BIT		0x20
+#define WTM_LEVEL_BITS	0x1F
+
+// Temperature at which bias errors are given
+static const double referenceTemperature = 25;
+
+MemsErrors::MemsErrors() :
+noise(0)
+{
+}
+
+MemsModel::MemsModel(Random& random) :
+_temperature(referenceTemperature),
+_random(random),
+_fifoHead(0),
+_fifoLevel(0),
+_overrun(false),
+_dataReady(false)
+{
+	std::memset(_registers, 0, sizeof(_registers));
+	std::memset(_fifo, 0, sizeof(_fifo));
+	std::memset(_lastSample, 0, sizeof(_lastSample));
+}
+
+MemsModel::~MemsModel()
+{
+}
+
+void MemsModel::errors(const MemsErrors& errors)
+{
+	_errors = errors;
+}
+
+void MemsModel::temperature(double celsius)
+{
+	_temperature = celsius;
+	latchTemperature();
+}
+
+void MemsModel::read(uint8_t* buffer, uint8_t address, uint16_t n)
+{
+	// Reading output registers in FIFO mode takes the oldest stored sample
+	if(address == OUT_X_L && fifoMode() != Bypass && (_registers[CTRL_REG5] & FIFO_EN_BIT) && _fifoLevel > 0){
+		latch(_fifo[_fifoHead]);
+		_fifoHead = (_fifoHead + 1) % FifoSize;
+		_fifoLevel--;
+	}
+
+	for(uint16_t i = 0; i < n; i++){
+		uint8_t a = (address + i) % RegisterN;
+		switch(a){
+		case STATUS_REG:
+			buffer[i] = _dataReady ? ZYXDA_BIT : 0;
+			break;
+		case FIFO_SRC_REG:
+			buffer[i] = (_fifoLevel & 0x1F) |
+						(_fifoLevel == 0 ? EMPTY_BIT : 0) |
+						(_overrun ? OVRN_BIT : 0) |
+						(_fifoLevel >= (_registers[FIFO_CTRL_REG] & WTM_LEVEL_BITS) ? WTM_BIT : 0);
+			break;
+		default:
+			buffer[i] = _registers[a];
+			break;
+		}
+
+		if(a == OUT_X_L + 5)
+			_dataReady = false;
+	}
+}
+
+void MemsModel::write(const uint8_t* buffer, uint8_t address, uint16_t n)
+{
+	for(uint16_t i = 0; i < n; i++){
+		uint8_t a = (address + i) % RegisterN;
+		if(a == STATUS_REG || a == FIFO_SRC_REG || (a >= OUT_X_L && a < OUT_X_L + 6))
+			continue;
+
+		_registers[a] = buffer[i];
+
+		// Entering bypass mode restarts FIFO
+		if(a == FIFO_CTRL_REG && fifoMode() == Bypass)
+			resetFifo();
+	}
+}
+
+void MemsModel::sample(const math3d::Vector3<double>& value)
+{
+	int16_t raw[3];
+	for(int i = 0; i < 3; i++)
+		raw[i] = quantize(value[i] * (1 + _errors.scale[i]) + _errors.bias[i] +
+						  _errors.thermalDrift[i] * (_temperature - referenceTemperature) + _random.gaussian(_errors.noise));
+
+	push(raw);
+}
+
+void MemsModel::push(const int16_t* raw)
+{
+	std::memcpy(_lastSample, raw, sizeof(_lastSample));
+
+	if(fifoMode() == Bypass || (_registers[CTRL_REG5] & FIFO_EN_BIT) == 0){
+		latch(raw);
+		return;
+	}
+
+	if(_fifoLevel == FifoSize){
+		_overrun = true;
+		// FIFO mode stops collecting when full, stream mode drops oldest
+		if(fifoMode() == Fifo)
+			return;
+		_fifoHead = (_fifoHead + 1) % FifoSize;
+		_fifoLevel--;
+	}
+
+	std::memcpy(_fifo[(_fifoHead + _fifoLevel) % FifoSize], raw, sizeof(_fifo[0]));
+	_fifoLevel++;
+}
+
+const int16_t* MemsModel::lastSample() const
+{
+	return _lastSample;
+}
+
+void MemsModel::latchTemperature()
+{
+}
+
+void MemsModel::resetFifo()
+{
+	_fifoHead = 0;
+	_fifoLevel = 0;
+	_overrun = false;
+}
+
+void MemsModel::latch(const int16_t* sample)
+{
+	bool bigEndian = (_registers[CTRL_REG4] & BLE_BIT) != 0;
+	for(int i = 0; i < 3; i++){
+		uint16_t v = (uint16_t)sample[i];
+		_registers[OUT_X_L + 2 * i] = bigEndian ? v >> 8 : v & 0xFF;
+		_registers[OUT_X_L + 2 * i + 1] = bigEndian ? v & 0xFF : v >> 8;
+	}
+	_dataReady = true;
+}
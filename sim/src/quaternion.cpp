@@ -0,0 +1,84 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "quaternion.h"
+
+#include <cmath>
+
+Quaternion::Quaternion() :
+w(1), x(0), y(0), z(0)
+{
+}
+
+Quaternion::Quaternion(double w, double x, double y, double z) :
+w(w), x(x), y(y), z(z)
+{
+}
+
+Quaternion Quaternion::fromAxisAngle(const math3d::Vector3<double>& axis, double angle)
+{
+	double s = std::sin(angle / 2);
+	return Quaternion(std::cos(angle / 2), axis[0] * s, axis[1] * s, axis[2] * s);
+}
+
+Quaternion Quaternion::operator *(const Quaternion& b) const
+{
+	return Quaternion(w * b.w - x * b.x - y * b.y - z * b.z,
+					  w * b.x + x * b.w + y * b.z - z * b.y,
+					  w * b.y - x * b.z + y * b.w + z * b.x,
+					  w * b.z + x * b.y - y * b.x + z * b.w);
+}
+
+Quaternion Quaternion::conjugate() const
+{
+	return Quaternion(w, -x, -y, -z);
+}
+
+math3d::Vector3<double> Quaternion::rotate(const math3d::Vector3<double>& v) const
+{
+	Quaternion r = *this * Quaternion(0, v[0], v[1], v[2]) * conjugate();
+	return math3d::Vector3<double>(r.x, r.y, r.z);
+}
+
+math3d::Vector3<double> Quaternion::rotateInverse(const math3d::Vector3<double>& v) const
+{
+	return conjugate().rotate(v);
+}
+
+void Quaternion::integrate(const math3d::Vector3<double>& rate, double dt)
+{
+	double angle = rate.magnitude() * dt;
+	if(angle <= 0)
+		return;
+
+	*this = *this * fromAxisAngle(rate / rate.magnitude(), angle);
+	normalize();
+}
+
+void Quaternion::normalize()
+{
+	double n = std::sqrt(w * w + x * x + y * y + z * z);
+	w /= n; x /= n; y /= n; z /= n;
+}
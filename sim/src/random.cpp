@@ -0,0 +1,75 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "random.h"
+
+#include <cmath>
+
+Random::Random(uint64_t seed) :
+_state(seed ? seed : 0x9E3779B97F4A7C15ull),
+_spare(0),
+_hasSpare(false)
+{
+}
+
+uint64_t Random::next()
+{
+	_state ^= _state >> 12;
+	_state ^= _state << 25;
+	_state ^= _state >> 27;
+	return _state * 0x2545F4914F6CDD1Dull;
+}
+
+double Random::uniform()
+{
+	// Use upper 53 bits for full double mantissa
+	return (next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double Random::uniform(double min, double max)
+{
+	return min + (max - min) * uniform();
+}
+
+double Random::gaussian(double sigma)
+{
+	// Marsaglia polar method, second value is kept for next call
+	if(_hasSpare){
+		_hasSpare = false;
+		return _spare * sigma;
+	}
+
+	double u, v, s;
+	do{
+		u = uniform() * 2 - 1;
+		v = uniform() * 2 - 1;
+		s = u * u + v * v;
+	}while(s >= 1 || s == 0);
+
+	s = std::sqrt(-2 * std::log(s) / s);
+	_spare = v * s;
+	_hasSpare = true;
+	return u * s * sigma;
+}
@@ -0,0 +1,84 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "scenario.h"
+#include "common.h"
+
+#include <cstring>
+
+// Time before take off in seconds
+static const double takeOffTime = 1.0;
+// Time after take off for the first manoeuvre in seconds
+static const double settleTime = 4.0;
+// Duration of single manoeuvre phase in seconds
+static const double stepTime = 2.0;
+// Stick deflection used for steps
+static const float stepDeflection = 0.1f;
+
+Scenario::Scenario(Type type, double altitude) :
+_type(type),
+_altitude(altitude),
+_integral(0)
+{
+}
+
+bool Scenario::parse(const char* name, Type& type)
+{
+	if(std::strcmp(name, "hover") == 0)
+		type = Hover;
+	else if(std::strcmp(name, "steps") == 0)
+		type = Steps;
+	else
+		return false;
+	return true;
+}
+
+RcSticks Scenario::sticks(double time, double deltaT, const Tricopter& tricopter)
+{
+	RcSticks sticks = {0.5f, 0.5f, 0.0f, 0.5f};
+
+	if(time < takeOffTime)
+		return sticks;
+
+	// Altitude hold PI-D, climb rate limits the derivative kick at take off
+	double error = _altitude - tricopter.position()[2];
+	_integral = limit(_integral + error * deltaT * 0.1, -0.3, 0.3);
+	sticks.throttle = limit(0.55 + 0.15 * error + _integral - 0.2 * tricopter.velocity()[2], 0.0, 1.0);
+
+	if(_type != Steps || time < takeOffTime + settleTime)
+		return sticks;
+
+	// Cycle through pitch, roll and yaw steps with neutral phases in between
+	int phase = (int)((time - takeOffTime - settleTime) / stepTime) % 8;
+	switch(phase){
+	case 0: sticks.pitch += stepDeflection; break;
+	case 2: sticks.pitch -= stepDeflection; break;
+	case 4: sticks.roll += stepDeflection; break;
+	case 6: sticks.yaw += stepDeflection; break;
+	default: break;
+	}
+
+	return sticks;
+}
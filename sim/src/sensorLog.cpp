@@ -0,0 +1,108 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "sensorLog.h"
+
+#include <cinttypes>
+
+SensorLog::SensorLog() :
+_file(nullptr),
+_records(0)
+{
+}
+
+SensorLog::~SensorLog()
+{
+	close();
+}
+
+bool SensorLog::create(const char* path)
+{
+	close();
+	_file = std::fopen(path, "w");
+	if(_file == nullptr)
+		return false;
+
+	std::fprintf(_file, "# G|A time x y z, R time pitch roll throttle yaw\n");
+	return true;
+}
+
+bool SensorLog::open(const char* path)
+{
+	close();
+	_file = std::fopen(path, "r");
+	return _file != nullptr;
+}
+
+void SensorLog::close()
+{
+	if(_file != nullptr)
+		std::fclose(_file);
+	_file = nullptr;
+}
+
+void SensorLog::write(const SensorRecord& record)
+{
+	if(_file == nullptr)
+		return;
+
+	std::fprintf(_file, "%c %" PRIu64 " %d %d %d", (char)record.source, record.time,
+				 record.values[0], record.values[1], record.values[2]);
+	if(record.source == SensorRecord::Rc)
+		std::fprintf(_file, " %d", record.values[3]);
+	std::fprintf(_file, "\n");
+	_records++;
+}
+
+bool SensorLog::read(SensorRecord& record)
+{
+	if(_file == nullptr)
+		return false;
+
+	char line[128];
+	while(std::fgets(line, sizeof(line), _file) != nullptr){
+		char source;
+		int values[SensorRecord::ValueN] = {0, 0, 0, 0};
+		int n = std::sscanf(line, "%c %" SCNu64 " %d %d %d %d", &source, &record.time,
+							&values[0], &values[1], &values[2], &values[3]);
+
+		bool sensor = source == SensorRecord::Gyroscope || source == SensorRecord::Accelerometer ||
+					  source == SensorRecord::Magnetometer;
+		if(!(sensor && n >= 5) && !(source == SensorRecord::Rc && n == 6))
+			continue;
+
+		record.source = (SensorRecord::Source)source;
+		for(uint8_t i = 0; i < SensorRecord::ValueN; i++)
+			record.values[i] = (int16_t)values[i];
+		_records++;
+		return true;
+	}
+	return false;
+}
+
+uint64_t SensorLog::records() const
+{
+	return _records;
+}
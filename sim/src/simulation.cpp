@@ -0,0 +1,318 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "simulation.h"
+#include "simHal.h"
+
+#include <cmath>
+#include <limits>
+
+using math3d::Vector3;
+
+extern uint64_t systemTime;
+
+// Time constant of wind gusts in seconds
+static const double gustTimeConstant = 2.0;
+
+// Interval for polling of stopped peripherals in microseconds
+static const double idlePoll = 1000;
+
+static Simulation* currentSimulation = nullptr;
+
+static const double never = std::numeric_limits<double>::infinity();
+
+SimulationConfig::SimulationConfig() :
+magneticField(0.2, 0, -0.43),
+seed(1),
+physicsRate(1000),
+temperature(25),
+temperatureRate(0),
+gust(0),
+escTimer(TIM1),
+escChannels{1, 2, 3},
+servoTimer(TIM1),
+servoChannel(4)
+{
+}
+
+Simulation::Simulation(const SimulationConfig& config) :
+_config(config),
+_random(config.seed),
+_tricopter(config.tricopter),
+_gyroscope(_random),
+_accelerometer(_random),
+_magnetometer(_random),
+_time(0),
+_nextPhysics(0),
+_nextGyroscope(idlePoll),
+_nextAccelerometer(idlePoll),
+_nextMagnetometer(idlePoll),
+_timerN(0),
+_temperature(config.temperature),
+_recordLog(nullptr),
+_replayLog(nullptr),
+_nextReplay(never),
+_rcPulseWidths{}
+{
+	_gyroscope.errors(config.gyroErrors);
+	_accelerometer.errors(config.accErrors);
+	_magnetometer.errors(config.magErrors);
+	_gyroscope.temperature(_temperature);
+	_accelerometer.temperature(_temperature);
+	_magnetometer.temperature(_temperature);
+
+	_timers[_timerN].timer = config.escTimer;
+	_timers[_timerN++].nextUpdate = idlePoll;
+	if(config.servoTimer != config.escTimer){
+		_timers[_timerN].timer = config.servoTimer;
+		_timers[_timerN++].nextUpdate = idlePoll;
+	}
+
+	currentSimulation = this;
+	systemTime = 0;
+}
+
+Simulation::~Simulation()
+{
+	if(currentSimulation == this)
+		currentSimulation = nullptr;
+}
+
+Simulation* Simulation::current()
+{
+	return currentSimulation;
+}
+
+void Simulation::advance(uint64_t microseconds)
+{
+	double end = (double)(_time + microseconds);
+
+	for(;;){
+		// Find nearest event
+		double next = _nextPhysics;
+		next = next < _nextGyroscope ? next : _nextGyroscope;
+		next = next < _nextAccelerometer ? next : _nextAccelerometer;
+		next = next < _nextMagnetometer ? next : _nextMagnetometer;
+		next = next < _nextReplay ? next : _nextReplay;
+		for(uint8_t i = 0; i < _timerN; i++)
+			next = next < _timers[i].nextUpdate ? next : _timers[i].nextUpdate;
+
+		if(next > end)
+			break;
+
+		// Actuators first so physics sees commands issued at the same instant
+		for(uint8_t i = 0; i < _timerN; i++)
+			if(_timers[i].nextUpdate == next)
+				timerUpdate(_timers[i]);
+		if(_nextPhysics == next)
+			physicsStep();
+		if(_nextGyroscope == next)
+			sampleGyroscope();
+		if(_nextAccelerometer == next)
+			sampleAccelerometer();
+		if(_nextMagnetometer == next)
+			sampleMagnetometer();
+		if(_nextReplay == next)
+			replayRecord();
+	}
+
+	_time += microseconds;
+	systemTime += microseconds;
+}
+
+void Simulation::record(SensorLog* log)
+{
+	_recordLog = log;
+}
+
+void Simulation::replay(SensorLog* log)
+{
+	_replayLog = log;
+	// Modelled sensors stop producing samples
+	_nextGyroscope = never;
+	_nextAccelerometer = never;
+	_nextMagnetometer = never;
+	_nextReplay = _replayLog->read(_replayNext) ? (double)_replayNext.time : never;
+}
+
+bool Simulation::replayEnded() const
+{
+	return _replayLog != nullptr && _nextReplay == never;
+}
+
+double Simulation::rcPulseWidth(uint8_t channel) const
+{
+	return channel < SensorRecord::ValueN ? _rcPulseWidths[channel] * 1e-6 : 0;
+}
+
+uint64_t Simulation::time() const
+{
+	return _time;
+}
+
+double Simulation::temperature() const
+{
+	return _temperature;
+}
+
+Tricopter& Simulation::tricopter()
+{
+	return _tricopter;
+}
+
+L3gd20Model& Simulation::gyroscope()
+{
+	return _gyroscope;
+}
+
+Lsm303dlhcModel& Simulation::accelerometer()
+{
+	return _accelerometer;
+}
+
+Lsm303dlhcMagModel& Simulation::magnetometer()
+{
+	return _magnetometer;
+}
+
+void Simulation::physicsStep()
+{
+	double dt = 1.0 / _config.physicsRate;
+
+	// First order Gauss-Markov gusts
+	if(_config.gust > 0){
+		double decay = dt / gustTimeConstant;
+		double spread = _config.gust * std::sqrt(2 * decay);
+		for(int i = 0; i < 3; i++)
+			_gust[i] += -_gust[i] * decay + _random.gaussian(spread);
+	}
+
+	_tricopter.wind(_config.wind + _gust);
+	_tricopter.step(dt);
+
+	if(_config.temperatureRate != 0){
+		_temperature = _config.temperature + _config.temperatureRate * _nextPhysics * 1e-6;
+		_gyroscope.temperature(_temperature);
+		_accelerometer.temperature(_temperature);
+		_magnetometer.temperature(_temperature);
+	}
+	_nextPhysics += dt * 1e6;
+}
+
+void Simulation::sampleGyroscope()
+{
+	double rate = _gyroscope.dataRate();
+	if(rate <= 0){
+		_nextGyroscope += idlePoll;
+		return;
+	}
+
+	_gyroscope.sample(_tricopter.angularRate());
+	if(_recordLog != nullptr)
+		recordSample(SensorRecord::Gyroscope, _nextGyroscope, _gyroscope.lastSample());
+	_nextGyroscope += 1e6 / rate;
+}
+
+void Simulation::sampleAccelerometer()
+{
+	double rate = _accelerometer.dataRate();
+	if(rate <= 0){
+		_nextAccelerometer += idlePoll;
+		return;
+	}
+
+	// LSM303DLHC is mounted rotated by 90 degrees around Z against L3GD20
+	Vector3<double> f = _tricopter.specificForce();
+	_accelerometer.sample(Vector3<double>(-f[1], f[0], f[2]));
+	if(_recordLog != nullptr)
+		recordSample(SensorRecord::Accelerometer, _nextAccelerometer, _accelerometer.lastSample());
+	_nextAccelerometer += 1e6 / rate;
+}
+
+void Simulation::sampleMagnetometer()
+{
+	double rate = _magnetometer.dataRate();
+	if(rate <= 0){
+		_nextMagnetometer += idlePoll;
+		return;
+	}
+
+	// Same package and axes as the accelerometer
+	Vector3<double> m = _tricopter.attitude().rotateInverse(_config.magneticField);
+	_magnetometer.sample(Vector3<double>(-m[1], m[0], m[2]));
+	if(_recordLog != nullptr)
+		recordSample(SensorRecord::Magnetometer, _nextMagnetometer, _magnetometer.lastSample());
+	_nextMagnetometer += 1e6 / rate;
+}
+
+void Simulation::timerUpdate(TimerState& state)
+{
+	double period = simTimerPeriod(state.timer);
+	if(period <= 0){
+		state.nextUpdate += idlePoll;
+		return;
+	}
+
+	simTimerUpdateEvent(state.timer);
+
+	if(state.timer == _config.escTimer)
+		for(int i = 0; i < Tricopter::MotorN; i++)
+			_tricopter.escPulse((Tricopter::Motors)i, simTimerPulseWidth(state.timer, _config.escChannels[i]));
+	if(state.timer == _config.servoTimer)
+		_tricopter.servoPulse(simTimerPulseWidth(state.timer, _config.servoChannel));
+
+	state.nextUpdate += period * 1e6;
+}
+
+void Simulation::recordSample(SensorRecord::Source source, double time, const int16_t* values)
+{
+	SensorRecord record = {source, (uint64_t)time, {values[0], values[1], values[2], 0}};
+	_recordLog->write(record);
+}
+
+void Simulation::replayRecord()
+{
+	switch(_replayNext.source){
+	case SensorRecord::Gyroscope:
+		_gyroscope.push(_replayNext.values);
+		break;
+	case SensorRecord::Accelerometer:
+		_accelerometer.push(_replayNext.values);
+		break;
+	case SensorRecord::Magnetometer:
+		_magnetometer.push(_replayNext.values);
+		break;
+	case SensorRecord::Rc:
+		for(uint8_t i = 0; i < SensorRecord::ValueN; i++)
+			_rcPulseWidths[i] = _replayNext.values[i];
+		break;
+	}
+
+	// Records out of order are applied immediately
+	double next = _nextReplay;
+	_nextReplay = _replayLog->read(_replayNext) ? (double)_replayNext.time : never;
+	if(_nextReplay < next)
+		_nextReplay = next;
+}
@@ -0,0 +1,117 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "stepResponse.h"
+
+#include <cmath>
+
+StepResponse::StepResponse(double threshold, double band) :
+_threshold(threshold),
+_band(band),
+_active(false),
+_lastSetpoint(NAN),
+_lastTime(0),
+_start(0),
+_initial(0),
+_target(0),
+_overshoot(0),
+_leftBand(0),
+_steps(0),
+_overshootSum(0),
+_overshootMax(0),
+_settlingSum(0),
+_settlingMax(0)
+{
+}
+
+void StepResponse::add(double time, double setpoint, double value)
+{
+	if(!std::isnan(_lastSetpoint) && std::fabs(setpoint - _lastSetpoint) > _threshold){
+		close();
+		_active = true;
+		_start = time;
+		_initial = _lastSetpoint;
+		_target = setpoint;
+		_overshoot = 0;
+		_leftBand = time;
+	}
+	_lastSetpoint = setpoint;
+	_lastTime = time;
+
+	if(!_active)
+		return;
+
+	double size = _target - _initial;
+	// Positive when value went past the target in direction of the step
+	double past = (value - _target) / size;
+	if(past > _overshoot)
+		_overshoot = past;
+	if(std::fabs(value - _target) > _band * std::fabs(size))
+		_leftBand = time;
+}
+
+void StepResponse::finish()
+{
+	close();
+}
+
+void StepResponse::close()
+{
+	if(!_active)
+		return;
+
+	double settling = _leftBand - _start;
+	_steps++;
+	_overshootSum += _overshoot;
+	_overshootMax = _overshoot > _overshootMax ? _overshoot : _overshootMax;
+	_settlingSum += settling;
+	_settlingMax = settling > _settlingMax ? settling : _settlingMax;
+	_active = false;
+}
+
+int StepResponse::steps() const
+{
+	return _steps;
+}
+
+double StepResponse::meanOvershoot() const
+{
+	return _steps ? _overshootSum / _steps : 0;
+}
+
+double StepResponse::maxOvershoot() const
+{
+	return _overshootMax;
+}
+
+double StepResponse::meanSettlingTime() const
+{
+	return _steps ? _settlingSum / _steps : 0;
+}
+
+double StepResponse::maxSettlingTime() const
+{
+	return _settlingMax;
+}
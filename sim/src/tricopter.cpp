@@ -0,0 +1,218 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "tricopter.h"
+#include "common.h"
+
+#include <cmath>
+
+using math3d::Vector3;
+
+static const double gravity = 9.80665;
+
+// Direction of rotor drag torque around body Z for each motor
+static const double spin[Tricopter::MotorN] = {1, 1, -1};
+
+TricopterConfig::TricopterConfig() :
+mass(1.0),
+inertia(0.021, 0.021, 0.036),
+armLength(0.4),
+frontArmAngle(math3d::Pi / 3),
+maxThrust(9.0),
+motorTimeConstant(0.05),
+torqueRatio(0.016),
+minEscPulse(1e-3),
+maxEscPulse(2e-3),
+minServoPulse(0.9e-3),
+maxServoPulse(2.1e-3),
+maxTilt(math3d::Radians(30.0)),
+servoRate(math3d::Radians(600.0)),
+linearDrag(0.25),
+angularDrag(0.02)
+{
+}
+
+Tricopter::Tricopter(const TricopterConfig& config) :
+_config(config),
+_servoTarget(0),
+_tilt(0),
+_landed(true)
+{
+	for(int i = 0; i < MotorN; i++)
+		_command[i] = _speed[i] = 0;
+}
+
+void Tricopter::escPulse(Motors motor, double pulseWidth)
+{
+	_command[motor] = limit((pulseWidth - _config.minEscPulse) / (_config.maxEscPulse - _config.minEscPulse), 0.0, 1.0);
+}
+
+void Tricopter::servoPulse(double pulseWidth)
+{
+	double centre = (_config.minServoPulse + _config.maxServoPulse) / 2;
+	double halfRange = (_config.maxServoPulse - _config.minServoPulse) / 2;
+	_servoTarget = limit((pulseWidth - centre) / halfRange, -1.0, 1.0) * _config.maxTilt;
+}
+
+void Tricopter::wind(const Vector3<double>& wind)
+{
+	_wind = wind;
+}
+
+void Tricopter::disturbance(const Vector3<double>& torque)
+{
+	_disturbance = torque;
+}
+
+void Tricopter::step(double dt)
+{
+	// Actuator dynamics
+	double motorFactor = 1 - std::exp(-dt / _config.motorTimeConstant);
+	for(int i = 0; i < MotorN; i++)
+		_speed[i] += (_command[i] - _speed[i]) * motorFactor;
+
+	double maxServoStep = _config.servoRate * dt;
+	_tilt += limit(_servoTarget - _tilt, -maxServoStep, maxServoStep);
+
+	// Motor positions and thrust vectors in body frame
+	double l = _config.armLength;
+	double sa = std::sin(_config.frontArmAngle), ca = std::cos(_config.frontArmAngle);
+	Vector3<double> position[MotorN] = {Vector3<double>(0, -l, 0),
+										Vector3<double>(l * sa, l * ca, 0),
+										Vector3<double>(-l * sa, l * ca, 0)};
+	Vector3<double> axis[MotorN] = {Vector3<double>(std::sin(_tilt), 0, std::cos(_tilt)),
+									Vector3<double>(0, 0, 1),
+									Vector3<double>(0, 0, 1)};
+
+	Vector3<double> force, torque;
+	for(int i = 0; i < MotorN; i++){
+		double thrust = _config.maxThrust * _speed[i] * _speed[i];
+		Vector3<double> f = axis[i] * thrust;
+		force += f;
+		torque += position[i].crossProduct(f);
+		torque += axis[i] * (spin[i] * _config.torqueRatio * thrust);
+	}
+
+	// Rotational dynamics with gyroscopic coupling of the rigid body
+	Vector3<double> momentum = _config.inertia * _rate;
+	torque += _disturbance - _rate * _config.angularDrag - _rate.crossProduct(momentum);
+
+	// Translational dynamics in world frame
+	Vector3<double> airVelocity = _wind - _velocity;
+	_acceleration = (_attitude.rotate(force) + airVelocity * _config.linearDrag) / _config.mass;
+	_acceleration[2] -= gravity;
+
+	if(_landed){
+		// Stays on the ground until thrust overcomes weight
+		if(_acceleration[2] <= 0){
+			_acceleration.zero();
+			_velocity.zero();
+			_rate.zero();
+			return;
+		}
+		_landed = false;
+	}
+
+	_rate += torque / _config.inertia * dt;
+	_attitude.integrate(_rate, dt);
+
+	_velocity += _acceleration * dt;
+	_position += _velocity * dt;
+
+	// Touchdown
+	if(_position[2] <= 0){
+		_position[2] = 0;
+		_velocity.zero();
+		_rate.zero();
+		_landed = true;
+
+		// Assume frame settles level on its legs, keep heading
+		Vector3<double> forward = _attitude.rotate(Vector3<double>(0, 1, 0));
+		_attitude = Quaternion::fromAxisAngle(Vector3<double>(0, 0, 1), std::atan2(-forward[0], forward[1]));
+	}
+}
+
+const Vector3<double>& Tricopter::position() const
+{
+	return _position;
+}
+
+const Vector3<double>& Tricopter::velocity() const
+{
+	return _velocity;
+}
+
+const Quaternion& Tricopter::attitude() const
+{
+	return _attitude;
+}
+
+const Vector3<double>& Tricopter::angularRate() const
+{
+	return _rate;
+}
+
+Vector3<double> Tricopter::specificForce() const
+{
+	Vector3<double> f = _acceleration;
+	f[2] += gravity;
+	return _attitude.rotateInverse(f);
+}
+
+Vector3<double> Tricopter::angles() const
+{
+	Vector3<double> up = _attitude.rotateInverse(Vector3<double>(0, 0, 1));
+	Vector3<double> forward = _attitude.rotate(Vector3<double>(0, 1, 0));
+
+	double yaw = std::atan2(-forward[0], forward[1]);
+	return Vector3<double>(std::atan2(up[1], std::sqrt(up[0] * up[0] + up[2] * up[2])),
+						   std::atan2(-up[0], std::sqrt(up[1] * up[1] + up[2] * up[2])),
+						   yaw >= 0 ? yaw : yaw + 2 * math3d::Pi);
+}
+
+double Tricopter::motorCommand(Motors motor) const
+{
+	return _command[motor];
+}
+
+double Tricopter::motorSpeed(Motors motor) const
+{
+	return _speed[motor];
+}
+
+double Tricopter::servoTilt() const
+{
+	return _tilt;
+}
+
+bool Tricopter::landed() const
+{
+	return _landed;
+}
+
+const TricopterConfig& Tricopter::config() const
+{
+	return _config;
+}
@@ -0,0 +1,65 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef TUNE_NELDERMEAD_H
+#define TUNE_NELDERMEAD_H
+
+#include <functional>
+#include <vector>
+
+/*
+ * Nelder-Mead simplex minimisation inside unit hypercube. Points are
+ * clamped to <0, 1> in every coordinate, callers map them to real ranges.
+ * Cost function evaluates whole batch at once so initial simplex and
+ * shrink steps can be spread over the worker pool.
+ */
+class NelderMead
+{
+public:
+	typedef std::vector<double> Point;
+	typedef std::function<std::vector<double>(const std::vector<Point>&)> BatchCost;
+
+	NelderMead(const BatchCost& cost, const Point& start, double initialStep = 0.25);
+
+	// Performs one iteration, returns number of cost evaluations made
+	int iterate();
+
+	const Point& best() const;
+	double bestCost() const;
+	// Largest distance of simplex vertex from the best one
+	double size() const;
+
+private:
+	void sort();
+	Point clamp(Point point) const;
+	Point lerp(const Point& from, const Point& to, double factor) const;
+	double evaluate(const Point& point);
+
+	BatchCost _cost;
+	std::vector<Point> _simplex;
+	std::vector<double> _costs;
+};
+
+#endif
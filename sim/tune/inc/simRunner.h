@@ -0,0 +1,73 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef TUNE_SIMRUNNER_H
+#define TUNE_SIMRUNNER_H
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef std::vector<std::pair<std::string, double> > ParameterList;
+typedef std::map<std::string, double> Metrics;
+
+// Random perturbations of the simulated world applied to each run
+struct Perturbation
+{
+	Perturbation();
+
+	// Relative spread of mass, uniform in <1 - mass, 1 + mass>
+	double mass;
+	// Maximum steady wind speed in m/s, random direction
+	double wind;
+	// Maximum gust intensity
+	double gust;
+	// Maximum multiplier of default sensor noise, uniform in <1, noise>
+	double noise;
+};
+
+/*
+ * Runs f3sim as a child process. Simulator uses global peripheral state
+ * like the firmware does, so separate processes are the only way to run
+ * several instances at once.
+ */
+class SimRunner
+{
+public:
+	SimRunner(const std::string& executable, double duration, const std::string& scenario);
+
+	// Returns false when simulator could not be started or printed no summary
+	bool run(uint64_t seed, const ParameterList& parameters, const Perturbation& perturbation, Metrics& metrics) const;
+
+private:
+	std::string _executable;
+	double _duration;
+	std::string _scenario;
+};
+
+#endif
@@ -0,0 +1,82 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#ifndef TUNE_WORKSTEALINGPOOL_H
+#define TUNE_WORKSTEALINGPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed set of worker threads, each with its own task deque. Owner takes
+ * newest tasks from the back, idle workers steal the oldest ones from the
+ * front of other deques. Tasks submitted from a worker go to its own deque.
+ */
+class WorkStealingPool
+{
+public:
+	typedef std::function<void()> Task;
+
+	// Zero means one thread per hardware thread
+	WorkStealingPool(unsigned threads = 0);
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	void submit(Task task);
+	// Blocks until all submitted tasks are finished
+	void wait();
+
+	unsigned threads() const;
+
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void run(unsigned index);
+	bool pop(unsigned index, Task& task);
+	bool steal(unsigned index, Task& task);
+
+	std::vector<Queue> _queues;
+	std::vector<std::thread> _threads;
+
+	std::mutex _mutex;
+	std::condition_variable _available;
+	std::condition_variable _finished;
+	unsigned _queued;
+	unsigned _pending;
+	unsigned _next;
+	bool _stop;
+};
+
+#endif
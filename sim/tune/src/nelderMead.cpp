@@ -0,0 +1,169 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "nelderMead.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Standard coefficients
+static const double reflection = 1.0;
+static const double expansion = 2.0;
+static const double contraction = 0.5;
+static const double shrinkage = 0.5;
+
+NelderMead::NelderMead(const BatchCost& cost, const Point& start, double initialStep) :
+_cost(cost)
+{
+	// Initial simplex along coordinate axes, stepping inwards near the upper bound
+	_simplex.push_back(clamp(start));
+	for(unsigned i = 0; i < start.size(); i++){
+		Point vertex = _simplex[0];
+		vertex[i] += (vertex[i] + initialStep <= 1) ? initialStep : -initialStep;
+		_simplex.push_back(clamp(vertex));
+	}
+
+	_costs = _cost(_simplex);
+	sort();
+}
+
+int NelderMead::iterate()
+{
+	unsigned n = _simplex.size() - 1;
+
+	// Centroid of all vertices but the worst
+	Point centroid(n, 0.0);
+	for(unsigned i = 0; i < n; i++)
+		for(unsigned j = 0; j < n; j++)
+			centroid[j] += _simplex[i][j] / n;
+
+	Point reflected = lerp(centroid, _simplex[n], -reflection);
+	double reflectedCost = evaluate(reflected);
+
+	if(reflectedCost < _costs[0]){
+		Point expanded = lerp(centroid, _simplex[n], -expansion);
+		double expandedCost = evaluate(expanded);
+		if(expandedCost < reflectedCost){
+			_simplex[n] = expanded;
+			_costs[n] = expandedCost;
+		}
+		else{
+			_simplex[n] = reflected;
+			_costs[n] = reflectedCost;
+		}
+		sort();
+		return 2;
+	}
+
+	if(reflectedCost < _costs[n - 1]){
+		_simplex[n] = reflected;
+		_costs[n] = reflectedCost;
+		sort();
+		return 1;
+	}
+
+	// Contract towards the better of worst and reflected point
+	bool outside = reflectedCost < _costs[n];
+	Point contracted = lerp(centroid, outside ? reflected : _simplex[n], contraction);
+	double contractedCost = evaluate(contracted);
+	if(contractedCost < (outside ? reflectedCost : _costs[n])){
+		_simplex[n] = contracted;
+		_costs[n] = contractedCost;
+		sort();
+		return 2;
+	}
+
+	// Shrink everything towards the best vertex
+	std::vector<Point> shrunk;
+	for(unsigned i = 1; i <= n; i++)
+		shrunk.push_back(lerp(_simplex[0], _simplex[i], shrinkage));
+
+	std::vector<double> shrunkCosts = _cost(shrunk);
+	for(unsigned i = 1; i <= n; i++){
+		_simplex[i] = shrunk[i - 1];
+		_costs[i] = shrunkCosts[i - 1];
+	}
+	sort();
+	return 2 + n;
+}
+
+const NelderMead::Point& NelderMead::best() const
+{
+	return _simplex[0];
+}
+
+double NelderMead::bestCost() const
+{
+	return _costs[0];
+}
+
+double NelderMead::size() const
+{
+	double size = 0;
+	for(unsigned i = 1; i < _simplex.size(); i++){
+		double distance = 0;
+		for(unsigned j = 0; j < _simplex[i].size(); j++)
+			distance += (_simplex[i][j] - _simplex[0][j]) * (_simplex[i][j] - _simplex[0][j]);
+		size = std::max(size, std::sqrt(distance));
+	}
+	return size;
+}
+
+void NelderMead::sort()
+{
+	std::vector<unsigned> order(_simplex.size());
+	for(unsigned i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [this](unsigned a, unsigned b){ return _costs[a] < _costs[b]; });
+
+	std::vector<Point> simplex;
+	std::vector<double> costs;
+	for(unsigned i = 0; i < order.size(); i++){
+		simplex.push_back(_simplex[order[i]]);
+		costs.push_back(_costs[order[i]]);
+	}
+	_simplex.swap(simplex);
+	_costs.swap(costs);
+}
+
+NelderMead::Point NelderMead::clamp(Point point) const
+{
+	for(unsigned i = 0; i < point.size(); i++)
+		point[i] = std::min(1.0, std::max(0.0, point[i]));
+	return point;
+}
+
+NelderMead::Point NelderMead::lerp(const Point& from, const Point& to, double factor) const
+{
+	Point point(from.size());
+	for(unsigned i = 0; i < from.size(); i++)
+		point[i] = from[i] + (to[i] - from[i]) * factor;
+	return clamp(point);
+}
+
+double NelderMead::evaluate(const Point& point)
+{
+	return _cost(std::vector<Point>(1, point))[0];
+}
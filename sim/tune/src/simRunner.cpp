@@ -0,0 +1,100 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "simRunner.h"
+#include "random.h"
+#include "math3d.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+// Defaults of f3sim, perturbations scale these
+static const double defaultMass = 1.0;
+static const double defaultGyroNoise = math3d::Radians(0.3);
+static const double defaultAccNoise = 0.05;
+
+Perturbation::Perturbation() :
+mass(0),
+wind(0),
+gust(0),
+noise(1)
+{
+}
+
+SimRunner::SimRunner(const std::string& executable, double duration, const std::string& scenario) :
+_executable(executable),
+_duration(duration),
+_scenario(scenario)
+{
+}
+
+bool SimRunner::run(uint64_t seed, const ParameterList& parameters, const Perturbation& perturbation, Metrics& metrics) const
+{
+	// Perturbations are drawn from the run seed so every candidate sees the same worlds
+	Random random(seed * 0x9E3779B97F4A7C15ull + 1);
+	double windAngle = random.uniform(0, 2 * math3d::Pi);
+	double windSpeed = random.uniform(0, perturbation.wind);
+	double noise = random.uniform(1, perturbation.noise > 1 ? perturbation.noise : 1);
+
+	std::ostringstream command;
+	command.precision(9);
+	command << _executable << " -t " << _duration << " -s " << seed << " -c " << _scenario
+			<< " -p mass=" << defaultMass * random.uniform(1 - perturbation.mass, 1 + perturbation.mass)
+			<< " -p windX=" << windSpeed * std::cos(windAngle)
+			<< " -p windY=" << windSpeed * std::sin(windAngle)
+			<< " -p gust=" << random.uniform(0, perturbation.gust)
+			<< " -p gyroNoise=" << defaultGyroNoise * noise
+			<< " -p accNoise=" << defaultAccNoise * noise;
+
+	// Explicit parameters go last so they override perturbations
+	for(unsigned i = 0; i < parameters.size(); i++)
+		command << " -p " << parameters[i].first << "=" << parameters[i].second;
+
+	FILE* pipe = popen(command.str().c_str(), "r");
+	if(pipe == nullptr)
+		return false;
+
+	std::string output;
+	char buffer[512];
+	while(std::fgets(buffer, sizeof(buffer), pipe) != nullptr)
+		output += buffer;
+
+	if(pclose(pipe) != 0)
+		return false;
+
+	// Summary is single line of name=value pairs
+	metrics.clear();
+	std::istringstream stream(output);
+	std::string pair;
+	while(stream >> pair){
+		size_t eq = pair.find('=');
+		if(eq == std::string::npos)
+			continue;
+		metrics[pair.substr(0, eq)] = std::strtod(pair.c_str() + eq + 1, nullptr);
+	}
+	return !metrics.empty();
+}
@@ -0,0 +1,308 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Monte-Carlo tuning of the flight control parameters. Every candidate
+ * parameter set is flown by f3sim in several randomly perturbed worlds,
+ * runs are spread over all cores by a work-stealing pool.
+ *
+ * Without -v the fixed parameters are evaluated and statistics of every
+ * simulator metric are printed. With -v the listed parameters are
+ * optimised by Nelder-Mead within given bounds.
+ *
+ * Usage: f3tune [-b f3sim] [-j threads] [-n runs] [-t seconds] [-c scenario]
+ *               [-s seed] [-i iterations] [-m massSpread] [-w wind] [-g gust]
+ *               [-e noiseScale] [-p name=value]... [-v name=min:max[:start]]...
+ */
+
+#include "workStealingPool.h"
+#include "simRunner.h"
+#include "nelderMead.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+// Cost weights, errors in radians and times in seconds
+static const double trackingWeight = 1.0;
+static const double overshootWeight = 0.2;
+static const double settlingWeight = 0.1;
+static const double saturationWeight = 0.5;
+// Added for every touchdown after take off and for failed runs
+static const double crashPenalty = 10.0;
+
+struct Variable
+{
+	std::string name;
+	double min;
+	double max;
+	double start;
+};
+
+struct Statistics
+{
+	double mean;
+	double deviation;
+	double min;
+	double max;
+};
+
+static double runCost(const Metrics& metrics)
+{
+	Metrics::const_iterator touchdowns = metrics.find("touchdowns");
+	if(touchdowns == metrics.end() || touchdowns->second < 0)
+		return crashPenalty;
+
+	double cost = touchdowns->second * crashPenalty;
+	const char* axes[2] = {"Pitch", "Roll"};
+	for(int i = 0; i < 2; i++){
+		std::string axis(axes[i]);
+		cost += trackingWeight * metrics.at("track" + axis + "Rms") +
+				overshootWeight * metrics.at("overshoot" + axis) +
+				settlingWeight * metrics.at("settling" + axis);
+	}
+	cost += saturationWeight * metrics.at("saturation");
+
+	// Diverged simulation is as bad as a crash
+	return std::isfinite(cost) ? cost : crashPenalty;
+}
+
+static std::map<std::string, Statistics> summarize(const std::vector<Metrics>& runs)
+{
+	std::map<std::string, Statistics> statistics;
+	std::map<std::string, int> counts;
+
+	for(unsigned i = 0; i < runs.size(); i++){
+		for(Metrics::const_iterator it = runs[i].begin(); it != runs[i].end(); ++it){
+			Statistics& s = statistics[it->first];
+			if(counts[it->first]++ == 0){
+				s.mean = s.deviation = 0;
+				s.min = s.max = it->second;
+			}
+			s.mean += it->second;
+			s.deviation += it->second * it->second;
+			s.min = std::min(s.min, it->second);
+			s.max = std::max(s.max, it->second);
+		}
+	}
+
+	for(std::map<std::string, Statistics>::iterator it = statistics.begin(); it != statistics.end(); ++it){
+		int n = counts[it->first];
+		it->second.mean /= n;
+		it->second.deviation = std::sqrt(std::max(0.0, it->second.deviation / n - it->second.mean * it->second.mean));
+	}
+	return statistics;
+}
+
+static bool parseParameter(const char* text, std::pair<std::string, double>& parameter)
+{
+	const char* eq = std::strchr(text, '=');
+	if(eq == nullptr || eq == text)
+		return false;
+	parameter = std::make_pair(std::string(text, eq), std::atof(eq + 1));
+	return true;
+}
+
+static bool parseVariable(const char* text, Variable& variable)
+{
+	const char* eq = std::strchr(text, '=');
+	if(eq == nullptr || eq == text)
+		return false;
+
+	variable.name = std::string(text, eq);
+	int n = std::sscanf(eq + 1, "%lf:%lf:%lf", &variable.min, &variable.max, &variable.start);
+	if(n < 2 || variable.max <= variable.min)
+		return false;
+	if(n < 3)
+		variable.start = (variable.min + variable.max) / 2;
+	return true;
+}
+
+static void usage()
+{
+	std::fprintf(stderr, "usage: f3tune [-b f3sim] [-j threads] [-n runs] [-t seconds] [-c scenario] [-s seed]\n"
+						 "              [-i iterations] [-m massSpread] [-w wind] [-g gust] [-e noiseScale]\n"
+						 "              [-p name=value]... [-v name=min:max[:start]]...\n");
+}
+
+int main(int argc, char** argv)
+{
+	std::string executable = "./f3sim";
+	std::string scenario = "steps";
+	unsigned threads = 0;
+	int runs = 16;
+	double duration = 60;
+	uint64_t seed = 1;
+	int iterations = 100;
+	Perturbation perturbation;
+	ParameterList fixed;
+	std::vector<Variable> variables;
+
+	perturbation.mass = 0.1;
+	perturbation.wind = 2.0;
+	perturbation.gust = 1.0;
+	perturbation.noise = 2.0;
+
+	for(int i = 1; i < argc; i++){
+		bool hasValue = i + 1 < argc;
+		std::pair<std::string, double> parameter;
+		Variable variable;
+
+		if(!hasValue){
+			usage();
+			return 1;
+		}
+
+		if(std::strcmp(argv[i], "-b") == 0)
+			executable = argv[++i];
+		else if(std::strcmp(argv[i], "-j") == 0)
+			threads = std::atoi(argv[++i]);
+		else if(std::strcmp(argv[i], "-n") == 0)
+			runs = std::max(1, std::atoi(argv[++i]));
+		else if(std::strcmp(argv[i], "-t") == 0)
+			duration = std::atof(argv[++i]);
+		else if(std::strcmp(argv[i], "-c") == 0)
+			scenario = argv[++i];
+		else if(std::strcmp(argv[i], "-s") == 0)
+			seed = std::strtoull(argv[++i], nullptr, 10);
+		else if(std::strcmp(argv[i], "-i") == 0)
+			iterations = std::atoi(argv[++i]);
+		else if(std::strcmp(argv[i], "-m") == 0)
+			perturbation.mass = std::atof(argv[++i]);
+		else if(std::strcmp(argv[i], "-w") == 0)
+			perturbation.wind = std::atof(argv[++i]);
+		else if(std::strcmp(argv[i], "-g") == 0)
+			perturbation.gust = std::atof(argv[++i]);
+		else if(std::strcmp(argv[i], "-e") == 0)
+			perturbation.noise = std::atof(argv[++i]);
+		else if(std::strcmp(argv[i], "-p") == 0 && parseParameter(argv[i + 1], parameter)){
+			fixed.push_back(parameter);
+			i++;
+		}
+		else if(std::strcmp(argv[i], "-v") == 0 && parseVariable(argv[i + 1], variable)){
+			variables.push_back(variable);
+			i++;
+		}
+		else{
+			usage();
+			return 1;
+		}
+	}
+
+	WorkStealingPool pool(threads);
+	SimRunner runner(executable, duration, scenario);
+	auto wallStart = std::chrono::steady_clock::now();
+	long simulations = 0;
+	bool failed = false;
+
+	// Flies every candidate in the same set of perturbed worlds
+	auto fly = [&](const std::vector<ParameterList>& candidates) -> std::vector<std::vector<Metrics> > {
+		std::vector<std::vector<Metrics> > results(candidates.size(), std::vector<Metrics>(runs));
+		std::vector<std::vector<char> > ok(candidates.size(), std::vector<char>(runs, 0));
+
+		for(unsigned c = 0; c < candidates.size(); c++)
+			for(int r = 0; r < runs; r++)
+				pool.submit([&, c, r]{ ok[c][r] = runner.run(seed + r, candidates[c], perturbation, results[c][r]); });
+		pool.wait();
+
+		simulations += candidates.size() * runs;
+		for(unsigned c = 0; c < candidates.size(); c++)
+			for(int r = 0; r < runs; r++)
+				if(!ok[c][r]){
+					results[c][r].clear();
+					failed = true;
+				}
+		return results;
+	};
+
+	auto candidate = [&](const NelderMead::Point& point) -> ParameterList {
+		ParameterList parameters(fixed);
+		for(unsigned i = 0; i < variables.size(); i++)
+			parameters.push_back(std::make_pair(variables[i].name, variables[i].min + point[i] * (variables[i].max - variables[i].min)));
+		return parameters;
+	};
+
+	ParameterList best = fixed;
+
+	if(!variables.empty()){
+		NelderMead::BatchCost cost = [&](const std::vector<NelderMead::Point>& points) -> std::vector<double> {
+			std::vector<ParameterList> candidates;
+			for(unsigned i = 0; i < points.size(); i++)
+				candidates.push_back(candidate(points[i]));
+
+			std::vector<std::vector<Metrics> > results = fly(candidates);
+			std::vector<double> costs(points.size(), 0.0);
+			for(unsigned c = 0; c < points.size(); c++){
+				for(int r = 0; r < runs; r++)
+					costs[c] += results[c][r].empty() ? crashPenalty : runCost(results[c][r]);
+				costs[c] /= runs;
+			}
+			return costs;
+		};
+
+		NelderMead::Point start;
+		for(unsigned i = 0; i < variables.size(); i++)
+			start.push_back((variables[i].start - variables[i].min) / (variables[i].max - variables[i].min));
+
+		NelderMead optimizer(cost, start);
+		for(int i = 0; i < iterations && optimizer.size() > 1e-3; i++){
+			optimizer.iterate();
+
+			std::printf("iteration=%d simulations=%ld cost=%.5f", i + 1, simulations, optimizer.bestCost());
+			ParameterList parameters = candidate(optimizer.best());
+			for(unsigned j = fixed.size(); j < parameters.size(); j++)
+				std::printf(" %s=%.5g", parameters[j].first.c_str(), parameters[j].second);
+			std::printf("\n");
+			std::fflush(stdout);
+		}
+		best = candidate(optimizer.best());
+	}
+
+	// Final statistics of fixed or optimised parameters
+	std::vector<Metrics> results = fly(std::vector<ParameterList>(1, best))[0];
+	std::map<std::string, Statistics> statistics = summarize(results);
+
+	double cost = 0;
+	for(int r = 0; r < runs; r++)
+		cost += results[r].empty() ? crashPenalty : runCost(results[r]);
+
+	std::printf("%-24s %12s %12s %12s %12s\n", "metric", "mean", "deviation", "min", "max");
+	for(std::map<std::string, Statistics>::const_iterator it = statistics.begin(); it != statistics.end(); ++it)
+		std::printf("%-24s %12.5g %12.5g %12.5g %12.5g\n", it->first.c_str(),
+					it->second.mean, it->second.deviation, it->second.min, it->second.max);
+
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+	std::printf("cost=%.5f runs=%d threads=%u simulations=%ld wall=%.1f\nparameters:", cost / runs, runs, pool.threads(), simulations, wall);
+	for(unsigned i = 0; i < best.size(); i++)
+		std::printf(" -p %s=%.6g", best[i].first.c_str(), best[i].second);
+	std::printf("\n");
+
+	if(failed)
+		std::fprintf(stderr, "f3tune: some simulator runs failed, check -b %s\n", executable.c_str());
+	return failed ? 2 : 0;
+}
@@ -0,0 +1,137 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "workStealingPool.h"
+
+// Index of the pool worker running on this thread, or -1 outside the pool
+static thread_local int workerIndex = -1;
+
+WorkStealingPool::WorkStealingPool(unsigned threads) :
+_queues(threads ? threads : (std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1)),
+_queued(0),
+_pending(0),
+_next(0),
+_stop(false)
+{
+	for(unsigned i = 0; i < _queues.size(); i++)
+		_threads.push_back(std::thread(&WorkStealingPool::run, this, i));
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_available.notify_all();
+
+	for(unsigned i = 0; i < _threads.size(); i++)
+		_threads[i].join();
+}
+
+void WorkStealingPool::submit(Task task)
+{
+	unsigned index;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		index = workerIndex >= 0 ? workerIndex : _next++ % _queues.size();
+		_pending++;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_queues[index].mutex);
+		_queues[index].tasks.push_back(std::move(task));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_queued++;
+	}
+	_available.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_finished.wait(lock, [this]{ return _pending == 0; });
+}
+
+unsigned WorkStealingPool::threads() const
+{
+	return _threads.size();
+}
+
+void WorkStealingPool::run(unsigned index)
+{
+	workerIndex = index;
+
+	while(true){
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_available.wait(lock, [this]{ return _stop || _queued > 0; });
+			if(_stop && _queued == 0)
+				return;
+			// Reserve one task, it is guaranteed to be in some deque
+			_queued--;
+		}
+
+		Task task;
+		while(!pop(index, task) && !steal(index, task))
+			std::this_thread::yield();
+
+		task();
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		if(--_pending == 0)
+			_finished.notify_all();
+	}
+}
+
+bool WorkStealingPool::pop(unsigned index, Task& task)
+{
+	Queue& queue = _queues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if(queue.tasks.empty())
+		return false;
+
+	task = std::move(queue.tasks.back());
+	queue.tasks.pop_back();
+	return true;
+}
+
+bool WorkStealingPool::steal(unsigned index, Task& task)
+{
+	for(unsigned i = 1; i < _queues.size(); i++){
+		Queue& victim = _queues[(index + i) % _queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if(victim.tasks.empty())
+			continue;
+
+		task = std::move(victim.tasks.front());
+		victim.tasks.pop_front();
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,92 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "accelerationTrust.h"
+#include "ccm.h"
+
+// Limits turned into the squared space the cues are measured in
+AccelerationTrust::AccelerationTrust(float magnitudeTolerance, float magnitudeLimit, float jerkTolerance, float jerkLimit) :
+_magnitudeTolerance((1 + magnitudeTolerance) * (1 + magnitudeTolerance) - 1),
+_magnitudeLimit((1 + magnitudeLimit) * (1 + magnitudeLimit) - 1),
+_jerkTolerance(jerkTolerance * jerkTolerance * WindowLength * WindowLength),
+_jerkLimit(jerkLimit * jerkLimit * WindowLength * WindowLength)
+{
+	reset();
+}
+
+void AccelerationTrust::reset()
+{
+	for(uint8_t i = 0; i < 2 * WindowLength; i++)
+		_samples[i] = math3d::ZeroVector;
+	_recentSum = math3d::ZeroVector;
+	_previousSum = math3d::ZeroVector;
+	_next = 0;
+	_count = 0;
+	_weight = 0;
+}
+
+CCM_CODE float AccelerationTrust::update(const math3d::Vector3<float>& reading)
+{
+	float magnitude = reading.dotProduct(reading);
+	if(magnitude <= 0){
+		_weight = 0;
+		return _weight;
+	}
+
+	// Slide both windows by one sample, sums stay exact in float for
+	// readings of a few g
+	math3d::Vector3<float>& oldest = _samples[_next];
+	math3d::Vector3<float>& middle = _samples[(_next + WindowLength) % (2 * WindowLength)];
+	_previousSum += middle - oldest;
+	_recentSum += reading - middle;
+	oldest = reading;
+	_next = (_next + 1) % (2 * WindowLength);
+	if(_count < 2 * WindowLength)
+		_count++;
+
+	_weight = ramp(magnitude > 1 ? magnitude - 1 : 1 - magnitude, _magnitudeTolerance, _magnitudeLimit);
+
+	// Until both windows are full the jump is not known, magnitude decides alone
+	if(_count == 2 * WindowLength){
+		math3d::Vector3<float> jump = _recentSum - _previousSum;
+		_weight *= ramp(jump.dotProduct(jump), _jerkTolerance, _jerkLimit);
+	}
+
+	return _weight;
+}
+
+float AccelerationTrust::weight() const
+{
+	return _weight;
+}
+
+float AccelerationTrust::ramp(float value, float tolerance, float limit)
+{
+	if(value <= tolerance)
+		return 1;
+	if(value >= limit)
+		return 0;
+	return (limit - value) / (limit - tolerance);
+}
@@ -62,11 +62,24 @@
 #define FIFO_EMPTY					0x20
 #define FIFO_OVERRUN				0x40
 
+// Temperature sensor, part of magnetometer //
+// Temperature is read along with data once per period in ms
+#define TEMPERATURE_PERIOD			1000
+// 12 bit left aligned, 8 LSB/deg from an untrimmed offset, only changes
+// are accurate
+#define LSM_TEMPERATURE_OFFSET		20
+#define LSM_TEMPERATURE_SENSITIVITY	8
+
 // Others //
 #define CHANGE_DELAY                5
 
 Accelerometer::Accelerometer(LSM303DLHCAcc_InitTypeDef& accInit, LSM303DLHCAcc_FilterConfigTypeDef& filterConfig, uint16_t maxBufferSize) :
-_maxBufferSize(maxBufferSize)
+_maxBufferSize(maxBufferSize),
+_readyTime(0),
+_restartFifo(false),
+_clearFifo(false),
+_temperature(LSM_TEMPERATURE_OFFSET),
+_temperatureTime(0)
 {
 	switch(accInit.AccOutput_DataRate)
 	{
@@ -107,8 +120,17 @@ _maxBufferSize(maxBufferSize)
     // uint8_t aaa;
     // LSM303DLHC_Read(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG2_A, &aaa, 1);
 
+    // Temperature sensor is enabled in magnetometer configuration
+    uint8_t craM;
+    LSM303DLHC_Read(MAG_I2C_ADDRESS, LSM303DLHC_CRA_REG_M, &craM, 1);
+    craM |= LSM303DLHC_TEMPSENSOR_ENABLE;
+    LSM303DLHC_Write(MAG_I2C_ADDRESS, LSM303DLHC_CRA_REG_M, &craM);
+
     /* Initialize scale buffer */
     _scaleBuffer.push_back(std::make_pair(accInit.AccFull_Scale, 0));
+
+    /* Let LSM303DLHC perform changes, the caller goes on meanwhile */
+    settle();
 }
 
 int Accelerometer::test()
@@ -118,14 +140,15 @@ int Accelerometer::test()
 	discard(true);
 	clearFifo();
 	sw.start();
+	int samples = 0;
 	while(sw.elapsed() < 1000)
 	{
-		retrieveValues();
+		samples += retrieveValues();
 	}
 
 	// TODO: Data rate je 2x vyssi nez by mal byt
 	// TODO: 400 a 1344 Hz nefunguje spravne
-	return _dataBuffer.size();
+	return samples;
 }
 
 math3d::Vector3<float> Accelerometer::readValue()
@@ -162,8 +185,8 @@ math3d::Vector3<float> Accelerometer::readValue()
         break;
     }
 
-    // Divide by sensitivity and scale from miliG to G
-    math3d::Vector3<float> ret = math3d::Vector3<float>(_dataBuffer.front()) / (sensitivity * 1000);
+    // Divide by sensitivity, scale from miliG to G and correct
+    math3d::Vector3<float> ret = _correction.apply(_dataBuffer.front(), 1 / (sensitivity * 1000));
 
     discard();
     return ret;
@@ -246,14 +269,12 @@ void Accelerometer::changeScale(uint8_t scale)
     /* Write new value to CTRL_REG4 regsister */
     LSM303DLHC_Write(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG4_A, &ctrl4);
 
-    /* Let L3GD20 perform changes */
-    sleep(CHANGE_DELAY);
-
-    /* Discard values recorded during scale change */
-    if(fifoMode)
-    	clearFifo();
+    /* Let LSM303DLHC perform changes, values recorded meanwhile are discarded */
+    settle();
+    _clearFifo = fifoMode;
 
-    if (_scaleBuffer.back().second > 0)
+    /* With no room left the newest label is reused, scale changes faster than reads */
+    if (_scaleBuffer.back().second > 0 && !_scaleBuffer.full())
         _scaleBuffer.push_back(std::make_pair(scale, 0));
     else
         _scaleBuffer.back().first = scale;
@@ -263,17 +284,88 @@ void Accelerometer::useHighPassFilter(bool use)
 {
 	LSM303DLHC_AccFilterCmd(use ? LSM303DLHC_HIGHPASSFILTER_ENABLE : LSM303DLHC_HIGHPASSFILTER_DISABLE);
 
-    /* Let L3GD20 perform changes */
-    sleep(CHANGE_DELAY);
+    /* Let LSM303DLHC perform changes */
+    settle();
+}
+
+bool Accelerometer::ready()
+{
+	if (getSystemTime() < _readyTime)
+		return false;
+
+	// Second half of FIFO reset
+	if (_restartFifo){
+		uint8_t fifoCtrl;
+		LSM303DLHC_Read(ACC_I2C_ADDRESS, LSM303DLHC_FIFO_CTRL_REG_A, &fifoCtrl, 1);
+		fifoCtrl = fifoCtrl | FIFO_MODE;
+		LSM303DLHC_Write(ACC_I2C_ADDRESS, LSM303DLHC_FIFO_CTRL_REG_A, &fifoCtrl);
+		_restartFifo = false;
+		settle();
+		return false;
+	}
+
+	if (_clearFifo){
+		_clearFifo = false;
+		clearFifo();
+		return getSystemTime() >= _readyTime && !_restartFifo;
+	}
+
+	return true;
+}
+
+uint64_t Accelerometer::readyTime() const
+{
+	return _readyTime;
+}
+
+float Accelerometer::temperature() const
+{
+	return _temperature;
+}
+
+void Accelerometer::sampleTemperature()
+{
+	uint64_t now = getSystemTime();
+	if (now < _temperatureTime)
+		return;
+
+	// Auto increment bit of multi-byte reads is not understood by magnetometer
+	uint8_t high, low;
+	LSM303DLHC_Read(MAG_I2C_ADDRESS, LSM303DLHC_TEMP_OUT_H_M, &high, 1);
+	LSM303DLHC_Read(MAG_I2C_ADDRESS, LSM303DLHC_TEMP_OUT_L_M, &low, 1);
+	int16_t raw = (int16_t)((uint16_t)high << 8 | low) >> 4;
+	_temperature = LSM_TEMPERATURE_OFFSET + (float)raw / LSM_TEMPERATURE_SENSITIVITY;
+	_temperatureTime = now + TEMPERATURE_PERIOD * (SYSTEM_TIME_RESOLUTION / millisecond);
+}
+
+void Accelerometer::correction(const SensorCorrection& correction)
+{
+	_correction = correction;
+}
+
+const SensorCorrection& Accelerometer::correction() const
+{
+	return _correction;
 }
 
-void Accelerometer::retrieveValues()
+void Accelerometer::settle()
+{
+	_readyTime = getSystemTime() + CHANGE_DELAY * (SYSTEM_TIME_RESOLUTION / millisecond);
+}
+
+int Accelerometer::retrieveValues()
 {
 	const uint16_t shift = 16;
     uint8_t tmpBuffer[6] = {0};
     math3d::Vector3<int16_t> vec;
     uint8_t ctrl4, fifoCtrl, fifoSrc;
     int i = 0;
+    int count = 0;
+
+    if (!ready())
+        return 0;
+
+    sampleTemperature();
 
     LSM303DLHC_Read(ACC_I2C_ADDRESS, LSM303DLHC_FIFO_CTRL_REG_A, &fifoCtrl, 1);
     bool fifoMode = (fifoCtrl & IS_FIFO) != 0;
@@ -284,11 +376,11 @@ void Accelerometer::retrieveValues()
 
         /* Test FIFO empty bit */
         if ((fifoSrc & FIFO_EMPTY) != 0)
-            return;
+            return 0;
     }
 
     if(_scaleBuffer.empty())
-        return;
+        return 0;
 
     LSM303DLHC_Read(ACC_I2C_ADDRESS, LSM303DLHC_CTRL_REG4_A, &ctrl4, 1);
     do{
@@ -313,12 +405,13 @@ void Accelerometer::retrieveValues()
         }
 
         // Check if buffer size isn't larger than maximum
-        if(_maxBufferSize > 0 && _dataBuffer.size() >= _maxBufferSize)
+        if((_maxBufferSize > 0 && _dataBuffer.size() >= _maxBufferSize) || _dataBuffer.full())
         	discard();
 
         /* Place retrieved values in local buffer */
         _dataBuffer.push_back(vec / shift);
         _scaleBuffer.back().second++;
+        count++;
 
         // FIFO empty test
         if (fifoMode){
@@ -332,6 +425,8 @@ void Accelerometer::retrieveValues()
     /* FIFO needs reset after being full */
     if (fifoMode && fifoFull)
         resetFifo();
+
+    return count;
 }
 
 void Accelerometer::clearFifo()
@@ -355,7 +450,7 @@ void Accelerometer::clearFifo()
 	if (fifoFull)
 		resetFifo();
 	else
-		sleep(CHANGE_DELAY);
+		settle();
 }
 
 void Accelerometer::resetFifo()
@@ -363,15 +458,12 @@ void Accelerometer::resetFifo()
 	uint8_t fifoCtrl;
 	LSM303DLHC_Read(ACC_I2C_ADDRESS, LSM303DLHC_FIFO_CTRL_REG_A, &fifoCtrl, 1);
 
-	// Set to bypass mode to restart data collection
+	// Set to bypass mode to restart data collection, ready() changes
+	// back to FIFO mode once it settles
 	fifoCtrl = (fifoCtrl & (~MODE_BITS));
 	LSM303DLHC_Write(ACC_I2C_ADDRESS, LSM303DLHC_FIFO_CTRL_REG_A, &fifoCtrl);
-	sleep(CHANGE_DELAY);
-
-	// Change back to FIFO mode
-	fifoCtrl = fifoCtrl | FIFO_MODE;
-	LSM303DLHC_Write(ACC_I2C_ADDRESS, LSM303DLHC_FIFO_CTRL_REG_A, &fifoCtrl);
-	sleep(CHANGE_DELAY);
+	_restartFifo = true;
+	settle();
 }
 
 // TODO: interupt if FIFO full or Bypass mode value changes
@@ -0,0 +1,333 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "attitudeEkf.h"
+#include "common.h"
+
+#include <cmath>
+
+// Standard deviations after reset, tilt unknown and taken from a still
+// accelerometer in rad, gyroscope bias left by calibration in rad/s
+static const float initialTilt = 0.5f;
+static const float alignedTilt = 0.05f;
+static const float initialBias = 0.01f;
+
+AttitudeEkf::AttitudeEkf(float gyroNoise, float biasDrift, float accNoise, float headingNoise, UpdateForm form) :
+_gyroVariance(gyroNoise * gyroNoise),
+_biasVariance(biasDrift * biasDrift),
+_accVariance(accNoise * accNoise),
+_headingVariance(headingNoise * headingNoise),
+_form(form)
+{
+	reset();
+}
+
+void AttitudeEkf::reset()
+{
+	_q[0] = 1;
+	_q[1] = _q[2] = _q[3] = 0;
+	_bias = math3d::ZeroVector;
+	resetCovariance(initialTilt * initialTilt);
+}
+
+void AttitudeEkf::reset(const math3d::Vector3<float>& accReading)
+{
+	math3d::Vector3<float> up(accReading[1], -accReading[0], accReading[2]);
+	float magnitude = up.magnitude();
+	if(magnitude <= 0){
+		reset();
+		return;
+	}
+	up /= magnitude;
+
+	// Shortest turn of world up onto the measured one, then yaw taken back
+	// to zero around world up
+	float w = 1 + up[2], x = up[1], y = -up[0];
+	// Upside down the turn is half a round around X
+	if(w < 1e-6f){
+		w = 0;
+		x = 1;
+		y = 0;
+	}
+	float yaw = std::atan2(-2 * x * y, w * w - x * x + y * y);
+	float c = std::cos(yaw / 2), s = -std::sin(yaw / 2);
+	_q[0] = c * w;
+	_q[1] = c * x - s * y;
+	_q[2] = c * y + s * x;
+	_q[3] = s * w;
+	normalize();
+	_bias = math3d::ZeroVector;
+	resetCovariance(alignedTilt * alignedTilt);
+}
+
+void AttitudeEkf::resetCovariance(float tiltVariance)
+{
+	// Quaternion x and y are sines of half the tilt, yaw starts known
+	_covariance.zero();
+	_covariance(1, 1) = _covariance(2, 2) = tiltVariance / 4;
+	for(uint8_t i = 4; i < StateN; i++)
+		_covariance(i, i) = initialBias * initialBias;
+}
+
+void AttitudeEkf::predict(const math3d::Vector3<float>& rate, float deltaT)
+{
+	math3d::Vector3<float> omega = rate - _bias;
+	float half = deltaT / 2;
+	float w = _q[0], x = _q[1], y = _q[2], z = _q[3];
+
+	// Quaternion part of the transition, q + q * (0, omega) * deltaT / 2
+	Matrix<float, 4, 4> a = Matrix<float, 4, 4>::identity();
+	a(0, 1) = -omega[0] * half; a(0, 2) = -omega[1] * half; a(0, 3) = -omega[2] * half;
+	a(1, 0) =  omega[0] * half; a(1, 2) =  omega[2] * half; a(1, 3) = -omega[1] * half;
+	a(2, 0) =  omega[1] * half; a(2, 1) = -omega[2] * half; a(2, 3) =  omega[0] * half;
+	a(3, 0) =  omega[2] * half; a(3, 1) =  omega[1] * half; a(3, 2) = -omega[0] * half;
+
+	// Its derivative by bias
+	Matrix<float, 4, 3> b;
+	b(0, 0) =  x * half; b(0, 1) =  y * half; b(0, 2) =  z * half;
+	b(1, 0) = -w * half; b(1, 1) =  z * half; b(1, 2) = -y * half;
+	b(2, 0) = -z * half; b(2, 1) = -w * half; b(2, 2) =  x * half;
+	b(3, 0) =  y * half; b(3, 1) = -x * half; b(3, 2) = -w * half;
+
+	// F P F^T with F = [a b; 0 I], blocks of zeros and identity are skipped
+	Matrix<float, 4, 4> pqq = _covariance.block<4, 4>(0, 0);
+	Matrix<float, 4, 3> pqb = _covariance.block<4, 3>(0, 4);
+	Matrix<float, 3, 3> pbb = _covariance.block<3, 3>(4, 4);
+	Matrix<float, 4, 4> m1 = a * pqq + b * pqb.transpose();
+	Matrix<float, 4, 3> m2 = a * pqb + b * pbb;
+
+	// Gyroscope noise enters through the same derivative, b b^T is
+	// (I - q q^T) scaled
+	float gyroNoise = _gyroVariance * half * half;
+	for(uint8_t i = 0; i < 4; i++)
+		for(uint8_t j = i; j < 4; j++){
+			float sum = (i == j ? gyroNoise : 0) - gyroNoise * _q[i] * _q[j];
+			for(uint8_t k = 0; k < 4; k++)
+				sum += m1(i, k) * a(j, k);
+			for(uint8_t k = 0; k < 3; k++)
+				sum += m2(i, k) * b(j, k);
+			_covariance(i, j) = sum;
+		}
+	_covariance.block(0, 4, m2);
+
+	float biasNoise = _biasVariance * deltaT;
+	for(uint8_t i = 4; i < StateN; i++)
+		_covariance(i, i) += biasNoise;
+	_covariance.mirrorUpper();
+
+	for(uint8_t i = 0; i < 4; i++){
+		float sum = 0;
+		for(uint8_t k = 0; k < 4; k++)
+			sum += a(i, k) * _q[k];
+		_q[i] = sum;
+	}
+	normalize();
+
+	// Transition stretches the covariance along the quaternion too, which
+	// no measurement shrinks. Normalization drops that direction, its
+	// Jacobian (I - q q^T) is applied as P - q v^T - v q^T + (q^T v) q q^T
+	// with v = P q, and the bias columns lose their component along q.
+	float v[4], u[3];
+	for(uint8_t i = 0; i < 4; i++)
+		v[i] = _covariance(i, 0) * _q[0] + _covariance(i, 1) * _q[1] + _covariance(i, 2) * _q[2] + _covariance(i, 3) * _q[3];
+	for(uint8_t j = 0; j < 3; j++)
+		u[j] = _covariance(0, 4 + j) * _q[0] + _covariance(1, 4 + j) * _q[1] + _covariance(2, 4 + j) * _q[2] +
+			   _covariance(3, 4 + j) * _q[3];
+	float s = v[0] * _q[0] + v[1] * _q[1] + v[2] * _q[2] + v[3] * _q[3];
+	for(uint8_t i = 0; i < 4; i++){
+		for(uint8_t j = i; j < 4; j++)
+			_covariance(j, i) = _covariance(i, j) += _q[i] * (s * _q[j] - v[j]) - v[i] * _q[j];
+		for(uint8_t j = 0; j < 3; j++)
+			_covariance(4 + j, i) = _covariance(i, 4 + j) -= _q[i] * u[j];
+	}
+}
+
+bool AttitudeEkf::correct(const math3d::Vector3<float>& accReading, float weight)
+{
+	// LSM303DLHC is turned by 90 degrees around Z against L3GD20
+	math3d::Vector3<float> up(accReading[1], -accReading[0], accReading[2]);
+	float magnitude = up.magnitude();
+	if(weight <= 0 || magnitude <= 0)
+		return false;
+	up /= magnitude;
+	float variance = _accVariance / weight;
+	// Reading that is not fully trusted comes from an accelerating craft,
+	// its error would be blamed on the gyroscope bias. Bias is kept then
+	// and only its correlation with the attitude is updated.
+	bool learnBias = weight >= 1;
+	uint8_t updated = learnBias ? StateN : 4;
+
+	// Gravity direction expected in gyroscope axes and its gradients
+	float w = _q[0], x = _q[1], y = _q[2], z = _q[3];
+	float expected[3] = {2 * (x * z - w * y), 2 * (y * z + w * x), w * w - x * x - y * y + z * z};
+	float h[3][4] = {{-2 * y,  2 * z, -2 * w, 2 * x},
+					 { 2 * x,  2 * w,  2 * z, 2 * y},
+					 { 2 * w, -2 * x, -2 * y, 2 * z}};
+
+	if(_form == Sequential){
+		// Innovation of each scalar accounts for the quaternion moved by
+		// the previous ones, same as the joint update
+		float prior[4] = {w, x, y, z};
+		for(uint8_t i = 0; i < 3; i++){
+			float innovation = up[i] - expected[i];
+			for(uint8_t j = 0; j < 4; j++)
+				innovation -= h[i][j] * (_q[j] - prior[j]);
+			if(!scalarUpdate(h[i], innovation, variance, learnBias))
+				return false;
+		}
+		normalize();
+		return true;
+	}
+
+	// P H^T and H P H^T + R
+	Matrix<float, StateN, 3> ph;
+	for(uint8_t i = 0; i < StateN; i++)
+		for(uint8_t j = 0; j < 3; j++){
+			float sum = 0;
+			for(uint8_t k = 0; k < 4; k++)
+				sum += _covariance(i, k) * h[j][k];
+			ph(i, j) = sum;
+		}
+	Matrix<float, 3, 3> s, sInverse;
+	for(uint8_t i = 0; i < 3; i++)
+		for(uint8_t j = 0; j < 3; j++){
+			float sum = i == j ? variance : 0;
+			for(uint8_t k = 0; k < 4; k++)
+				sum += h[i][k] * ph(k, j);
+			s(i, j) = sum;
+		}
+	if(!invert(s, sInverse))
+		return false;
+
+	Matrix<float, StateN, 3> gain = ph * sInverse;
+	for(uint8_t i = 0; i < updated; i++){
+		float step = 0;
+		for(uint8_t j = 0; j < 3; j++)
+			step += gain(i, j) * (up[j] - expected[j]);
+		if(i < 4)
+			_q[i] += step;
+		else
+			_bias[i - 4] += step;
+	}
+
+	for(uint8_t i = 0; i < updated; i++)
+		for(uint8_t j = i; j < StateN; j++){
+			float sum = 0;
+			for(uint8_t k = 0; k < 3; k++)
+				sum += gain(i, k) * ph(j, k);
+			_covariance(i, j) -= sum;
+		}
+	_covariance.mirrorUpper();
+	normalize();
+	return true;
+}
+
+bool AttitudeEkf::correctHeading(float heading, float weight)
+{
+	if(weight <= 0)
+		return false;
+
+	// Yaw is atan2(u, v) of the forward axis turned into the world
+	float w = _q[0], x = _q[1], y = _q[2], z = _q[3];
+	float u = 2 * (w * z - x * y);
+	float v = w * w - x * x + y * y - z * z;
+	float squares = u * u + v * v;
+	// Forward axis points up or down, heading says nothing about yaw
+	if(squares < 1e-2f)
+		return false;
+
+	float du[4] = {2 * z, -2 * y, -2 * x, 2 * w};
+	float dv[4] = {2 * w, -2 * x, 2 * y, -2 * z};
+	float h[4];
+	for(uint8_t i = 0; i < 4; i++)
+		h[i] = (v * du[i] - u * dv[i]) / squares;
+
+	float innovation = interpolateAngle(std::atan2(u, v), heading);
+	if(!scalarUpdate(h, innovation, _headingVariance / weight, true))
+		return false;
+	normalize();
+	return true;
+}
+
+math3d::Vector3<float> AttitudeEkf::angles() const
+{
+	float w = _q[0], x = _q[1], y = _q[2], z = _q[3];
+	math3d::Vector3<float> up(2 * (x * z - w * y), 2 * (y * z + w * x), w * w - x * x - y * y + z * z);
+	float yaw = std::atan2(2 * (w * z - x * y), w * w - x * x + y * y - z * z);
+	return math3d::Vector3<float>(std::atan2(up[1], std::sqrt(up[0] * up[0] + up[2] * up[2])),
+								  std::atan2(-up[0], std::sqrt(up[1] * up[1] + up[2] * up[2])),
+								  yaw >= 0 ? yaw : yaw + 2 * math3d::Pi);
+}
+
+const float* AttitudeEkf::quaternion() const
+{
+	return _q;
+}
+
+const math3d::Vector3<float>& AttitudeEkf::bias() const
+{
+	return _bias;
+}
+
+const Matrix<float, AttitudeEkf::StateN, AttitudeEkf::StateN>& AttitudeEkf::covariance() const
+{
+	return _covariance;
+}
+
+bool AttitudeEkf::scalarUpdate(const float h[4], float innovation, float variance, bool learnBias)
+{
+	// P H^T, the measurement does not depend on bias
+	float ph[StateN];
+	for(uint8_t i = 0; i < StateN; i++)
+		ph[i] = _covariance(i, 0) * h[0] + _covariance(i, 1) * h[1] + _covariance(i, 2) * h[2] + _covariance(i, 3) * h[3];
+
+	float s = h[0] * ph[0] + h[1] * ph[1] + h[2] * ph[2] + h[3] * ph[3] + variance;
+	if(s <= 0)
+		return false;
+	float sInverse = 1 / s;
+
+	float step = innovation * sInverse;
+	for(uint8_t i = 0; i < 4; i++)
+		_q[i] += ph[i] * step;
+	uint8_t updated = learnBias ? StateN : 4;
+	for(uint8_t i = 4; i < updated; i++)
+		_bias[i - 4] += ph[i] * step;
+
+	// P - K S K^T with K = P H^T / S, written to both triangles. Kept bias
+	// has zero gain, its own block stays.
+	for(uint8_t i = 0; i < updated; i++){
+		float k = ph[i] * sInverse;
+		for(uint8_t j = i; j < StateN; j++)
+			_covariance(j, i) = _covariance(i, j) -= k * ph[j];
+	}
+	return true;
+}
+
+void AttitudeEkf::normalize()
+{
+	float norm = std::sqrt(_q[0] * _q[0] + _q[1] * _q[1] + _q[2] * _q[2] + _q[3] * _q[3]);
+	for(uint8_t i = 0; i < 4; i++)
+		_q[i] /= norm;
+}
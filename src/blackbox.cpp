@@ -0,0 +1,312 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "blackbox.h"
+
+#include <cstring>
+
+static const char* fieldNames[BlackboxEncoder::FieldN] = {
+	"time",
+	"gyroX", "gyroY", "gyroZ",
+	"accX", "accY", "accZ",
+	"pitch", "roll", "yaw",
+	"spPitch", "spRoll", "spYaw",
+	"pPitch", "pRoll", "pYaw",
+	"iPitch", "iRoll", "iYaw",
+	"dPitch", "dRoll", "dYaw",
+	"throttle", "rear", "right", "left", "servo"
+};
+
+// Time in microseconds, gyro in 0.1 mrad/s, acc in mg, everything else in 1e-4
+static const float timeScale = 1e-6f;
+static const float gyroScale = 1e4f;
+static const float accScale = 1e3f;
+static const float valueScale = 1e4f;
+
+static uint32_t zigZag(int32_t value)
+{
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unZigZag(uint32_t value)
+{
+	return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static uint8_t putVarint(uint32_t value, uint8_t* out)
+{
+	uint8_t size = 0;
+	while(value >= 0x80){
+		out[size++] = (uint8_t)value | 0x80;
+		value >>= 7;
+	}
+	out[size++] = (uint8_t)value;
+	return size;
+}
+
+// Returns bytes used, 0 when data ended, -1 on overlong value
+static int8_t getVarint(const uint8_t* data, uint32_t size, uint32_t& value)
+{
+	value = 0;
+	for(uint8_t i = 0; i < 5; i++){
+		if(i >= size)
+			return 0;
+		value |= (uint32_t)(data[i] & 0x7F) << (7 * i);
+		if((data[i] & 0x80) == 0)
+			return i + 1;
+	}
+	return -1;
+}
+
+static int32_t quantizeValue(float value, float scale)
+{
+	float scaled = value * scale;
+	if(!(scaled > -2e9f))
+		return -2000000000;
+	if(scaled > 2e9f)
+		return 2000000000;
+	return (int32_t)(scaled + (scaled >= 0 ? 0.5f : -0.5f));
+}
+
+BlackboxEncoder::BlackboxEncoder(uint8_t keyframeInterval) :
+_keyframeInterval(keyframeInterval),
+_sinceKeyframe(keyframeInterval),
+_lastKeyframe(false),
+_previous{}
+{
+}
+
+uint8_t BlackboxEncoder::encode(const int32_t* fields, uint8_t* out)
+{
+	uint8_t size = 0;
+	_lastKeyframe = _sinceKeyframe >= _keyframeInterval;
+
+	if(_lastKeyframe){
+		out[size++] = KeyframeMarker;
+		out[size++] = KeyframeTag;
+		for(uint8_t i = 0; i < FieldN; i++)
+			size += putVarint(zigZag(fields[i]), out + size);
+		_sinceKeyframe = 0;
+	}
+	else{
+		out[size++] = DeltaTag;
+		for(uint8_t i = 0; i < FieldN; i++)
+			size += putVarint(zigZag((int32_t)((uint32_t)fields[i] - (uint32_t)_previous[i])), out + size);
+	}
+
+	_sinceKeyframe++;
+	std::memcpy(_previous, fields, sizeof(_previous));
+	return size;
+}
+
+void BlackboxEncoder::reset()
+{
+	_sinceKeyframe = _keyframeInterval;
+}
+
+bool BlackboxEncoder::lastKeyframe() const
+{
+	return _lastKeyframe;
+}
+
+void BlackboxEncoder::quantize(const BlackboxFrame& frame, int32_t* fields)
+{
+	uint8_t field = 0;
+	// Wraps after 71 minutes, deltas stay small across it
+	fields[field++] = (int32_t)frame.time;
+
+	const math3d::Vector3<float>* vectors[] = {&frame.gyro, &frame.acc, &frame.attitude, &frame.setpoint,
+											   &frame.proportional, &frame.integral, &frame.derivative};
+	for(uint8_t v = 0; v < 7; v++){
+		float scale = v == 0 ? gyroScale : v == 1 ? accScale : valueScale;
+		for(uint8_t i = 0; i < 3; i++)
+			fields[field++] = quantizeValue((*vectors[v])[i], scale);
+	}
+
+	fields[field++] = quantizeValue(frame.throttle, valueScale);
+	for(uint8_t i = 0; i < 3; i++)
+		fields[field++] = quantizeValue(frame.motors[i], valueScale);
+	fields[field++] = quantizeValue(frame.servo, valueScale);
+}
+
+const char* BlackboxEncoder::fieldName(uint8_t field)
+{
+	return field < FieldN ? fieldNames[field] : "";
+}
+
+float BlackboxEncoder::fieldScale(uint8_t field)
+{
+	if(field == 0)
+		return timeScale;
+	if(field <= 3)
+		return 1 / gyroScale;
+	if(field <= 6)
+		return 1 / accScale;
+	return 1 / valueScale;
+}
+
+BlackboxDecoder::BlackboxDecoder() :
+_fields{},
+_synced(false),
+_errors(0)
+{
+}
+
+BlackboxDecoder::Result BlackboxDecoder::decode(const uint8_t* data, uint32_t size, uint32_t& consumed)
+{
+	consumed = 0;
+	if(size == 0)
+		return NeedMore;
+
+	bool keyframe = data[0] == BlackboxEncoder::KeyframeMarker;
+	if(keyframe){
+		if(size < 2)
+			return NeedMore;
+		keyframe = data[1] == BlackboxEncoder::KeyframeTag;
+	}
+
+	if(!keyframe && (!_synced || data[0] != BlackboxEncoder::DeltaTag)){
+		// Lost, skip to next keyframe marker
+		if(_synced)
+			_errors++;
+		_synced = false;
+		consumed = 1;
+		while(consumed < size && data[consumed] != BlackboxEncoder::KeyframeMarker)
+			consumed++;
+		return Skipped;
+	}
+
+	uint32_t position = keyframe ? 2 : 1;
+	int32_t fields[BlackboxEncoder::FieldN];
+	for(uint8_t i = 0; i < BlackboxEncoder::FieldN; i++){
+		uint32_t value;
+		int8_t used = getVarint(data + position, size - position, value);
+		if(used == 0)
+			return NeedMore;
+		if(used < 0){
+			_errors++;
+			_synced = false;
+			consumed = 1;
+			return Skipped;
+		}
+
+		fields[i] = keyframe ? unZigZag(value) : (int32_t)((uint32_t)_fields[i] + (uint32_t)unZigZag(value));
+		position += used;
+	}
+
+	std::memcpy(_fields, fields, sizeof(_fields));
+	_synced = true;
+	consumed = position;
+	return Decoded;
+}
+
+const int32_t* BlackboxDecoder::fields() const
+{
+	return _fields;
+}
+
+uint32_t BlackboxDecoder::errors() const
+{
+	return _errors;
+}
+
+Blackbox::Blackbox() :
+_encoder(KeyframeInterval),
+_buffer{},
+_written(0),
+_read(0),
+_keyframes{},
+_keyframeIndex(0),
+_records(0),
+_lost(0)
+{
+}
+
+void Blackbox::record(const BlackboxFrame& frame)
+{
+	int32_t fields[BlackboxEncoder::FieldN];
+	uint8_t encoded[BlackboxEncoder::MaxRecordSize];
+
+	BlackboxEncoder::quantize(frame, fields);
+	uint8_t size = _encoder.encode(fields, encoded);
+
+	if(_encoder.lastKeyframe()){
+		_keyframes[_keyframeIndex] = _written;
+		_keyframeIndex = (_keyframeIndex + 1) % KeyframeSlots;
+	}
+
+	for(uint8_t i = 0; i < size; i++)
+		_buffer[(_written + i) % BufferSize] = encoded[i];
+	_written += size;
+	_records++;
+}
+
+uint16_t Blackbox::read(uint8_t* out, uint16_t size)
+{
+	uint32_t oldest = _written > BufferSize ? _written - BufferSize : 0;
+	if(_read < oldest){
+		uint32_t resume = oldestKeyframe(oldest);
+		_lost += resume - _read;
+		_read = resume;
+	}
+
+	uint32_t available = _written - _read;
+	uint16_t count = available < size ? available : size;
+	for(uint16_t i = 0; i < count; i++)
+		out[i] = _buffer[(_read + i) % BufferSize];
+	_read += count;
+
+	return count;
+}
+
+void Blackbox::rewind()
+{
+	uint32_t oldest = _written > BufferSize ? _written - BufferSize : 0;
+	_read = oldestKeyframe(oldest);
+}
+
+uint32_t Blackbox::records() const
+{
+	return _records;
+}
+
+uint32_t Blackbox::lost() const
+{
+	return _lost;
+}
+
+uint32_t Blackbox::oldestKeyframe(uint32_t from)
+{
+	uint32_t oldest = _written;
+	for(uint8_t i = 0; i < KeyframeSlots; i++)
+		if(_keyframes[i] >= from && _keyframes[i] < oldest)
+			oldest = _keyframes[i];
+
+	// No complete keyframe left, make the next record one
+	if(oldest == _written)
+		_encoder.reset();
+
+	return oldest;
+}
@@ -0,0 +1,156 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "bringUp.h"
+#include "systime.h"
+
+// ESCs arm after seeing minimum throttle for this long
+static const uint64_t escArmingTime = 2 * SYSTEM_TIME_RESOLUTION;
+// Gyroscope output drifts right after power up
+static const uint64_t gyroWarmUpTime = SYSTEM_TIME_RESOLUTION / 2;
+// Four still windows of 0.25 s at 100 Hz loop, deviation in rad/s
+static const uint16_t calibrationWindow = 25;
+static const uint8_t calibrationWindowN = 4;
+static const float gyroStillLimit = 0.02f;
+// Moved craft keeps stored bias after this long
+static const uint64_t calibrationTimeout = 10 * SYSTEM_TIME_RESOLUTION;
+// Smaller bias change is not worth a flash erase, rad/s
+static const float gyroSaveLimit = 0.002f;
+
+static const char* deviceNames[BringUp::DeviceN] = {"gyro", "accel", "escs", "gyroCal"};
+
+BringUp::BringUp(Gyroscope& gyro, Accelerometer& acc, Model& model, ConfigStore& store) :
+_gyro(gyro),
+_acc(acc),
+_model(model),
+_store(store),
+_start(getSystemTime()),
+_gyroCalibration(calibrationWindow, calibrationWindowN, gyroStillLimit)
+{
+	for(uint8_t i = 0; i < DeviceN; i++)
+		_readyTimes[i] = 0;
+
+	SensorCorrection correction;
+	_loaded = Calibration::load(_store, ConfigStore::GyroCorrection, correction);
+	if(_loaded)
+		_gyro.correction(correction);
+	if(Calibration::load(_store, ConfigStore::AccCorrection, correction))
+		_acc.correction(correction);
+}
+
+bool BringUp::poll()
+{
+	uint64_t now = getSystemTime();
+
+	// Sensors settle after the configuration written by their constructors
+	if(!ready(Gyro) && _gyro.ready())
+		markReady(Gyro, _gyro.readyTime());
+	if(!ready(Accel) && _acc.ready())
+		markReady(Accel, _acc.readyTime());
+
+	// Minimum throttle is refreshed every period, protocols other than
+	// standard pwm need a frame each loop
+	_model.update(0, math3d::Vector3<float>(0, 0, 0));
+	if(!ready(Escs) && now - _start >= escArmingTime)
+		markReady(Escs, now);
+
+	// Craft stands still on the ground while ESCs arm
+	if(ready(Gyro) && !ready(GyroCalibration) && now - readyTime(Gyro) >= gyroWarmUpTime){
+		if(_gyroCalibration.add(_gyro.readValue())){
+			// Samples were already corrected, their mean is what remains
+			const math3d::Vector3<float>& residual = _gyroCalibration.stats().mean();
+			SensorCorrection correction = _gyro.correction();
+			_gyroCalibration.updateGyroscope(correction);
+			_gyro.correction(correction);
+
+			bool changed = !_loaded;
+			for(uint8_t i = 0; i < 3; i++)
+				changed |= std::fabs(residual[i]) > gyroSaveLimit;
+			if(changed)
+				Calibration::save(_store, ConfigStore::GyroCorrection, correction);
+
+			markReady(GyroCalibration, now);
+		}
+		else if(now - readyTime(Gyro) >= gyroWarmUpTime + calibrationTimeout)
+			markReady(GyroCalibration, now);
+	}
+
+	return armed();
+}
+
+bool BringUp::ready(Device device) const
+{
+	return _readyTimes[device] != 0;
+}
+
+bool BringUp::armed() const
+{
+	for(uint8_t i = 0; i < DeviceN; i++)
+		if(!ready((Device)i))
+			return false;
+	return true;
+}
+
+uint64_t BringUp::readyTime(Device device) const
+{
+	return _readyTimes[device];
+}
+
+uint64_t BringUp::armedTime() const
+{
+	if(!armed())
+		return 0;
+
+	uint64_t last = 0;
+	for(uint8_t i = 0; i < DeviceN; i++)
+		last = _readyTimes[i] > last ? _readyTimes[i] : last;
+	return last;
+}
+
+bool BringUp::loaded() const
+{
+	return _loaded;
+}
+
+bool BringUp::calibrated() const
+{
+	return _gyroCalibration.done();
+}
+
+const Calibration& BringUp::gyroCalibration() const
+{
+	return _gyroCalibration;
+}
+
+const char* BringUp::name(Device device)
+{
+	return deviceNames[device];
+}
+
+void BringUp::markReady(Device device, uint64_t time)
+{
+	// Zero means pending, device ready right at boot is reported 1 us late
+	_readyTimes[device] = time > 0 ? time : 1;
+}
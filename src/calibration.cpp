@@ -0,0 +1,205 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "calibration.h"
+#include "configStore.h"
+
+using namespace math3d;
+
+RunningStats::RunningStats()
+{
+	reset();
+}
+
+void RunningStats::reset()
+{
+	_count = 0;
+	_mean.zero();
+	_m2.zero();
+}
+
+void RunningStats::add(const Vector3<float>& sample)
+{
+	_count++;
+	Vector3<float> delta = sample - _mean;
+	_mean += delta / (float)_count;
+	_m2 += delta * (sample - _mean);
+}
+
+void RunningStats::merge(const RunningStats& other)
+{
+	if(other._count == 0)
+		return;
+	if(_count == 0){
+		*this = other;
+		return;
+	}
+
+	uint32_t count = _count + other._count;
+	Vector3<float> delta = other._mean - _mean;
+	float weight = (float)other._count / count;
+
+	_mean += delta * weight;
+	_m2 += other._m2 + delta * delta * (_count * weight);
+	_count = count;
+}
+
+uint32_t RunningStats::count() const
+{
+	return _count;
+}
+
+const Vector3<float>& RunningStats::mean() const
+{
+	return _mean;
+}
+
+Vector3<float> RunningStats::variance() const
+{
+	if(_count == 0)
+		return Vector3<float>(0, 0, 0);
+	return _m2 / (float)_count;
+}
+
+Calibration::Calibration(uint16_t windowLength, uint8_t windowsNeeded, float stillLimit) :
+	_windowLength(windowLength), _windowsNeeded(windowsNeeded),
+	_stillVariance(stillLimit * stillLimit), _stillLimit(stillLimit)
+{
+	reset();
+}
+
+void Calibration::reset()
+{
+	_window.reset();
+	_accepted.reset();
+	_acceptedWindows = 0;
+	_rejectedWindows = 0;
+}
+
+bool Calibration::add(const Vector3<float>& sample)
+{
+	if(done())
+		return true;
+
+	_window.add(sample);
+	if(_window.count() < _windowLength)
+		return false;
+
+	Vector3<float> variance = _window.variance();
+	bool still = true;
+	for(uint8_t i = 0; i < 3; i++)
+		still &= variance[i] <= _stillVariance;
+
+	if(!still){
+		_rejectedWindows++;
+	}
+	else if(_acceptedWindows > 0){
+		// Still again, but somewhere else - collect the new position
+		Vector3<float> drift = _window.mean() - _accepted.mean();
+		bool moved = false;
+		for(uint8_t i = 0; i < 3; i++)
+			moved |= std::fabs(drift[i]) > _stillLimit;
+
+		if(moved){
+			_rejectedWindows++;
+			_accepted.reset();
+			_acceptedWindows = 0;
+		}
+	}
+
+	if(still){
+		_accepted.merge(_window);
+		_acceptedWindows++;
+	}
+	_window.reset();
+
+	return done();
+}
+
+bool Calibration::done() const
+{
+	return _acceptedWindows >= _windowsNeeded;
+}
+
+uint32_t Calibration::rejectedWindows() const
+{
+	return _rejectedWindows;
+}
+
+const RunningStats& Calibration::stats() const
+{
+	return _accepted;
+}
+
+void Calibration::updateGyroscope(SensorCorrection& correction) const
+{
+	correction.bias += _accepted.mean();
+}
+
+void Calibration::updateAccelerometer(SensorCorrection& correction) const
+{
+	const Vector3<float>& mean = _accepted.mean();
+	if(mean[2] == 0)
+		return;
+
+	// Horizontal axes read their offset, only the vertical gain is seen
+	// from one position: its output (raw * scale - bias) * k reads 1 g
+	float k = 1 / std::fabs(mean[2]);
+	correction.bias[0] += mean[0];
+	correction.bias[1] += mean[1];
+	correction.scale[2] *= k;
+	correction.bias[2] *= k;
+}
+
+namespace
+{
+	// Stored form of a correction
+	struct CorrectionRecord
+	{
+		float bias[3];
+		float scale[3];
+	};
+}
+
+bool Calibration::load(const ConfigStore& store, uint8_t key, SensorCorrection& correction)
+{
+	CorrectionRecord record;
+	if(!store.read(key, record))
+		return false;
+
+	correction.bias = Vector3<float>(record.bias[0], record.bias[1], record.bias[2]);
+	correction.scale = Vector3<float>(record.scale[0], record.scale[1], record.scale[2]);
+	return true;
+}
+
+bool Calibration::save(ConfigStore& store, uint8_t key, const SensorCorrection& correction)
+{
+	CorrectionRecord record;
+	for(uint8_t i = 0; i < 3; i++){
+		record.bias[i] = correction.bias[i];
+		record.scale[i] = correction.scale[i];
+	}
+	return store.write(key, record);
+}
@@ -24,3 +24,23 @@
 */
 
 #include "common.h"
+#include "math3d.h"
+#include "ccm.h"
+
+#include <cmath>
+
+CCM_CODE float interpolateAngle(float start, float end)
+{
+	float dif = end - start;
+	return dif >= 0 ? dif <= math3d::Pi ? dif : dif - 2 * math3d::Pi
+			        : dif >= -math3d::Pi ? dif : 2 * math3d::Pi + dif;
+}
+
+float normalizeAngle(float angle)
+{
+	// Remove extra rounds
+	angle = fmod(angle, 2 * math3d::Pi);
+
+	// Return positive angle
+	return angle >= 0 ? angle : 2 * math3d::Pi + angle;
+}
@@ -27,6 +27,8 @@
 
 #include "stm32f30x.h"
 
+#include <cstring>
+
 #define START_BYTE 	0xAA
 #define STRING_COM	0x80
 #define UINT32_COM 	0x81
@@ -46,54 +48,41 @@ _atStart(false)
 	_uart.connect(GPIOA, 9, 7, GPIOA, 10, 7);
 }
 
-void Communicator::send(std::string s)
+void Communicator::send(Span<const char> s)
+{
+	uint8_t header[3] = {START_BYTE, STRING_COM, (uint8_t)(s.size() < 255 ? s.size() : 255)};
+	_uart.write(header);
+	_uart.write(Span<const uint8_t>((const uint8_t*)s.data(), header[2]));
+}
+
+void Communicator::send(const char* s)
 {
-	std::vector<uint8_t> vec;
-	vec.reserve(s.size()+3);
-	vec.push_back(START_BYTE);
-	vec.push_back(STRING_COM);
-	vec.push_back((uint8_t)s.size());
-	for(auto it = s.begin(); it != s.end(); it++)
-		vec.push_back((uint8_t)*it);
-	_uart.write(vec);
+	send(Span<const char>(s, std::strlen(s)));
 }
 
 // TODO: CheckSum
 void Communicator::send(uint32_t ui)
 {
 	uint8_t *c = (uint8_t*)(&ui);
-	std::vector<uint8_t> vec;
-	vec.reserve(4+2);
-	vec.push_back(START_BYTE);
-	vec.push_back(UINT32_COM);
-	vec.push_back(c[0]);
-	vec.push_back(c[1]);
-	vec.push_back(c[2]);
-	vec.push_back(c[3]);
-	_uart.write(vec);
+	uint8_t packet[4+2] = {START_BYTE, UINT32_COM, c[0], c[1], c[2], c[3]};
+	_uart.write(packet);
 }
 
 void Communicator::send(float f)
 {
 	uint8_t *c = (uint8_t*)(&f);
-	std::vector<uint8_t> vec;
-	vec.reserve(4+2);
-	vec.push_back(START_BYTE);
-	vec.push_back(FLOAT_COM);
-	vec.push_back(c[0]);
-	vec.push_back(c[1]);
-	vec.push_back(c[2]);
-	vec.push_back(c[3]);
-	_uart.write(vec);
+	uint8_t packet[4+2] = {START_BYTE, FLOAT_COM, c[0], c[1], c[2], c[3]};
+	_uart.write(packet);
 }
 
-void Communicator::sendRaw(std::string s)
+void Communicator::sendRaw(Span<const char> s)
 {
-	std::vector<uint8_t> vec;
-	vec.reserve(s.size());
-	for(auto it = s.begin(); it != s.end(); it++)
-		vec.push_back((uint8_t)*it);
-	_uart.write(vec);
+	_uart.write(Span<const uint8_t>((const uint8_t*)s.data(), s.size()));
+}
+
+void Communicator::sendRaw(const char* s)
+{
+	sendRaw(Span<const char>(s, std::strlen(s)));
 }
 
 void Communicator::discard()
@@ -114,7 +103,8 @@ bool Communicator::receive(CommandId& commandId)
 
 	_atStart = false;
 	// Get 2 bytes of uint16_t (command ID)
-	std::vector<uint8_t> vec = _uart.read(2);
+	uint8_t vec[2];
+	_uart.read(vec);
 
 	// Get checksum
 	// uint8_t checkSum = _uart.get();
@@ -129,19 +119,21 @@ bool Communicator::receive(CommandId& commandId)
 	return true;
 }
 
-bool Communicator::receive(std::string& s)
+bool Communicator::receive(Span<char> s, uint8_t& length)
 {
 	if(!discardUntilStart() || _commandByte != STRING_COM)
 		return false;
 
 	_atStart = false;
-	s.clear();
-	uint8_t length = _uart.get();
+	length = 0;
+	uint8_t size = _uart.get();
 	uint8_t ch;
-	for(int i = 0; i < length; i++){
+	for(int i = 0; i < size; i++){
 		ch = _uart.get();
-		if(ch < 0x80)
-			s += ch;
+		if(ch < 0x80){
+			if(length < s.size())
+				s[length++] = ch;
+		}
 		else if(ch == START_BYTE){
 			// Reinitialize communication state when some bytes were lost
 			_atStart = true;
@@ -162,7 +154,8 @@ bool Communicator::receive(uint32_t& ui)
 
 	_atStart = false;
 	// Get 4 bytes of uint32_t
-	std::vector<uint8_t> vec = _uart.read(4);
+	uint8_t vec[4];
+	_uart.read(vec);
 
 	// Get checksum
 	// uint8_t checkSum = _uart.get();
@@ -185,7 +178,8 @@ bool Communicator::receive(float& f)
 
 	_atStart = false;
 	// Get 4 bytes of float
-	std::vector<uint8_t> vec = _uart.read(4);
+	uint8_t vec[4];
+	_uart.read(vec);
 
 	// Get checksum
 	// uint8_t checkSum = _uart.get();
@@ -24,6 +24,7 @@
 */
 
 #include "complementaryFilter2.h"
+#include "ccm.h"
 
 ComplementaryFilter2::ComplementaryFilter2(float deltaT, float timeConstant) :
 _state(math3d::ZeroVector),
@@ -36,12 +37,28 @@ void ComplementaryFilter2::reset()
 	_state = math3d::ZeroVector;
 }
 
-math3d::Vector3<float> ComplementaryFilter2::addSample(math3d::Vector3<float> lowPassSample, math3d::Vector3<float> highPassSample)
+CCM_CODE math3d::Vector3<float> ComplementaryFilter2::addSample(math3d::Vector3<float> lowPassSample, math3d::Vector3<float> highPassSample)
 {
 	_state = (_state + highPassSample) * _factor + lowPassSample * (1 - _factor);
 	return _state;
 }
 
+CCM_CODE math3d::Vector3<float> ComplementaryFilter2::addSample(math3d::Vector3<float> lowPassSample, math3d::Vector3<float> highPassSample, float weight)
+{
+	float gain = (1 - _factor) * weight;
+	_state = (_state + highPassSample) * (1 - gain) + lowPassSample * gain;
+	return _state;
+}
+
+CCM_CODE math3d::Vector3<float> ComplementaryFilter2::addSample(math3d::Vector3<float> lowPassSample, math3d::Vector3<float> highPassSample, math3d::Vector3<float> weight)
+{
+	for(uint8_t i = 0; i < 3; i++){
+		float gain = (1 - _factor) * weight[i];
+		_state[i] = (_state[i] + highPassSample[i]) * (1 - gain) + lowPassSample[i] * gain;
+	}
+	return _state;
+}
+
 math3d::Vector3<float> ComplementaryFilter2::readState()
 {
 	return _state;
@@ -0,0 +1,238 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "configStore.h"
+
+#include <cstring>
+
+// Record: tag (key | value size << 8), value padded to halfwords, CRC of
+// tag and value. Erased tag ends the log.
+static const uint32_t storeMagic = 0x31474643; // "CFG1"
+static const uint16_t erasedTag = 0xFFFF;
+
+static uint16_t halfWord(const uint8_t* data)
+{
+	return data[0] | (uint16_t)data[1] << 8;
+}
+
+ConfigStore::ConfigStore(uint32_t firstPage, uint32_t secondPage) :
+_pages{FlashPage(firstPage), FlashPage(secondPage)},
+_active(-1),
+_sequence(0),
+_free(FlashPage::Size),
+_damaged(0)
+{
+	for(uint8_t i = 0; i < KeyN; i++)
+		_index[i] = NoRecord;
+}
+
+void ConfigStore::mount()
+{
+	_active = -1;
+	_sequence = 0;
+	_free = FlashPage::Size;
+	_damaged = 0;
+	for(uint8_t i = 0; i < KeyN; i++)
+		_index[i] = NoRecord;
+
+	// Header is written last, only finished pages have it
+	for(int8_t p = 0; p < 2; p++){
+		Header header;
+		std::memcpy(&header, _pages[p].data(), sizeof(header));
+		if(header.magic == storeMagic && header.sequence != 0xFFFFFFFF &&
+		   (_active < 0 || header.sequence > _sequence)){
+			_active = p;
+			_sequence = header.sequence;
+		}
+	}
+	if(_active < 0)
+		return;
+
+	// Torn tag only has bits left set, so its size is never smaller than
+	// the one written and skipping it lands on erased flash
+	const uint8_t* data = _pages[_active].data();
+	uint16_t offset = HeaderSize;
+	while(offset + recordSize(0) <= FlashPage::Size){
+		uint16_t tag = halfWord(data + offset);
+		if(tag == erasedTag)
+			break;
+
+		uint8_t key = tag & 0xFF;
+		uint16_t size = tag >> 8;
+		uint16_t length = recordSize(size);
+		if(size > MaxValueSize || offset + length > FlashPage::Size){
+			_damaged++;
+			offset = FlashPage::Size;
+			break;
+		}
+
+		if(key < KeyN && halfWord(data + offset + length - 2) == FlashPage::checksum(data + offset, 2 + size))
+			_index[key] = offset;
+		else
+			_damaged++;
+		offset += length;
+	}
+
+	// Value of a record torn before its tag lies past the end, page is
+	// compacted on next write instead of programming over it
+	_free = offset < FlashPage::Size && erased(offset, FlashPage::Size - offset) ? offset : FlashPage::Size;
+}
+
+bool ConfigStore::read(uint8_t key, void* value, uint16_t size) const
+{
+	if(_active < 0 || key >= KeyN || _index[key] == NoRecord)
+		return false;
+
+	const uint8_t* record = _pages[_active].data() + _index[key];
+	if((halfWord(record) >> 8) != size)
+		return false;
+
+	std::memcpy(value, record + 2, size);
+	return true;
+}
+
+bool ConfigStore::write(uint8_t key, const void* value, uint16_t size)
+{
+	if(key >= KeyN || size > MaxValueSize)
+		return false;
+
+	// Flash wears with erases, unchanged value costs nothing
+	if(_active >= 0 && _index[key] != NoRecord){
+		const uint8_t* record = _pages[_active].data() + _index[key];
+		if((halfWord(record) >> 8) == size && std::memcmp(record + 2, value, size) == 0)
+			return true;
+	}
+
+	if(_active >= 0 && _free + recordSize(size) <= FlashPage::Size && append(key, value, size))
+		return true;
+	return compact(key, value, size);
+}
+
+uint8_t ConfigStore::count() const
+{
+	uint8_t n = 0;
+	for(uint8_t i = 0; i < KeyN; i++)
+		n += _active >= 0 && _index[i] != NoRecord;
+	return n;
+}
+
+uint16_t ConfigStore::used() const
+{
+	return _active >= 0 ? _free : 0;
+}
+
+uint32_t ConfigStore::sequence() const
+{
+	return _sequence;
+}
+
+uint16_t ConfigStore::damaged() const
+{
+	return _damaged;
+}
+
+uint16_t ConfigStore::recordSize(uint16_t valueSize)
+{
+	return 2 + ((valueSize + 1) & ~1) + 2;
+}
+
+bool ConfigStore::append(uint8_t key, const void* value, uint16_t size)
+{
+	if(!programRecord(_pages[_active], _free, key, value, size)){
+		// Partly written record stays, next write compacts
+		_free = FlashPage::Size;
+		return false;
+	}
+
+	_index[key] = _free;
+	_free += recordSize(size);
+	return true;
+}
+
+bool ConfigStore::compact(uint8_t key, const void* value, uint16_t size)
+{
+	int8_t target = _active < 0 ? 0 : 1 - _active;
+	FlashPage& page = _pages[target];
+	if(!page.erase())
+		return false;
+
+	// Latest record of every other key is copied as is
+	uint16_t index[KeyN];
+	uint16_t offset = HeaderSize;
+	for(uint8_t i = 0; i < KeyN; i++){
+		index[i] = NoRecord;
+		if(i == key || _active < 0 || _index[i] == NoRecord)
+			continue;
+
+		const uint8_t* record = _pages[_active].data() + _index[i];
+		uint16_t length = recordSize(halfWord(record) >> 8);
+		if(offset + length > FlashPage::Size || !page.program(offset, record, length))
+			return false;
+		index[i] = offset;
+		offset += length;
+	}
+
+	if(offset + recordSize(size) > FlashPage::Size || !programRecord(page, offset, key, value, size))
+		return false;
+	index[key] = offset;
+	offset += recordSize(size);
+
+	// Page becomes the newest one with its header
+	Header header = {storeMagic, _sequence + 1};
+	if(!page.program(4, &header.sequence, 4) || !page.program(0, &header.magic, 4))
+		return false;
+
+	_active = target;
+	_sequence = header.sequence;
+	_free = offset;
+	std::memcpy(_index, index, sizeof(_index));
+	return true;
+}
+
+bool ConfigStore::programRecord(FlashPage& page, uint16_t offset, uint8_t key, const void* value, uint16_t size)
+{
+	uint8_t record[2 + MaxValueSize + 2];
+	uint16_t length = recordSize(size);
+
+	record[0] = key;
+	record[1] = size;
+	std::memcpy(record + 2, value, size);
+	record[2 + size] = 0xFF;
+	uint16_t crc = FlashPage::checksum(record, 2 + size);
+	record[length - 2] = crc & 0xFF;
+	record[length - 1] = crc >> 8;
+
+	// Tag goes last, record does not exist until it is there
+	return page.program(offset + 2, record + 2, length - 2) && page.program(offset, record, 2);
+}
+
+bool ConfigStore::erased(uint16_t offset, uint16_t size) const
+{
+	const uint8_t* data = _pages[_active].data() + offset;
+	for(uint16_t i = 0; i < size; i++)
+		if(data[i] != 0xFF)
+			return false;
+	return true;
+}
@@ -25,12 +25,15 @@
 */
 
 #include "controller.h"
+#include "ccm.h"
 
 Controller::Controller(float proportional, float integral, float derivative, float deltaT) :
 _setpoint(0),
 _manipulated(0),
 _integralTerm(0),
 _previousInput(0),
+_proportionalOutput(0),
+_derivativeOutput(0),
 _proportional(proportional),
 _integralRecip(deltaT / integral),
 _derivative(derivative / deltaT),
@@ -58,7 +61,7 @@ void Controller::limitOutput(bool limit, float minLimit, float maxLimit)
 	_maxLimit = maxLimit;
 }
 
-float Controller::process(float input, float(*interpolate)(float, float))
+CCM_CODE float Controller::process(float input, float(*interpolate)(float, float))
 {
 	float sum, error, inputDif;
 
@@ -79,6 +82,8 @@ float Controller::process(float input, float(*interpolate)(float, float))
 	_previousInput = input;
 
 	_manipulated = sum * _proportional;
+	_proportionalOutput = error * _proportional;
+	_derivativeOutput = inputDif * _derivative * _proportional;
 
 	// Windup prevention on both integral term and output
 	if(_outputLimited){
@@ -94,3 +99,19 @@ float Controller::process(float input, float(*interpolate)(float, float))
 
 	return _manipulated;
 }
+
+float Controller::proportionalTerm()
+{
+	return _proportionalOutput;
+}
+
+float Controller::integralTerm()
+{
+	// Whatever remains after windup prevention
+	return _manipulated - _proportionalOutput - _derivativeOutput;
+}
+
+float Controller::derivativeTerm()
+{
+	return _derivativeOutput;
+}
@@ -0,0 +1,126 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "dshot.h"
+
+#include <stm32f30x_tim.h>
+#include <stm32f30x_dma.h>
+
+// TIM1 update event is served by DMA1 channel 5
+static Dshot tim1Output(TIM1, DMA1_Channel5);
+
+Dshot* Dshot::output(TIM_TypeDef* timer)
+{
+	return timer == TIM1 ? &tim1Output : nullptr;
+}
+
+uint16_t Dshot::frame(uint16_t value, bool telemetry)
+{
+	uint16_t packet = ((value & 0x7FF) << 1) | (telemetry ? 1 : 0);
+	uint16_t checksum = (packet ^ (packet >> 4) ^ (packet >> 8)) & 0xF;
+	return (packet << 4) | checksum;
+}
+
+uint16_t Dshot::throttleValue(float throttle)
+{
+	if(throttle <= 0.0f)
+		return 0;
+	if(throttle >= 1.0f)
+		return MaxThrottle;
+	return MinThrottle + (uint16_t)(throttle * (MaxThrottle - MinThrottle) + 0.5f);
+}
+
+Dshot::Dshot(TIM_TypeDef* timer, DMA_Channel_TypeDef* dma) :
+_timer(timer),
+_dma(dma),
+_one(0),
+_zero(0),
+_buffer{}
+{
+}
+
+void Dshot::configure(Speed speed)
+{
+	// Bit period from undivided timer clock, 1 is 3/4 and 0 is 3/8 of period high
+	uint32_t period = SystemCoreClock / (speed * 1000);
+	_one = period * 3 / 4;
+	_zero = period * 3 / 8;
+
+	TIM_TimeBaseInitTypeDef timeBase;
+	TIM_TimeBaseStructInit(&timeBase);
+	timeBase.TIM_Prescaler = 0;
+	timeBase.TIM_Period = period - 1;
+	timeBase.TIM_ClockDivision = 0;
+	timeBase.TIM_CounterMode = TIM_CounterMode_Up;
+	TIM_TimeBaseInit(_timer, &timeBase);
+	TIM_ARRPreloadConfig(_timer, ENABLE);
+
+	// Every update event writes next slot to CCR1..CCR4 through DMAR
+	TIM_DMAConfig(_timer, TIM_DMABase_CCR1, TIM_DMABurstLength_4Transfers);
+	TIM_DMACmd(_timer, TIM_DMA_Update, ENABLE);
+
+	DMA_InitTypeDef dmaConfig;
+	DMA_StructInit(&dmaConfig);
+	dmaConfig.DMA_PeripheralBaseAddr = (uintptr_t)&_timer->DMAR;
+	dmaConfig.DMA_MemoryBaseAddr = (uintptr_t)_buffer;
+	dmaConfig.DMA_DIR = DMA_DIR_PeripheralDST;
+	dmaConfig.DMA_BufferSize = SlotN * ChannelN;
+	dmaConfig.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	dmaConfig.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	dmaConfig.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+	dmaConfig.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+	dmaConfig.DMA_Mode = DMA_Mode_Normal;
+	dmaConfig.DMA_Priority = DMA_Priority_High;
+	dmaConfig.DMA_M2M = DMA_M2M_Disable;
+	DMA_DeInit(_dma);
+	DMA_Init(_dma, &dmaConfig);
+
+	if(IS_TIM_LIST6_PERIPH(_timer))
+		TIM_CtrlPWMOutputs(_timer, ENABLE);
+
+	TIM_Cmd(_timer, ENABLE);
+}
+
+void Dshot::value(uint8_t channel, uint16_t value)
+{
+	uint16_t bits = frame(value);
+	uint16_t* slot = _buffer + (channel - 1);
+
+	// Most significant bit first
+	for(uint8_t i = 0; i < FrameBits; i++, slot += ChannelN)
+		*slot = (bits & (0x8000 >> i)) ? _one : _zero;
+}
+
+void Dshot::send()
+{
+	DMA_Cmd(_dma, DISABLE);
+	DMA_SetCurrDataCounter(_dma, SlotN * ChannelN);
+	DMA_Cmd(_dma, ENABLE);
+}
+
+const uint16_t* Dshot::buffer() const
+{
+	return _buffer;
+}
@@ -0,0 +1,221 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "ellipsoidCalibration.h"
+
+#include <cmath>
+
+// Smallest Cholesky pivot relative to the diagonal it came from, below it
+// the readings do not tell the parameters apart
+static const float pivotLimit = 1e-5f;
+
+EllipsoidCalibration::EllipsoidCalibration(float spacing, float maxResidual) :
+_spacing(spacing),
+_maxResidual(maxResidual)
+{
+	reset();
+}
+
+void EllipsoidCalibration::reset()
+{
+	for(uint8_t i = 0; i < N; i++){
+		for(uint8_t j = 0; j < N; j++)
+			_normal[i][j] = 0;
+		_moment[i] = 0;
+	}
+	_targetSquares = 0;
+	_count = 0;
+	_sinceFit = 0;
+	_step = Idle;
+	_done = false;
+	_residual = 0;
+	_center = math3d::ZeroVector;
+	_scale = math3d::Vector3<float>(1, 1, 1);
+}
+
+bool EllipsoidCalibration::add(const math3d::Vector3<float>& sample)
+{
+	if(_count > 0){
+		math3d::Vector3<float> moved = sample - _last;
+		if(moved.dotProduct(moved) < _spacing * _spacing)
+			return false;
+
+		for(uint8_t i = 0; i < 3; i++){
+			_min[i] = sample[i] < _min[i] ? sample[i] : _min[i];
+			_max[i] = sample[i] > _max[i] ? sample[i] : _max[i];
+		}
+	}
+	else
+		_min = _max = sample;
+	_last = sample;
+
+	float x = sample[0], y = sample[1], z = sample[2];
+	float regressors[N] = {y * y, z * z, x, y, z, 1};
+	float target = x * x;
+	for(uint8_t i = 0; i < N; i++){
+		for(uint8_t j = i; j < N; j++)
+			_normal[i][j] += regressors[i] * regressors[j];
+		_moment[i] += regressors[i] * target;
+	}
+	_targetSquares += target * target;
+	_count += 1;
+	_sinceFit++;
+
+	// Fading keeps the sums bounded and lets the fit follow changes
+	if(_count >= MaxSamples){
+		for(uint8_t i = 0; i < N; i++){
+			for(uint8_t j = i; j < N; j++)
+				_normal[i][j] *= 0.5f;
+			_moment[i] *= 0.5f;
+		}
+		_targetSquares *= 0.5f;
+		_count *= 0.5f;
+	}
+	return true;
+}
+
+bool EllipsoidCalibration::poll()
+{
+	if(_step == Idle){
+		if(_count >= MinSamples && _sinceFit >= SolveInterval)
+			startFit();
+		return false;
+	}
+
+	if(_step < N){
+		// Column j of the Cholesky factor
+		uint8_t j = _step;
+		float pivot = _factor[j][j];
+		for(uint8_t k = 0; k < j; k++)
+			pivot -= _factor[j][k] * _factor[j][k];
+		if(!(pivot > pivotLimit * _factor[j][j])){
+			_step = Idle;
+			return false;
+		}
+
+		float diagonal = std::sqrt(pivot);
+		_factor[j][j] = diagonal;
+		for(uint8_t i = j + 1; i < N; i++){
+			float value = _factor[j][i];
+			for(uint8_t k = 0; k < j; k++)
+				value -= _factor[i][k] * _factor[j][k];
+			_factor[i][j] = value / diagonal;
+		}
+		_step++;
+		return false;
+	}
+
+	if(_step == Substitution){
+		float forward[N];
+		for(uint8_t i = 0; i < N; i++){
+			float value = _rhs[i];
+			for(uint8_t k = 0; k < i; k++)
+				value -= _factor[i][k] * forward[k];
+			forward[i] = value / _factor[i][i];
+		}
+		for(int8_t i = N - 1; i >= 0; i--){
+			float value = forward[i];
+			for(uint8_t k = i + 1; k < N; k++)
+				value -= _factor[k][i] * _solution[k];
+			_solution[i] = value / _factor[i][i];
+		}
+		_step = Finish;
+		return false;
+	}
+
+	_step = Idle;
+	return finishFit();
+}
+
+bool EllipsoidCalibration::done() const
+{
+	return _done;
+}
+
+uint16_t EllipsoidCalibration::samples() const
+{
+	return (uint16_t)_count;
+}
+
+float EllipsoidCalibration::residual() const
+{
+	return _residual;
+}
+
+void EllipsoidCalibration::update(SensorCorrection& correction) const
+{
+	correction.scale = _scale;
+	for(uint8_t i = 0; i < 3; i++)
+		correction.bias[i] = _center[i] * _scale[i];
+}
+
+void EllipsoidCalibration::startFit()
+{
+	for(uint8_t i = 0; i < N; i++){
+		for(uint8_t j = i; j < N; j++)
+			_factor[i][j] = _normal[i][j];
+		_rhs[i] = _moment[i];
+	}
+	_fitSquares = _targetSquares;
+	_fitCount = _count;
+	_fitMin = _min;
+	_fitMax = _max;
+	_sinceFit = 0;
+	_step = 0;
+}
+
+bool EllipsoidCalibration::finishFit()
+{
+	// Solution is (-b, -c, -d, -e, -f, -g)
+	float b = -_solution[0];
+	float c = -_solution[1];
+	if(!(b > 0 && c > 0))
+		return false;
+
+	math3d::Vector3<float> center(_solution[2] / 2, _solution[3] / (2 * b), _solution[4] / (2 * c));
+	float squaredRadius = center[0] * center[0] + b * center[1] * center[1] + c * center[2] * center[2] + _solution[5];
+	if(!(squaredRadius > 0))
+		return false;
+
+	// Readings must reach at least one radius along every axis
+	math3d::Vector3<float> radius(std::sqrt(squaredRadius), std::sqrt(squaredRadius / b), std::sqrt(squaredRadius / c));
+	for(uint8_t i = 0; i < 3; i++)
+		if(_fitMax[i] - _fitMin[i] < radius[i])
+			return false;
+
+	// Residual sum of squares left by the least squares solution
+	float residualSquares = _fitSquares;
+	for(uint8_t i = 0; i < N; i++)
+		residualSquares -= _solution[i] * _rhs[i];
+	float residual = std::sqrt(residualSquares > 0 ? residualSquares / _fitCount : 0) / squaredRadius;
+	if(residual > _maxResidual)
+		return false;
+
+	_center = center;
+	_scale = math3d::Vector3<float>(1 / radius[0], 1 / radius[1], 1 / radius[2]);
+	_residual = residual;
+	_done = true;
+	return true;
+}
@@ -24,26 +24,118 @@
 *    source distribution.
 */
 
-#include "Engine.h"
+#include "engine.h"
+#include "dshot.h"
 
-#include "systime.h"
+
+#include <stm32f30x_tim.h>
+
+// OneShot125 runs standard pulse widths 8 times faster. 16 MHz doesn't
+// divide from 72 MHz, at 24 MHz the compare values are 1.5 times the
+// standard pwm ticks at 2 MHz
+static const uint32_t oneShotFrequency = 24e6;
+// 125-250 us pulse + 12.5 us delay
+static const uint32_t oneShotPeriod = 6300;
+static const float oneShotScale = 1.5f;
+
+// Multishot 5-25 us pulse at 72 MHz, mapped from standard pwm ticks
+static const uint32_t multishotFrequency = 72e6;
+static const uint32_t multishotPeriod = 1872;
+static const float multishotScale = 0.72f;
+static const float multishotOffset = -1080.0f;
+
+static bool isDshot(Engine::Protocol protocol)
+{
+	return protocol == Engine::Dshot150 || protocol == Engine::Dshot300 || protocol == Engine::Dshot600;
+}
+
+static bool isOneShot(Engine::Protocol protocol)
+{
+	return protocol == Engine::OneShot125 || protocol == Engine::Multishot;
+}
+
+// Counter runs once per trigger, pulses are aligned to its end
+static void configureOneShotTimer(TIM_TypeDef* timer, uint32_t frequency, uint32_t period)
+{
+	TIM_TimeBaseInitTypeDef timeBase;
+	TIM_TimeBaseStructInit(&timeBase);
+	timeBase.TIM_Prescaler = SystemCoreClock / frequency - 1;
+	timeBase.TIM_Period = period - 1;
+	timeBase.TIM_ClockDivision = 0;
+	timeBase.TIM_CounterMode = TIM_CounterMode_Up;
+	TIM_TimeBaseInit(timer, &timeBase);
+
+	TIM_ARRPreloadConfig(timer, DISABLE);
+	TIM_SelectOnePulseMode(timer, TIM_OPMode_Single);
+
+	if(IS_TIM_LIST6_PERIPH(timer))
+		TIM_CtrlPWMOutputs(timer, ENABLE);
+}
 
 Engine::Engine(TIM_TypeDef* timer, uint8_t channel, float minPulseWidth, float maxPulseWidth, float throttle) :
+_protocol(StandardPwm),
+_channel(channel),
 _pwm(timer, channel),
+_dshot(nullptr),
+_table(nullptr),
+_throttle(0),
 _minPulseWidth(minPulseWidth),
 _maxPulseWidth(maxPulseWidth)
 {
+	updateTicks();
+	this->throttle(throttle);
+}
+
+Engine::Engine(TIM_TypeDef* timer, uint8_t channel, const ActuatorTable* table, float throttle) :
+Engine(timer, channel, table, StandardPwm, throttle)
+{
+}
+
+Engine::Engine(TIM_TypeDef* timer, uint8_t channel, const ActuatorTable* table, Protocol protocol, float throttle) :
+_protocol(protocol),
+_channel(channel),
+_pwm(timer, channel, isOneShot(protocol) ? Pwm::TrailingEdge : Pwm::LeadingEdge),
+_dshot(isDshot(protocol) ? Dshot::output(timer) : nullptr),
+_table(table),
+_throttle(0),
+_minPulseWidth(table->ticks(0) / Pwm::pulseTicks(1)),
+_maxPulseWidth(table->ticks(1) / Pwm::pulseTicks(1))
+{
+	updateTicks();
 	this->throttle(throttle);
 }
 
 float Engine::throttle()
 {
-	return (_pwm.pulseWidth() - _minPulseWidth) / (_maxPulseWidth - _minPulseWidth);
+	return _throttle;
 }
 
 void Engine::throttle(float throttle)
 {
-	_pwm.pulseWidth(_minPulseWidth + throttle * (_maxPulseWidth - _minPulseWidth));
+	_throttle = throttle;
+
+	// Standard pwm ticks, other protocols are derived from them
+	float ticks;
+	if(_table != nullptr)
+		ticks = _table->ticks(throttle);
+	else
+		ticks = _minTicks + throttle * _rangeTicks;
+
+	switch(_protocol){
+	case StandardPwm:
+		_pwm.compare(ticks);
+		break;
+	case OneShot125:
+		_pwm.compare(oneShotPeriod - ticks * oneShotScale);
+		break;
+	case Multishot:
+		_pwm.compare(multishotPeriod - (ticks * multishotScale + multishotOffset));
+		break;
+	default:
+		if(_dshot != nullptr)
+			_dshot->value(_channel, Dshot::throttleValue((ticks - _minTicks) * _dshotScale));
+		break;
+	}
 }
 
 float Engine::minPulseWidth()
@@ -54,6 +146,7 @@ float Engine::minPulseWidth()
 void Engine::minPulseWidth(float minPulseWidth)
 {
 	_minPulseWidth = minPulseWidth;
+	updateTicks();
 }
 
 float Engine::maxPulseWidth()
@@ -64,6 +157,7 @@ float Engine::maxPulseWidth()
 void Engine::maxPulseWidth(float maxPulseWidth)
 {
 	_maxPulseWidth = maxPulseWidth;
+	updateTicks();
 }
 
 void Engine::connect(GPIO_TypeDef* port, uint16_t pin, uint8_t altFunction)
@@ -71,9 +165,47 @@ void Engine::connect(GPIO_TypeDef* port, uint16_t pin, uint8_t altFunction)
 	_pwm.connect(port, pin, altFunction);
 }
 
-void Engine::arm()
+void Engine::configureTimer(TIM_TypeDef* timer, Protocol protocol)
+{
+	switch(protocol){
+	case StandardPwm:
+		Pwm::configureTimer(timer, 50);
+		break;
+	case OneShot125:
+		configureOneShotTimer(timer, oneShotFrequency, oneShotPeriod);
+		break;
+	case Multishot:
+		configureOneShotTimer(timer, multishotFrequency, multishotPeriod);
+		break;
+	case Dshot150:
+	case Dshot300:
+	case Dshot600:{
+		Dshot* output = Dshot::output(timer);
+		if(output == nullptr)
+			break;
+		output->configure(protocol == Dshot150 ? Dshot::Dshot150 :
+						  protocol == Dshot300 ? Dshot::Dshot300 : Dshot::Dshot600);
+		break;}
+	}
+}
+
+void Engine::trigger(TIM_TypeDef* timer, Protocol protocol)
+{
+	if(isOneShot(protocol)){
+		// Load new compare values and run the counter once
+		TIM_GenerateEvent(timer, TIM_EventSource_Update);
+		TIM_Cmd(timer, ENABLE);
+	}
+	else if(isDshot(protocol)){
+		Dshot* output = Dshot::output(timer);
+		if(output != nullptr)
+			output->send();
+	}
+}
+
+void Engine::updateTicks()
 {
-	throttle(1);
-	sleep(2, second);
-	throttle(0);
+	_minTicks = Pwm::pulseTicks(_minPulseWidth);
+	_rangeTicks = Pwm::pulseTicks(_maxPulseWidth) - _minTicks;
+	_dshotScale = _rangeTicks > 0 ? 1.0f / _rangeTicks : 0.0f;
 }
@@ -0,0 +1,78 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "flashPage.h"
+
+#include <stm32f30x.h>
+#include <stm32f30x_flash.h>
+
+FlashPage::FlashPage(uint32_t address) :
+_address(address)
+{
+}
+
+const uint8_t* FlashPage::data() const
+{
+	return (const uint8_t*)(uintptr_t)_address;
+}
+
+bool FlashPage::erase()
+{
+	FLASH_Unlock();
+	FLASH_ClearFlag(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+	FLASH_Status status = FLASH_ErasePage(_address);
+	FLASH_Lock();
+
+	return status == FLASH_COMPLETE;
+}
+
+bool FlashPage::program(uint32_t offset, const void* data, uint32_t size)
+{
+	if(offset % 2 != 0 || size % 2 != 0 || offset + size > Size)
+		return false;
+
+	const uint8_t* bytes = (const uint8_t*)data;
+	FLASH_Status status = FLASH_COMPLETE;
+
+	FLASH_Unlock();
+	FLASH_ClearFlag(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+	for(uint32_t i = 0; i < size && status == FLASH_COMPLETE; i += 2)
+		status = FLASH_ProgramHalfWord(_address + offset + i, bytes[i] | (uint16_t)bytes[i + 1] << 8);
+	FLASH_Lock();
+
+	return status == FLASH_COMPLETE;
+}
+
+uint16_t FlashPage::checksum(const void* data, uint32_t size, uint16_t crc)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+
+	for(uint32_t i = 0; i < size; i++){
+		crc ^= (uint16_t)bytes[i] << 8;
+		for(uint8_t bit = 0; bit < 8; bit++)
+			crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
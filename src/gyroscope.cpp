@@ -42,6 +42,21 @@
 
 #define CHANGE_DELAY                5
 
+// Auto-ranging goes up once peak rate exceeds this part of full scale and
+// down when it stays below this part of the lower full scale for hold time in ms
+#define RANGE_UP                    0.8f
+#define RANGE_DOWN                  0.4f
+#define RANGE_HOLD                  500
+
+// Output at the rail is clipped, true rate is unknown
+#define RAW_CLIPPED                 32767
+
+// Temperature is read along with data once per period in ms
+#define TEMPERATURE_PERIOD          1000
+// OUT_TEMP counts down 1 LSB/deg from an untrimmed offset, only
+// changes are accurate
+#define L3G_TEMPERATURE_OFFSET      25
+
 #define BYPASS_MODE					0x00
 #define FIFO_MODE					0x20
 #define STREAM_MODE					0x40
@@ -49,8 +64,70 @@
 #define FIFO_ENABLED				0x40
 #define FIFO_DISABLED				0x00
 
+#define DATA_READY					0x08
+
+// Full scales in ascending order
+static const uint8_t fullScales[] = {L3GD20_FULLSCALE_250, L3GD20_FULLSCALE_500, L3GD20_FULLSCALE_2000};
+static const int fullScaleN = sizeof(fullScales) / sizeof(fullScales[0]);
+
+// Digits per dps, 0x30 selects 2000 dps as well
+static float sensitivity(uint8_t scale)
+{
+    switch(scale & 0x30)
+    {
+    case L3GD20_FULLSCALE_250:
+        return L3G_Sensitivity_250dps;
+    case L3GD20_FULLSCALE_500:
+        return L3G_Sensitivity_500dps;
+    default:
+        return L3G_Sensitivity_2000dps;
+    }
+}
+
+// Nominal full scale range in dps
+static float range(uint8_t scale)
+{
+    switch(scale & 0x30)
+    {
+    case L3GD20_FULLSCALE_250:
+        return 250;
+    case L3GD20_FULLSCALE_500:
+        return 500;
+    default:
+        return 2000;
+    }
+}
+
+// Smallest full scale keeping peak rate below part of it
+static uint8_t fitScale(float peak, float part)
+{
+    for (int i = 0; i < fullScaleN - 1; i++)
+        if (peak < part * range(fullScales[i]))
+            return fullScales[i];
+    return fullScales[fullScaleN - 1];
+}
+
+// Samples stored in sensor FIFO by its source register, overrun means full
+static uint8_t fifoLevel(uint8_t fifoSrc)
+{
+    return (fifoSrc & 0x40) != 0 ? 32 : fifoSrc & 0x1F;
+}
+
 Gyroscope::Gyroscope(L3GD20_InitTypeDef& gyroInit, L3GD20_FilterConfigTypeDef& filterConfig, uint16_t maxBufferSize) :
-_maxBufferSize(maxBufferSize)
+_maxBufferSize(maxBufferSize),
+_readyTime(0),
+_restartFifo(false),
+_clearFifo(false),
+_autoRange(false),
+_rangePeak(0),
+_rangeTime(0),
+_scalePending(false),
+_pendingScale(gyroInit.Full_Scale),
+_pendingSamples(0),
+_pendingDrops(0),
+_droppedSamples(0),
+_temperature(L3G_TEMPERATURE_OFFSET),
+_temperatureTime(0)
 {
 	switch(gyroInit.Output_DataRate)
 	{
@@ -78,6 +155,9 @@ _maxBufferSize(maxBufferSize)
     
     /* Initialize scale buffer */
     _scaleBuffer.push_back(std::make_pair(gyroInit.Full_Scale, 0));
+
+    /* Let L3GD20 perform changes, the caller goes on meanwhile */
+    settle();
 }
 
 int Gyroscope::test()
@@ -87,14 +167,15 @@ int Gyroscope::test()
 	discard(true);
 	clearFifo();
 	sw.start();
+	int samples = 0;
 	while(sw.elapsed() < 1000)
 	{
-		retrieveValues();
+		samples += retrieveValues();
 	}
 
 	// TODO: Data rate je 2x vyssi nez by mal byt
 
-	return _dataBuffer.size();
+	return samples;
 }
     
 math3d::Vector3<float> Gyroscope::readValue()
@@ -105,30 +186,8 @@ math3d::Vector3<float> Gyroscope::readValue()
     if (_dataBuffer.size() <= 0)
         return math3d::ZeroVector;
         
-    float sensitivity;
-
-    /* Switch the sensitivity value */
-    switch(_scaleBuffer.front().first & 0x30)
-    {
-    case L3GD20_FULLSCALE_250:
-        sensitivity = L3G_Sensitivity_250dps;
-        break;
-
-    case L3GD20_FULLSCALE_500:
-        sensitivity = L3G_Sensitivity_500dps;
-        break;
-
-    case L3GD20_FULLSCALE_2000:
-        sensitivity = L3G_Sensitivity_2000dps;
-        break;
-        
-    default:
-        sensitivity = 0;
-        break;
-    }
-    
-    /* Divide by sensitivity and convert to radians*/
-    math3d::Vector3<float> ret = math3d::Vector3<float>(_dataBuffer.front()) * (math3d::radiansInDegree / sensitivity);
+    /* Divide by sensitivity of the sample's scale, convert to radians and correct */
+    math3d::Vector3<float> ret = _correction.apply(_dataBuffer.front(), math3d::radiansInDegree / sensitivity(_scaleBuffer.front().first));
     
     discard();
     return ret;
@@ -185,40 +244,113 @@ void Gyroscope::selectMode(Mode mode)
     fifoCtrl = (fifoCtrl & (~0xE0)) | fifoMode;
     L3GD20_Write(&fifoCtrl, L3GD20_FIFO_CTRL_REG_ADDR, 1);
 
-    // Clear FIFO from previously stored data
+    // Clear FIFO from previously stored data, it collects with pending scale
     if(fifoEn == FIFO_ENABLED)
-    	clearFifo();
+    {
+        clearFifo();
+    }
 }
 
 void Gyroscope::changeScale(uint8_t scale)
 {
-    uint8_t ctrl4, fifoCtrl;
-
-    scale &= 0x30;
+    uint8_t fifoCtrl;
 
     L3GD20_Read(&fifoCtrl, L3GD20_FIFO_CTRL_REG_ADDR, 1);
     bool fifoMode = (fifoCtrl & 0x70) != 0;
 
-    /* Retrieve stored values before changing scale */
+    /* Retrieve stored values before changing scale, they keep the old one */
     retrieveValues();
-    
+    writeScale(scale & 0x30, fifoMode);
+}
+
+void Gyroscope::autoRange(bool enable)
+{
+    _autoRange = enable;
+    _rangePeak = 0;
+    _rangeTime = getSystemTime() + RANGE_HOLD * (SYSTEM_TIME_RESOLUTION / millisecond);
+}
+
+bool Gyroscope::autoRange() const
+{
+    return _autoRange;
+}
+
+uint8_t Gyroscope::scale() const
+{
+    return _scaleBuffer.back().first;
+}
+
+void Gyroscope::updateRange(bool fifoMode)
+{
+    uint8_t current = _scalePending ? _pendingScale : scale();
+    uint8_t wanted = fitScale(_rangePeak, RANGE_UP);
+    uint64_t now = getSystemTime();
+
+    if (range(wanted) <= range(current))
+    {
+        wanted = current;
+        if (now < _rangeTime)
+            return;
+
+        /* Peak stayed low for whole hold time */
+        uint8_t lower = fitScale(_rangePeak, RANGE_DOWN);
+        if (range(lower) < range(current))
+            wanted = lower;
+        _rangePeak = 0;
+        _rangeTime = now + RANGE_HOLD * (SYSTEM_TIME_RESOLUTION / millisecond);
+    }
+
+    /* Switch waits until reads free a scale label, relabeling would misscale samples */
+    if (wanted == current || (_scaleBuffer.back().second > 0 && _scaleBuffer.full()))
+        return;
+
+    writeScale(wanted, fifoMode);
+}
+
+void Gyroscope::writeScale(uint8_t scale, bool fifoMode)
+{
+    uint8_t ctrl4, fifoSrc = 0x20;
+
     /* Read current value from CTRL_REG4 register */
     L3GD20_Read(&ctrl4, L3GD20_CTRL_REG4_ADDR, 1);
 
     /* Change scale */
     ctrl4 = (ctrl4 & ~0x30) | scale;
-                    
-    /* Write new value to CTRL_REG4 regsister */
+
+    /* Samples may come after FIFO was drained, the ones stored now keep the old scale */
+    if (fifoMode)
+        L3GD20_Read(&fifoSrc, L3GD20_FIFO_SRC_REG_ADDR, 1);
+    uint8_t queued = fifoLevel(fifoSrc);
+
+    /* Write new value to CTRL_REG4 regsister, next sample is taken with it */
     L3GD20_Write(&ctrl4, L3GD20_CTRL_REG4_ADDR, 1);
 
-    /* Let L3GD20 perform changes */
-    sleep(CHANGE_DELAY);
+    _rangePeak = 0;
+    _rangeTime = getSystemTime() + RANGE_HOLD * (SYSTEM_TIME_RESOLUTION / millisecond);
 
-    /* Discard values recorded during scale change */
-    if(fifoMode)
-    	clearFifo();
+    /* Samples stored between the two FIFO reads were taken around the
+       write with either scale. In bypass mode the last sample stays in
+       output registers until the next one is ready */
+    if (fifoMode)
+    {
+        L3GD20_Read(&fifoSrc, L3GD20_FIFO_SRC_REG_ADDR, 1);
+        uint8_t level = fifoLevel(fifoSrc);
+        _pendingSamples = queued;
+        _pendingDrops = level > queued ? level - queued : 0;
+        if (_pendingSamples + _pendingDrops == 0)
+        {
+            tagScale(scale);
+            return;
+        }
+    }
+    _scalePending = true;
+    _pendingScale = scale;
+}
 
-    if (_scaleBuffer.back().second > 0)
+void Gyroscope::tagScale(uint8_t scale)
+{
+    /* With no room left the newest label is reused, scale changes faster than reads */
+    if (_scaleBuffer.back().second > 0 && !_scaleBuffer.full())
         _scaleBuffer.push_back(std::make_pair(scale, 0));
     else
         _scaleBuffer.back().first = scale;
@@ -229,18 +361,93 @@ void Gyroscope::useHighPassFilter(bool use)
     L3GD20_FilterCmd(use ? L3GD20_HIGHPASSFILTER_ENABLE : L3GD20_HIGHPASSFILTER_DISABLE);
     
     /* Let L3GD20 perform changes */
-    sleep(CHANGE_DELAY);
+    settle();
+}
+
+bool Gyroscope::ready()
+{
+    if (getSystemTime() < _readyTime)
+        return false;
+
+    /* Second half of FIFO reset */
+    if (_restartFifo){
+        uint8_t fifoCtrl;
+        L3GD20_Read(&fifoCtrl, L3GD20_FIFO_CTRL_REG_ADDR, 1);
+        fifoCtrl = fifoCtrl | FIFO_MODE;
+        L3GD20_Write(&fifoCtrl, L3GD20_FIFO_CTRL_REG_ADDR, 1);
+        _restartFifo = false;
+        settle();
+        return false;
+    }
+
+    if (_clearFifo){
+        _clearFifo = false;
+        clearFifo();
+        return getSystemTime() >= _readyTime && !_restartFifo;
+    }
+
+    return true;
+}
+
+uint64_t Gyroscope::readyTime() const
+{
+    return _readyTime;
+}
+
+void Gyroscope::correction(const SensorCorrection& correction)
+{
+    _correction = correction;
+}
+
+const SensorCorrection& Gyroscope::correction() const
+{
+    return _correction;
+}
+
+void Gyroscope::settle()
+{
+    _readyTime = getSystemTime() + CHANGE_DELAY * (SYSTEM_TIME_RESOLUTION / millisecond);
+}
+
+float Gyroscope::temperature() const
+{
+    return _temperature;
+}
+
+uint32_t Gyroscope::droppedSamples() const
+{
+    return _droppedSamples;
+}
+
+void Gyroscope::sampleTemperature()
+{
+    uint64_t now = getSystemTime();
+    if (now < _temperatureTime)
+        return;
+
+    int8_t raw;
+    L3GD20_Read((uint8_t*)&raw, L3GD20_OUT_TEMP_ADDR, 1);
+    _temperature = L3G_TEMPERATURE_OFFSET - raw;
+    _temperatureTime = now + TEMPERATURE_PERIOD * (SYSTEM_TIME_RESOLUTION / millisecond);
 }
 
 
 // TODO: Bypass to stream support
 // Stream to FIFO support
-void Gyroscope::retrieveValues()
+int Gyroscope::retrieveValues()
 {
-    uint8_t tmpbuffer[6] = {0};
+    /* Status register precedes output registers */
+    uint8_t tmpbuffer[7] = {0};
+    uint8_t* data = tmpbuffer + 1;
     math3d::Vector3<int16_t> vec;
     uint8_t ctrl4, fifoCtrl, fifoSrc;
     int i = 0;
+    int count = 0;
+
+    if (!ready())
+        return 0;
+
+    sampleTemperature();
 
     L3GD20_Read(&fifoCtrl, L3GD20_FIFO_CTRL_REG_ADDR, 1);
     bool fifoMode = (fifoCtrl & 0x70) != 0;
@@ -251,11 +458,11 @@ void Gyroscope::retrieveValues()
         
         /* Test FIFO empty bit */
         if ((fifoSrc & 0x20) != 0)
-            return; 
+            return 0;
     }
     
     if(_scaleBuffer.empty())
-        return;
+        return 0;
 
     L3GD20_Read(&ctrl4, L3GD20_CTRL_REG4_ADDR, 1);    
     do{
@@ -265,28 +472,74 @@ void Gyroscope::retrieveValues()
     		fifoFull = fifoFull || (fifoSrc & 0x40) != 0;
     	}
 
-        L3GD20_Read(tmpbuffer, L3GD20_OUT_X_L_ADDR, 6);
+        /* Sample taken with new scale replaced the old one in output registers,
+           status is read in the same transfer so no sample slips in between */
+        if (!fifoMode && _scalePending){
+            L3GD20_Read(tmpbuffer, L3GD20_STATUS_REG_ADDR, 7);
+            if ((tmpbuffer[0] & DATA_READY) != 0){
+                tagScale(_pendingScale);
+                _scalePending = false;
+            }
+        }
+        else
+            L3GD20_Read(data, L3GD20_OUT_X_L_ADDR, 6);
 
         /* Check in the control register 4 the data alignment (Big Endian or Little Endian) */
         if(ctrl4 & 0x40){
             for(i = 0; i < 3; i++){
-              vec[i] = (int16_t)(((uint16_t)tmpbuffer[2*i] << 8) + tmpbuffer[2*i+1]);
+              vec[i] = (int16_t)(((uint16_t)data[2*i] << 8) + data[2*i+1]);
             }
         }
         else{
             for(i = 0; i < 3; i++){
-              vec[i] = (int16_t)(((uint16_t)tmpbuffer[2*i+1] << 8) + tmpbuffer[2*i]);
+              vec[i] = (int16_t)(((uint16_t)data[2*i+1] << 8) + data[2*i]);
             }
         }
         
-        // Check if buffer size isn't larger than maximum
-        if(_maxBufferSize > 0 && _dataBuffer.size() >= _maxBufferSize)
-        	discard();
+        /* Samples of old scale come first after a switch in FIFO mode, then
+           the ones of unknown scale are dropped */
+        bool drop = false;
+        if (fifoMode && _scalePending){
+            if (_pendingSamples > 0)
+                _pendingSamples--;
+            else{
+                _pendingDrops--;
+                _droppedSamples++;
+                drop = true;
+            }
+        }
+
+        if (!drop){
+            // Check if buffer size isn't larger than maximum
+            if((_maxBufferSize > 0 && _dataBuffer.size() >= _maxBufferSize) || _dataBuffer.full())
+                discard();
+
+            /* Place retrieved values in local buffer */
+            _dataBuffer.push_back(vec);
+            _scaleBuffer.back().second++;
+            count++;
+
+            /* Track peak rate, clipped samples ask for the top scale */
+            if (_autoRange){
+                float peak = 0;
+                for(i = 0; i < 3; i++){
+                    if(vec[i] >= RAW_CLIPPED || vec[i] < -RAW_CLIPPED){
+                        peak = range(L3GD20_FULLSCALE_2000);
+                        break;
+                    }
+                    float rate = (vec[i] < 0 ? -vec[i] : vec[i]) / sensitivity(_scaleBuffer.back().first);
+                    peak = rate > peak ? rate : peak;
+                }
+                _rangePeak = peak > _rangePeak ? peak : _rangePeak;
+            }
+        }
+
+        /* Rest of FIFO has the new scale */
+        if (fifoMode && _scalePending && _pendingSamples + _pendingDrops == 0){
+            tagScale(_pendingScale);
+            _scalePending = false;
+        }
 
-        /* Place retrieved values in local buffer */
-        _dataBuffer.push_back(vec);
-        _scaleBuffer.back().second++;
-        
         // FIFO empty test
         if (fifoMode){
         	// Let FIFO update
@@ -299,6 +552,11 @@ void Gyroscope::retrieveValues()
     /* FIFO needs reset after being full */
     if (fifoMode && fifoFull)
         resetFifo();
+    /* Sensor FIFO is empty now, scale can change without losing samples */
+    else if (_autoRange)
+        updateRange(fifoMode);
+
+    return count;
 }
 
 void Gyroscope::clearFifo()
@@ -318,12 +576,13 @@ void Gyroscope::clearFifo()
 		L3GD20_Read(&fifoSrc, L3GD20_FIFO_SRC_REG_ADDR, 1);
 
 	}while ((fifoSrc & 0x20) == 0);
+	flushPendingScale();
 
 	/* FIFO needs reset after being full */
 	if (fifoFull)
 		resetFifo();
 	else
-		sleep(CHANGE_DELAY);
+		settle();
 }
 
 void Gyroscope::resetFifo()
@@ -331,15 +590,24 @@ void Gyroscope::resetFifo()
 	uint8_t fifoCtrl;
 	L3GD20_Read(&fifoCtrl, L3GD20_FIFO_CTRL_REG_ADDR, 1);
 
-	// Set to bypass mode to restart data collection
+	// Set to bypass mode to restart data collection, ready() changes
+	// back to FIFO mode once it settles
 	fifoCtrl = (fifoCtrl & (~0xE0));
 	L3GD20_Write(&fifoCtrl, L3GD20_FIFO_CTRL_REG_ADDR, 1);
-	sleep(CHANGE_DELAY);
+	_restartFifo = true;
+	settle();
+	flushPendingScale();
+}
 
-	// Change back to FIFO mode
-	fifoCtrl = fifoCtrl | FIFO_MODE;
-	L3GD20_Write(&fifoCtrl, L3GD20_FIFO_CTRL_REG_ADDR, 1);
-	sleep(CHANGE_DELAY);
+void Gyroscope::flushPendingScale()
+{
+	if (!_scalePending)
+		return;
+
+	tagScale(_pendingScale);
+	_scalePending = false;
+	_pendingSamples = 0;
+	_pendingDrops = 0;
 }
 
 // TODO: interupt if FIFO full or Bypass mode value changes
@@ -24,6 +24,7 @@
 */
 
 #include "interrupt.h"
+#include "irqMonitor.h"
 
 #include <stm32f30x_misc.h>
 
@@ -37,6 +38,9 @@ void Interrupt::enable(uint8_t irq, uint8_t priority, uint8_t subPriority)
 	NVIC_InitStructure.NVIC_IRQChannelSubPriority = subPriority;
 	NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
 	NVIC_Init(&NVIC_InitStructure);
+
+	// Remembered for response time estimates
+	IrqMonitor::priority(IrqMonitor::source(irq), priority);
 }
 
 void Interrupt::disable(uint8_t irq)
@@ -0,0 +1,211 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "irqMonitor.h"
+#include "profiler.h"
+#include "systime.h"
+
+#include <stm32f30x.h>
+
+static IrqStats irqStats[IrqSourceN];
+
+static const char* irqNames[IrqSourceN] = {
+	"exti0", "tim3", "usart1", "usart2", "usart3", "uart4", "uart5"
+};
+
+// Cycles of nested handlers at each depth, subtracted from the parent
+static uint32_t nestedCycles[IrqMonitor::MaxNesting + 1];
+static volatile uint8_t nesting = 0;
+static uint8_t deepestNesting = 0;
+static uint64_t startTime = 0;
+
+// A handler preempting the bookkeeping would see nesting and the cycles
+// slot of its depth disagree and charge its time to the wrong parent, so
+// both entry and exit run with interrupts masked. It takes a few cycles.
+uint32_t irqEnter(IrqSource source)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint32_t now = Profiler::now();
+	IrqStats& stats = irqStats[source];
+
+	if(stats.count > 0 && (stats.minInterval == 0 || now - stats.lastEntry < stats.minInterval))
+		stats.minInterval = now - stats.lastEntry;
+	stats.lastEntry = now;
+	stats.count++;
+
+	// Slot is cleared before nesting is raised
+	uint8_t depth = nesting + 1;
+	if(depth <= IrqMonitor::MaxNesting)
+		nestedCycles[depth] = 0;
+	nesting = depth;
+	if(depth > stats.maxNesting)
+		stats.maxNesting = depth;
+	if(depth > deepestNesting)
+		deepestNesting = depth;
+
+	__set_PRIMASK(primask);
+	return now;
+}
+
+void irqExit(IrqSource source, uint32_t start)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	uint32_t duration = Profiler::now() - start;
+	IrqStats& stats = irqStats[source];
+
+	uint8_t depth = nesting;
+	uint32_t exclusive = duration;
+	if(depth <= IrqMonitor::MaxNesting){
+		exclusive -= nestedCycles[depth];
+		nestedCycles[depth - 1] += duration;
+	}
+	nesting = depth - 1;
+
+	stats.cycles += exclusive;
+	if(exclusive > stats.maxCycles)
+		stats.maxCycles = exclusive;
+
+	__set_PRIMASK(primask);
+}
+
+void IrqMonitor::reset()
+{
+	for(uint8_t i = 0; i < IrqSourceN; i++){
+		uint8_t priority = irqStats[i].priority;
+		irqStats[i] = IrqStats();
+		irqStats[i].priority = priority;
+	}
+	deepestNesting = 0;
+	startTime = getSystemTime();
+}
+
+void IrqMonitor::priority(IrqSource source, uint8_t priority)
+{
+	if(source < IrqSourceN)
+		irqStats[source].priority = priority;
+}
+
+IrqSource IrqMonitor::source(uint8_t irq)
+{
+	switch(irq){
+	case EXTI0_IRQn: return IrqExti0;
+	case TIM3_IRQn: return IrqTim3;
+	case USART1_IRQn: return IrqUsart1;
+	case USART2_IRQn: return IrqUsart2;
+	case USART3_IRQn: return IrqUsart3;
+	case UART4_IRQn: return IrqUart4;
+	case UART5_IRQn: return IrqUart5;
+	default: return IrqSourceN;
+	}
+}
+
+const IrqStats& IrqMonitor::stats(IrqSource source)
+{
+	return irqStats[source];
+}
+
+const char* IrqMonitor::name(IrqSource source)
+{
+	return irqNames[source];
+}
+
+uint8_t IrqMonitor::maxNesting()
+{
+	return deepestNesting;
+}
+
+float IrqMonitor::load()
+{
+	uint64_t elapsed = getSystemTime() - startTime;
+	if(elapsed == 0)
+		return 0;
+
+	uint64_t cycles = 0;
+	for(uint8_t i = 0; i < IrqSourceN; i++)
+		cycles += irqStats[i].cycles;
+
+	return cycles / ((float)elapsed * Profiler::frequency() / SYSTEM_TIME_RESOLUTION);
+}
+
+// Activations of source within window, one when interval is unknown
+static uint32_t activations(const IrqStats& stats, uint32_t window)
+{
+	if(stats.count < 2 || stats.minInterval == 0)
+		return 1;
+	return (window + stats.minInterval - 1) / stats.minInterval;
+}
+
+uint32_t IrqMonitor::responseTime(uint8_t priority)
+{
+	// Own worst case and blocking by another handler of the same priority
+	uint32_t own = 0, blocking = 0;
+	for(uint8_t i = 0; i < IrqSourceN; i++){
+		const IrqStats& stats = irqStats[i];
+		if(stats.count == 0 || stats.priority != priority)
+			continue;
+		if(stats.maxCycles > own){
+			blocking = own;
+			own = stats.maxCycles;
+		}
+		else if(stats.maxCycles > blocking)
+			blocking = stats.maxCycles;
+	}
+
+	// Fixed point of R = C + B + sum(ceil(R / T_j) * C_j) over higher priorities
+	uint64_t response = own + blocking;
+	const uint64_t limit = Profiler::frequency();
+	for(uint8_t iteration = 0; iteration < 32; iteration++){
+		uint64_t next = own + blocking;
+		for(uint8_t i = 0; i < IrqSourceN; i++){
+			const IrqStats& stats = irqStats[i];
+			if(stats.count > 0 && stats.priority < priority)
+				next += (uint64_t)activations(stats, response) * stats.maxCycles;
+		}
+
+		if(next == response)
+			return response;
+		if(next > limit)
+			break;
+		response = next;
+	}
+
+	return Unbounded;
+}
+
+uint32_t IrqMonitor::interference(uint32_t cycles)
+{
+	uint64_t total = 0;
+	for(uint8_t i = 0; i < IrqSourceN; i++){
+		const IrqStats& stats = irqStats[i];
+		if(stats.count > 0)
+			total += (uint64_t)activations(stats, cycles) * stats.maxCycles;
+	}
+
+	return total < Unbounded ? total : Unbounded;
+}
@@ -0,0 +1,245 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "magnetometer.h"
+#include "main.h"
+#include "systime.h"
+
+#include <cmath>
+
+// CRA_REG_M related //
+// Output data rate in Hz
+#define LSM_MAG_ODR_0_75			0.75f
+#define LSM_MAG_ODR_1_5				1.5f
+#define LSM_MAG_ODR_3				3.0f
+#define LSM_MAG_ODR_7_5				7.5f
+#define LSM_MAG_ODR_15				15.0f
+#define LSM_MAG_ODR_30				30.0f
+#define LSM_MAG_ODR_75				75.0f
+#define LSM_MAG_ODR_220				220.0f
+
+// CRB_REG_M related //
+// Sensitivity in LSB/gauss, Z axis differs from X and Y
+#define LSM_Mag_Sensitivity_XY_1_3Ga	1100
+#define LSM_Mag_Sensitivity_Z_1_3Ga		980
+#define LSM_Mag_Sensitivity_XY_1_9Ga	855
+#define LSM_Mag_Sensitivity_Z_1_9Ga		760
+#define LSM_Mag_Sensitivity_XY_2_5Ga	670
+#define LSM_Mag_Sensitivity_Z_2_5Ga		600
+#define LSM_Mag_Sensitivity_XY_4Ga		450
+#define LSM_Mag_Sensitivity_Z_4Ga		400
+#define LSM_Mag_Sensitivity_XY_4_7Ga	400
+#define LSM_Mag_Sensitivity_Z_4_7Ga		355
+#define LSM_Mag_Sensitivity_XY_5_6Ga	330
+#define LSM_Mag_Sensitivity_Z_5_6Ga		295
+#define LSM_Mag_Sensitivity_XY_8_1Ga	230
+#define LSM_Mag_Sensitivity_Z_8_1Ga		205
+
+// Output register value of an axis out of range
+#define LSM_MAG_OVERFLOW			-4096
+
+// Board handler blocks on a stuck bus, transfer fails if it returns
+static bool timedOut()
+{
+	LSM303DLHC_TIMEOUT_UserCallback();
+	return false;
+}
+
+Magnetometer::Magnetometer(LSM303DLHCMag_InitTypeDef& magInit) :
+_period(0),
+_sampleTime(0),
+_sensitivityXy(0),
+_sensitivityZ(0),
+_raw(math3d::ZeroVector)
+{
+	float rate;
+	switch(magInit.MagOutput_DataRate)
+	{
+	case LSM303DLHC_ODR_0_75_HZ:
+		rate = LSM_MAG_ODR_0_75;
+		break;
+	case LSM303DLHC_ODR_1_5_HZ:
+		rate = LSM_MAG_ODR_1_5;
+		break;
+	case LSM303DLHC_ODR_3_0_HZ:
+		rate = LSM_MAG_ODR_3;
+		break;
+	case LSM303DLHC_ODR_7_5_HZ:
+		rate = LSM_MAG_ODR_7_5;
+		break;
+	case LSM303DLHC_ODR_15_HZ:
+		rate = LSM_MAG_ODR_15;
+		break;
+	case LSM303DLHC_ODR_30_HZ:
+		rate = LSM_MAG_ODR_30;
+		break;
+	case LSM303DLHC_ODR_75_HZ:
+		rate = LSM_MAG_ODR_75;
+		break;
+	case LSM303DLHC_ODR_220_HZ:
+		rate = LSM_MAG_ODR_220;
+		break;
+	default:
+		return;
+	}
+
+	uint16_t xy, z;
+	switch(magInit.MagFull_Scale)
+	{
+	case LSM303DLHC_FS_1_3_GA:
+		xy = LSM_Mag_Sensitivity_XY_1_3Ga;
+		z = LSM_Mag_Sensitivity_Z_1_3Ga;
+		break;
+	case LSM303DLHC_FS_1_9_GA:
+		xy = LSM_Mag_Sensitivity_XY_1_9Ga;
+		z = LSM_Mag_Sensitivity_Z_1_9Ga;
+		break;
+	case LSM303DLHC_FS_2_5_GA:
+		xy = LSM_Mag_Sensitivity_XY_2_5Ga;
+		z = LSM_Mag_Sensitivity_Z_2_5Ga;
+		break;
+	case LSM303DLHC_FS_4_0_GA:
+		xy = LSM_Mag_Sensitivity_XY_4Ga;
+		z = LSM_Mag_Sensitivity_Z_4Ga;
+		break;
+	case LSM303DLHC_FS_4_7_GA:
+		xy = LSM_Mag_Sensitivity_XY_4_7Ga;
+		z = LSM_Mag_Sensitivity_Z_4_7Ga;
+		break;
+	case LSM303DLHC_FS_5_6_GA:
+		xy = LSM_Mag_Sensitivity_XY_5_6Ga;
+		z = LSM_Mag_Sensitivity_Z_5_6Ga;
+		break;
+	case LSM303DLHC_FS_8_1_GA:
+		xy = LSM_Mag_Sensitivity_XY_8_1Ga;
+		z = LSM_Mag_Sensitivity_Z_8_1Ga;
+		break;
+	default:
+		return;
+	}
+	_sensitivityXy = 1.0f / xy;
+	_sensitivityZ = 1.0f / z;
+
+	/* Configure Mems LSM303DLHC Magnetometer */
+	LSM303DLHC_MagInit(&magInit);
+
+	// First conversion is ready one period after the configuration
+	_period = (uint64_t)(SYSTEM_TIME_RESOLUTION / rate);
+	_sampleTime = getSystemTime() + _period;
+}
+
+bool Magnetometer::readValue(math3d::Vector3<float>& value)
+{
+	uint64_t now = getSystemTime();
+	if (_period == 0 || now < _sampleTime)
+		return false;
+
+	// Reads follow the output period, a late one does not shift it
+	_sampleTime += _period;
+	if (_sampleTime <= now)
+		_sampleTime = now + _period;
+
+	uint8_t buffer[6];
+	if (!burstRead(LSM303DLHC_OUT_X_H_M, buffer, sizeof(buffer)))
+		return false;
+
+	// Big endian, axes in X, Z, Y order
+	int16_t x = (int16_t)((uint16_t)buffer[0] << 8 | buffer[1]);
+	int16_t z = (int16_t)((uint16_t)buffer[2] << 8 | buffer[3]);
+	int16_t y = (int16_t)((uint16_t)buffer[4] << 8 | buffer[5]);
+	if (x == LSM_MAG_OVERFLOW || y == LSM_MAG_OVERFLOW || z == LSM_MAG_OVERFLOW)
+		return false;
+
+	_raw = math3d::Vector3<float>(x * _sensitivityXy, y * _sensitivityXy, z * _sensitivityZ);
+	value = _correction.apply(_raw);
+	return true;
+}
+
+const math3d::Vector3<float>& Magnetometer::raw() const
+{
+	return _raw;
+}
+
+void Magnetometer::correction(const SensorCorrection& correction)
+{
+	_correction = correction;
+}
+
+const SensorCorrection& Magnetometer::correction() const
+{
+	return _correction;
+}
+
+float Magnetometer::heading(const math3d::Vector3<float>& field, float pitch, float roll)
+{
+	// Up in sensor axes, inverse of the accelerometer angle formulas
+	float sinPitch = std::sin(pitch);
+	float sinRoll = std::sin(roll);
+	float vertical = 1 - sinPitch * sinPitch - sinRoll * sinRoll;
+	math3d::Vector3<float> up(-sinPitch, -sinRoll, vertical > 0 ? std::sqrt(vertical) : 0);
+
+	// Horizontal part of the field, heading turns it onto the X axis
+	math3d::Vector3<float> north = field - up * field.dotProduct(up);
+	return std::atan2(north.crossProduct(math3d::Vector3<float>(1, 0, 0)).dotProduct(up), north[0]);
+}
+
+bool Magnetometer::burstRead(uint8_t address, uint8_t* buffer, uint8_t n)
+{
+	// Same transfer as LSM303DLHC_Read without the auto increment bit,
+	// magnetometer increments the address by itself
+	uint32_t timeout = LSM303DLHC_LONG_TIMEOUT;
+	while (I2C_GetFlagStatus(LSM303DLHC_I2C, I2C_ISR_BUSY) != RESET)
+		if (timeout-- == 0)
+			return timedOut();
+
+	I2C_TransferHandling(LSM303DLHC_I2C, MAG_I2C_ADDRESS, 1, I2C_SoftEnd_Mode, I2C_Generate_Start_Write);
+	timeout = LSM303DLHC_FLAG_TIMEOUT;
+	while (I2C_GetFlagStatus(LSM303DLHC_I2C, I2C_ISR_TXIS) == RESET)
+		if (timeout-- == 0)
+			return timedOut();
+
+	I2C_SendData(LSM303DLHC_I2C, address);
+	timeout = LSM303DLHC_FLAG_TIMEOUT;
+	while (I2C_GetFlagStatus(LSM303DLHC_I2C, I2C_ISR_TC) == RESET)
+		if (timeout-- == 0)
+			return timedOut();
+
+	I2C_TransferHandling(LSM303DLHC_I2C, MAG_I2C_ADDRESS, n, I2C_AutoEnd_Mode, I2C_Generate_Start_Read);
+	for (uint8_t i = 0; i < n; i++)
+	{
+		timeout = LSM303DLHC_FLAG_TIMEOUT;
+		while (I2C_GetFlagStatus(LSM303DLHC_I2C, I2C_ISR_RXNE) == RESET)
+			if (timeout-- == 0)
+				return timedOut();
+		buffer[i] = I2C_ReceiveData(LSM303DLHC_I2C);
+	}
+
+	timeout = LSM303DLHC_FLAG_TIMEOUT;
+	while (I2C_GetFlagStatus(LSM303DLHC_I2C, I2C_ISR_STOPF) == RESET)
+		if (timeout-- == 0)
+			return timedOut();
+	I2C_ClearFlag(LSM303DLHC_I2C, I2C_ICR_STOPCF);
+	return true;
+}
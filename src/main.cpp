@@ -27,16 +27,30 @@
 #include "common.h"
 #include "gyroscope.h"
 #include "accelerometer.h"
+#include "magnetometer.h"
 #include "math3d.h"
 #include "complementaryFilter2.h"
+#include "attitudeEkf.h"
+#include "accelerationTrust.h"
 #include "controller.h"
 #include "stopwatch.h"
 #include "model.h"
 #include "systime.h"
 #include "communicator.h"
 #include "rc_receiver.h"
+#include "rcShaper.h"
+#include "profiler.h"
+#include "irqMonitor.h"
+#include "blackbox.h"
+#include "memoryMonitor.h"
 #include "periphery.h"
 #include "interrupt.h"
+#include "bringUp.h"
+#include "calibration.h"
+#include "ellipsoidCalibration.h"
+#include "configStore.h"
+#include "thermalBias.h"
+#include "ccm.h"
 
 #include <cmath>
 #include <cstdio>
@@ -46,7 +60,24 @@
 #include <stm32f30x_tim.h>
 
 static const float sensorUpdateTime = 0.01;
-static const float filterTimeConst = 0.49;
+static float filterTimeConst = 0.49;
+// Accelerometer trust falls from full to none between tolerance and limit
+// of the magnitude error and of the jump between sample windows, in g
+static const float accMagnitudeTolerance = 0.05f, accMagnitudeLimit = 0.15f;
+static const float accJerkTolerance = 0.1f, accJerkLimit = 0.3f;
+// Weight of magnetometer heading against yaw of the accelerometer angles,
+// a new heading comes every third loop
+static const float headingWeight = 0.25f;
+// Attitude EKF noise: gyroscope in rad/s per sample, its bias drift in
+// rad/s per square root of second, accelerometer in g including the
+// unmodelled acceleration, heading in rad
+static const float ekfGyroNoise = math3d::Radians(0.3f);
+static const float ekfBiasDrift = math3d::Radians(0.01f);
+static const float ekfAccNoise = 0.3f;
+static const float ekfHeadingNoise = math3d::Radians(5.0f);
+
+// ESC signalling of engines on TIM1
+static const Engine::Protocol escProtocol = Engine::StandardPwm;
 
 static float pitchProportional = 0.3f;
 static float pitchIntegral = 0.01f;
@@ -64,34 +95,281 @@ static float maxPitchAngle = 0.7f;
 static float maxRollAngle = 0.7f;
 static float maxYawAngularSpeed = math3d::Pi;
 
+// Expected time between RC frames
+static const float rcFramePeriod = 0.02f;
+static const float rcDeadband = 0.03f;
+// Bottom of throttle travel that reads zero. A stick resting a little above
+// its calibrated minimum keeps motors stopped and the craft on the ground
+// for thermal learning and flash writes, which only run at zero throttle
+static const float rcThrottleDeadband = 0.05f;
+
+enum RcChannels {RcPitch, RcRoll, RcThrottle, RcYaw, RcChannelN};
+
+// RC shaping commands are followed by channel number and value(s)
 enum class CommandIds{pitchProportional = 1, pitchIntegral, pitchDerivative,
-				      rollProportional, rollIntegral, rollDerivative};
+				      rollProportional, rollIntegral, rollDerivative,
+				      rcCalibration, rcDeadband, rcExpo, rcRate,
+				      profileDownload, profileReset, irqStatsDownload,
+				      blackboxStream, blackboxDump, memoryReport, bringUpReport,
+				      accCalibration, calibrationReport, thermalReport,
+				      servoTrim, configSave, configReport, headingReport};
 
 enum ProgramState {ProgramRunning, ProgramEnded, StateN}; 
 ProgramState programState;
 
+// Flight recorder, kept out of the stack
+static Blackbox blackbox;
+static bool blackboxStreaming = false;
+// Bytes sent per loop while streaming, below what the link drains in one period
+static const uint16_t blackboxStreamChunk = 64;
+
+// Accelerometer is calibrated on request with the craft standing level,
+// 2 s of still samples in 0.25 s windows, deviation in g
+static Calibration accCalibration(25, 8, 0.1f);
+static bool accCalibrating = false;
+
+// Magnetometer hard and soft iron are fitted while the craft turns around,
+// readings 0.05 G apart, residual within 5 % of squared field
+static EllipsoidCalibration magCalibration(0.05f, 0.05f);
+// Heading is fused once the magnetometer is calibrated. It is aligned with
+// the yaw estimate at first use, yaw keeps starting from boot orientation.
+static bool headingValid = false;
+static bool headingAligned = false;
+static float headingOffset = 0;
+
+// Settings kept over reboots, defaults above are replaced by saved ones
+static ConfigStore configStore;
+static uint32_t configMountTime = 0;
+
+// Stored forms of settings
+struct PidGains
+{
+	float proportional, integral, derivative;
+};
+
+struct RcShaping
+{
+	float min, center, max, deadband, expo, rate;
+};
+
+// Gyroscope bias over -10 to 60 deg C, learned while standing on the ground.
+// Nodes remember a few minutes of still periods, shorter memory fits only
+// the last fraction of a degree of a slow warm up and bends the rest
+static ThermalBias thermalBias(-10, 10, 256);
+// Still periods of one second learned between writes of the table to flash
+static const uint8_t thermalSaveInterval = 60;
+
 //#define PWM_TEST
 //#define ANGLE_TEST
+// Attitude from the EKF instead of the complementary filter
+//#define ATTITUDE_EKF
 #define CTRL_TEST
 
-// Input angles from range <0, 2*Pi)
-// Output from range <-Pi, Pi>
-float interpolateAngle(float start, float end)
+// Sensors, fusion and controllers live in core coupled RAM instead of the
+// stack, they are constructed in main() once the hardware is running
+CCM_BSS static CcmObject<Gyroscope> gyroStorage;
+CCM_BSS static CcmObject<Accelerometer> accStorage;
+CCM_BSS static CcmObject<Magnetometer> magStorage;
+CCM_BSS static CcmObject<ComplementaryFilter2> cmplFilterStorage;
+CCM_BSS static CcmObject<AccelerationTrust> accTrustStorage;
+#ifdef ATTITUDE_EKF
+CCM_BSS static CcmObject<AttitudeEkf> ekfStorage;
+#endif
+CCM_BSS static CcmObject<Controller> pitchControllerStorage;
+CCM_BSS static CcmObject<Controller> rollControllerStorage;
+CCM_BSS static CcmObject<Controller> yawControllerStorage;
+#ifndef PWM_TEST
+CCM_BSS static CcmObject<Model> modelStorage;
+#endif
+
+// Sends up to limit unread recorder bytes as string packets
+static void sendBlackbox(Communicator& comm, uint32_t limit)
 {
-	float dif = end - start;
-	return dif >= 0 ? dif <= math3d::Pi ? dif : dif - 2 * math3d::Pi
-			        : dif >= -math3d::Pi ? dif : 2 * math3d::Pi + dif;
+	uint8_t chunk[255];
+	uint16_t size;
+	while(limit > 0 && (size = blackbox.read(chunk, limit < sizeof(chunk) ? limit : sizeof(chunk))) > 0){
+		comm.send(Span<const char>((const char*)chunk, size));
+		limit -= size;
+	}
 }
 
-// Normalizes angle into <0, 2*Pi) interval
-float normalizeAngle(float angle)
+// Static data, heap and stack peaks, their sum and available SRAM in bytes,
+// then operator new calls in total and after initialization, then static
+// data and size of core coupled RAM in bytes
+static void sendMemoryReport(Communicator& comm)
 {
-	// Remove extra rounds
-	angle = fmod(angle, 2 * math3d::Pi);
+	comm.send(MemoryMonitor::staticSize());
+	comm.send(MemoryMonitor::heapPeak());
+	comm.send(MemoryMonitor::stackPeak());
+	comm.send(MemoryMonitor::ramPeak());
+	comm.send(MemoryMonitor::ramSize());
+	comm.send(MemoryMonitor::allocations());
+	comm.send(MemoryMonitor::lockedAllocations());
+	comm.send(MemoryMonitor::ccmStaticSize());
+	comm.send(MemoryMonitor::ccmSize());
+}
+
+// Per device: name and system time when it became ready (0 while pending),
+// then time when armed
+static void sendBringUp(Communicator& comm, const BringUp& bringUp)
+{
+	for(int i = 0; i < BringUp::DeviceN; i++){
+		BringUp::Device device = (BringUp::Device)i;
+		comm.send(BringUp::name(device));
+		comm.send((uint32_t)bringUp.readyTime(device));
+	}
+	comm.send((uint32_t)bringUp.armedTime());
+}
+
+static void sendVector(Communicator& comm, const math3d::Vector3<float>& v)
+{
+	for(uint8_t i = 0; i < 3; i++)
+		comm.send(v[i]);
+}
+
+// Gyroscope bias and scale, accelerometer bias and scale (3 floats each),
+// then whether corrections were stored, gyroscope calibrated this boot,
+// its rejected windows and accelerometer calibration in progress
+static void sendCalibration(Communicator& comm, const Gyroscope& gyro, const Accelerometer& acc, const BringUp& bringUp)
+{
+	sendVector(comm, gyro.correction().bias);
+	sendVector(comm, gyro.correction().scale);
+	sendVector(comm, acc.correction().bias);
+	sendVector(comm, acc.correction().scale);
+	comm.send((uint32_t)bringUp.loaded());
+	comm.send((uint32_t)bringUp.calibrated());
+	comm.send(bringUp.gyroCalibration().rejectedWindows());
+	comm.send((uint32_t)accCalibrating);
+}
+
+// Gyroscope and accelerometer temperature, then per table node:
+// temperature, weight and bias (3 floats)
+static void sendThermal(Communicator& comm, const Gyroscope& gyro, const Accelerometer& acc)
+{
+	comm.send(gyro.temperature());
+	comm.send(acc.temperature());
+	for(uint8_t i = 0; i < ThermalBias::NodeN; i++){
+		comm.send(thermalBias.nodeTemperature(i));
+		comm.send(thermalBias.nodeWeight(i));
+		sendVector(comm, thermalBias.nodeBias(i));
+	}
+}
 
-	// Return positive angle
-	return angle >= 0 ? angle : 2 * math3d::Pi + angle;
+static void loadGains(ConfigStore::Key key, float& proportional, float& integral, float& derivative)
+{
+	PidGains gains;
+	if(configStore.read(key, gains)){
+		proportional = gains.proportional;
+		integral = gains.integral;
+		derivative = gains.derivative;
+	}
+}
+
+static bool saveGains(ConfigStore::Key key, float proportional, float integral, float derivative)
+{
+	PidGains gains = {proportional, integral, derivative};
+	return configStore.write(key, gains);
+}
+
+static void loadShaping(RcShaper* rcShapers)
+{
+	for(uint8_t i = 0; i < RcChannelN; i++){
+		RcShaping shaping;
+		if(!configStore.read(ConfigStore::RcShaping + i, shaping))
+			continue;
+		rcShapers[i].calibration(shaping.min, shaping.center, shaping.max);
+		rcShapers[i].deadband(shaping.deadband);
+		rcShapers[i].expo(shaping.expo);
+		rcShapers[i].rate(shaping.rate);
+	}
+}
+
+// Writes every tunable setting, unchanged ones cost no flash. Compaction
+// erases a page and stalls the loop for tens of ms, save on the ground.
+static bool saveConfig(RcShaper* rcShapers, Model& model)
+{
+	bool saved = saveGains(ConfigStore::PitchGains, pitchProportional, pitchIntegral, pitchDerivative);
+	saved &= saveGains(ConfigStore::RollGains, rollProportional, rollIntegral, rollDerivative);
+	saved &= saveGains(ConfigStore::YawGains, yawProportional, yawIntegral, yawDerivative);
+	saved &= configStore.write(ConfigStore::FilterTimeConst, filterTimeConst);
+	saved &= configStore.write(ConfigStore::ServoTrim, model.tailTrim());
+	for(uint8_t i = 0; i < RcChannelN; i++){
+		RcShaping shaping = {rcShapers[i].minimum(), rcShapers[i].center(), rcShapers[i].maximum(),
+							 rcShapers[i].deadband(), rcShapers[i].expo(), rcShapers[i].rate()};
+		saved &= configStore.write(ConfigStore::RcShaping + i, shaping);
+	}
+	return saved;
+}
+
+// Heading relative to boot in radians, whether it is fused, magnetometer
+// bias and scale (3 floats each), then whether the fit is done, its samples
+// and relative residual
+static void sendHeading(Communicator& comm, const Magnetometer& mag, float heading)
+{
+	comm.send(heading);
+	comm.send((uint32_t)headingValid);
+	sendVector(comm, mag.correction().bias);
+	sendVector(comm, mag.correction().scale);
+	comm.send((uint32_t)magCalibration.done());
+	comm.send((uint32_t)magCalibration.samples());
+	comm.send(magCalibration.residual());
+}
+
+// Stored keys, bytes used in active page, compactions, damaged records
+// dropped at boot and mount time in us
+static void sendConfigReport(Communicator& comm)
+{
+	comm.send((uint32_t)configStore.count());
+	comm.send((uint32_t)configStore.used());
+	comm.send(configStore.sequence());
+	comm.send((uint32_t)configStore.damaged());
+	comm.send(configMountTime);
+}
+
+#ifdef PROFILER_ENABLED
+// Per stage: name, count, min, max, mean (in cycles) and log2 histogram
+static void sendProfile(Communicator& comm)
+{
+	comm.send((uint32_t)Profiler::frequency());
+	for(int i = 0; i < Profiler::StageN; i++){
+		Profiler::Stage stage = (Profiler::Stage)i;
+		const Profiler::Stats& stats = Profiler::stats(stage);
+
+		comm.send(Profiler::name(stage));
+		comm.send(stats.count);
+		comm.send(stats.count > 0 ? stats.min : 0);
+		comm.send(stats.max);
+		comm.send(Profiler::mean(stage));
+		for(int j = 0; j < Profiler::BucketN; j++)
+			comm.send(stats.histogram[j]);
+	}
+}
+
+// Per handler: name, priority, count, exclusive cycles, worst case, shortest
+// interval, nesting and response time of its priority level, then total load
+// and worst-case interference within one control loop period
+static void sendIrqStats(Communicator& comm)
+{
+	for(int i = 0; i < IrqSourceN; i++){
+		IrqSource source = (IrqSource)i;
+		const IrqStats& stats = IrqMonitor::stats(source);
+		if(stats.count == 0)
+			continue;
+
+		comm.send(IrqMonitor::name(source));
+		comm.send((uint32_t)stats.priority);
+		comm.send(stats.count);
+		comm.send((float)stats.cycles);
+		comm.send(stats.maxCycles);
+		comm.send(stats.minInterval);
+		comm.send((uint32_t)stats.maxNesting);
+		comm.send(IrqMonitor::responseTime(stats.priority));
+	}
+
+	comm.send(IrqMonitor::load());
+	comm.send((uint32_t)IrqMonitor::interference(sensorUpdateTime * Profiler::frequency()));
 }
+#endif
 
 int main(void)
 {
@@ -108,12 +386,15 @@ int main(void)
 
     // Initialize User Button available on STM32F3-Discovery board
     STM_EVAL_PBInit(BUTTON_USER, BUTTON_MODE_EXTI); 
+    // Lowest preemption priority set by the BSP
+    IrqMonitor::priority(IrqExti0, 15);
 
     // Sensors Test
     L3GD20_InitTypeDef gyroInit;
     L3GD20_FilterConfigTypeDef gyroFilterConfig;
     LSM303DLHCAcc_InitTypeDef accInit;
     LSM303DLHCAcc_FilterConfigTypeDef accFilterConfig;
+    LSM303DLHCMag_InitTypeDef magInit;
 
     gyroInit.Power_Mode         = L3GD20_MODE_ACTIVE;
     gyroInit.Output_DataRate    = L3GD20_OUTPUT_DATARATE_4;
@@ -140,19 +421,50 @@ int main(void)
     accFilterConfig.HighPassFilter_AOI1 			= LSM303DLHC_HPF_AOI1_DISABLE;
     accFilterConfig.HighPassFilter_AOI2 			= LSM303DLHC_HPF_AOI2_DISABLE;
 
-    Gyroscope gyro(gyroInit, gyroFilterConfig, 0);
-    Accelerometer acc(accInit, accFilterConfig, 0);
-    ComplementaryFilter2 cmplFilter(sensorUpdateTime, filterTimeConst);
+    magInit.Temperature_Sensor 	= LSM303DLHC_TEMPSENSOR_ENABLE;
+    magInit.MagOutput_DataRate 	= LSM303DLHC_ODR_30_HZ;
+    magInit.Working_Mode 		= LSM303DLHC_CONTINUOS_CONVERSION;
+    magInit.MagFull_Scale 		= LSM303DLHC_FS_1_3_GA;
+
+    // --- STORED SETTINGS ---
+    // Mount scans at most one flash page
+    uint64_t mountStart = getSystemTime();
+    configStore.mount();
+    configMountTime = getSystemTime() - mountStart;
+    loadGains(ConfigStore::PitchGains, pitchProportional, pitchIntegral, pitchDerivative);
+    loadGains(ConfigStore::RollGains, rollProportional, rollIntegral, rollDerivative);
+    loadGains(ConfigStore::YawGains, yawProportional, yawIntegral, yawDerivative);
+    configStore.read(ConfigStore::FilterTimeConst, filterTimeConst);
+
+    Gyroscope& gyro = gyroStorage.construct(gyroInit, gyroFilterConfig, 0);
+    // 250 dps resolution in hover, no saturation in flips
+    gyro.autoRange(true);
+    Accelerometer& acc = accStorage.construct(accInit, accFilterConfig, 0);
+    Magnetometer& mag = magStorage.construct(magInit);
+    {
+    	SensorCorrection correction;
+    	if(Calibration::load(configStore, ConfigStore::MagCorrection, correction)){
+    		mag.correction(correction);
+    		headingValid = true;
+    	}
+    }
+    ComplementaryFilter2& cmplFilter = cmplFilterStorage.construct(sensorUpdateTime, filterTimeConst);
+    AccelerationTrust& accTrust = accTrustStorage.construct(accMagnitudeTolerance, accMagnitudeLimit, accJerkTolerance, accJerkLimit);
+#ifdef ATTITUDE_EKF
+    AttitudeEkf& ekf = ekfStorage.construct(ekfGyroNoise, ekfBiasDrift, ekfAccNoise, ekfHeadingNoise);
+#endif
 
     // --- PID CONTROLLER SETUP ---
-    Controller pitchController(pitchProportional, pitchIntegral, pitchDerivative, sensorUpdateTime);
+    Controller& pitchController = pitchControllerStorage.construct(pitchProportional, pitchIntegral, pitchDerivative, sensorUpdateTime);
     pitchController.limitOutput(true, -1, 1);
-    Controller rollController(rollProportional, rollIntegral, rollDerivative, sensorUpdateTime);
+    Controller& rollController = rollControllerStorage.construct(rollProportional, rollIntegral, rollDerivative, sensorUpdateTime);
     rollController.limitOutput(true, -1, 1);
-    Controller yawController(yawProportional, yawIntegral, yawDerivative, sensorUpdateTime);
+    Controller& yawController = yawControllerStorage.construct(yawProportional, yawIntegral, yawDerivative, sensorUpdateTime);
     yawController.limitOutput(true, -1, 1);
 
-    math3d::Vector3<float> accReading, accAngle, gyroAngle, gyroAngleOut, angle, controllerOuttput;
+    math3d::Vector3<float> gyroRate, accReading, accAngle, gyroAngle, gyroAngleOut, angle, controllerOuttput;
+    math3d::Vector3<float> magField;
+    float heading = 0;
 
 #ifdef PWM_TEST
     // Enable interface clock on timer 1
@@ -176,9 +488,21 @@ int main(void)
 	// --- MODEL SETUP ---
 	Periphery::enable(Periphery::TIM1_P);
 	Periphery::enable(Periphery::GPIOE_P);
-	Pwm::configureTimer(TIM1, 50);
-
-	Model model;
+	if(escProtocol >= Engine::Dshot150)
+		Periphery::enable(Periphery::DMA1_P);
+	Engine::configureTimer(TIM1, escProtocol);
+
+	if(escProtocol != Engine::StandardPwm){
+		// Tail servo moves to its own 50 Hz timer
+		Periphery::enable(Periphery::TIM4_P);
+		Periphery::enable(Periphery::GPIOD_P);
+		Pwm::configureTimer(TIM4, 50);
+	}
+
+	Model& model = modelStorage.construct(escProtocol);
+	float trim;
+	if(configStore.read(ConfigStore::ServoTrim, trim))
+		model.tailTrim(trim);
 #endif
 
     // --- COMMUNICATION SETUP ---
@@ -187,6 +511,22 @@ int main(void)
 	Communicator comm(Communicator::UartSource);
 
 	// --- RC RECEIVER SETUP ---
+#if defined(RC_PPM)
+	Periphery::enable(Periphery::TIM3_P);
+	Periphery::enable(Periphery::GPIOC_P);
+	Periphery::enable(Periphery::DMA1_P);
+	RcReceiver::configureTimer(TIM3);
+	// TIM3 CH1 capture is served by DMA1 channel 6
+	PpmReceiver rc(TIM3, 1, DMA1_Channel6);
+	rc.connect(GPIOC, 6, 2);
+#elif defined(RC_SBUS)
+	Periphery::enable(Periphery::USART3_P);
+	Periphery::enable(Periphery::GPIOB_P);
+	Periphery::enable(Periphery::DMA1_P);
+	// USART3 RX is served by DMA1 channel 3
+	SbusReceiver rc(USART3, DMA1_Channel3);
+	rc.connect(GPIOB, 11, 7);
+#else
 	RcReceiver rc;
 	Periphery::enable(Periphery::TIM3_P);
 	Periphery::enable(Periphery::GPIOC_P);
@@ -196,6 +536,21 @@ int main(void)
 	rc.addChannel(2, TIM3, 3, GPIOC, 8, 2);
 	rc.addChannel(3, TIM3, 4, GPIOC, 9, 2);
 	Interrupt::enable(TIM3_IRQn, 3, 1);
+#endif
+
+	// --- RC INPUT SHAPING ---
+	RcShaper rcShapers[RcChannelN] = {RcShaper(RcShaper::Centered, sensorUpdateTime, rcFramePeriod),
+									  RcShaper(RcShaper::Centered, sensorUpdateTime, rcFramePeriod),
+									  RcShaper(RcShaper::Unipolar, sensorUpdateTime, rcFramePeriod),
+									  RcShaper(RcShaper::Centered, sensorUpdateTime, rcFramePeriod)};
+	rcShapers[RcPitch].rate(maxPitchAngle);
+	rcShapers[RcRoll].rate(maxRollAngle);
+	rcShapers[RcYaw].rate(maxYawAngularSpeed);
+	rcShapers[RcPitch].deadband(rcDeadband);
+	rcShapers[RcRoll].deadband(rcDeadband);
+	rcShapers[RcYaw].deadband(rcDeadband);
+	rcShapers[RcThrottle].deadband(rcThrottleDeadband);
+	loadShaping(rcShapers);
 
 	// --- LOOP TIME CONTROL ---
 	Stopwatch watch;
@@ -204,6 +559,29 @@ int main(void)
 	uint64_t totalSpareTime = 0;
 	int iter = 0;
 
+	// --- DEVICE BRING-UP ---
+	// Sensors settle, gyroscope is calibrated and ESCs arm at the same
+	// time, each in its own steps once per loop period
+	BringUp bringUp(gyro, acc, model, configStore);
+	while(1){
+		watch.restart();
+		if(bringUp.poll())
+			break;
+
+		elapsed = watch.elapsed(microsecond);
+		if(elapsed < sensorUpdateTime * microsecond)
+			sleep(sensorUpdateTime * microsecond - elapsed, microsecond);
+	}
+
+	// Gyroscope bias was measured again at this temperature, the stored
+	// table is rebuilt around it
+	thermalBias.load(configStore, ConfigStore::GyroThermalBias, gyro.correction().bias);
+
+#ifdef ATTITUDE_EKF
+	// Craft stands still after bring-up, tilt is taken from the accelerometer
+	ekf.reset(acc.readValue());
+#endif
+
 #ifdef ANGLE_TEST
 	accReading = acc.readValue();
 	accAngle = math3d::Vector3<float>(std::atan2(-accReading[0], std::sqrt(accReading[1] * accReading[1] + accReading[2] * accReading[2])),
@@ -212,101 +590,339 @@ int main(void)
 	gyroAngleOut = accAngle;
 #endif
 
+#ifdef PROFILER_ENABLED
+    Profiler::start();
+    IrqMonitor::reset();
+#endif
+
+    // Everything is allocated, loop must not touch the heap
+    MemoryMonitor::lockHeap();
+
+    // Throttle was up in the previous loop, long transfers wait for the ground
+    bool flying = false;
+    // Still periods learned since the thermal table was last saved
+    uint8_t thermalLearned = 0;
+    // Magnetometer correction refitted in flight, flash is written after landing
+    bool magSavePending = false;
+
     programState = ProgramRunning;
     while(programState == ProgramRunning){
         watch.restart();
 
         // Process incoming communication
-        Communicator::CommandId commandId;
-        while(!comm.empty())
         {
-        	if(comm.receive(commandId)){
-        		switch((CommandIds)commandId){
-        		case CommandIds::pitchProportional:{
-        			float pp;
-        			if(comm.receive(pp))
-        				pitchProportional = pp;
-        			break;}
-
-        		case CommandIds::pitchIntegral:{
-        			float pi;
-					if(comm.receive(pi))
-						pitchIntegral = pi;
-        			break;}
-
-        		case CommandIds::pitchDerivative:{
-        			float pd;
-					if(comm.receive(pd))
-						pitchDerivative = pd;
-        			break;}
-
-        		case CommandIds::rollProportional:{
-					float rp;
-					if(comm.receive(rp))
-						rollProportional = rp;
-					break;}
-
-				case CommandIds::rollIntegral:{
-					float ri;
-					if(comm.receive(ri))
-						rollIntegral = ri;
-					break;}
-
-				case CommandIds::rollDerivative:{
-					float rd;
-					if(comm.receive(rd))
-						rollDerivative = rd;
-					break;}
-				}
+        	PROFILE_SCOPE(Communication);
+        	Communicator::CommandId commandId;
+        	while(!comm.empty())
+        	{
+        		if(comm.receive(commandId)){
+        			switch((CommandIds)commandId){
+        			case CommandIds::pitchProportional:{
+        				float pp;
+        				if(comm.receive(pp))
+        					pitchProportional = pp;
+        				break;}
+
+        			case CommandIds::pitchIntegral:{
+        				float pi;
+						if(comm.receive(pi))
+							pitchIntegral = pi;
+        				break;}
+
+        			case CommandIds::pitchDerivative:{
+        				float pd;
+						if(comm.receive(pd))
+							pitchDerivative = pd;
+        				break;}
+
+        			case CommandIds::rollProportional:{
+						float rp;
+						if(comm.receive(rp))
+							rollProportional = rp;
+						break;}
+
+					case CommandIds::rollIntegral:{
+						float ri;
+						if(comm.receive(ri))
+							rollIntegral = ri;
+						break;}
+
+					case CommandIds::rollDerivative:{
+						float rd;
+						if(comm.receive(rd))
+							rollDerivative = rd;
+						break;}
+
+					case CommandIds::rcCalibration:{
+						uint32_t ch;
+						float min, center, max;
+						if(comm.receive(ch) && ch < RcChannelN && comm.receive(min) && comm.receive(center) && comm.receive(max))
+							rcShapers[ch].calibration(min, center, max);
+						break;}
+
+					case CommandIds::rcDeadband:{
+						uint32_t ch;
+						float db;
+						if(comm.receive(ch) && ch < RcChannelN && comm.receive(db))
+							rcShapers[ch].deadband(db);
+						break;}
+
+					case CommandIds::rcExpo:{
+						uint32_t ch;
+						float expo;
+						if(comm.receive(ch) && ch < RcChannelN && comm.receive(expo))
+							rcShapers[ch].expo(expo);
+						break;}
+
+					case CommandIds::rcRate:{
+						uint32_t ch;
+						float rate;
+						if(comm.receive(ch) && ch < RcChannelN && comm.receive(rate))
+							rcShapers[ch].rate(rate);
+						break;}
+
+					case CommandIds::blackboxStream:{
+						uint32_t enable;
+						if(comm.receive(enable))
+							blackboxStreaming = enable != 0;
+						break;}
+
+					case CommandIds::memoryReport:
+						sendMemoryReport(comm);
+						break;
+
+					case CommandIds::bringUpReport:
+						sendBringUp(comm, bringUp);
+						break;
+
+					case CommandIds::accCalibration:
+						accCalibration.reset();
+						accCalibrating = true;
+						break;
+
+					case CommandIds::calibrationReport:
+						sendCalibration(comm, gyro, acc, bringUp);
+						break;
+
+					case CommandIds::thermalReport:
+						sendThermal(comm, gyro, acc);
+						break;
+
+					case CommandIds::servoTrim:{
+						float trim;
+						if(comm.receive(trim))
+							model.tailTrim(trim);
+						break;}
+
+					case CommandIds::configSave:
+						comm.send((uint32_t)saveConfig(rcShapers, model));
+						break;
+
+					case CommandIds::configReport:
+						sendConfigReport(comm);
+						break;
+
+					case CommandIds::headingReport:
+						sendHeading(comm, mag, heading);
+						break;
+
+					case CommandIds::blackboxDump:
+						// Whole buffer from its oldest keyframe, empty packet ends it.
+						// It takes many loop periods, in flight only the end is sent.
+						if(!flying){
+							blackbox.rewind();
+							sendBlackbox(comm, Blackbox::BufferSize);
+						}
+						comm.send(Span<const char>());
+						break;
+
+#ifdef PROFILER_ENABLED
+					case CommandIds::profileDownload:
+						sendProfile(comm);
+						break;
+
+					case CommandIds::profileReset:
+						Profiler::reset();
+						IrqMonitor::reset();
+						break;
+
+					case CommandIds::irqStatsDownload:
+						sendIrqStats(comm);
+						break;
+#endif
+					}
+        		}
+        		else
+        			comm.discard();
         	}
-        	else
-        		comm.discard();
         }
 
         // Integrate gyroscope output
-        gyroAngle = gyro.readValue() * sensorUpdateTime;
+        {
+        	PROFILE_SCOPE(GyroRead);
+        	gyroRate = gyro.readValue();
+        	gyroRate = thermalBias.apply(gyroRate, gyro.temperature());
+        	gyroAngle = gyroRate * sensorUpdateTime;
+        }
 
         // TODO: ak by mala trikoptera naklon viac ako +-90 stupnov v roll a pitch, treba riesit
         // aliasing, prevadzat uhly do intervalu <0, 2*PI) a nejak osetrit gimbal lock. V tom pripade
         // by bolo mozno vyhodnejsie pouzit quaterniony a prevadzat uhly priamo do nich
         // TODO: prerobit triedy na uchovavanie stavu - zrychlenie
-        accReading = acc.readValue();
+        {
+        	PROFILE_SCOPE(AccelRead);
+        	accReading = acc.readValue();
+
+        	// Transform accelerometer reading into board space and calculate angles
+        	// Pitch (X rot), Roll (Y rot), Yaw (Z rot)
+        	accAngle = math3d::Vector3<float>(std::atan2(-accReading[0], std::sqrt(accReading[1] * accReading[1] + accReading[2] * accReading[2])),
+        									  -std::atan2(accReading[1], std::sqrt(accReading[0] * accReading[0] + accReading[2] * accReading[2])),
+        									  angle[2]);
+
+        	if(accCalibrating && accCalibration.add(accReading)){
+        		SensorCorrection correction = acc.correction();
+        		accCalibration.updateAccelerometer(correction);
+        		acc.correction(correction);
+        		Calibration::save(configStore, ConfigStore::AccCorrection, correction);
+        		accCalibrating = false;
+        	}
+        }
 
-        // Transform accelerometer reading into board space and calculate angles
-        // Pitch (X rot), Roll (Y rot), Yaw (Z rot)
-		accAngle = math3d::Vector3<float>(std::atan2(-accReading[0], std::sqrt(accReading[1] * accReading[1] + accReading[2] * accReading[2])),
-										  -std::atan2(accReading[1], std::sqrt(accReading[0] * accReading[0] + accReading[2] * accReading[2])),
-										  angle[2]);
+        // Magnetometer runs slower than the loop, calibration takes one
+        // small slice of its fit per loop
+        bool magUpdate;
+        {
+        	PROFILE_SCOPE(MagRead);
+        	magUpdate = mag.readValue(magField);
+        	if(magUpdate)
+        		magCalibration.add(mag.raw());
+
+        	if(magCalibration.poll()){
+        		SensorCorrection correction = mag.correction();
+        		magCalibration.update(correction);
+        		// Refits of the same field change little, flash is kept for real changes
+        		math3d::Vector3<float> change = correction.bias - mag.correction().bias;
+        		if(!headingValid || change.dotProduct(change) > 1e-4f){
+        			mag.correction(correction);
+        			magSavePending = true;
+        			headingAligned = false;
+        		}
+        		headingValid = true;
+        	}
 
-        // Combine angles from two sensors
-		// TODO: ak je velkost vektora accReading mimo rozumnych hodnot (okolo 1g), pouzi iba udaje z gyra?
-		angle = cmplFilter.addSample(accAngle, gyroAngle);
-		// Normalize Yaw angle
-		// TODO: should be normalized inside the filter too
-		angle[2] = normalizeAngle(angle[2]);
+        	// Page erase stalls the loop, correction stays in RAM while flying
+        	if(magSavePending && !flying){
+        		Calibration::save(configStore, ConfigStore::MagCorrection, mag.correction());
+        		magSavePending = false;
+        	}
+        }
+
+        // Combine angles from two sensors, accelerometer correction is
+        // weighted down while the craft accelerates. Yaw follows gyroscope
+        // alone between tilt compensated magnetometer headings.
+		{
+			PROFILE_SCOPE(Fusion);
+			float trust = accTrust.update(accReading);
+			bool headingUpdate = magUpdate && headingValid;
+			if(headingUpdate){
+				float magHeading = Magnetometer::heading(magField, angle[0], angle[1]);
+				if(!headingAligned){
+					headingOffset = magHeading - angle[2];
+					headingAligned = true;
+				}
+				heading = normalizeAngle(magHeading - headingOffset);
+			}
+
+#ifdef ATTITUDE_EKF
+			ekf.predict(gyroRate, sensorUpdateTime);
+			ekf.correct(accReading, trust);
+			if(headingUpdate)
+				ekf.correctHeading(heading, 1);
+			angle = ekf.angles();
+#else
+			math3d::Vector3<float> weight(trust, trust, 0);
+			if(headingUpdate){
+				float predicted = cmplFilter.readState()[2] + gyroAngle[2];
+				accAngle[2] = predicted + interpolateAngle(predicted, heading);
+				weight[2] = headingWeight;
+			}
+			angle = cmplFilter.addSample(accAngle, gyroAngle, weight);
+			// Normalize Yaw angle
+			// TODO: should be normalized inside the filter too
+			angle[2] = normalizeAngle(angle[2]);
+#endif
+		}
 
 		// --- Proven to be working to this place ---
 
-		// Get RC input
-		float rcPitch = 0;//(rc.normalizedReading(0) - 0.5) * 2 * maxPitchAngle;
-		float rcRoll = 0;//(rc.normalizedReading(1) - 0.5) * 2 * maxRollAngle;
-		float rcThrottle = rc.normalizedReading(2);
-		float rcYaw = 0;//(rc.normalizedReading(3) - 0.5) * 2 * maxYawAngularSpeed;
+		float rcThrottle, yawAngle;
+		{
+			PROFILE_SCOPE(Control);
+
+			// Get RC input, sticks are held neutral while signal is lost
+			rc.update();
+			bool rcLost = rc.pulseWidth(RcThrottle) == 0;
+			float rcInput[RcChannelN];
+			for(int i = 0; i < RcChannelN; i++)
+				rcInput[i] = rcShapers[i].process(rcLost ? rcShapers[i].neutral() : rc.normalizedReading(i));
+
+			float rcPitch = rcInput[RcPitch];
+			float rcRoll = rcInput[RcRoll];
+			float rcYaw = rcInput[RcYaw];
+			rcThrottle = rcInput[RcThrottle];
+
+			// Received rcYaw is representing angular speed so it needs to be integrated
+			yawAngle = normalizeAngle(yawController.setpoint() + rcYaw * sensorUpdateTime);
+
+			// Update setpoints for controllers based on RC input
+			pitchController.setpoint(rcPitch);
+			rollController.setpoint(rcRoll);
+			yawController.setpoint(yawAngle);
+
+			controllerOuttput = math3d::Vector3<float>(pitchController.process(angle[0]),
+													   rollController.process(angle[1]),
+													   yawController.process(angle[2], interpolateAngle));
+		}
 
-		// Received rcYaw is representing angular speed so it needs to be integrated
-		float yawAngle = normalizeAngle(yawController.setpoint() + rcYaw * sensorUpdateTime);
+		// Update model
+		{
+			PROFILE_SCOPE(Mixing);
+			model.update(rcThrottle, controllerOuttput);
+		}
 
-		// Update setpoints for controllers based on RC input
-		pitchController.setpoint(rcPitch);
-		rollController.setpoint(rcRoll);
-		yawController.setpoint(yawAngle);
+		// Throttle deadband makes a stick near minimum read exactly zero
+		flying = rcThrottle > 0;
 
-		controllerOuttput = math3d::Vector3<float>(pitchController.process(angle[0]),
-										   	   	   rollController.process(angle[1]),
-										   	   	   yawController.process(angle[2], interpolateAngle));
+		// Bias over temperature is learned while the craft stands on the ground
+		// and survives reboots, flash writes stay on the ground too
+		if(flying)
+			thermalBias.interrupt();
+		else if(thermalBias.observe(gyroRate, gyro.temperature()) && ++thermalLearned >= thermalSaveInterval){
+			thermalBias.save(configStore, ConfigStore::GyroThermalBias, gyro.correction().bias);
+			thermalLearned = 0;
+		}
 
-		// Update model
-		model.update(rcThrottle, controllerOuttput);
+		// Record loop into blackbox
+		{
+			PROFILE_SCOPE(Telemetry);
+			BlackboxFrame frame;
+			frame.time = (uint32_t)getSystemTime();
+			frame.gyro = gyroRate;
+			frame.acc = accReading;
+			frame.attitude = angle;
+			frame.setpoint = math3d::Vector3<float>(pitchController.setpoint(), rollController.setpoint(), yawController.setpoint());
+			frame.proportional = math3d::Vector3<float>(pitchController.proportionalTerm(), rollController.proportionalTerm(), yawController.proportionalTerm());
+			frame.integral = math3d::Vector3<float>(pitchController.integralTerm(), rollController.integralTerm(), yawController.integralTerm());
+			frame.derivative = math3d::Vector3<float>(pitchController.derivativeTerm(), rollController.derivativeTerm(), yawController.derivativeTerm());
+			frame.throttle = rcThrottle;
+			for(uint8_t i = 0; i < 3; i++)
+				frame.motors[i] = model.throttle(i);
+			frame.servo = model.tailAngle();
+			blackbox.record(frame);
+
+			if(blackboxStreaming)
+				sendBlackbox(comm, blackboxStreamChunk);
+		}
 
 #ifdef PWM_TEST
 		a.dutyCycle(dc);
@@ -318,20 +934,26 @@ int main(void)
 #endif
 
 #ifdef ANGLE_TEST
-		gyroAngleOut += gyroAngle;
-		char buf[200];
-		std::sprintf(buf, "%f,%f,%f\r\n", math3d::Degrees(gyroAngleOut[1]),
-										  math3d::Degrees(accAngle[1]),
-										  math3d::Degrees(angle[1]));
-		comm.sendRaw(std::string(buf));
+		{
+			PROFILE_SCOPE(Debug);
+			gyroAngleOut += gyroAngle;
+			char buf[200];
+			std::sprintf(buf, "%f,%f,%f\r\n", math3d::Degrees(gyroAngleOut[1]),
+											  math3d::Degrees(accAngle[1]),
+											  math3d::Degrees(angle[1]));
+			comm.sendRaw(buf);
+		}
 #endif
 
 #ifdef CTRL_TEST
-		char buf[200];
-		std::sprintf(buf, "%f,%f,%f\r\n", math3d::Degrees(angle[2]),
-										  math3d::Degrees(yawAngle),
-										  controllerOuttput[2]);
-		comm.sendRaw(std::string(buf));
+		{
+			PROFILE_SCOPE(Debug);
+			char buf[200];
+			std::sprintf(buf, "%f,%f,%f\r\n", math3d::Degrees(angle[2]),
+											  math3d::Degrees(yawAngle),
+											  controllerOuttput[2]);
+			comm.sendRaw(buf);
+		}
 #endif
 
 		elapsed = watch.elapsed(microsecond);
@@ -0,0 +1,153 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "memoryMonitor.h"
+
+#include <malloc.h>
+#include <cstdlib>
+#include <new>
+
+#include <stm32f30x.h>
+
+// Provided by the linker script
+extern "C" char _sdata, _ebss, _estack;
+extern "C" char _sccmram, _eccmram, _sccmbss, _eccmbss, _eccm;
+
+static const uint32_t stackPattern = 0xC5C5C5C5;
+// Room left for heap growth by the C library and for the painting itself
+static const uint32_t heapReserve = 512;
+static const uint32_t stackReserve = 64;
+
+static bool locked = false;
+static uint32_t allocationCount = 0;
+static uint32_t lockedAllocationCount = 0;
+static uint32_t* stackBottom = nullptr;
+
+static void* allocate(size_t size)
+{
+	allocationCount++;
+	if(locked){
+		lockedAllocationCount++;
+#ifdef HEAP_FREE
+		// Allocation after initialization, see call stack in debugger
+		while(1);
+#endif
+	}
+
+	void* p = std::malloc(size ? size : 1);
+	// Exceptions are not used, running out of memory is fatal
+	while(p == nullptr);
+	return p;
+}
+
+void* operator new(size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+	return allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void MemoryMonitor::lockHeap()
+{
+	locked = true;
+
+	// Heap starts right after .bss
+	uint32_t heapTop = (uint32_t)&_ebss + mallinfo().arena + heapReserve;
+	stackBottom = (uint32_t*)((heapTop + 3) & ~3u);
+	uint32_t* stackTop = (uint32_t*)(__get_MSP() - stackReserve);
+
+	for(uint32_t* p = stackBottom; p < stackTop; p++)
+		*p = stackPattern;
+}
+
+bool MemoryMonitor::heapLocked()
+{
+	return locked;
+}
+
+uint32_t MemoryMonitor::staticSize()
+{
+	return &_ebss - &_sdata;
+}
+
+uint32_t MemoryMonitor::heapPeak()
+{
+	return mallinfo().arena;
+}
+
+uint32_t MemoryMonitor::stackPeak()
+{
+	if(stackBottom == nullptr)
+		return 0;
+
+	uint32_t* p = stackBottom;
+	while(p < (uint32_t*)&_estack && *p == stackPattern)
+		p++;
+	return (uint32_t)&_estack - (uint32_t)p;
+}
+
+uint32_t MemoryMonitor::ramPeak()
+{
+	return staticSize() + heapPeak() + stackPeak();
+}
+
+uint32_t MemoryMonitor::ramSize()
+{
+	return &_estack - &_sdata;
+}
+
+uint32_t MemoryMonitor::ccmStaticSize()
+{
+	return (&_eccmram - &_sccmram) + (&_eccmbss - &_sccmbss);
+}
+
+uint32_t MemoryMonitor::ccmSize()
+{
+	// .ccmram starts the region
+	return &_eccm - &_sccmram;
+}
+
+uint32_t MemoryMonitor::allocations()
+{
+	return allocationCount;
+}
+
+uint32_t MemoryMonitor::lockedAllocations()
+{
+	return lockedAllocationCount;
+}
@@ -0,0 +1,125 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "mixer.h"
+#include "common.h"
+#include "ccm.h"
+
+#include <cmath>
+
+Mixer::Mixer(const float positions[][2], uint8_t motorN, float authority) :
+_motorN(min(motorN, MaxMotors)),
+_authority(authority)
+{
+	// Effectiveness matrix rows: collective, torque around X (pitch), torque around Y (roll).
+	// Thrust of motor i gives torque y_i around X and -x_i around Y.
+	float effect[3][MaxMotors];
+	for(uint8_t i = 0; i < _motorN; i++){
+		effect[0][i] = 1;
+		effect[1][i] = positions[i][1];
+		effect[2][i] = -positions[i][0];
+	}
+
+	// Mixing table is pseudo-inverse E^T * (E * E^T)^-1
+	float square[3][3];
+	for(int r = 0; r < 3; r++)
+		for(int c = 0; c < 3; c++){
+			square[r][c] = 0;
+			for(uint8_t i = 0; i < _motorN; i++)
+				square[r][c] += effect[r][i] * effect[c][i];
+		}
+
+	float inverse[3][3];
+	float determinant = square[0][0] * (square[1][1] * square[2][2] - square[1][2] * square[2][1]) -
+						square[0][1] * (square[1][0] * square[2][2] - square[1][2] * square[2][0]) +
+						square[0][2] * (square[1][0] * square[2][1] - square[1][1] * square[2][0]);
+	for(int r = 0; r < 3; r++)
+		for(int c = 0; c < 3; c++){
+			// Cofactor of transposed element divided by determinant
+			int r1 = (c + 1) % 3, r2 = (c + 2) % 3;
+			int c1 = (r + 1) % 3, c2 = (r + 2) % 3;
+			inverse[r][c] = (square[r1][c1] * square[r2][c2] - square[r1][c2] * square[r2][c1]) / determinant;
+		}
+
+	// Keep pitch and roll columns and normalize each to unit peak,
+	// collective column is replaced by throttle itself
+	float pitchPeak = 0, rollPeak = 0;
+	for(uint8_t i = 0; i < _motorN; i++){
+		_pitch[i] = _roll[i] = 0;
+		for(int k = 0; k < 3; k++){
+			_pitch[i] += effect[k][i] * inverse[k][1];
+			_roll[i] += effect[k][i] * inverse[k][2];
+		}
+		pitchPeak = max(pitchPeak, std::fabs(_pitch[i]));
+		rollPeak = max(rollPeak, std::fabs(_roll[i]));
+	}
+
+	for(uint8_t i = 0; i < _motorN; i++){
+		_pitch[i] = pitchPeak > 0 ? _pitch[i] / pitchPeak : 0;
+		_roll[i] = rollPeak > 0 ? _roll[i] / rollPeak : 0;
+	}
+}
+
+CCM_CODE void Mixer::mix(float throttle, float pitch, float roll, float* outputs) const
+{
+	float scale = throttle * _authority;
+	float low = 0, high = 0;
+
+	for(uint8_t i = 0; i < _motorN; i++){
+		outputs[i] = (pitch * _pitch[i] + roll * _roll[i]) * scale;
+		low = min(low, outputs[i]);
+		high = max(high, outputs[i]);
+	}
+
+	// Attitude spread larger than whole range can't be achieved, shrink it
+	float spread = high - low;
+	if(spread > 1.0f){
+		float shrink = 1.0f / spread;
+		low *= shrink;
+		high *= shrink;
+		for(uint8_t i = 0; i < _motorN; i++)
+			outputs[i] *= shrink;
+	}
+
+	// Sacrifice collective throttle so the whole attitude part fits
+	float collective = limit(throttle, -low, 1.0f - high);
+	for(uint8_t i = 0; i < _motorN; i++)
+		outputs[i] = limit(outputs[i] + collective, 0.0f, 1.0f);
+}
+
+uint8_t Mixer::motorN() const
+{
+	return _motorN;
+}
+
+float Mixer::authority() const
+{
+	return _authority;
+}
+
+void Mixer::authority(float authority)
+{
+	_authority = authority;
+}
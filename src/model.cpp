@@ -26,72 +26,108 @@
 #include "model.h"
 #include "periphery.h"
 #include "common.h"
+#include "actuatorTables.h"
+#include "ccm.h"
 
 #include <stm32f30x_rcc.h>
 #include "math3d.h"
 
 #include <cmath>
 
-#define ROBBE_FS_500_MIN_PW 0.9e-3
-#define ROBBE_FS_500_MAX_PW	2.1e-3
+// Default fraction of throttle used for maneuvering purposes in one axis
+#define DEFAULT_MANEUVER_FRACTION	0.25f
 
-// Fraction of throttle can be used for maneuvering purposes in one axis
-static float maneuverFraction = 0.25;
+// Angle between front arms and forward direction, see doc/layout.pdf
+#define FRONT_ARM_ANGLE				(math3d::Pi / 3)
 
-Model::Model() :
-engines{Engine(TIM1, 1),
-	    Engine(TIM1, 2),
-	    Engine(TIM1, 3)},
-servo(TIM1, 4, ROBBE_FS_500_MIN_PW, ROBBE_FS_500_MAX_PW)
+// Motor positions [x, y] for unit arm length, same order as Engines
+static const float enginePositions[][2] = {
+	{0.0f, -1.0f},
+	{(float)std::sin(FRONT_ARM_ANGLE), (float)std::cos(FRONT_ARM_ANGLE)},
+	{(float)-std::sin(FRONT_ARM_ANGLE), (float)std::cos(FRONT_ARM_ANGLE)}
+};
+
+// Calibrated thrust and tail tilt (ROBBE FS 500 servo), see calibration/
+static const ActuatorTable engineTable(engineThrustTicks, sizeof(engineThrustTicks) / sizeof(engineThrustTicks[0]));
+static const ActuatorTable servoTable(servoAngleTicks, sizeof(servoAngleTicks) / sizeof(servoAngleTicks[0]));
+
+Model::Model(Engine::Protocol protocol) :
+protocol(protocol),
+engines{Engine(TIM1, 1, &engineTable, protocol),
+	    Engine(TIM1, 2, &engineTable, protocol),
+	    Engine(TIM1, 3, &engineTable, protocol)},
+// Servo needs 50 Hz pwm, it can share the timer only with standard pwm engines
+servo(protocol == Engine::StandardPwm ? TIM1 : TIM4, protocol == Engine::StandardPwm ? 4 : 1, &servoTable),
+mixer(enginePositions, EngineN, DEFAULT_MANEUVER_FRACTION),
+trim(0)
 {
-	engines[Rear].throttle(1.);
-	engines[Right].throttle(.5);
-	engines[Left].throttle(0);
+	// Motors stay stopped until the first update, one pulse and DShot
+	// outputs send whatever is set on the first trigger
+	for(int i = 0; i < EngineN; i++)
+		engines[i].throttle(0);
 	servo.normalizedAngle(0);
 
     // Connect PWM outputs for engines to pins
     engines[Rear].connect(GPIOE, 9, 2);
     engines[Right].connect(GPIOE, 11, 2);
     engines[Left].connect(GPIOE, 13, 2);
-    servo.connect(GPIOE, 14, 2);
+    if(protocol == Engine::StandardPwm)
+    	servo.connect(GPIOE, 14, 2);
+    else
+    	servo.connect(GPIOD, 12, 2);
+
+    Engine::trigger(TIM1, protocol);
 }
 
-void Model::update(float throttle, math3d::Vector3<float> rotation)
+CCM_CODE void Model::update(float throttle, math3d::Vector3<float> rotation)
 {
-	float rearAdjustment, rightAdjustment, leftAdjustment;
-
-	// Initialize adjustments values
-	rearAdjustment = rightAdjustment = leftAdjustment = 0.0f;
+	float outputs[EngineN];
 
-	// Adjust for each engine, based on mathematical model and specified rotation
 	// Rotation is in range <-1, 1>
-	if(rotation[0] > 0.0f)
-	{
-		rearAdjustment += rotation[0];
-	}
-	else if(rotation[0] < 0.0f)
-	{
-		rightAdjustment -= rotation[0];
-		leftAdjustment -= rotation[0];
-	}
-
-	if(rotation[1] > 0.0f)
-	{
-		rearAdjustment += rotation[1] * 0.5f;
-		rightAdjustment += rotation[1];
-	}
-	else if(rotation[1] < 0.0f)
-	{
-		rearAdjustment -= rotation[1] * 0.5f;
-		leftAdjustment -= rotation[1];
-	}
-
-	// Apply adjustments to engine throttle, limit to allowed range and change it
-	engines[Rear].throttle(limit(throttle * (1 - maneuverFraction * rearAdjustment), 0.0f, 1.0f));
-	engines[Right].throttle(limit(throttle * (1 - maneuverFraction * rightAdjustment), 0.0f, 1.0f));
-	engines[Left].throttle(limit(throttle * (1 - maneuverFraction * leftAdjustment), 0.0f, 1.0f));
-
-	// Servo is controlled directly as there is no math behind yaw mechanism
+	mixer.mix(throttle, rotation[0], rotation[1], outputs);
+
+	// Engines and servo share TIM1 with standard pwm, all of them are
+	// latched by the same update event
+	Pwm::beginFrame(TIM1);
+
+	for(int i = 0; i < EngineN; i++)
+		engines[i].throttle(outputs[i]);
+
+	// Servo is controlled directly as there is no math behind yaw mechanism,
+	// its normalized angle is in range <0, 1>
 	// TODO: fix by negating if servo "polarity" is different
-	servo.normalizedAngle(rotation[2]);
+	servo.normalizedAngle((rotation[2] + 1) * 0.5f + trim);
+
+	Pwm::commitFrame(TIM1);
+	Engine::trigger(TIM1, protocol);
+}
+
+float Model::maneuverFraction()
+{
+	return mixer.authority();
+}
+
+void Model::maneuverFraction(float fraction)
+{
+	mixer.authority(fraction);
+}
+
+float Model::tailTrim()
+{
+	return trim;
+}
+
+void Model::tailTrim(float trim)
+{
+	this->trim = trim;
+}
+
+float Model::throttle(uint8_t engine)
+{
+	return engine < EngineN ? engines[engine].throttle() : 0;
+}
+
+float Model::tailAngle()
+{
+	return servo.normalizedAngle();
 }
@@ -0,0 +1,106 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "ppmDecoder.h"
+
+// Accepted channel pulse range and minimal sync gap in seconds
+static const float minChannelWidth = 0.75e-3;
+static const float maxChannelWidth = 2.25e-3;
+static const float minSyncWidth = 2.7e-3;
+
+PpmDecoder::PpmDecoder(uint32_t tickFrequency) :
+_minTicks(minChannelWidth * tickFrequency),
+_maxTicks(maxChannelWidth * tickFrequency),
+_syncTicks(minSyncWidth * tickFrequency),
+_lastCapture(0),
+_hasCapture(false),
+_synced(false),
+_count(0),
+_pending{},
+_channelN(0),
+_channels{},
+_frames(0),
+_errors(0)
+{
+}
+
+bool PpmDecoder::push(uint16_t capture)
+{
+	// Unsigned 16 bit difference handles timer overflow
+	uint16_t interval = capture - _lastCapture;
+	_lastCapture = capture;
+
+	if(!_hasCapture){
+		_hasCapture = true;
+		return false;
+	}
+
+	if(interval >= _syncTicks){
+		bool complete = _synced && _count >= MinChannels;
+		if(complete){
+			for(uint8_t i = 0; i < _count; i++)
+				_channels[i] = _pending[i];
+			_channelN = _count;
+			_frames++;
+		}
+
+		_synced = true;
+		_count = 0;
+		return complete;
+	}
+
+	if(!_synced)
+		return false;
+
+	if(interval >= _minTicks && interval <= _maxTicks && _count < MaxChannels)
+		_pending[_count++] = interval;
+	else{
+		// Glitch or missed edge, drop the frame and wait for next sync
+		_errors++;
+		_synced = false;
+	}
+
+	return false;
+}
+
+uint8_t PpmDecoder::channelN() const
+{
+	return _channelN;
+}
+
+uint16_t PpmDecoder::channel(uint8_t channel) const
+{
+	return channel < _channelN ? _channels[channel] : 0;
+}
+
+uint32_t PpmDecoder::frames() const
+{
+	return _frames;
+}
+
+uint32_t PpmDecoder::errors() const
+{
+	return _errors;
+}
@@ -0,0 +1,106 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "profiler.h"
+
+#ifdef SIMULATION
+#include <chrono>
+#else
+#include <stm32f30x.h>
+#endif
+
+static Profiler::Stats stageStats[Profiler::StageN];
+
+static const char* stageNames[Profiler::StageN] = {
+	"communication", "gyro", "accel", "mag", "fusion", "control", "mixing", "telemetry", "debug"
+};
+
+void Profiler::start()
+{
+#ifndef SIMULATION
+	// Cycle counter is part of trace unit
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+	reset();
+}
+
+void Profiler::reset()
+{
+	for(uint8_t i = 0; i < StageN; i++){
+		stageStats[i] = Stats();
+		stageStats[i].min = 0xFFFFFFFF;
+	}
+}
+
+uint32_t Profiler::now()
+{
+#ifdef SIMULATION
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+	return DWT->CYCCNT;
+#endif
+}
+
+void Profiler::record(Stage stage, uint32_t cycles)
+{
+	Stats& stats = stageStats[stage];
+	stats.count++;
+	stats.total += cycles;
+	if(cycles < stats.min)
+		stats.min = cycles;
+	if(cycles > stats.max)
+		stats.max = cycles;
+
+	uint8_t bucket = cycles == 0 ? 0 : 31 - __builtin_clz(cycles);
+	stats.histogram[bucket]++;
+}
+
+const Profiler::Stats& Profiler::stats(Stage stage)
+{
+	return stageStats[stage];
+}
+
+uint32_t Profiler::mean(Stage stage)
+{
+	const Stats& stats = stageStats[stage];
+	return stats.count > 0 ? stats.total / stats.count : 0;
+}
+
+const char* Profiler::name(Stage stage)
+{
+	return stageNames[stage];
+}
+
+uint32_t Profiler::frequency()
+{
+#ifdef SIMULATION
+	return 1000000000;
+#else
+	return SystemCoreClock;
+#endif
+}
@@ -30,15 +30,15 @@
 // 2MHz Base frequency of the pwm timer
 const uint32_t pwmTimerFrequency = 2e6;
 
-Pwm::Pwm(TIM_TypeDef* timer, uint8_t channel) :
+Pwm::Pwm(TIM_TypeDef* timer, uint8_t channel, Alignment alignment) :
 _timer(timer),
 _channel(channel),
-_dutyCycle(0)
+_compare(0)
 {
 	TIM_OCInitTypeDef channelConfig;
 	TIM_OCStructInit(&channelConfig);
 
-	channelConfig.TIM_OCMode = TIM_OCMode_PWM1;
+	channelConfig.TIM_OCMode = alignment == LeadingEdge ? TIM_OCMode_PWM1 : TIM_OCMode_PWM2;
 	channelConfig.TIM_OutputState = TIM_OutputState_Enable;
 	channelConfig.TIM_Pulse = 0;
 	channelConfig.TIM_OCPolarity = TIM_OCPolarity_High; // Pulse polarity
@@ -66,15 +66,36 @@ _dutyCycle(0)
 
 float Pwm::dutyCycle()
 {
-	return _dutyCycle;
+	return _compare / (float)(_timer->ARR + 1);
 }
 
 void Pwm::dutyCycle(float dc)
 {
-	_dutyCycle = dc;
 	// TODO: create timer class -> period() will return (_timer->ARR + 1)
 	// pwmConfig() instead Pwm::configureTimer..
-	uint32_t ticks = (_timer->ARR + 1) * _dutyCycle;
+	compare((_timer->ARR + 1) * dc);
+}
+
+float Pwm::pulseWidth()
+{
+	return _compare / (float)pwmTimerFrequency;
+}
+
+void Pwm::pulseWidth(float pulseWidth)
+{
+	// Pwm timer runs at fixed frequency, so the pulse width maps to ticks
+	// without regard to the pwm period
+	compare(pulseTicks(pulseWidth));
+}
+
+uint32_t Pwm::compare()
+{
+	return _compare;
+}
+
+void Pwm::compare(uint32_t ticks)
+{
+	_compare = ticks;
 
 	switch(_channel)
 	{
@@ -93,17 +114,20 @@ void Pwm::dutyCycle(float dc)
 	}
 }
 
-float Pwm::pulseWidth()
+float Pwm::pulseTicks(float pulseWidth)
 {
-	return ((_dutyCycle * (_timer->ARR + 1)) / (float)pwmTimerFrequency);
+	return pulseWidth * pwmTimerFrequency;
 }
 
-void Pwm::pulseWidth(float pulseWidth)
+void Pwm::beginFrame(TIM_TypeDef* timer)
+{
+	// Preloaded compare registers are not transferred while updates are disabled
+	TIM_UpdateDisableConfig(timer, ENABLE);
+}
+
+void Pwm::commitFrame(TIM_TypeDef* timer)
 {
-	// Set dutyCycle to equivalent of pulseWidth
-	// First determine number of pwmTimer ticks in pulseWidth
-	// and then divide by pwmTimer ticks in one pwm period
-	dutyCycle((pwmTimerFrequency * pulseWidth) / (float)(_timer->ARR + 1));
+	TIM_UpdateDisableConfig(timer, DISABLE);
 }
 
 void Pwm::connect(GPIO_TypeDef* port, uint16_t pin, uint8_t altFunction)
@@ -0,0 +1,169 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "rcShaper.h"
+#include "common.h"
+
+#include <cmath>
+
+RcShaper::RcShaper(Mode mode, float loopPeriod, float framePeriod) :
+_mode(mode),
+_loopPeriod(loopPeriod),
+_framePeriod(framePeriod),
+_min(0),
+_center(0.5f),
+_max(1),
+_deadband(0),
+_expo(0),
+_rate(1),
+_curve{},
+_lastReading(-1),
+_target(0),
+_step(0),
+_output(0)
+{
+	updateCurve();
+}
+
+void RcShaper::calibration(float min, float center, float max)
+{
+	_min = min;
+	_center = center;
+	_max = max;
+}
+
+void RcShaper::deadband(float deadband)
+{
+	_deadband = limit(deadband, 0.0f, 0.99f);
+}
+
+void RcShaper::expo(float expo)
+{
+	_expo = limit(expo, 0, 1);
+	updateCurve();
+}
+
+void RcShaper::rate(float rate)
+{
+	_rate = rate;
+}
+
+void RcShaper::framePeriod(float framePeriod)
+{
+	_framePeriod = framePeriod;
+}
+
+float RcShaper::minimum()
+{
+	return _min;
+}
+
+float RcShaper::center()
+{
+	return _center;
+}
+
+float RcShaper::maximum()
+{
+	return _max;
+}
+
+float RcShaper::deadband()
+{
+	return _deadband;
+}
+
+float RcShaper::expo()
+{
+	return _expo;
+}
+
+float RcShaper::rate()
+{
+	return _rate;
+}
+
+float RcShaper::neutral()
+{
+	return _mode == Centered ? _center : _min;
+}
+
+float RcShaper::process(float reading)
+{
+	// New RC frame, ramp from current output to its value within one frame period
+	if(reading != _lastReading){
+		_lastReading = reading;
+		_target = shape(reading);
+		_step = _framePeriod > _loopPeriod ? (_target - _output) * _loopPeriod / _framePeriod : _target - _output;
+	}
+
+	_output += _step;
+	if((_step >= 0 && _output >= _target) || (_step <= 0 && _output <= _target)){
+		_output = _target;
+		_step = 0;
+	}
+
+	return _output;
+}
+
+float RcShaper::shape(float reading)
+{
+	float stick;
+	if(_mode == Centered){
+		if(reading >= _center)
+			stick = _max > _center ? (reading - _center) / (_max - _center) : 0;
+		else
+			stick = _center > _min ? (reading - _center) / (_center - _min) : 0;
+		stick = limit(stick, -1, 1);
+	}
+	else
+		stick = limit(_max > _min ? (reading - _min) / (_max - _min) : 0, 0, 1);
+
+	// Deadband is removed from the travel, so output stays continuous
+	float magnitude = std::fabs(stick);
+	magnitude = magnitude > _deadband ? (magnitude - _deadband) / (1 - _deadband) : 0;
+
+	float shaped = curve(magnitude) * _rate;
+	return stick < 0 ? -shaped : shaped;
+}
+
+void RcShaper::updateCurve()
+{
+	for(uint8_t i = 0; i < CurvePoints; i++){
+		float x = i / (float)(CurvePoints - 1);
+		_curve[i] = x * (1 - _expo) + x * x * x * _expo;
+	}
+}
+
+float RcShaper::curve(float stick)
+{
+	float position = stick * (CurvePoints - 1);
+	uint8_t index = position;
+	if(index >= CurvePoints - 1)
+		return _curve[CurvePoints - 1];
+
+	float fraction = position - index;
+	return _curve[index] + (_curve[index + 1] - _curve[index]) * fraction;
+}
@@ -27,6 +27,11 @@
 
 #include "systime.h"
 #include "common.h"
+#include "irqMonitor.h"
+#include "irqDispatch.h"
+#include "ccm.h"
+
+#include <new>
 
 // Maximum expected pulse width is 2 milliseconds
 // with 2MHz capture timer, 1 tick is 0.5 microseconds
@@ -47,8 +52,7 @@ static const float minPulseWidth = 1e-3;
 
 static const float maxPulseWidth = 2e-3;
 
-uint64_t channelTimeStamps[CHANNEL_N] = {0};
-uint32_t channelCaptures[CHANNEL_N] = {0};
+SeqLock<RcFrame> channelFrame;
 uint16_t channelStarts[CHANNEL_N] = {0};
 uint8_t channelContinuous[CHANNEL_N] = {0};
 uint16_t channelFlags = 0;
@@ -75,6 +79,8 @@ _timerChannel(timerChannel)
 		timChannel = TIM_Channel_4;
 		timInterrupt = TIM_IT_CC4;
 		break;
+	default:
+		return;
 	}
 
 	TIM_ICInitTypeDef TIM_ICInitStructure;
@@ -101,6 +107,7 @@ RcChannel::~RcChannel()
 	case 2: timInterrupt = TIM_IT_CC2; break;
 	case 3:	timInterrupt = TIM_IT_CC3; break;
 	case 4:	timInterrupt = TIM_IT_CC4; break;
+	default: return;
 	}
 	TIM_ITConfig(_timer, timInterrupt, DISABLE);
 	TIM_ClearITPendingBit(_timer, timInterrupt);
@@ -123,7 +130,9 @@ void RcChannel::connect(GPIO_TypeDef* port, uint16_t pin, uint8_t altFunction)
 	GPIO_PinAFConfig (port, pin, altFunction);
 }
 
-RcReceiver::RcReceiver()
+RcReceiver::RcReceiver() :
+_frame(),
+_frameTime(0)
 {
 	for(int i = 0; i < CHANNEL_N; i++)
 		_channels[i] = nullptr;
@@ -131,10 +140,8 @@ RcReceiver::RcReceiver()
 
 RcReceiver::~RcReceiver()
 {
-	for(int i = 0; i < CHANNEL_N; i++){
-		delete _channels[i];
-		_channels[i] = nullptr;
-	}
+	for(int i = 0; i < CHANNEL_N; i++)
+		removeChannel(i);
 }
 
 void RcReceiver::addChannel(uint8_t channel, TIM_TypeDef* timer, uint8_t timerChannel, GPIO_TypeDef* port, uint16_t pin, uint8_t altFunction)
@@ -142,11 +149,14 @@ void RcReceiver::addChannel(uint8_t channel, TIM_TypeDef* timer, uint8_t timerCh
 	if(channel >= CHANNEL_N || _channels[channel] != nullptr)
 		return;
 
-	_channels[channel] = new RcChannel(timer, timerChannel);
+	_channels[channel] = new(_channelStorage[channel]) RcChannel(timer, timerChannel);
 	_channels[channel]->connect(port, pin, altFunction);
 
-	channelTimeStamps[channel] = getSystemTime();
-	channelCaptures[channel] = 0;
+	RcFrame& frame = channelFrame.beginWrite();
+	frame.timeStamps[channel] = getSystemTime();
+	frame.captures[channel] = 0;
+	channelFrame.endWrite();
+
 	channelStarts[channel] = 0;
 	channelContinuous[channel] = 0;
 	channelFlags &= ~(1 << channel);
@@ -154,23 +164,23 @@ void RcReceiver::addChannel(uint8_t channel, TIM_TypeDef* timer, uint8_t timerCh
 
 void RcReceiver::removeChannel(uint8_t channel)
 {
-	if(channel >= CHANNEL_N && _channels[channel] != nullptr)
+	if(channel >= CHANNEL_N || _channels[channel] == nullptr)
 		return;
 
-	delete _channels[channel];
+	_channels[channel]->~RcChannel();
 	_channels[channel] = nullptr;
 }
 
 float RcReceiver::pulseWidth(uint8_t channel)
 {
-	if(channel >= CHANNEL_N && _channels[channel] != nullptr)
+	if(channel >= CHANNEL_N || _channels[channel] == nullptr)
 		return 0;
 
 	// If signal was lost, return zero pulse width
-	if(getSystemTime() - channelTimeStamps[channel] > maxTimeDifference)
+	if(_frameTime - _frame.timeStamps[channel] > maxTimeDifference)
 		return 0;
 
-	return ((float)channelCaptures[channel]) / captureTimerFrequency;
+	return ((float)_frame.captures[channel]) / captureTimerFrequency;
 }
 
 float RcReceiver::normalizedReading(uint8_t channel)
@@ -180,6 +190,17 @@ float RcReceiver::normalizedReading(uint8_t channel)
 	return limit((pw - minPulseWidth) / (maxPulseWidth - minPulseWidth), 0, 1);
 }
 
+void RcReceiver::update()
+{
+	_frameTime = getSystemTime();
+	_frame = channelFrame.read();
+}
+
+uint64_t RcReceiver::frameAge()
+{
+	return _frameTime - _frame.time;
+}
+
 void RcReceiver::configureTimer(TIM_TypeDef* timer)
 {
 	TIM_DeInit(timer);
@@ -201,7 +222,7 @@ void RcReceiver::configureTimer(TIM_TypeDef* timer)
 	TIM_Cmd(timer, ENABLE);
 }
 
-void RcReceiver::handleInterrupt(uint8_t channel, TIM_TypeDef* timer, uint8_t timerChannel)
+CCM_CODE void RcReceiver::handleInterrupt(uint8_t channel, TIM_TypeDef* timer, uint8_t timerChannel)
 {
 	uint16_t capture;
 	switch(timerChannel)
@@ -230,17 +251,22 @@ void RcReceiver::handleInterrupt(uint8_t channel, TIM_TypeDef* timer, uint8_t ti
 		// pulse start (pulse can't be wider than 4ms, if it is, we are measuring
 		// idle part of pulse).
 		if(width < maxCaptureTicks){
+			uint64_t now = getSystemTime();
+			RcFrame& frame = channelFrame.beginWrite();
 
-			if(getSystemTime() - channelTimeStamps[channel] < maxTimeDifference){
+			if(now - frame.timeStamps[channel] < maxTimeDifference){
 				if(channelContinuous[channel] > minContinuousSamples)
-					channelCaptures[channel] = width;
+					frame.captures[channel] = width;
 				else
 					channelContinuous[channel]++;
 			}
 			else
 				channelContinuous[channel] = 0;
 
-			channelTimeStamps[channel] = getSystemTime();
+			frame.timeStamps[channel] = now;
+			frame.time = now;
+			channelFrame.endWrite();
+
 			channelFlags ^= 1 << channel;
 		}
 		else
@@ -248,27 +274,192 @@ void RcReceiver::handleInterrupt(uint8_t channel, TIM_TypeDef* timer, uint8_t ti
 	}
 }
 
-// Interrupt handlers
-void TIM3_IRQHandler(void)
+static void configureRxDma(DMA_Channel_TypeDef* dma, uintptr_t source, void* buffer, uint16_t size, bool halfWord)
 {
-	if(TIM_GetITStatus(TIM3, TIM_IT_CC1)){
-		TIM_ClearITPendingBit(TIM3, TIM_IT_CC1);
-		RcReceiver::handleInterrupt(0, TIM3, 1);
-	}
+	DMA_InitTypeDef dmaConfig;
+	DMA_StructInit(&dmaConfig);
+	dmaConfig.DMA_PeripheralBaseAddr = source;
+	dmaConfig.DMA_MemoryBaseAddr = (uintptr_t)buffer;
+	dmaConfig.DMA_DIR = DMA_DIR_PeripheralSRC;
+	dmaConfig.DMA_BufferSize = size;
+	dmaConfig.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	dmaConfig.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	dmaConfig.DMA_PeripheralDataSize = halfWord ? DMA_PeripheralDataSize_HalfWord : DMA_PeripheralDataSize_Byte;
+	dmaConfig.DMA_MemoryDataSize = halfWord ? DMA_MemoryDataSize_HalfWord : DMA_MemoryDataSize_Byte;
+	dmaConfig.DMA_Mode = DMA_Mode_Circular;
+	dmaConfig.DMA_Priority = DMA_Priority_Medium;
+	dmaConfig.DMA_M2M = DMA_M2M_Disable;
+	DMA_DeInit(dma);
+	DMA_Init(dma, &dmaConfig);
+	DMA_Cmd(dma, ENABLE);
+}
 
-	if(TIM_GetITStatus(TIM3, TIM_IT_CC2)){
-		TIM_ClearITPendingBit(TIM3, TIM_IT_CC2);
-		RcReceiver::handleInterrupt(1, TIM3, 2);
+PpmReceiver::PpmReceiver(TIM_TypeDef* timer, uint8_t timerChannel, DMA_Channel_TypeDef* dma) :
+_dma(dma),
+_decoder(captureTimerFrequency),
+_captures{},
+_readIndex(0),
+_frameTime(0)
+{
+	uint16_t timChannel, timDma;
+	__IO uint32_t* captureRegister;
+	switch(timerChannel){
+	case 1: timChannel = TIM_Channel_1; timDma = TIM_DMA_CC1; captureRegister = &timer->CCR1; break;
+	case 2: timChannel = TIM_Channel_2; timDma = TIM_DMA_CC2; captureRegister = &timer->CCR2; break;
+	case 3: timChannel = TIM_Channel_3; timDma = TIM_DMA_CC3; captureRegister = &timer->CCR3; break;
+	case 4: timChannel = TIM_Channel_4; timDma = TIM_DMA_CC4; captureRegister = &timer->CCR4; break;
+	default: return;
 	}
 
-	if(TIM_GetITStatus(TIM3, TIM_IT_CC3)){
-		TIM_ClearITPendingBit(TIM3, TIM_IT_CC3);
-		RcReceiver::handleInterrupt(2, TIM3, 3);
+	TIM_ICInitTypeDef TIM_ICInitStructure;
+	TIM_ICStructInit(&TIM_ICInitStructure);
+
+	TIM_ICInitStructure.TIM_Channel = timChannel;
+	TIM_ICInitStructure.TIM_ICPolarity = TIM_ICPolarity_Rising;
+	TIM_ICInitStructure.TIM_ICSelection = TIM_ICSelection_DirectTI;
+	TIM_ICInitStructure.TIM_ICPrescaler = TIM_ICPSC_DIV1;
+	TIM_ICInitStructure.TIM_ICFilter = 0x3; // Filters noise
+	TIM_ICInit(timer, &TIM_ICInitStructure);
+
+	configureRxDma(_dma, (uintptr_t)captureRegister, _captures, CaptureBufferSize, true);
+	TIM_DMACmd(timer, timDma, ENABLE);
+}
+
+void PpmReceiver::connect(GPIO_TypeDef* port, uint16_t pin, uint8_t altFunction)
+{
+	GPIO_InitTypeDef GPIO_InitStructure;
+
+	GPIO_InitStructure.GPIO_Pin = 1 << pin;
+	GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF;
+	GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+	GPIO_InitStructure.GPIO_OType = GPIO_OType_PP;
+	GPIO_InitStructure.GPIO_PuPd = GPIO_PuPd_UP;
+
+	GPIO_Init(port, &GPIO_InitStructure);
+	GPIO_PinAFConfig(port, pin, altFunction);
+}
+
+void PpmReceiver::update()
+{
+	// DMA counts remaining transfers down, wrapping to buffer size
+	uint8_t writeIndex = (CaptureBufferSize - DMA_GetCurrDataCounter(_dma)) % CaptureBufferSize;
+
+	while(_readIndex != writeIndex){
+		if(_decoder.push(_captures[_readIndex]))
+			_frameTime = getSystemTime();
+		_readIndex = (_readIndex + 1) % CaptureBufferSize;
 	}
+}
+
+uint8_t PpmReceiver::channelN()
+{
+	return _decoder.channelN();
+}
 
-	if(TIM_GetITStatus(TIM3, TIM_IT_CC4)){
-		TIM_ClearITPendingBit(TIM3, TIM_IT_CC4);
-		RcReceiver::handleInterrupt(3, TIM3, 4);
+float PpmReceiver::pulseWidth(uint8_t channel)
+{
+	// If signal was lost, return zero pulse width
+	if(_decoder.frames() == 0 || getSystemTime() - _frameTime > maxTimeDifference)
+		return 0;
+
+	return ((float)_decoder.channel(channel)) / captureTimerFrequency;
+}
+
+float PpmReceiver::normalizedReading(uint8_t channel)
+{
+	float pw = pulseWidth(channel);
+
+	return limit((pw - minPulseWidth) / (maxPulseWidth - minPulseWidth), 0, 1);
+}
+
+SbusReceiver::SbusReceiver(USART_TypeDef* uart, DMA_Channel_TypeDef* dma) :
+_dma(dma),
+_decoder(),
+_rxBuffer{},
+_readIndex(0),
+_frameTime(0)
+{
+	USART_InitTypeDef USART_InitStructure;
+
+	// 8 data bits with parity bit
+	USART_InitStructure.USART_BaudRate = 100000;
+	USART_InitStructure.USART_WordLength = USART_WordLength_9b;
+	USART_InitStructure.USART_StopBits = USART_StopBits_2;
+	USART_InitStructure.USART_Parity = USART_Parity_Even;
+	USART_InitStructure.USART_HardwareFlowControl = USART_HardwareFlowControl_None;
+	USART_InitStructure.USART_Mode = USART_Mode_Rx;
+	USART_Init(uart, &USART_InitStructure);
+
+	// SBUS line is inverted, no external inverter needed
+	USART_InvPinCmd(uart, USART_InvPin_Rx, ENABLE);
+
+	configureRxDma(_dma, (uintptr_t)&uart->RDR, _rxBuffer, RxBufferSize, false);
+	USART_DMACmd(uart, USART_DMAReq_Rx, ENABLE);
+
+	USART_Cmd(uart, ENABLE);
+}
+
+void SbusReceiver::connect(GPIO_TypeDef* rxPort, uint16_t rxPin, uint8_t rxAltFunction)
+{
+	GPIO_InitTypeDef GPIO_InitStructure;
+
+	GPIO_InitStructure.GPIO_Pin = 1 << rxPin;
+	GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF;
+	GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+	GPIO_InitStructure.GPIO_OType = GPIO_OType_PP;
+	GPIO_InitStructure.GPIO_PuPd = GPIO_PuPd_NOPULL;
+
+	GPIO_Init(rxPort, &GPIO_InitStructure);
+	GPIO_PinAFConfig(rxPort, rxPin, rxAltFunction);
+}
+
+void SbusReceiver::update()
+{
+	// DMA counts remaining transfers down, wrapping to buffer size
+	uint8_t writeIndex = (RxBufferSize - DMA_GetCurrDataCounter(_dma)) % RxBufferSize;
+
+	while(_readIndex != writeIndex){
+		if(_decoder.push(_rxBuffer[_readIndex]))
+			_frameTime = getSystemTime();
+		_readIndex = (_readIndex + 1) % RxBufferSize;
 	}
 }
 
+uint8_t SbusReceiver::channelN()
+{
+	return SbusDecoder::ChannelN;
+}
+
+float SbusReceiver::pulseWidth(uint8_t channel)
+{
+	// If signal was lost, return zero pulse width
+	if(_decoder.frames() == 0 || _decoder.failsafe() || getSystemTime() - _frameTime > maxTimeDifference)
+		return 0;
+
+	return SbusDecoder::pulseWidth(_decoder.channel(channel));
+}
+
+float SbusReceiver::normalizedReading(uint8_t channel)
+{
+	float pw = pulseWidth(channel);
+
+	return limit((pw - minPulseWidth) / (maxPulseWidth - minPulseWidth), 0, 1);
+}
+
+// Interrupt handlers
+CCM_CODE void TIM3_IRQHandler(void)
+{
+	IRQ_ENTER(IrqTim3);
+
+	// Capture flags CCxIF share bit positions 1 to 4 in SR and DIER,
+	// all pending ones are read and cleared at once
+	uint32_t pending = TIM3->SR & TIM3->DIER & (TIM_IT_CC1 | TIM_IT_CC2 | TIM_IT_CC3 | TIM_IT_CC4);
+	TIM3->SR = ~pending;
+
+	while(pending){
+		uint8_t timerChannel = nextPending(pending);
+		RcReceiver::handleInterrupt(timerChannel - 1, TIM3, timerChannel);
+	}
+
+	IRQ_EXIT(IrqTim3);
+}
@@ -0,0 +1,129 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "sbusDecoder.h"
+
+#include <cstring>
+
+static const uint8_t sbusHeader = 0x0F;
+static const uint8_t sbusFooter = 0x00;
+// SBUS2 receivers rotate telemetry slot markers in the footer
+static const uint8_t sbus2FooterMask = 0x0F;
+static const uint8_t sbus2Footer = 0x04;
+
+static const uint8_t frameLostFlag = 0x04;
+static const uint8_t failsafeFlag = 0x08;
+
+SbusDecoder::SbusDecoder() :
+_frame{},
+_position(0),
+_channels{},
+_flags(0),
+_frames(0),
+_errors(0)
+{
+}
+
+bool SbusDecoder::push(uint8_t byte)
+{
+	if(_position == 0 && byte != sbusHeader)
+		return false;
+
+	_frame[_position++] = byte;
+	if(_position < FrameSize)
+		return false;
+
+	uint8_t footer = _frame[FrameSize - 1];
+	if(footer == sbusFooter || (footer & sbus2FooterMask) == sbus2Footer){
+		decode();
+		_position = 0;
+		return true;
+	}
+
+	// Misaligned, continue from next header candidate inside the frame
+	_errors++;
+	_position = 0;
+	for(uint8_t i = 1; i < FrameSize; i++){
+		if(_frame[i] == sbusHeader){
+			_position = FrameSize - i;
+			std::memmove(_frame, _frame + i, _position);
+			break;
+		}
+	}
+
+	return false;
+}
+
+void SbusDecoder::decode()
+{
+	const uint8_t* data = _frame + 1;
+	uint32_t bits = 0;
+	uint8_t bitN = 0;
+	uint8_t channel = 0;
+
+	for(uint8_t i = 0; i < ChannelN * 11 / 8; i++){
+		bits |= (uint32_t)data[i] << bitN;
+		bitN += 8;
+		if(bitN >= 11){
+			_channels[channel++] = bits & 0x7FF;
+			bits >>= 11;
+			bitN -= 11;
+		}
+	}
+
+	_flags = _frame[FrameSize - 2];
+	_frames++;
+}
+
+uint16_t SbusDecoder::channel(uint8_t channel) const
+{
+	return channel < ChannelN ? _channels[channel] : 0;
+}
+
+bool SbusDecoder::frameLost() const
+{
+	return _flags & frameLostFlag;
+}
+
+bool SbusDecoder::failsafe() const
+{
+	return _flags & failsafeFlag;
+}
+
+uint32_t SbusDecoder::frames() const
+{
+	return _frames;
+}
+
+uint32_t SbusDecoder::errors() const
+{
+	return _errors;
+}
+
+float SbusDecoder::pulseWidth(uint16_t value)
+{
+	// Common receiver mapping, 172..1811 is 988..2012 us with center 992 at 1500 us
+	return (value * 0.625f + 880.0f) * 1e-6f;
+}
@@ -29,10 +29,30 @@
 
 Servo::Servo(TIM_TypeDef* timer, uint8_t channel, float minPulseWidth, float maxPulseWidth, float maxAngle, float angle) :
 _pwm(timer, channel),
+_table(nullptr),
+_normalizedAngle(0),
 _maxAngle(maxAngle),
 _minPulseWidth(minPulseWidth),
 _maxPulseWidth(maxPulseWidth)
 {
+	updateTicks();
+
+	if(maxAngle > 0)
+		this->angle(angle);
+	else
+		this->normalizedAngle(0);
+}
+
+Servo::Servo(TIM_TypeDef* timer, uint8_t channel, const ActuatorTable* table, float maxAngle, float angle) :
+_pwm(timer, channel),
+_table(table),
+_normalizedAngle(0),
+_maxAngle(maxAngle),
+_minPulseWidth(table->ticks(0) / Pwm::pulseTicks(1)),
+_maxPulseWidth(table->ticks(1) / Pwm::pulseTicks(1))
+{
+	updateTicks();
+
 	if(maxAngle > 0)
 		this->angle(angle);
 	else
@@ -42,23 +62,27 @@ _maxPulseWidth(maxPulseWidth)
 float Servo::angle()
 {
 	// assert(_maxAngle > 0);
-	return (_pwm.pulseWidth() - _minPulseWidth) / (_maxPulseWidth - _minPulseWidth) * (2 * _maxAngle) - _maxAngle;
+	return _normalizedAngle * (2 * _maxAngle) - _maxAngle;
 }
 
 void Servo::angle(float angle)
 {
 	// assert(_maxAngle > 0);
-	_pwm.pulseWidth(_minPulseWidth + (angle + _maxAngle) / (2 * _maxAngle) * (_maxPulseWidth - _minPulseWidth));
+	normalizedAngle((angle + _maxAngle) / (2 * _maxAngle));
 }
 
 float Servo::normalizedAngle()
 {
-	return (_pwm.pulseWidth() - _minPulseWidth) / (_maxPulseWidth - _minPulseWidth);
+	return _normalizedAngle;
 }
 
 void Servo::normalizedAngle(float angle)
 {
-	_pwm.pulseWidth(_minPulseWidth + angle * (_maxPulseWidth - _minPulseWidth));
+	_normalizedAngle = angle;
+	if(_table != nullptr)
+		_pwm.compare(_table->ticks(angle));
+	else
+		_pwm.compare(_minTicks + angle * _rangeTicks);
 }
 
 float Servo::minPulseWidth()
@@ -69,6 +93,7 @@ float Servo::minPulseWidth()
 void Servo::minPulseWidth(float minPulseWidth)
 {
 	_minPulseWidth = minPulseWidth;
+	updateTicks();
 }
 
 float Servo::maxPulseWidth()
@@ -79,9 +104,16 @@ float Servo::maxPulseWidth()
 void Servo::maxPulseWidth(float maxPulseWidth)
 {
 	_maxPulseWidth = maxPulseWidth;
+	updateTicks();
 }
 
 void Servo::connect(GPIO_TypeDef* port, uint16_t pin, uint8_t altFunction)
 {
 	_pwm.connect(port, pin, altFunction);
 }
+
+void Servo::updateTicks()
+{
+	_minTicks = Pwm::pulseTicks(_minPulseWidth);
+	_rangeTicks = Pwm::pulseTicks(_maxPulseWidth) - _minTicks;
+}
@@ -0,0 +1,181 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+#include "thermalBias.h"
+
+using namespace math3d;
+
+// Still period of one second at 100 Hz loop in four windows, deviation in rad/s
+static const uint16_t stillWindow = 25;
+static const uint8_t stillWindowN = 4;
+static const float stillLimit = 0.02f;
+
+namespace
+{
+	// Stored form of the nodes, bias includes what the sensor correction removes
+	struct NodeRecord
+	{
+		float bias[ThermalBias::NodeN][3];
+		float weight[ThermalBias::NodeN];
+	};
+	static_assert(sizeof(NodeRecord) <= ConfigStore::MaxValueSize, "thermal nodes do not fit a record");
+}
+
+ThermalBias::ThermalBias(float lowestTemperature, float nodeSpacing, float maxWeight) :
+_lowestTemperature(lowestTemperature),
+_nodeSpacing(nodeSpacing),
+_maxWeight(maxWeight),
+_still(stillWindow, stillWindowN, stillLimit)
+{
+	reset();
+}
+
+void ThermalBias::reset()
+{
+	for(uint8_t i = 0; i < NodeN; i++){
+		_bias[i].zero();
+		_weight[i] = 0;
+	}
+	_still.reset();
+}
+
+Vector3<float> ThermalBias::bias(float temperature) const
+{
+	float p = position(temperature);
+
+	// Nearest learned nodes below and above
+	int8_t below = -1, above = -1;
+	for(int8_t i = 0; i < NodeN; i++){
+		if(_weight[i] <= 0)
+			continue;
+		if(i <= p)
+			below = i;
+		else if(above < 0)
+			above = i;
+	}
+
+	if(below < 0 && above < 0)
+		return Vector3<float>(0, 0, 0);
+	if(above < 0)
+		return _bias[below];
+	if(below < 0)
+		return _bias[above];
+
+	float u = (p - below) / (above - below);
+	return _bias[below] + (_bias[above] - _bias[below]) * u;
+}
+
+Vector3<float> ThermalBias::apply(const Vector3<float>& rate, float temperature) const
+{
+	return rate - bias(temperature);
+}
+
+bool ThermalBias::observe(const Vector3<float>& rate, float temperature)
+{
+	if(!_still.add(rate))
+		return false;
+
+	// Rate was compensated already, its mean is what the table missed
+	learn(temperature, bias(temperature) + _still.stats().mean());
+	_still.reset();
+	return true;
+}
+
+void ThermalBias::interrupt()
+{
+	_still.reset();
+}
+
+void ThermalBias::learn(float temperature, const Vector3<float>& bias)
+{
+	float p = position(temperature);
+	uint8_t node = p < NodeN - 1 ? (uint8_t)p : NodeN - 2;
+	float u = p - node;
+
+	// Unlearned neighbours start from the sample, then both move so the
+	// interpolation at this temperature approaches it (normalized LMS),
+	// gain falls with the still periods seen up to the weight limit
+	float weights[2] = {1 - u, u};
+	for(uint8_t i = 0; i < 2; i++)
+		if(_weight[node + i] <= 0)
+			_bias[node + i] = bias;
+
+	Vector3<float> error = bias - (_bias[node] * weights[0] + _bias[node + 1] * weights[1]);
+	float norm = weights[0] * weights[0] + weights[1] * weights[1];
+	for(uint8_t i = 0; i < 2; i++){
+		float w = weights[i];
+		if(w <= 0)
+			continue;
+
+		float& weight = _weight[node + i];
+		weight = weight + w < _maxWeight ? weight + w : _maxWeight;
+		_bias[node + i] += error * (w / norm * w / weight);
+	}
+}
+
+bool ThermalBias::load(const ConfigStore& store, uint8_t key, const Vector3<float>& corrected)
+{
+	NodeRecord record;
+	if(!store.read(key, record))
+		return false;
+
+	for(uint8_t i = 0; i < NodeN; i++){
+		_bias[i] = Vector3<float>(record.bias[i][0], record.bias[i][1], record.bias[i][2]) - corrected;
+		_weight[i] = record.weight[i] < _maxWeight ? record.weight[i] : _maxWeight;
+	}
+	return true;
+}
+
+bool ThermalBias::save(ConfigStore& store, uint8_t key, const Vector3<float>& corrected) const
+{
+	NodeRecord record;
+	for(uint8_t i = 0; i < NodeN; i++){
+		for(uint8_t j = 0; j < 3; j++)
+			record.bias[i][j] = _bias[i][j] + corrected[j];
+		record.weight[i] = _weight[i];
+	}
+	return store.write(key, record);
+}
+
+float ThermalBias::nodeTemperature(uint8_t node) const
+{
+	return _lowestTemperature + node * _nodeSpacing;
+}
+
+const Vector3<float>& ThermalBias::nodeBias(uint8_t node) const
+{
+	return _bias[node];
+}
+
+float ThermalBias::nodeWeight(uint8_t node) const
+{
+	return _weight[node];
+}
+
+float ThermalBias::position(float temperature) const
+{
+	float p = (temperature - _lowestTemperature) / _nodeSpacing;
+	return p < 0 ? 0 : p > NodeN - 1 ? NodeN - 1 : p;
+}
@@ -26,15 +26,40 @@
 #include "uart.h"
 #include "interrupt.h"
 #include "systime.h"
+#include "irqMonitor.h"
+#include "irqDispatch.h"
+#include "ccm.h"
 
 #include <stm32f30x.h>
 
-//TODO: needs __IO?
-Uart* uart1Reg = nullptr;
-Uart* uart2Reg = nullptr;
-Uart* uart3Reg = nullptr;
-Uart* uart4Reg = nullptr;
-Uart* uart5Reg = nullptr;
+static const uint8_t noChannel = 0xFF;
+
+// Binds handler (nullptr unbinds) to interrupt slot of the peripheral,
+// returns its NVIC channel
+static uint8_t bindUart(USART_TypeDef* uart, Uart* handler)
+{
+	if(uart == USART1){
+		IrqSlot<Uart, 1>::bind(handler);
+		return USART1_IRQn;
+	}
+	if(uart == USART2){
+		IrqSlot<Uart, 2>::bind(handler);
+		return USART2_IRQn;
+	}
+	if(uart == USART3){
+		IrqSlot<Uart, 3>::bind(handler);
+		return USART3_IRQn;
+	}
+	if(uart == UART4){
+		IrqSlot<Uart, 4>::bind(handler);
+		return UART4_IRQn;
+	}
+	if(uart == UART5){
+		IrqSlot<Uart, 5>::bind(handler);
+		return UART5_IRQn;
+	}
+	return noChannel;
+}
 
 Uart::Uart(USART_TypeDef* uart, uint32_t baudRate, uint32_t parity) :
 _uart(uart),
@@ -57,28 +82,8 @@ _canSend(true)
 	// Enable the USART1
 	USART_Cmd(uart, ENABLE);
 
-	// Register Uart
-	uint8_t channel;
-	if(_uart == USART1){
-		uart1Reg = this;
-		channel = USART1_IRQn;
-	}
-	else if(_uart == USART2){
-		uart2Reg = this;
-		channel = USART2_IRQn;
-	}
-	else if(_uart == USART3){
-		uart3Reg = this;
-		channel = USART3_IRQn;
-	}
-	else if(_uart == UART4){
-		uart4Reg = this;
-		channel = UART4_IRQn;
-	}
-	else if(_uart == UART5){
-		uart5Reg = this;
-		channel = UART5_IRQn;
-	}
+	// Register Uart before its interrupt can fire
+	uint8_t channel = bindUart(_uart, this);
 
 	// Enable interrupts
 	// Enable interrupt on data received
@@ -90,38 +95,19 @@ _canSend(true)
 	// Use low priority
 	uint8_t priority = 1;
 	uint8_t subPriority = 0;
-	Interrupt::enable(channel, priority, subPriority);
+	if(channel != noChannel)
+		Interrupt::enable(channel, priority, subPriority);
 }
 
 Uart::~Uart()
 {
-	uint8_t channel;
-	if(_uart == USART1){
-		uart1Reg = nullptr;
-		channel = USART1_IRQn;
-	}
-	else if(_uart == USART2){
-		uart2Reg = nullptr;
-		channel = USART2_IRQn;
-	}
-	else if(_uart == USART3){
-		uart3Reg = nullptr;
-		channel = USART3_IRQn;
-	}
-	else if(_uart == UART4){
-		uart4Reg = nullptr;
-		channel = UART4_IRQn;
-	}
-	else if(_uart == UART5){
-		uart5Reg = nullptr;
-		channel = UART5_IRQn;
-	}
-
 	USART_ITConfig(_uart, USART_IT_RXNE, DISABLE);
 	USART_ITConfig(_uart, USART_IT_TXE, DISABLE);
 
-	// Disable interrupt
-	Interrupt::disable(channel);
+	// Nothing can be pending now, unregister and disable interrupt
+	uint8_t channel = bindUart(_uart, nullptr);
+	if(channel != noChannel)
+		Interrupt::disable(channel);
 }
 
 void Uart::connect(GPIO_TypeDef* txPort, uint16_t txPin, uint8_t txAltFunction,
@@ -166,34 +152,30 @@ uint8_t Uart::get()
 
 void Uart::put(uint8_t byte)
 {
-	_txBuffer.push_back(byte);
+	write(Span<const uint8_t>(&byte, 1));
 }
 
-std::vector<uint8_t> Uart::read(int num)
+int Uart::read(Span<uint8_t> data)
 {
-	if(num <= 0)
-		return std::vector<uint8_t>();
-
-	std::vector<uint8_t> vec;
-	int read = 0;
-
-	while(read < num){
+	for(size_t i = 0; i < data.size(); i++){
 		// TODO: timeouts
 		while(_rxBuffer.empty());
-		vec.push_back(_rxBuffer.front());
+		data[i] = _rxBuffer.front();
 		_rxBuffer.pop_front();
-		read++;
 	}
-	return vec;
+	return data.size();
 }
 
-int Uart::write(const std::vector<uint8_t>& vec)
+int Uart::write(Span<const uint8_t> data)
 {
-	if(vec.empty())
+	if(data.empty())
 		return 0;
 
-	for(auto it = vec.begin(); it != vec.end(); it++)
-		_txBuffer.push_back(*it);
+	for(size_t i = 0; i < data.size(); i++){
+		// Let interrupt drain the buffer when it is full
+		while(!_txBuffer.push_back(data[i]))
+			USART_ITConfig(_uart, USART_IT_TXE, ENABLE);
+	}
 
 	if(_canSend){
 		// Enable interrupt on transmit to let UART
@@ -201,10 +183,10 @@ int Uart::write(const std::vector<uint8_t>& vec)
 		USART_ITConfig(_uart, USART_IT_TXE, ENABLE);
 	}
 
-	return vec.size();
+	return data.size();
 }
 
-void Uart::send()
+CCM_CODE void Uart::send()
 {
 	if(_txBuffer.empty()){
 		_canSend = true;
@@ -222,69 +204,65 @@ void Uart::send()
 	sleep(1, microsecond);
 }
 
-void Uart::receive()
+CCM_CODE void Uart::receive()
 {
+	// Byte is dropped when main loop does not keep up
 	_rxBuffer.push_back(USART_ReceiveData(_uart));
 }
 
-// Interrupt handlers
-uint32_t USART1_IRQHandler(void)
+CCM_CODE void Uart::handleInterrupt()
 {
-	while(uart1Reg == nullptr);
-    if(USART_GetITStatus(USART1, USART_IT_RXNE) != RESET){
-    	uart1Reg->receive();
-    }
-    else if(USART_GetITStatus(USART1, USART_IT_TXE) != RESET){
-    	uart1Reg->send();
-    }
-    return 0;
+	// Single read of the status, only enabled sources are served
+	uint32_t status = _uart->ISR;
+	uint32_t control = _uart->CR1;
+
+	// Overrun keeps the interrupt pending until cleared, the byte is lost
+	if(status & USART_ISR_ORE)
+		_uart->ICR = USART_ICR_ORECF;
+
+	if((status & USART_ISR_RXNE) && (control & USART_CR1_RXNEIE))
+		receive();
+	if((status & USART_ISR_TXE) && (control & USART_CR1_TXEIE))
+		send();
 }
 
-uint32_t USART2_IRQHandler(void)
+// Interrupt handlers
+CCM_CODE uint32_t USART1_IRQHandler(void)
 {
-	while(uart2Reg == nullptr);
-	if(USART_GetITStatus(USART2, USART_IT_RXNE) != RESET){
-		uart2Reg->receive();
-	}
-	else if(USART_GetITStatus(USART2, USART_IT_TXE) != RESET){
-		uart2Reg->send();
-	}
+	IRQ_ENTER(IrqUsart1);
+	IrqSlot<Uart, 1>::dispatch();
+	IRQ_EXIT(IrqUsart1);
 	return 0;
 }
 
-uint32_t USART3_IRQHandler(void)
+CCM_CODE uint32_t USART2_IRQHandler(void)
 {
-	while(uart3Reg == nullptr);
-	if(USART_GetITStatus(USART3, USART_IT_RXNE) != RESET){
-		uart3Reg->receive();
-	}
-	else if(USART_GetITStatus(USART3, USART_IT_TXE) != RESET){
-		uart3Reg->send();
-	}
+	IRQ_ENTER(IrqUsart2);
+	IrqSlot<Uart, 2>::dispatch();
+	IRQ_EXIT(IrqUsart2);
 	return 0;
 }
 
-uint32_t UART4_IRQHandler(void)
+CCM_CODE uint32_t USART3_IRQHandler(void)
 {
-	while(uart4Reg == nullptr);
-	if(USART_GetITStatus(UART4, USART_IT_RXNE) != RESET){
-		uart4Reg->receive();
-	}
-	else if(USART_GetITStatus(UART4, USART_IT_TXE) != RESET){
-		uart4Reg->send();
-	}
+	IRQ_ENTER(IrqUsart3);
+	IrqSlot<Uart, 3>::dispatch();
+	IRQ_EXIT(IrqUsart3);
 	return 0;
 }
 
-uint32_t UART5_IRQHandler(void)
+CCM_CODE uint32_t UART4_IRQHandler(void)
 {
-	while(uart5Reg == nullptr);
-	if(USART_GetITStatus(UART5, USART_IT_RXNE) != RESET){
-		uart1Reg->receive();
-	}
-	else if(USART_GetITStatus(UART5, USART_IT_TXE) != RESET){
-		uart5Reg->send();
-	}
+	IRQ_ENTER(IrqUart4);
+	IrqSlot<Uart, 4>::dispatch();
+	IRQ_EXIT(IrqUart4);
 	return 0;
 }
 
+CCM_CODE uint32_t UART5_IRQHandler(void)
+{
+	IRQ_ENTER(IrqUart5);
+	IrqSlot<Uart, 5>::dispatch();
+	IRQ_EXIT(IrqUart5);
+	return 0;
+}
@@ -0,0 +1,121 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Throughput benchmark of the blackbox encoding. A synthetic flight of
+ * noisy sensor readings and slowly moving controller state is quantized,
+ * encoded, decoded and compared field by field.
+ *
+ * Usage: bbbench [-n records]
+ */
+
+#include "blackbox.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Small deterministic generator, benchmark must not depend on libc rand
+static uint32_t randomState = 12345;
+
+static float noise(float amplitude)
+{
+	randomState = randomState * 1664525u + 1013904223u;
+	return ((randomState >> 8) / 16777216.0f - 0.5f) * 2 * amplitude;
+}
+
+static BlackboxFrame syntheticFrame(uint32_t i)
+{
+	float t = i * 0.01f;
+	BlackboxFrame frame;
+	frame.time = i * 10000;
+	for(uint8_t a = 0; a < 3; a++){
+		float phase = t * (0.5f + a * 0.3f);
+		frame.gyro[a] = 0.3f * std::cos(phase) + noise(0.005f);
+		frame.acc[a] = (a == 2 ? 1.0f : 0.1f * std::sin(phase)) + noise(0.05f);
+		frame.attitude[a] = 0.3f * std::sin(phase);
+		frame.setpoint[a] = (i / 200) % 2 ? 0.2f : -0.2f;
+		frame.proportional[a] = 0.3f * (frame.setpoint[a] - frame.attitude[a]);
+		frame.integral[a] = 0.01f * std::sin(phase * 0.1f);
+		frame.derivative[a] = 0;
+	}
+	frame.throttle = 0.6f;
+	for(uint8_t m = 0; m < 3; m++)
+		frame.motors[m] = 0.6f + frame.proportional[m % 2] * 0.5f;
+	frame.servo = 0.5f + frame.proportional[2] * 0.5f;
+	return frame;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t recordN = 1000000;
+	if(argc == 3 && std::strcmp(argv[1], "-n") == 0)
+		recordN = std::strtoul(argv[2], nullptr, 10);
+	else if(argc != 1){
+		std::fprintf(stderr, "usage: bbbench [-n records]\n");
+		return 1;
+	}
+
+	// Quantized input prepared up front, only encoding is timed
+	std::vector<int32_t> fields(recordN * BlackboxEncoder::FieldN);
+	for(uint32_t i = 0; i < recordN; i++)
+		BlackboxEncoder::quantize(syntheticFrame(i), &fields[i * BlackboxEncoder::FieldN]);
+
+	std::vector<uint8_t> stream(recordN * (size_t)BlackboxEncoder::MaxRecordSize);
+	BlackboxEncoder encoder(32);
+	size_t size = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for(uint32_t i = 0; i < recordN; i++)
+		size += encoder.encode(&fields[i * BlackboxEncoder::FieldN], &stream[size]);
+	double encodeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	BlackboxDecoder decoder;
+	uint32_t decoded = 0, mismatches = 0;
+	size_t position = 0;
+
+	start = std::chrono::steady_clock::now();
+	while(position < size){
+		uint32_t consumed;
+		if(decoder.decode(&stream[position], size - position, consumed) != BlackboxDecoder::Decoded)
+			break;
+		position += consumed;
+		if(std::memcmp(decoder.fields(), &fields[decoded * BlackboxEncoder::FieldN], BlackboxEncoder::FieldN * sizeof(int32_t)) != 0)
+			mismatches++;
+		decoded++;
+	}
+	double decodeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	double rawSize = (double)recordN * BlackboxEncoder::FieldN * sizeof(int32_t);
+	std::printf("records=%u bytesPerRecord=%.2f ratio=%.2f encodeMBps=%.1f encodeNsPerRecord=%.1f decodeMBps=%.1f decodeNsPerRecord=%.1f roundtrip=%s\n",
+				recordN, size / (double)recordN, rawSize / size,
+				rawSize / encodeTime * 1e-6, encodeTime / recordN * 1e9,
+				rawSize / decodeTime * 1e-6, decodeTime / recordN * 1e9,
+				decoded == recordN && mismatches == 0 ? "ok" : "FAILED");
+	return decoded == recordN && mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Decodes blackbox recorder output into CSV with physical units. Input is
+ * the raw stream, either f3sim -b output or concatenated payloads of
+ * blackbox string packets. Damaged parts are skipped up to the next
+ * keyframe, number of skipped bytes is reported on stderr.
+ *
+ * Usage: bbdecode [-r] blackbox.bin > log.csv
+ *        -r	raw integer fields instead of physical units
+ */
+
+#include "blackbox.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+	bool raw = false;
+	const char* path = nullptr;
+	for(int i = 1; i < argc; i++){
+		if(std::strcmp(argv[i], "-r") == 0)
+			raw = true;
+		else
+			path = argv[i];
+	}
+
+	if(path == nullptr){
+		std::fprintf(stderr, "usage: bbdecode [-r] blackbox.bin > log.csv\n");
+		return 1;
+	}
+
+	FILE* file = std::fopen(path, "rb");
+	if(file == nullptr){
+		std::perror(path);
+		return 1;
+	}
+
+	std::vector<uint8_t> data;
+	uint8_t chunk[4096];
+	size_t size;
+	while((size = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+		data.insert(data.end(), chunk, chunk + size);
+	std::fclose(file);
+
+	for(uint8_t i = 0; i < BlackboxEncoder::FieldN; i++)
+		std::printf(i ? ",%s" : "%s", BlackboxEncoder::fieldName(i));
+	std::printf("\n");
+
+	BlackboxDecoder decoder;
+	uint32_t position = 0, records = 0, skipped = 0;
+	while(position < data.size()){
+		uint32_t consumed;
+		BlackboxDecoder::Result result = decoder.decode(&data[position], data.size() - position, consumed);
+		if(result == BlackboxDecoder::NeedMore)
+			break;
+		position += consumed;
+		if(result == BlackboxDecoder::Skipped){
+			skipped += consumed;
+			continue;
+		}
+
+		const int32_t* fields = decoder.fields();
+		for(uint8_t i = 0; i < BlackboxEncoder::FieldN; i++){
+			if(i)
+				std::printf(",");
+			if(raw)
+				std::printf("%d", fields[i]);
+			// Time is unsigned microseconds
+			else if(i == 0)
+				std::printf("%.6f", (uint32_t)fields[i] * BlackboxEncoder::fieldScale(i));
+			else
+				std::printf("%.4f", fields[i] * BlackboxEncoder::fieldScale(i));
+		}
+		std::printf("\n");
+		records++;
+	}
+
+	std::fprintf(stderr, "records=%u skipped=%u truncated=%u errors=%u\n",
+				 records, skipped, (uint32_t)(data.size() - position), decoder.errors());
+	return 0;
+}
@@ -0,0 +1,249 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Host check of still period calibration on synthetic data. Noisy samples
+ * of a still sensor with known gyroscope bias, accelerometer offsets and
+ * vertical gain go through RunningStats and Calibration with the settings
+ * of src/bringUp.cpp and src/main.cpp:
+ *   - running mean and variance match the generated noise, merged halves
+ *     equal the whole
+ *   - recovered gyroscope bias is the true one within the error of the
+ *     mean, the first boot residual is over the save limit and later boots
+ *     on corrected samples stay under it but for a few percent
+ *   - corrected accelerometer reads zero on horizontal axes and 1 g up
+ *   - a moving window is rejected and a moved craft restarts collection
+ *   - corrections survive a save and mount of the configuration store
+ *
+ * Usage: calcheck [-s seed]
+ */
+
+#include "calibration.h"
+#include "configStore.h"
+#include "random.h"
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static int failures = 0;
+
+static void expect(bool ok, const char* format, ...)
+{
+	if(ok)
+		return;
+	va_list args;
+	va_start(args, format);
+	std::printf("FAIL ");
+	std::vprintf(format, args);
+	std::printf("\n");
+	va_end(args);
+	failures++;
+}
+
+using math3d::Vector3;
+
+// Same as src/bringUp.cpp
+static const uint16_t calibrationWindow = 25;
+static const uint8_t calibrationWindowN = 4;
+static const float gyroStillLimit = 0.02f;
+static const float gyroSaveLimit = 0.002f;
+// Same as accCalibration in src/main.cpp
+static const uint16_t accWindow = 25;
+static const uint8_t accWindowN = 8;
+static const float accStillLimit = 0.1f;
+
+// Same sensor noise as f3sim, 0.3 deg/s and 0.05 g
+static const float gyroNoise = 0.3f * math3d::Pi / 180;
+static const float accNoise = 0.05f;
+
+static Vector3<float> noisy(Random& random, const Vector3<float>& value, float sigma)
+{
+	return Vector3<float>(value[0] + random.gaussian(sigma), value[1] + random.gaussian(sigma),
+						  value[2] + random.gaussian(sigma));
+}
+
+static bool near(const Vector3<float>& value, const Vector3<float>& wanted, float tolerance)
+{
+	for(uint8_t i = 0; i < 3; i++)
+		if(std::fabs(value[i] - wanted[i]) > tolerance)
+			return false;
+	return true;
+}
+
+// Feeds samples until calibration is done, returns their number
+static int collect(Calibration& calibration, Random& random, const Vector3<float>& mean, float sigma,
+				   const SensorCorrection& correction, int limit)
+{
+	for(int i = 1; i <= limit; i++)
+		if(calibration.add(correction.apply(noisy(random, mean, sigma))))
+			return i;
+	return 0;
+}
+
+static void checkRunningStats(Random& random)
+{
+	const Vector3<float> mean(0.5f, -2, 10);
+	const int sampleN = 10000;
+	RunningStats all, first, second;
+	for(int i = 0; i < sampleN; i++){
+		Vector3<float> sample = noisy(random, mean, 0.1f);
+		all.add(sample);
+		(i < sampleN / 3 ? first : second).add(sample);
+	}
+
+	// Mean within 4 standard errors, variance within 5 percent
+	expect(all.count() == sampleN && near(all.mean(), mean, 4 * 0.1f / 100), "mean (%f, %f, %f)", all.mean()[0],
+		   all.mean()[1], all.mean()[2]);
+	expect(near(all.variance(), Vector3<float>(0.01f, 0.01f, 0.01f), 0.0005f), "variance (%f, %f, %f)",
+		   all.variance()[0], all.variance()[1], all.variance()[2]);
+
+	first.merge(second);
+	expect(first.count() == all.count() && near(first.mean(), all.mean(), 1e-4f) &&
+		   near(first.variance(), all.variance(), 1e-5f), "merged halves differ from the whole");
+}
+
+static void checkGyroscope(Random& random)
+{
+	const Vector3<float> bias(0.03f, -0.02f, 0.011f);
+	const int samples = calibrationWindow * calibrationWindowN;
+	// Mean of all samples is off by 4 standard errors at most
+	const float tolerance = 4 * gyroNoise / std::sqrt((float)samples);
+
+	// First boot, nothing stored
+	SensorCorrection correction;
+	Calibration calibration(calibrationWindow, calibrationWindowN, gyroStillLimit);
+	int used = collect(calibration, random, bias, gyroNoise, correction, 10 * samples);
+	expect(used == samples && calibration.rejectedWindows() == 0, "still gyro took %d samples, %u windows rejected",
+		   used, calibration.rejectedWindows());
+
+	Vector3<float> residual = calibration.stats().mean();
+	bool save = false;
+	for(uint8_t i = 0; i < 3; i++)
+		save |= std::fabs(residual[i]) > gyroSaveLimit;
+	expect(save, "uncorrected residual (%f, %f, %f) is under save limit", residual[0], residual[1], residual[2]);
+
+	calibration.updateGyroscope(correction);
+	expect(near(correction.bias, bias, tolerance) && near(correction.scale, Vector3<float>(1, 1, 1), 0),
+		   "gyro bias (%f, %f, %f), wanted (%f, %f, %f)", correction.bias[0], correction.bias[1], correction.bias[2],
+		   bias[0], bias[1], bias[2]);
+
+	// Later boots load the stored correction and write back a refined one
+	// when residual is over the limit, as BringUp::poll does. The two
+	// means differ only by noise, so flash writes are seldom.
+	const int boots = 200;
+	int saves = 0;
+	SensorCorrection stored = correction;
+	for(int boot = 0; boot < boots; boot++){
+		calibration.reset();
+		collect(calibration, random, bias, gyroNoise, stored, 10 * samples);
+		if(!near(calibration.stats().mean(), Vector3<float>(0, 0, 0), gyroSaveLimit)){
+			calibration.updateGyroscope(stored);
+			saves++;
+		}
+	}
+	expect(saves <= boots / 10, "%d of %d boots on corrected samples are over save limit", saves, boots);
+	expect(near(stored.bias, bias, tolerance), "stored bias drifted to (%f, %f, %f)", stored.bias[0], stored.bias[1],
+		   stored.bias[2]);
+
+	// Craft moved by hand, the window is rejected
+	calibration.reset();
+	for(int i = 0; i < calibrationWindow; i++)
+		calibration.add(noisy(random, bias, gyroNoise) + Vector3<float>(0, 0, i % 2 ? 0.5f : -0.5f));
+	expect(calibration.rejectedWindows() == 1 && calibration.stats().count() == 0, "motion window was accepted");
+
+	// Craft still again at another heading rate, collection restarts
+	collect(calibration, random, bias, gyroNoise, SensorCorrection(), calibrationWindow * 2);
+	SensorCorrection none;
+	used = collect(calibration, random, bias + Vector3<float>(0.1f, 0, 0), gyroNoise, none, 10 * samples);
+	expect(calibration.done() && calibration.rejectedWindows() == 2 && used == samples,
+		   "moved craft took %d samples, %u windows rejected", used, calibration.rejectedWindows());
+	expect(near(calibration.stats().mean(), bias + Vector3<float>(0.1f, 0, 0), tolerance),
+		   "samples before the move were kept");
+}
+
+static void checkAccelerometer(Random& random)
+{
+	// Sensor reads offset horizontally and gain * 1 g + offset up
+	const Vector3<float> offset(0.05f, -0.03f, 0.02f);
+	const float gain = 1.04f;
+	const Vector3<float> reading(offset[0], offset[1], gain + offset[2]);
+	const float tolerance = 4 * accNoise / std::sqrt((float)(accWindow * accWindowN));
+
+	SensorCorrection correction;
+	Calibration calibration(accWindow, accWindowN, accStillLimit);
+	int used = collect(calibration, random, reading, accNoise, correction, 10 * accWindow * accWindowN);
+	expect(used == accWindow * accWindowN, "still accelerometer took %d samples", used);
+	calibration.updateAccelerometer(correction);
+
+	Vector3<float> level = correction.apply(reading);
+	expect(near(level, Vector3<float>(0, 0, 1), tolerance), "level craft reads (%f, %f, %f) g", level[0], level[1],
+		   level[2]);
+	expect(std::fabs(correction.scale[2] - 1 / (gain + offset[2])) < tolerance && correction.scale[0] == 1,
+		   "accelerometer scale (%f, %f, %f)", correction.scale[0], correction.scale[1], correction.scale[2]);
+}
+
+static void checkStore()
+{
+	SensorCorrection correction;
+	correction.bias = Vector3<float>(0.03f, -0.02f, 0.011f);
+	correction.scale = Vector3<float>(1, 1, 0.95f);
+
+	ConfigStore store;
+	store.mount();
+	expect(Calibration::save(store, ConfigStore::GyroCorrection, correction), "correction is not saved");
+
+	// Next boot mounts what flash holds
+	ConfigStore boot;
+	boot.mount();
+	SensorCorrection loaded;
+	expect(Calibration::load(boot, ConfigStore::GyroCorrection, loaded) && near(loaded.bias, correction.bias, 0) &&
+		   near(loaded.scale, correction.scale, 0), "loaded correction differs");
+	expect(!Calibration::load(boot, ConfigStore::AccCorrection, loaded), "missing correction loads");
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t seed = 1;
+	for(int i = 1; i < argc; i++){
+		if(std::strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = std::strtoull(argv[++i], nullptr, 10);
+		else{
+			std::fprintf(stderr, "usage: calcheck [-s seed]\n");
+			return 1;
+		}
+	}
+
+	Random random(seed);
+	checkRunningStats(random);
+	checkGyroscope(random);
+	checkAccelerometer(random);
+	checkStore();
+
+	std::printf("calcheck %s\n", failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Configuration store benchmark and power loss test on the simulated
+ * flash. Mount time is measured on a page full of records, the worst case
+ * at boot. Then a sequence of writes is interrupted by power loss at
+ * every flash operation in turn: after remount each key must hold its
+ * last written value, the interrupted one may hold the old or the new
+ * one, and the store must keep working. Program errors are injected last.
+ *
+ * Usage: cfgbench [-n mounts]
+ */
+
+#include "configStore.h"
+
+#include <stm32f30x_flash.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const uint8_t keyN = 12;
+static const uint16_t writeN = 300;
+
+struct Value
+{
+	uint16_t size;
+	uint8_t data[ConfigStore::MaxValueSize];
+
+	bool operator ==(const Value& other) const
+	{
+		return size == other.size && std::memcmp(data, other.data, size) == 0;
+	}
+};
+
+// Value of write i, sizes from 1 to 40 bytes
+static Value scenarioValue(uint16_t i)
+{
+	uint32_t state = i * 2654435761u + 1;
+	Value value;
+	value.size = 1 + state % 40;
+	for(uint16_t b = 0; b < value.size; b++){
+		state = state * 1664525u + 1013904223u;
+		value.data[b] = state >> 24;
+	}
+	return value;
+}
+
+static uint8_t scenarioKey(uint16_t i)
+{
+	return 1 + (i * 7) % keyN;
+}
+
+static bool holds(const ConfigStore& store, uint8_t key, const Value& value)
+{
+	Value stored;
+	stored.size = value.size;
+	return value.size == 0 ? !store.read(key, stored.data, 1) && !store.read(key, stored.data, 0)
+						   : store.read(key, stored.data, value.size) && stored == value;
+}
+
+// Runs the scenario, power is lost at flash operation cut (0 never).
+// Returns false when the store is inconsistent after remount.
+static bool powerLossRun(uint32_t cut, uint32_t& operations)
+{
+	simFlashReset();
+	ConfigStore store;
+	store.mount();
+
+	Value committed[keyN + 1] = {};
+	int interrupted = -1;
+	Value pending;
+
+	uint32_t start = simFlashOperations();
+	simFlashPowerLoss(cut, cut);
+	for(uint16_t i = 0; i < writeN; i++){
+		uint8_t key = scenarioKey(i);
+		Value value = scenarioValue(i);
+		if(!store.write(key, value.data, value.size)){
+			interrupted = key;
+			pending = value;
+			break;
+		}
+		committed[key] = value;
+	}
+	operations = simFlashOperations() - start;
+	simFlashPowerUp();
+
+	ConfigStore rebooted;
+	rebooted.mount();
+	for(uint8_t key = 1; key <= keyN; key++){
+		bool ok = holds(rebooted, key, committed[key]) || (key == interrupted && holds(rebooted, key, pending));
+		if(!ok)
+			return false;
+	}
+
+	// Store keeps working, new values survive another reboot
+	for(uint8_t key = 1; key <= keyN; key++){
+		Value value = scenarioValue(writeN + key);
+		if(!rebooted.write(key, value.data, value.size))
+			return false;
+		committed[key] = value;
+	}
+	ConfigStore again;
+	again.mount();
+	for(uint8_t key = 1; key <= keyN; key++)
+		if(!holds(again, key, committed[key]))
+			return false;
+	return true;
+}
+
+// Failed programming leaves the previous values readable
+static bool programErrorRun()
+{
+	simFlashReset();
+	ConfigStore store;
+	store.mount();
+
+	Value value = scenarioValue(0);
+	if(!store.write(1, value.data, value.size))
+		return false;
+
+	simFlashProgramErrors(true);
+	for(uint16_t i = 1; i < 200; i++){
+		Value next = scenarioValue(i);
+		if(store.write(1, next.data, next.size))
+			return false;
+	}
+	simFlashProgramErrors(false);
+
+	ConfigStore rebooted;
+	rebooted.mount();
+	if(!holds(rebooted, 1, value))
+		return false;
+
+	Value next = scenarioValue(1000);
+	if(!rebooted.write(1, next.data, next.size))
+		return false;
+	ConfigStore again;
+	again.mount();
+	return holds(again, 1, next);
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t mountN = 100000;
+	if(argc == 3 && std::strcmp(argv[1], "-n") == 0)
+		mountN = std::strtoul(argv[2], nullptr, 10);
+	else if(argc != 1){
+		std::fprintf(stderr, "usage: cfgbench [-n mounts]\n");
+		return 1;
+	}
+
+	// Page full of the smallest records is the longest scan
+	simFlashReset();
+	ConfigStore store;
+	store.mount();
+	uint32_t records = 0;
+	uint8_t byte = 0;
+	while(store.used() + 4u <= FlashPage::Size && store.write(1 + records % keyN, &++byte, 1))
+		records++;
+
+	ConfigStore mounted;
+	auto start = std::chrono::steady_clock::now();
+	for(uint32_t i = 0; i < mountN; i++)
+		mounted.mount();
+	double mountTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// Writes of small values, including compactions
+	simFlashReset();
+	store.mount();
+	start = std::chrono::steady_clock::now();
+	for(uint16_t i = 0; i < writeN; i++){
+		Value value = scenarioValue(i);
+		store.write(scenarioKey(i), value.data, value.size);
+	}
+	double writeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	uint32_t compactions = store.sequence();
+
+	uint32_t operations;
+	bool powerLoss = powerLossRun(0, operations);
+	uint32_t cutN = operations;
+	uint32_t failures = powerLoss ? 0 : 1;
+	for(uint32_t cut = 1; cut <= cutN; cut++){
+		uint32_t ignored;
+		if(!powerLossRun(cut, ignored)){
+			if(failures == 0)
+				std::fprintf(stderr, "power loss at operation %u breaks the store\n", cut);
+			failures++;
+		}
+	}
+	bool programErrors = programErrorRun();
+
+	std::printf("fullPageRecords=%u mountNs=%.0f writeNs=%.0f compactions=%u powerLossCuts=%u powerLoss=%s programErrors=%s\n",
+				records, mountTime / mountN * 1e9, writeTime / writeN * 1e9, compactions, cutN,
+				failures == 0 ? "ok" : "FAILED", programErrors ? "ok" : "FAILED");
+	return failures == 0 && programErrors ? 0 : 1;
+}
@@ -0,0 +1,291 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Host check of the attitude EKF with the noise settings of src/main.cpp
+ * at the 100 Hz flight loop rate:
+ *   - sequential and joint update forms fed the same noisy readings of a
+ *     moving craft, trusted and not, keep the same state and covariance
+ *   - covariance stays symmetric and positive definite over a long hover
+ *     with accelerometer and heading corrections, variance along the
+ *     quaternion, which normalization drops, stays negligible
+ *   - bias of a still craft converges to a constant gyroscope offset
+ *
+ * Usage: ekfcheck [-s seed]
+ */
+
+#include "attitudeEkf.h"
+#include "random.h"
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static int failures = 0;
+
+static void expect(bool ok, const char* format, ...)
+{
+	if(ok)
+		return;
+	va_list args;
+	va_start(args, format);
+	std::printf("FAIL ");
+	std::vprintf(format, args);
+	std::printf("\n");
+	va_end(args);
+	failures++;
+}
+
+using math3d::Vector3;
+
+// Same as src/main.cpp
+static const float ekfGyroNoise = math3d::Radians(0.3f);
+static const float ekfBiasDrift = math3d::Radians(0.01f);
+static const float ekfAccNoise = 0.3f;
+static const float ekfHeadingNoise = math3d::Radians(5.0f);
+
+static const float deltaT = 0.01f;
+// Heading arrives at 30 Hz
+static const int headingInterval = 3;
+
+typedef Matrix<float, AttitudeEkf::StateN, AttitudeEkf::StateN> Covariance;
+
+static Vector3<float> noisy(Random& random, const Vector3<float>& value, float sigma)
+{
+	return Vector3<float>(value[0] + (float)random.gaussian(sigma), value[1] + (float)random.gaussian(sigma),
+						  value[2] + (float)random.gaussian(sigma));
+}
+
+// Accelerometer reading of up given in gyroscope axes, LSM303DLHC is
+// turned by 90 degrees around Z
+static Vector3<float> accReading(const Vector3<float>& up)
+{
+	return Vector3<float>(-up[1], up[0], up[2]);
+}
+
+// Largest difference relative to the largest variance
+static float largestDifference(const Covariance& a, const Covariance& b)
+{
+	float largest = 0, scale = 0;
+	for(uint8_t i = 0; i < AttitudeEkf::StateN; i++){
+		scale = a(i, i) > scale ? a(i, i) : scale;
+		for(uint8_t j = 0; j < AttitudeEkf::StateN; j++){
+			float difference = std::fabs(a(i, j) - b(i, j));
+			largest = difference > largest ? difference : largest;
+		}
+	}
+	return largest / scale;
+}
+
+// Smallest Cholesky pivot relative to the diagonal it came from, not
+// positive when the matrix is not positive definite
+template <uint8_t N>
+static double smallestPivot(const double (&m)[N][N])
+{
+	double l[N][N];
+	double smallest = 1;
+	for(uint8_t j = 0; j < N; j++){
+		double pivot = m[j][j];
+		for(uint8_t k = 0; k < j; k++)
+			pivot -= l[j][k] * l[j][k];
+		double relative = m[j][j] > 0 ? pivot / m[j][j] : pivot;
+		smallest = relative < smallest ? relative : smallest;
+		if(!(pivot > 0))
+			return smallest;
+		l[j][j] = std::sqrt(pivot);
+		for(uint8_t i = j + 1; i < N; i++){
+			double value = m[i][j];
+			for(uint8_t k = 0; k < j; k++)
+				value -= l[i][k] * l[j][k];
+			l[i][j] = value / l[j][j];
+		}
+	}
+	return smallest;
+}
+
+// Covariance of attitude error and bias. Quaternion covariance turned into
+// body rotation angles drops the direction of the quaternion itself: the
+// norm is fixed by normalization, measurements and noise leave its
+// variance at rounding level and it may turn slightly negative.
+static void errorCovariance(const AttitudeEkf& ekf, double (&error)[6][6])
+{
+	const float* q = ekf.quaternion();
+	double t[AttitudeEkf::StateN][6] = {};
+	const double g[4][3] = {{-q[1], -q[2], -q[3]},
+							{ q[0], -q[3],  q[2]},
+							{ q[3],  q[0], -q[1]},
+							{-q[2],  q[1],  q[0]}};
+	for(uint8_t i = 0; i < 4; i++)
+		for(uint8_t j = 0; j < 3; j++)
+			t[i][j] = g[i][j];
+	for(uint8_t i = 0; i < 3; i++)
+		t[4 + i][3 + i] = 1;
+
+	const Covariance& p = ekf.covariance();
+	for(uint8_t i = 0; i < 6; i++)
+		for(uint8_t j = 0; j < 6; j++){
+			double sum = 0;
+			for(uint8_t k = 0; k < AttitudeEkf::StateN; k++)
+				for(uint8_t l = 0; l < AttitudeEkf::StateN; l++)
+					sum += t[k][i] * p(k, l) * t[l][j];
+			error[i][j] = sum;
+		}
+}
+
+// Variance along the quaternion relative to the largest variance
+static double normVariance(const AttitudeEkf& ekf)
+{
+	const float* q = ekf.quaternion();
+	const Covariance& p = ekf.covariance();
+	double sum = 0, scale = 0;
+	for(uint8_t i = 0; i < 4; i++)
+		for(uint8_t j = 0; j < 4; j++)
+			sum += q[i] * p(i, j) * q[j];
+	for(uint8_t i = 0; i < AttitudeEkf::StateN; i++)
+		scale = p(i, i) > scale ? p(i, i) : scale;
+	return std::fabs(sum) / scale;
+}
+
+static void checkForms(Random& random)
+{
+	// Rounding differences of the forms add up over a long run while the
+	// gains are small, short runs from fresh tilted starts compare the
+	// updates themselves, large gains included
+	float angleError = 0, biasError = 0, covarianceError = 0;
+	for(int run = 0; run < 100; run++){
+		AttitudeEkf sequential(ekfGyroNoise, ekfBiasDrift, ekfAccNoise, ekfHeadingNoise, AttitudeEkf::Sequential);
+		AttitudeEkf joint(ekfGyroNoise, ekfBiasDrift, ekfAccNoise, ekfHeadingNoise, AttitudeEkf::Joint);
+		Vector3<float> tilt((float)random.uniform(-0.5, 0.5), (float)random.uniform(-0.5, 0.5), 1);
+		sequential.reset(accReading(tilt));
+		joint.reset(accReading(tilt));
+
+		Vector3<float> rate((float)random.uniform(-1, 1), (float)random.uniform(-1, 1), (float)random.uniform(-1, 1));
+		for(int i = 0; i < 100; i++){
+			// Rocking craft measured with noise, every fourth reading comes
+			// from an accelerating craft and is trusted half
+			float t = i * deltaT;
+			Vector3<float> gyroReading = noisy(random, rate * std::cos(t), ekfGyroNoise);
+			Vector3<float> reading = accReading(noisy(random, tilt + rate * std::sin(t), 0.05f));
+			float weight = i % 4 == 0 ? 0.5f : 1;
+
+			sequential.predict(gyroReading, deltaT);
+			joint.predict(gyroReading, deltaT);
+			bool corrected = sequential.correct(reading, weight);
+			expect(corrected == joint.correct(reading, weight), "forms disagree on correcting in run %d", run);
+			if(i % headingInterval == 0){
+				float heading = (float)random.gaussian(math3d::Radians(2.0f));
+				sequential.correctHeading(heading, 1);
+				joint.correctHeading(heading, 1);
+			}
+
+			Vector3<float> angles = sequential.angles() - joint.angles();
+			Vector3<float> bias = sequential.bias() - joint.bias();
+			for(uint8_t j = 0; j < 3; j++){
+				// Yaw wraps around
+				float angle = std::fabs(std::remainder(angles[j], 2 * math3d::Pi));
+				angleError = angle > angleError ? angle : angleError;
+				biasError = std::fabs(bias[j]) > biasError ? std::fabs(bias[j]) : biasError;
+			}
+			float difference = largestDifference(sequential.covariance(), joint.covariance());
+			covarianceError = difference > covarianceError ? difference : covarianceError;
+		}
+	}
+	expect(angleError < 1e-5f, "update forms differ by %g rad in angles", angleError);
+	expect(biasError < 1e-6f, "update forms differ by %g rad/s in bias", biasError);
+	expect(covarianceError < 1e-5f, "update forms differ by %g of largest variance in covariance", covarianceError);
+}
+
+static void checkCovariance(Random& random)
+{
+	AttitudeEkf ekf(ekfGyroNoise, ekfBiasDrift, ekfAccNoise, ekfHeadingNoise);
+	ekf.reset(accReading(Vector3<float>(0, 0, 1)));
+
+	bool symmetric = true;
+	double smallest = 1, largestNorm = 0;
+	// Ten minutes of hover
+	for(int i = 0; i < 60000; i++){
+		ekf.predict(noisy(random, math3d::ZeroVector, ekfGyroNoise), deltaT);
+		ekf.correct(accReading(noisy(random, Vector3<float>(0, 0, 1), 0.05f)), 1);
+		if(i % headingInterval == 0)
+			ekf.correctHeading((float)random.gaussian(math3d::Radians(2.0f)), 1);
+
+		const Covariance& p = ekf.covariance();
+		for(uint8_t j = 0; j < AttitudeEkf::StateN; j++)
+			for(uint8_t k = j + 1; k < AttitudeEkf::StateN; k++)
+				symmetric = symmetric && p(j, k) == p(k, j);
+		double error[6][6];
+		errorCovariance(ekf, error);
+		double pivot = smallestPivot(error);
+		smallest = pivot < smallest ? pivot : smallest;
+		double norm = normVariance(ekf);
+		largestNorm = norm > largestNorm ? norm : largestNorm;
+	}
+	expect(symmetric, "covariance is not symmetric");
+	expect(smallest > 0, "covariance of attitude error and bias is not positive definite, smallest relative pivot %g",
+		   smallest);
+	expect(largestNorm < 1e-4, "variance along the quaternion grew to %g of the largest variance", largestNorm);
+}
+
+static void checkBias(Random& random)
+{
+	// Constant offset of about 1 deg/s left by calibration
+	Vector3<float> offset(math3d::Radians(1.0f), math3d::Radians(-0.8f), math3d::Radians(0.6f));
+	AttitudeEkf ekf(ekfGyroNoise, ekfBiasDrift, ekfAccNoise, ekfHeadingNoise);
+	ekf.reset(accReading(Vector3<float>(0, 0, 1)));
+
+	// Two minutes still, level and facing yaw zero
+	for(int i = 0; i < 12000; i++){
+		ekf.predict(noisy(random, offset, ekfGyroNoise), deltaT);
+		ekf.correct(accReading(noisy(random, Vector3<float>(0, 0, 1), 0.05f)), 1);
+		if(i % headingInterval == 0)
+			ekf.correctHeading((float)random.gaussian(math3d::Radians(2.0f)), 1);
+	}
+	for(uint8_t i = 0; i < 3; i++)
+		expect(std::fabs(ekf.bias()[i] - offset[i]) < 0.1f * std::fabs(offset[i]), "axis %u bias %f deg/s, true %f deg/s",
+			   i, math3d::Degrees(ekf.bias()[i]), math3d::Degrees(offset[i]));
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t seed = 1;
+	for(int i = 1; i < argc; i++){
+		if(std::strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = std::strtoull(argv[++i], nullptr, 10);
+		else{
+			std::fprintf(stderr, "usage: ekfcheck [-s seed]\n");
+			return 1;
+		}
+	}
+
+	Random random(seed);
+	checkForms(random);
+	checkCovariance(random);
+	checkBias(random);
+
+	std::printf("ekfcheck %s\n", failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
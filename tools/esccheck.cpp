@@ -0,0 +1,255 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Host check of the ESC outputs on the simulated timers. DShot frames are
+ * compared with hand computed vectors, including the checksum and the
+ * telemetry bit, and the DMA buffer with the compare values of each bit
+ * for every speed. OneShot125 and Multishot timer periods and compare
+ * values must give the nominal pulse widths at both ends of the range.
+ * Last the Model must leave every motor output stopped until its first
+ * update, in every protocol.
+ *
+ * Usage: esccheck
+ */
+
+#include "engine.h"
+#include "dshot.h"
+#include "model.h"
+#include "simHal.h"
+
+#include <stm32f30x_tim.h>
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+
+static int failures = 0;
+
+static void expect(bool ok, const char* format, ...)
+{
+	if(ok)
+		return;
+	va_list args;
+	va_start(args, format);
+	std::printf("FAIL ");
+	std::vprintf(format, args);
+	std::printf("\n");
+	va_end(args);
+	failures++;
+}
+
+// Standard 1-2 ms pulses at 2 MHz pwm timer
+static const uint16_t linearTicks[] = {2000, 4000};
+static const ActuatorTable linearTable(linearTicks, 2);
+
+struct FrameVector
+{
+	uint16_t value;
+	bool telemetry;
+	uint16_t frame;
+};
+
+// Value shifted left by one with telemetry bit, then XOR of its three nibbles
+static const FrameVector frameVectors[] = {
+	{0,    false, 0x0000},
+	{0,    true,  0x0011},
+	{48,   false, 0x0606},
+	{1046, false, 0x82C6},
+	{2047, false, 0xFFEE},
+	{2047, true,  0xFFFF}
+};
+
+static void checkFrames()
+{
+	for(unsigned i = 0; i < sizeof(frameVectors) / sizeof(frameVectors[0]); i++){
+		const FrameVector& v = frameVectors[i];
+		uint16_t frame = Dshot::frame(v.value, v.telemetry);
+		expect(frame == v.frame, "frame of %u telemetry %d is 0x%04X, wanted 0x%04X", v.value, v.telemetry, frame, v.frame);
+	}
+
+	expect(Dshot::throttleValue(0) == 0 && Dshot::throttleValue(-0.5f) == 0, "zero throttle does not stop motor");
+	expect(Dshot::throttleValue(1e-4f) == Dshot::MinThrottle, "smallest throttle gives %u", Dshot::throttleValue(1e-4f));
+	expect(Dshot::throttleValue(0.5f) == 1048, "half throttle gives %u", Dshot::throttleValue(0.5f));
+	expect(Dshot::throttleValue(1) == Dshot::MaxThrottle && Dshot::throttleValue(2) == Dshot::MaxThrottle,
+		   "full throttle gives %u", Dshot::throttleValue(1));
+}
+
+// Frame sent on channel, decoded from the compare values of the DMA buffer
+static bool decode(const uint16_t* buffer, uint8_t channel, uint16_t one, uint16_t zero, uint16_t& frame)
+{
+	frame = 0;
+	for(uint8_t bit = 0; bit < Dshot::FrameBits; bit++){
+		uint16_t compare = buffer[bit * Dshot::ChannelN + channel - 1];
+		if(compare != one && compare != zero)
+			return false;
+		frame = (frame << 1) | (compare == one ? 1 : 0);
+	}
+	// Line stays low after the frame
+	for(uint8_t slot = Dshot::FrameBits; slot < Dshot::SlotN; slot++)
+		if(buffer[slot * Dshot::ChannelN + channel - 1] != 0)
+			return false;
+	return true;
+}
+
+static void checkDshotBuffer()
+{
+	static const Engine::Protocol protocols[] = {Engine::Dshot150, Engine::Dshot300, Engine::Dshot600};
+	static const uint32_t speeds[] = {150, 300, 600};
+
+	for(int p = 0; p < 3; p++){
+		TIM_DeInit(TIM1);
+		Engine::configureTimer(TIM1, protocols[p]);
+
+		// Bit period in timer clock, 1 is high for 3/4 and 0 for 3/8 of it
+		uint32_t period = SystemCoreClock / (speeds[p] * 1000);
+		expect(TIM1->ARR + 1 == period && TIM1->PSC == 0, "DShot%lu period %lu, wanted %lu", (unsigned long)speeds[p],
+			   (unsigned long)(TIM1->ARR + 1), (unsigned long)period);
+		expect(TIM1->DCR == (TIM_DMABase_CCR1 | TIM_DMABurstLength_4Transfers) && (TIM1->DIER & TIM_DMA_Update),
+			   "DShot%lu burst not set to CCR1..CCR4 on update", (unsigned long)speeds[p]);
+		uint16_t one = period * 3 / 4, zero = period * 3 / 8;
+
+		Dshot* output = Dshot::output(TIM1);
+		uint16_t values[] = {0, 48, 1046, 2047};
+		for(uint8_t channel = 1; channel <= Dshot::ChannelN; channel++)
+			output->value(channel, values[channel - 1]);
+
+		for(uint8_t channel = 1; channel <= Dshot::ChannelN; channel++){
+			uint16_t frame;
+			bool valid = decode(output->buffer(), channel, one, zero, frame);
+			expect(valid && frame == Dshot::frame(values[channel - 1]), "DShot%lu channel %u sends 0x%04X, wanted 0x%04X",
+				   (unsigned long)speeds[p], channel, frame, Dshot::frame(values[channel - 1]));
+		}
+
+		output->send();
+		expect((DMA1_Channel5->CCR & DMA_CCR_EN) && DMA1_Channel5->CNDTR == Dshot::SlotN * Dshot::ChannelN &&
+			   DMA1_Channel5->CMAR == (uintptr_t)output->buffer() && DMA1_Channel5->CPAR == (uintptr_t)&TIM1->DMAR,
+			   "DShot%lu DMA not armed for whole buffer", (unsigned long)speeds[p]);
+
+		// Engine maps the ends of its table to motor stop and full throttle
+		Engine engine(TIM1, 2, &linearTable, protocols[p]);
+		uint16_t frame;
+		engine.throttle(0);
+		decode(output->buffer(), 2, one, zero, frame);
+		expect(frame == Dshot::frame(0), "DShot%lu engine at zero sends 0x%04X", (unsigned long)speeds[p], frame);
+		engine.throttle(1);
+		decode(output->buffer(), 2, one, zero, frame);
+		expect(frame == Dshot::frame(Dshot::MaxThrottle), "DShot%lu engine at full sends 0x%04X", (unsigned long)speeds[p], frame);
+	}
+}
+
+// Pulse of one pulse mode channel, trailing edge so high from compare to overflow
+static double oneShotPulse(uint8_t channel)
+{
+	uint32_t compare = TIM1->activeCCR[channel - 1];
+	return (double)(TIM1->ARR + 1 - compare) * (TIM1->PSC + 1) / SystemCoreClock;
+}
+
+static void checkOneShot(Engine::Protocol protocol, const char* name, double frequency, uint32_t period,
+						 double minPulse, double maxPulse)
+{
+	TIM_DeInit(TIM1);
+	Engine::configureTimer(TIM1, protocol);
+	expect(SystemCoreClock / (TIM1->PSC + 1) == frequency && TIM1->ARR + 1 == period && (TIM1->CR1 & TIM_CR1_OPM),
+		   "%s timer at %lu Hz period %lu", name, (unsigned long)(SystemCoreClock / (TIM1->PSC + 1)),
+		   (unsigned long)(TIM1->ARR + 1));
+
+	Engine engine(TIM1, 1, &linearTable, protocol);
+	double ends[] = {minPulse, maxPulse};
+	for(int end = 0; end < 2; end++){
+		engine.throttle(end);
+		Engine::trigger(TIM1, protocol);
+		double pulse = oneShotPulse(1);
+		expect(std::fabs(pulse - ends[end]) < 1e-9 && (TIM1->CR1 & TIM_CR1_CEN),
+			   "%s throttle %d pulse %.3f us, wanted %.3f us", name, end, pulse * 1e6, ends[end] * 1e6);
+	}
+	engine.throttle(0.5f);
+	Engine::trigger(TIM1, protocol);
+	expect(std::fabs(oneShotPulse(1) - (minPulse + maxPulse) / 2) < 1e-9, "%s half throttle pulse %.3f us",
+		   name, oneShotPulse(1) * 1e6);
+}
+
+// Motors of a freshly constructed model are stopped in every protocol
+static void checkModelStart()
+{
+	static const Engine::Protocol protocols[] = {Engine::StandardPwm, Engine::OneShot125, Engine::Multishot,
+												 Engine::Dshot150, Engine::Dshot300, Engine::Dshot600};
+	static const char* names[] = {"pwm", "OneShot125", "Multishot", "DShot150", "DShot300", "DShot600"};
+
+	for(int p = 0; p < 6; p++){
+		TIM_DeInit(TIM1);
+		TIM_DeInit(TIM4);
+		Engine::configureTimer(TIM1, protocols[p]);
+		Pwm::configureTimer(TIM4, 50);
+		Model model(protocols[p]);
+
+		for(uint8_t engine = 0; engine < 3; engine++)
+			expect(model.throttle(engine) == 0, "%s engine %u starts at %f", names[p], engine, model.throttle(engine));
+
+		uint8_t channel;
+		switch(protocols[p]){
+		case Engine::StandardPwm:
+			// Compare values are preloaded, the first period takes them
+			simTimerUpdateEvent(TIM1);
+			for(channel = 1; channel <= 3; channel++)
+				expect(std::fabs(simTimerPulseWidth(TIM1, channel) - 1e-3) < 1e-9, "%s channel %u starts at %.3f ms",
+					   names[p], channel, simTimerPulseWidth(TIM1, channel) * 1e3);
+			break;
+		case Engine::OneShot125:
+		case Engine::Multishot:{
+			double minPulse = protocols[p] == Engine::OneShot125 ? 125e-6 : 5e-6;
+			for(channel = 1; channel <= 3; channel++)
+				expect(std::fabs(oneShotPulse(channel) - minPulse) < 1e-9, "%s channel %u starts at %.3f us",
+					   names[p], channel, oneShotPulse(channel) * 1e6);
+			break;}
+		default:{
+			uint32_t period = TIM1->ARR + 1;
+			for(channel = 1; channel <= 3; channel++){
+				uint16_t frame;
+				bool valid = decode(Dshot::output(TIM1)->buffer(), channel, period * 3 / 4, period * 3 / 8, frame);
+				expect(valid && frame == Dshot::frame(0), "%s channel %u starts with 0x%04X", names[p], channel, frame);
+			}
+			break;}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if(argc > 1){
+		std::fprintf(stderr, "usage: esccheck\n");
+		return 1;
+	}
+
+	checkFrames();
+	checkDshotBuffer();
+	// OneShot125 is standard pwm 8 times faster, Multishot 5-25 us
+	checkOneShot(Engine::OneShot125, "OneShot125", 24e6, 6300, 125e-6, 250e-6);
+	checkOneShot(Engine::Multishot, "Multishot", 72e6, 1872, 5e-6, 25e-6);
+	checkModelStart();
+
+	std::printf("esccheck %s\n", failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
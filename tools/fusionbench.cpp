@@ -0,0 +1,312 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Open loop evaluation of the attitude fusion on manoeuvres that
+ * accelerate the craft. Sensor readings are synthesized from known
+ * attitude and specific force, then fed to the complementary filter once
+ * with its fixed gain, once with the gain weighted by the acceleration
+ * trust and to the attitude EKF with the same trust. Per manoeuvre the
+ * pitch/roll estimation error is reported in degrees together with the
+ * mean trust. Costs of one trust update and of one EKF step, prediction
+ * and accelerometer correction, follow in nanoseconds and, on x86, in
+ * time stamp counter cycles for both EKF update forms.
+ *
+ * Manoeuvres, 100 Hz like the flight loop:
+ *   hover  level and still, noise alone must not turn the correction off
+ *   dash   pitch 20 degrees forward, then 20 degrees back to brake,
+ *          speed limited by drag
+ *   orbit  coordinated 30 degree banked turn, specific force stays on
+ *          body Z so the accelerometer alone reads level flight
+ *
+ * Usage: fusionbench [-s seed] [-a accNoise] [-g gyroBias]
+ *
+ * Accelerometer noise is in g, gyroscope bias deviation in deg/s.
+ */
+
+#include "complementaryFilter2.h"
+#include "accelerationTrust.h"
+#include "attitudeEkf.h"
+#include "random.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_TSC
+#endif
+
+using math3d::Vector3;
+
+static const double deltaT = 0.01;
+static const double gravity = 9.81;
+// Linear drag of the dash, 1/s
+static const double drag = 0.5;
+
+// Same fusion settings as src/main.cpp
+static const float filterTimeConst = 0.49f;
+static const float magnitudeTolerance = 0.05f, magnitudeLimit = 0.15f;
+static const float jerkTolerance = 0.1f, jerkLimit = 0.3f;
+
+// Same EKF settings as src/main.cpp
+static const float ekfGyroNoise = math3d::Radians(0.3f);
+static const float ekfBiasDrift = math3d::Radians(0.01f);
+static const float ekfAccNoise = 0.3f;
+static const float ekfHeadingNoise = math3d::Radians(5.0f);
+
+// Accelerometer readings averaged for the EKF initial tilt
+static const int alignN = 16;
+
+// Residual gyro bias and noise per sample in rad/s, accelerometer noise in g
+static double gyroBias = math3d::Radians(0.2);
+static const double gyroNoise = math3d::Radians(0.3);
+static double accNoise = 0.05;
+
+enum Manoeuvre {Hover, Dash, Orbit, ManoeuvreN};
+
+static const char* const manoeuvreNames[ManoeuvreN] = {"hover", "dash", "orbit"};
+static const double manoeuvreDurations[ManoeuvreN] = {20, 12, 16};
+
+// Angle held at peak between linear ramps, zero outside
+static double trapezoid(double time, double start, double ramp, double hold, double peak)
+{
+	double t = time - start;
+	if(t <= 0 || t >= 2 * ramp + hold)
+		return 0;
+	if(t < ramp)
+		return peak * t / ramp;
+	if(t < ramp + hold)
+		return peak;
+	return peak * (2 * ramp + hold - t) / ramp;
+}
+
+// True pitch and roll at time
+static Vector3<double> attitude(Manoeuvre manoeuvre, double time)
+{
+	switch(manoeuvre){
+	case Hover:
+		return Vector3<double>();
+	case Dash:
+		return Vector3<double>(trapezoid(time, 1, 0.5, 3, math3d::Radians(20.0)) - trapezoid(time, 5, 0.5, 2, math3d::Radians(20.0)), 0, 0);
+	case Orbit:
+		return Vector3<double>(0, trapezoid(time, 2, 1, 10, math3d::Radians(30.0)), 0);
+	default:
+		return Vector3<double>();
+	}
+}
+
+enum Estimator {Fixed, Weighted, Ekf, EstimatorN};
+
+static const char* const estimatorNames[EstimatorN] = {"fixed", "weighted", "ekf"};
+
+struct Result
+{
+	double rms[2];
+	double max[2];
+	double meanWeight;
+};
+
+static void accumulate(double error[2], double sum[2], double max[2])
+{
+	for(int i = 0; i < 2; i++){
+		sum[i] += error[i] * error[i];
+		max[i] = std::fabs(error[i]) > max[i] ? std::fabs(error[i]) : max[i];
+	}
+}
+
+static void run(Manoeuvre manoeuvre, uint64_t seed, Result results[EstimatorN])
+{
+	Random random(seed);
+	Vector3<double> bias(random.gaussian(gyroBias), random.gaussian(gyroBias), 0);
+
+	ComplementaryFilter2 fixedFilter(deltaT, filterTimeConst);
+	ComplementaryFilter2 weightedFilter(deltaT, filterTimeConst);
+	AccelerationTrust trust(magnitudeTolerance, magnitudeLimit, jerkTolerance, jerkLimit);
+	AttitudeEkf ekf(ekfGyroNoise, ekfBiasDrift, ekfAccNoise, ekfHeadingNoise);
+
+	double sum[EstimatorN][2];
+	for(int e = 0; e < EstimatorN; e++)
+		sum[e][0] = sum[e][1] = results[e].max[0] = results[e].max[1] = 0;
+	double weightSum = 0;
+	double velocity = 0;
+
+	// Complementary filters start at the true level attitude, EKF is
+	// aligned on readings of the craft standing still before the start
+	Random alignRandom(seed ^ 0xA11647ull);
+	Vector3<float> still;
+	for(int i = 0; i < alignN; i++)
+		still += Vector3<float>(alignRandom.gaussian(accNoise), alignRandom.gaussian(accNoise), 1 + alignRandom.gaussian(accNoise));
+	ekf.reset(still / (float)alignN);
+
+	long n = 0;
+
+	Vector3<double> previous = attitude(manoeuvre, 0);
+	for(double time = deltaT; time <= manoeuvreDurations[manoeuvre]; time += deltaT, n++){
+		Vector3<double> truth = attitude(manoeuvre, time);
+		double pitch = truth[0], roll = truth[1];
+
+		// Specific force in g, body axes
+		Vector3<double> force;
+		if(manoeuvre == Hover)
+			force = Vector3<double>(0, 0, 1);
+		else if(manoeuvre == Orbit)
+			force = Vector3<double>(0, 0, 1 / std::cos(roll));
+		else{
+			// Thrust holds altitude, drag slows the horizontal motion
+			double acceleration = gravity * std::tan(pitch) - drag * velocity;
+			velocity += acceleration * deltaT;
+			double horizontal = acceleration / gravity;
+			force = Vector3<double>(horizontal * std::cos(pitch) - std::sin(pitch), 0, horizontal * std::sin(pitch) + std::cos(pitch));
+		}
+
+		Vector3<float> accReading(force[0] + random.gaussian(accNoise), force[1] + random.gaussian(accNoise),
+								  force[2] + random.gaussian(accNoise));
+		Vector3<float> gyroAngle((truth[0] - previous[0]) + (bias[0] + random.gaussian(gyroNoise)) * deltaT,
+								 (truth[1] - previous[1]) + (bias[1] + random.gaussian(gyroNoise)) * deltaT, 0);
+		previous = truth;
+
+		Vector3<float> accAngle(std::atan2(-accReading[0], std::sqrt(accReading[1] * accReading[1] + accReading[2] * accReading[2])),
+								-std::atan2(accReading[1], std::sqrt(accReading[0] * accReading[0] + accReading[2] * accReading[2])),
+								0);
+
+		Vector3<float> angles[EstimatorN];
+		angles[Fixed] = fixedFilter.addSample(accAngle, gyroAngle);
+		float weight = trust.update(accReading);
+		angles[Weighted] = weightedFilter.addSample(accAngle, gyroAngle, weight);
+		weightSum += weight;
+		ekf.predict(gyroAngle / (float)deltaT, deltaT);
+		ekf.correct(accReading, weight);
+		angles[Ekf] = ekf.angles();
+
+		for(int e = 0; e < EstimatorN; e++){
+			double error[2] = {angles[e][0] - pitch, angles[e][1] - roll};
+			accumulate(error, sum[e], results[e].max);
+		}
+	}
+
+	for(int e = 0; e < EstimatorN; e++){
+		for(int i = 0; i < 2; i++){
+			results[e].rms[i] = math3d::Degrees(std::sqrt(sum[e][i] / n));
+			results[e].max[i] = math3d::Degrees(results[e].max[i]);
+		}
+		results[e].meanWeight = e == Fixed ? 1 : weightSum / n;
+	}
+}
+
+// Nanoseconds per trust update on noisy readings
+static double trustCost(uint64_t seed)
+{
+	const long updateN = 1000000;
+	Random random(seed);
+	Vector3<float> readings[256];
+	for(int i = 0; i < 256; i++)
+		readings[i] = Vector3<float>(random.gaussian(accNoise), random.gaussian(accNoise), 1 + random.gaussian(accNoise));
+
+	AccelerationTrust trust(magnitudeTolerance, magnitudeLimit, jerkTolerance, jerkLimit);
+	volatile float sink = 0;
+	auto start = std::chrono::steady_clock::now();
+	for(long i = 0; i < updateN; i++)
+		sink = sink + trust.update(readings[i & 255]);
+	double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return time / updateN * 1e9;
+}
+
+struct Cost
+{
+	double ns;
+	double cycles;
+};
+
+// One EKF prediction and accelerometer correction on noisy readings
+static Cost ekfCost(uint64_t seed, AttitudeEkf::UpdateForm form)
+{
+	const long updateN = 200000;
+	Random random(seed);
+	Vector3<float> rates[256], readings[256];
+	for(int i = 0; i < 256; i++){
+		rates[i] = Vector3<float>(random.gaussian(gyroNoise), random.gaussian(gyroNoise), random.gaussian(gyroNoise));
+		readings[i] = Vector3<float>(random.gaussian(accNoise), random.gaussian(accNoise), 1 + random.gaussian(accNoise));
+	}
+
+	AttitudeEkf ekf(ekfGyroNoise, ekfBiasDrift, ekfAccNoise, ekfHeadingNoise, form);
+	volatile float sink = 0;
+	Cost cost = {0, 0};
+	auto start = std::chrono::steady_clock::now();
+#ifdef HAS_TSC
+	uint64_t startCycles = __rdtsc();
+#endif
+	for(long i = 0; i < updateN; i++){
+		ekf.predict(rates[i & 255], deltaT);
+		ekf.correct(readings[i & 255], 1);
+		sink = sink + ekf.bias()[0];
+	}
+#ifdef HAS_TSC
+	cost.cycles = (double)(__rdtsc() - startCycles) / updateN;
+#endif
+	double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	cost.ns = time / updateN * 1e9;
+	return cost;
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t seed = 1;
+	for(int i = 1; i < argc; i++){
+		bool hasValue = i + 1 < argc;
+		if(std::strcmp(argv[i], "-s") == 0 && hasValue)
+			seed = std::strtoull(argv[++i], nullptr, 10);
+		else if(std::strcmp(argv[i], "-a") == 0 && hasValue)
+			accNoise = std::atof(argv[++i]);
+		else if(std::strcmp(argv[i], "-g") == 0 && hasValue)
+			gyroBias = math3d::Radians(std::atof(argv[++i]));
+		else{
+			std::fprintf(stderr, "usage: fusionbench [-s seed] [-a accNoise] [-g gyroBias]\n");
+			return 1;
+		}
+	}
+
+	for(int m = 0; m < ManoeuvreN; m++){
+		Result results[EstimatorN];
+		run((Manoeuvre)m, seed + m, results);
+		std::printf("%-5s", manoeuvreNames[m]);
+		for(int e = 0; e < EstimatorN; e++)
+			std::printf("%s %s pitchRms=%.2f pitchMax=%.2f rollRms=%.2f rollMax=%.2f", e > 0 ? " |" : "", estimatorNames[e],
+						results[e].rms[0], results[e].max[0], results[e].rms[1], results[e].max[1]);
+		std::printf(" meanWeight=%.3f\n", results[Weighted].meanWeight);
+	}
+
+	Cost sequential = ekfCost(seed, AttitudeEkf::Sequential);
+	Cost joint = ekfCost(seed, AttitudeEkf::Joint);
+	std::printf("trustNs=%.1f ekfSequentialNs=%.1f ekfJointNs=%.1f", trustCost(seed), sequential.ns, joint.ns);
+#ifdef HAS_TSC
+	std::printf(" ekfSequentialCycles=%.0f ekfJointCycles=%.0f", sequential.cycles, joint.cycles);
+#endif
+	std::printf("\n");
+	return 0;
+}
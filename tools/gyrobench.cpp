@@ -0,0 +1,439 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Gyroscope full scale auto-ranging against the simulated L3GD20. The
+ * driver talks to the register model through host replacements of the
+ * bus and system time, samples are produced at the output data rate from
+ * a known rate profile. Every sample the driver returns is compared with
+ * the true rate it was taken from, so a sample scaled with the wrong full
+ * scale shows up as error far beyond quantization. Each manoeuvre runs
+ * with the scale fixed at 250, 500 and 2000 dps and with auto-ranging
+ * starting at 500 dps, in FIFO mode read every millisecond, in bypass
+ * mode read by the 100 Hz flight loop and in bypass mode polled every
+ * 0.3 ms, where the last sample of old scale is read after a switch.
+ * The race reading is FIFO mode with a sample forced just before or just
+ * after every full scale write. Samples that come between the FIFO source
+ * reads around the write may have either scale, the driver has to drop
+ * exactly these.
+ *
+ * Reported per run in dps: RMS and maximum error, samples clipped by the
+ * full scale, samples scaled wrong while the rate fits every full scale,
+ * error of integrated angle in degrees, scale switches, share of time at
+ * 250 dps and samples dropped at switches.
+ *
+ * Manoeuvres:
+ *   hover  gentle wobble on all axes, well within 250 dps
+ *   rock   300 dps roll oscillation, between 250 and 500 dps full scale
+ *   flip   hover, full roll flip peaking at 720 dps, hover again
+ *
+ * Usage: gyrobench [-s seed] [-n noise]
+ *
+ * Noise is white noise deviation in dps, misscaling is judged against
+ * quantization of the 2000 dps scale widened by five deviations. Exit
+ * status is non-zero when any sample is misscaled, auto-ranging lets any
+ * sample clip or the driver drops other samples than the ones taken
+ * around a switch.
+ */
+
+#include "gyroscope.h"
+#include "systime.h"
+#include "l3gd20Model.h"
+#include "random.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+
+enum Manoeuvre {Hover, Rock, Flip, ManoeuvreN};
+static const char* manoeuvreNames[ManoeuvreN] = {"hover", "rock", "flip"};
+
+// FIFO read every millisecond, bypass read by the flight loop, bypass
+// polled faster than samples come and FIFO with samples at scale writes
+enum Reading {FifoRead, LoopRead, PollRead, RaceRead, ReadingN};
+static const char* readingNames[ReadingN] = {"fifo", "loop", "poll", "race"};
+static const uint64_t readingPeriods[ReadingN] = {1000, 10000, 300, 1000};
+
+enum Ranging {Fixed250, Fixed500, Fixed2000, Auto, RangingN};
+static const char* rangingNames[RangingN] = {"250", "500", "2000", "auto"};
+static const uint8_t rangingScales[RangingN] = {L3GD20_FULLSCALE_250, L3GD20_FULLSCALE_500, L3GD20_FULLSCALE_2000,
+												L3GD20_FULLSCALE_500};
+
+static const double duration = 4;
+// Rates every full scale represents exactly
+static const double commonRange = 225;
+// Half digit of 2000 dps scale with float rounding
+static const double quantization = 0.036;
+
+static double noise = 0;
+
+// --- Host replacements of system time and L3GD20 bus ---
+
+uint64_t systemTime = 0;
+
+// True rate of a sample and its time, ambiguous when it came between the
+// FIFO source reads around a full scale write
+struct Truth
+{
+	Truth() : time(0), ambiguous(false) {}
+
+	math3d::Vector3<double> rate;
+	double time;
+	bool ambiguous;
+};
+
+static L3gd20Model* sensor;
+static Manoeuvre manoeuvre;
+// Time manoeuvre starts at and time of next sample in microseconds
+static double startTime;
+static double nextSample;
+// True rate of last produced sample, of samples in sensor FIFO and of
+// samples read by the driver not yet returned
+static Truth lastTruth;
+static std::deque<Truth> fifoTruths;
+static std::deque<Truth> readTruths;
+// Samples are forced around full scale writes, every other one before it
+static bool racing;
+static int scaleWrites;
+// Time of last FIFO source read, of the one before a full scale write in
+// FIFO mode while the next read is awaited
+static double sourceReadTime;
+static double switchTime;
+static bool switching;
+
+// True rate in dps at time in seconds
+static math3d::Vector3<double> rate(double t)
+{
+	math3d::Vector3<double> wobble(15 * std::sin(2 * M_PI * 1.3 * t), 10 * std::sin(2 * M_PI * 0.7 * t),
+								   5 * std::sin(2 * M_PI * 0.3 * t));
+	switch(manoeuvre){
+	case Rock:
+		return math3d::Vector3<double>(wobble[0], 300 * std::sin(2 * M_PI * 2 * t), wobble[2]);
+	case Flip:{
+		// 0.1 s ramps around 0.4 s at 720 dps make 360 degrees
+		double flip = 0;
+		if(t >= 1 && t < 1.1)
+			flip = 7200 * (t - 1);
+		else if(t >= 1.1 && t < 1.5)
+			flip = 720;
+		else if(t >= 1.5 && t < 1.6)
+			flip = 7200 * (1.6 - t);
+		return math3d::Vector3<double>(wobble[0], wobble[1] + flip, wobble[2]);
+	}
+	default:
+		return wobble;
+	}
+}
+
+static void advance(uint64_t microseconds)
+{
+	uint64_t end = systemTime + microseconds;
+	while(sensor->dataRate() > 0 && nextSample <= end){
+		systemTime = (uint64_t)nextSample;
+		lastTruth.rate = rate((nextSample - startTime) * 1e-6);
+		lastTruth.time = nextSample;
+		lastTruth.ambiguous = false;
+		sensor->sample(math3d::Vector3<double>(math3d::Radians(lastTruth.rate[0]), math3d::Radians(lastTruth.rate[1]),
+											   math3d::Radians(lastTruth.rate[2])));
+		fifoTruths.push_back(lastTruth);
+		if(fifoTruths.size() > 32)
+			fifoTruths.pop_front();
+		nextSample += 1e6 / sensor->dataRate();
+	}
+	systemTime = end;
+}
+
+uint64_t getSystemTime()
+{
+	return systemTime;
+}
+
+void restartSystemTime()
+{
+	systemTime = 0;
+}
+
+void sleep(uint64_t duration, TimeUnit unit)
+{
+	advance((duration * SYSTEM_TIME_RESOLUTION) / unit);
+}
+
+// Sample produced right now, off the output data rate
+static void forceSample()
+{
+	nextSample = (double)systemTime;
+	advance(0);
+}
+
+// SPI at 9 MHz, same timing as the simulator
+void L3GD20_Write(uint8_t* pBuffer, uint8_t WriteAddr, uint16_t NumByteToWrite)
+{
+	uint8_t address = WriteAddr & 0x3F;
+	uint8_t fifoCtrl;
+	sensor->read(&fifoCtrl, L3GD20_FIFO_CTRL_REG_ADDR, 1);
+	bool scaleWrite = address == L3GD20_CTRL_REG4_ADDR && (fifoCtrl & 0xE0) != 0;
+	if(scaleWrite){
+		switchTime = sourceReadTime;
+		switching = true;
+	}
+
+	bool before = scaleWrites % 2 == 0;
+	if(scaleWrite && racing && before)
+		forceSample();
+	sensor->write(pBuffer, address, NumByteToWrite);
+	if(scaleWrite && racing && !before)
+		forceSample();
+	scaleWrites += scaleWrite ? 1 : 0;
+
+	if(address == L3GD20_FIFO_CTRL_REG_ADDR && (pBuffer[0] & 0xE0) == 0)
+		fifoTruths.clear();
+	advance(1 + ((NumByteToWrite + 1) * 8 + 8) / 9);
+}
+
+void L3GD20_Read(uint8_t* pBuffer, uint8_t ReadAddr, uint16_t NumByteToRead)
+{
+	uint8_t address = ReadAddr & 0x3F;
+	uint8_t fifoSrc;
+	sensor->read(&fifoSrc, L3GD20_FIFO_SRC_REG_ADDR, 1);
+	sensor->read(pBuffer, address, NumByteToRead);
+
+	// Samples stored since the source read before a full scale write were
+	// taken with either scale
+	if(address == L3GD20_FIFO_SRC_REG_ADDR){
+		if(switching)
+			for(size_t i = 0; i < fifoTruths.size(); i++)
+				fifoTruths[i].ambiguous = fifoTruths[i].ambiguous || fifoTruths[i].time > switchTime;
+		switching = false;
+		sourceReadTime = (double)systemTime;
+	}
+
+	// Output registers in FIFO mode take the oldest sample unless FIFO is
+	// empty, in bypass mode they may be read along with status register
+	if(address == L3GD20_OUT_X_L_ADDR || (address == L3GD20_STATUS_REG_ADDR && NumByteToRead > 1)){
+		uint8_t fifoCtrl;
+		sensor->read(&fifoCtrl, L3GD20_FIFO_CTRL_REG_ADDR, 1);
+		if((fifoCtrl & 0xE0) != 0 && (fifoSrc & 0x20) == 0){
+			lastTruth = fifoTruths.front();
+			fifoTruths.pop_front();
+		}
+		readTruths.push_back(lastTruth);
+	}
+	advance(1 + ((NumByteToRead + 1) * 8 + 8) / 9);
+}
+
+void L3GD20_Init(L3GD20_InitTypeDef* L3GD20_InitStruct)
+{
+	uint8_t ctrl1 = L3GD20_InitStruct->Output_DataRate | L3GD20_InitStruct->Band_Width |
+					L3GD20_InitStruct->Power_Mode | L3GD20_InitStruct->Axes_Enable;
+	uint8_t ctrl4 = L3GD20_InitStruct->BlockData_Update | L3GD20_InitStruct->Endianness |
+					L3GD20_InitStruct->Full_Scale;
+
+	L3GD20_Write(&ctrl1, L3GD20_CTRL_REG1_ADDR, 1);
+	L3GD20_Write(&ctrl4, L3GD20_CTRL_REG4_ADDR, 1);
+}
+
+void L3GD20_FilterConfig(L3GD20_FilterConfigTypeDef*)
+{
+}
+
+void L3GD20_FilterCmd(uint8_t)
+{
+}
+
+// --- Bench ---
+
+struct Result
+{
+	Result() : rms(0), max(0), clipped(0), misscaled(0), angle(0), switches(0), lowShare(0), dropped(0), wrongDrops(0) {}
+
+	double rms;
+	double max;
+	int clipped;
+	int misscaled;
+	double angle;
+	int switches;
+	double lowShare;
+	// Samples dropped by the driver, the ones not taken around full scale writes
+	int dropped;
+	int wrongDrops;
+};
+
+static Result run(Manoeuvre m, Ranging ranging, Reading reading, uint64_t seed)
+{
+	Random random(seed);
+	L3gd20Model model(random);
+	MemsErrors errors;
+	errors.noise = math3d::Radians(noise);
+	model.errors(errors);
+
+	sensor = &model;
+	manoeuvre = m;
+	systemTime = 0;
+	startTime = 0;
+	nextSample = 0;
+	lastTruth = Truth();
+	fifoTruths.clear();
+	racing = reading == RaceRead;
+	scaleWrites = 0;
+	sourceReadTime = 0;
+	switching = false;
+
+	L3GD20_InitTypeDef gyroInit;
+	L3GD20_FilterConfigTypeDef gyroFilterConfig;
+	gyroInit.Power_Mode         = L3GD20_MODE_ACTIVE;
+	gyroInit.Output_DataRate    = L3GD20_OUTPUT_DATARATE_4;
+	gyroInit.Axes_Enable        = L3GD20_AXES_ENABLE;
+	gyroInit.Band_Width         = L3GD20_BANDWIDTH_4;
+	gyroInit.BlockData_Update   = L3GD20_BlockDataUpdate_Continous;
+	gyroInit.Endianness         = L3GD20_BLE_LSB;
+	gyroInit.Full_Scale         = rangingScales[ranging];
+	gyroFilterConfig.HighPassFilter_Mode_Selection = L3GD20_HPM_NORMAL_MODE_RES;
+	gyroFilterConfig.HighPassFilter_CutOff_Frequency = L3GD20_HPFCF_0;
+
+	Gyroscope gyro(gyroInit, gyroFilterConfig, 0);
+	bool fifo = reading == FifoRead || reading == RaceRead;
+	if(fifo)
+		gyro.selectMode(Gyroscope::FifoMode);
+	while(!gyro.ready())
+		advance(100);
+	gyro.autoRange(ranging == Auto);
+
+	// Manoeuvre starts once the driver is ready
+	gyro.discard(true);
+	readTruths.clear();
+	startTime = systemTime;
+	uint64_t start = systemTime;
+
+	uint64_t period = readingPeriods[reading];
+	double deltaT = fifo ? 1 / sensor->dataRate() : period * 1e-6;
+	double threshold = quantization + 5 * noise;
+	uint8_t scale = gyro.scale();
+	uint32_t dropped = 0;
+	int n = 0, low = 0;
+	Result result;
+
+	while(systemTime - start < duration * SYSTEM_TIME_RESOLUTION){
+		uint64_t next = systemTime + period;
+		for(;;){
+			math3d::Vector3<float> value = gyro.readValue();
+			// Samples dropped by the driver have no value, ambiguous ones
+			// it keeps are judged by the scale they were really taken with
+			for(; dropped < gyro.droppedSamples(); dropped++){
+				std::deque<Truth>::iterator truth = readTruths.begin();
+				while(truth != readTruths.end() && !truth->ambiguous)
+					truth++;
+				if(truth != readTruths.end())
+					readTruths.erase(truth);
+				else
+					result.wrongDrops++;
+			}
+			if(readTruths.empty())
+				break;
+			math3d::Vector3<double> truth = readTruths.front().rate;
+			readTruths.pop_front();
+
+			bool fits = true;
+			double peak = 0;
+			for(int i = 0; i < 3; i++){
+				double error = std::fabs(math3d::Degrees((double)value[i]) - truth[i]);
+				result.rms += error * error;
+				result.max = error > result.max ? error : result.max;
+				result.angle += (math3d::Degrees((double)value[i]) - truth[i]) * deltaT;
+				peak = error > peak ? error : peak;
+				fits = fits && std::fabs(truth[i]) <= commonRange;
+			}
+			if(peak > threshold){
+				if(fits)
+					result.misscaled++;
+				else
+					result.clipped++;
+			}
+			if(gyro.scale() != scale){
+				scale = gyro.scale();
+				result.switches++;
+			}
+			low += scale == L3GD20_FULLSCALE_250;
+			n++;
+			// Bypass mode returns single sample per loop
+			if(!fifo)
+				break;
+		}
+		if(next > systemTime)
+			advance(next - systemTime);
+	}
+
+	result.dropped = (int)gyro.droppedSamples();
+	result.rms = std::sqrt(result.rms / (3 * (n > 0 ? n : 1)));
+	result.angle = std::fabs(result.angle);
+	result.lowShare = 100.0 * low / (n > 0 ? n : 1);
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t seed = 1;
+	for(int i = 1; i < argc; i++){
+		bool hasValue = i + 1 < argc;
+		if(std::strcmp(argv[i], "-s") == 0 && hasValue)
+			seed = std::strtoull(argv[++i], nullptr, 10);
+		else if(std::strcmp(argv[i], "-n") == 0 && hasValue)
+			noise = std::atof(argv[++i]);
+		else{
+			std::fprintf(stderr, "usage: gyrobench [-s seed] [-n noise]\n");
+			return 1;
+		}
+	}
+
+	int misscaled = 0, autoClipped = 0, wrongDrops = 0;
+	for(int m = 0; m < ManoeuvreN; m++){
+		for(int reading = 0; reading < ReadingN; reading++){
+			std::printf("%-5s %-4s", manoeuvreNames[m], readingNames[reading]);
+			for(int r = 0; r < RangingN; r++){
+				Result result = run((Manoeuvre)m, (Ranging)r, (Reading)reading, seed + m);
+				std::printf("%s %s rms=%.3f max=%.3f clipped=%d misscaled=%d angle=%.2f", r > 0 ? " |" : "", rangingNames[r],
+							result.rms, result.max, result.clipped, result.misscaled, result.angle);
+				if(r == Auto){
+					std::printf(" switches=%d at250=%.0f%% dropped=%d", result.switches, result.lowShare,
+								result.dropped);
+					// Fixed scales clip by design, auto-ranging must not
+					autoClipped += result.clipped;
+				}
+				misscaled += result.misscaled;
+				wrongDrops += result.wrongDrops;
+			}
+			std::printf("\n");
+		}
+	}
+
+	if(misscaled > 0)
+		std::printf("FAIL %d misscaled samples\n", misscaled);
+	if(autoClipped > 0)
+		std::printf("FAIL %d samples clipped with auto-ranging\n", autoClipped);
+	if(wrongDrops > 0)
+		std::printf("FAIL %d samples dropped other than the ones taken around a switch\n", wrongDrops);
+	return misscaled > 0 || autoClipped > 0 || wrongDrops > 0 ? 1 : 0;
+}
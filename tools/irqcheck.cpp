@@ -0,0 +1,229 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Host check of interrupt dispatch. src/uart.cpp and src/rc_receiver.cpp
+ * are built against the USART and TIM3 register fakes of sim/hal:
+ *   - IrqSlot binds every Uart to the handler of its own peripheral, the
+ *     handler of an unbound slot returns, destruction unbinds
+ *   - Uart::handleInterrupt serves RXNE and TXE only when enabled and
+ *     clears overrun, which would otherwise keep the interrupt pending
+ *   - nextPending walks pending flags from the lowest bit
+ *   - TIM3 handler serves every pending enabled capture of one status
+ *     read and clears exactly those flags
+ *
+ * Usage: irqcheck
+ */
+
+#include "uart.h"
+#include "rc_receiver.h"
+#include "irqDispatch.h"
+#include "irqMonitor.h"
+#include "systime.h"
+#include "simHal.h"
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+
+static int failures = 0;
+
+static void expect(bool ok, const char* format, ...)
+{
+	if(ok)
+		return;
+	va_list args;
+	va_start(args, format);
+	std::printf("FAIL ");
+	std::vprintf(format, args);
+	std::printf("\n");
+	va_end(args);
+	failures++;
+}
+
+// Time of the check, advanced by waits and by the test itself
+static uint64_t systemTime = 0;
+
+void restartSystemTime()
+{
+	systemTime = 0;
+}
+
+uint64_t getSystemTime()
+{
+	return systemTime;
+}
+
+void sleep(uint64_t duration, TimeUnit unit)
+{
+	systemTime += duration * SYSTEM_TIME_RESOLUTION / unit;
+}
+
+static void checkNextPending()
+{
+	uint32_t pending = 0x80000016;
+	static const uint8_t bits[] = {1, 2, 4, 31};
+	for(unsigned i = 0; i < sizeof(bits) / sizeof(bits[0]); i++){
+		expect(pending != 0, "pending ran out before bit %u", bits[i]);
+		uint8_t bit = nextPending(pending);
+		expect(bit == bits[i], "pending bit %u served as %u", bits[i], bit);
+	}
+	expect(pending == 0, "pending left 0x%08X", pending);
+}
+
+static void checkUartSlots()
+{
+	{
+		Uart first(USART1, 115200);
+		Uart second(USART2, 115200);
+		expect(IrqSlot<Uart, 1>::handler() == &first && IrqSlot<Uart, 2>::handler() == &second,
+			   "uarts are not bound to their slots");
+		expect(IrqSlot<Uart, 3>::handler() == nullptr, "slot of unused uart is bound");
+		expect(IrqMonitor::stats(IrqUsart1).priority == 1, "uart priority is not recorded");
+
+		// Each peripheral reaches only its own object
+		simUartReceive(USART1, 'a');
+		simUartReceive(USART2, 'b');
+		uint32_t count = IrqMonitor::stats(IrqUsart1).count;
+		USART1_IRQHandler();
+		expect(IrqMonitor::stats(IrqUsart1).count == count + 1, "uart handler is not monitored");
+		expect(!first.empty() && first.get() == 'a' && first.empty(), "USART1 byte did not reach its uart");
+		expect(second.empty(), "USART1 interrupt served USART2");
+		USART2_IRQHandler();
+		expect(!second.empty() && second.get() == 'b', "USART2 byte did not reach its uart");
+
+		// Unbound slot returns without touching the peripheral
+		simUartReceive(USART3, 'c');
+		USART3_IRQHandler();
+		expect(simUartStatus(USART3) & USART_ISR_RXNE, "unbound USART3 was served");
+	}
+	expect(IrqSlot<Uart, 1>::handler() == nullptr && IrqSlot<Uart, 2>::handler() == nullptr,
+		   "destroyed uarts stay bound");
+	USART1_IRQHandler();
+}
+
+static void checkUartFlags()
+{
+	Uart uart(USART1, 115200);
+
+	// Byte arriving before the previous one was read is lost, ORE is set
+	simUartReceive(USART1, 'x');
+	simUartReceive(USART1, 'y');
+	expect(simUartStatus(USART1) & USART_ISR_ORE, "overrun is not flagged");
+	USART1_IRQHandler();
+	uint32_t status = simUartStatus(USART1);
+	expect((status & (USART_ISR_ORE | USART_ISR_RXNE)) == 0, "overrun left status 0x%08X", status);
+	expect(uart.get() == 'x' && uart.empty(), "byte before overrun is not kept alone");
+
+	// Overrun alone is cleared too, ICR is not written without it
+	USART1->ISR |= USART_ISR_ORE;
+	USART1_IRQHandler();
+	expect((simUartStatus(USART1) & USART_ISR_ORE) == 0 && uart.empty(), "lone overrun is not cleared");
+	USART1_IRQHandler();
+	expect(USART1->ICR == 0, "ICR written without overrun");
+
+	// Idle transmitter raises TXE, it is served only while TXEIE is set
+	USART1_IRQHandler();
+	uint8_t byte;
+	expect(!simUartTransmit(USART1, byte), "TXE served with TXEIE clear");
+
+	static const uint8_t message[] = {'h', 'i', '!'};
+	uart.write(Span<const uint8_t>(message, sizeof(message)));
+	expect(USART1->CR1 & USART_CR1_TXEIE, "write does not enable TXE interrupt");
+	uint8_t sent[sizeof(message) + 1];
+	unsigned sentN = 0;
+	for(int i = 0; i < 8; i++){
+		USART1_IRQHandler();
+		if(sentN < sizeof(sent) && simUartTransmit(USART1, byte))
+			sent[sentN++] = byte;
+	}
+	expect(sentN == sizeof(message) && sent[0] == 'h' && sent[1] == 'i' && sent[2] == '!', "sent %u bytes", sentN);
+	expect((USART1->CR1 & USART_CR1_TXEIE) == 0, "TXE interrupt stays enabled with nothing to send");
+
+	// RXNE is left for the DMA when its interrupt is disabled
+	USART_ITConfig(USART1, USART_IT_RXNE, DISABLE);
+	simUartReceive(USART1, 'z');
+	USART1_IRQHandler();
+	expect(uart.empty() && (simUartStatus(USART1) & USART_ISR_RXNE), "RXNE served with RXNEIE clear");
+	USART_ReceiveData(USART1);
+}
+
+// Both edges of a pulse on each listed channel, edges of all channels
+// arrive before the interrupt is served
+static void pulse(const uint8_t* channels, uint8_t channelN, uint16_t start, uint16_t width)
+{
+	for(uint8_t i = 0; i < channelN; i++)
+		simTimerCapture(TIM3, channels[i], start);
+	TIM3_IRQHandler();
+	for(uint8_t i = 0; i < channelN; i++)
+		simTimerCapture(TIM3, channels[i], start + width);
+	TIM3_IRQHandler();
+}
+
+static void checkCaptureDispatch()
+{
+	RcReceiver::configureTimer(TIM3);
+	RcReceiver rc;
+	rc.addChannel(0, TIM3, 1, GPIOA, 6, 2);
+	rc.addChannel(2, TIM3, 3, GPIOB, 0, 2);
+	expect(TIM3->DIER == (TIM_IT_CC1 | TIM_IT_CC3), "capture interrupts 0x%04X enabled", TIM3->DIER);
+
+	// Widths are taken after a few continuous pulses, 1.5 ms at 2 MHz with
+	// a timer overflow inside
+	static const uint8_t channels[] = {1, 3};
+	uint16_t start = 60000;
+	for(int i = 0; i < 10; i++){
+		systemTime += 20000;
+		pulse(channels, 2, start, 3000);
+		start += 7000;
+		expect((simTimerStatus(TIM3) & (TIM_IT_CC1 | TIM_IT_CC3)) == 0, "serving left flags 0x%04X", TIM3->SR);
+	}
+
+	// Flag of a channel without its interrupt is neither served nor cleared
+	simTimerCapture(TIM3, 2, 1234);
+	TIM3_IRQHandler();
+	expect(simTimerStatus(TIM3) & TIM_IT_CC2, "flag of disabled channel was cleared");
+
+	rc.update();
+	expect(std::fabs(rc.pulseWidth(0) - 1.5e-3f) < 1e-7f && std::fabs(rc.pulseWidth(2) - 1.5e-3f) < 1e-7f,
+		   "captured %f and %f ms", rc.pulseWidth(0) * 1e3, rc.pulseWidth(2) * 1e3);
+	expect(rc.pulseWidth(1) == 0 && rc.pulseWidth(CHANNEL_N) == 0, "channel without input gives %f", rc.pulseWidth(1));
+}
+
+int main(int argc, char** argv)
+{
+	if(argc > 1){
+		std::fprintf(stderr, "usage: irqcheck\n");
+		return 1;
+	}
+
+	checkNextPending();
+	checkUartSlots();
+	checkUartFlags();
+	checkCaptureDispatch();
+
+	std::printf("irqcheck %s\n", failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Host check that compare values of one control iteration take effect
+ * together. On the simulated TIM1 an update event is forced after every
+ * compare value and update disable write, the worst timing the counter
+ * could have. Every set of active compare values seen must then be
+ * wholly the one of the previous iteration or wholly the new one, and
+ * the new one must be active once the frame is committed. The same
+ * writes without beginFrame/commitFrame must tear, otherwise the check
+ * would not see anything.
+ *
+ * Usage: latchcheck [-s seed] [-n iterations]
+ */
+
+#include "model.h"
+#include "pwm.h"
+#include "simHal.h"
+#include "random.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const uint8_t channelN = 4;
+
+struct Snapshot
+{
+	uint32_t compare[channelN];
+};
+
+static Snapshot latched[64];
+static int latchedN;
+
+static Snapshot active()
+{
+	Snapshot snapshot;
+	for(uint8_t i = 0; i < channelN; i++)
+		snapshot.compare[i] = TIM1->activeCCR[i];
+	return snapshot;
+}
+
+static Snapshot preloaded()
+{
+	Snapshot snapshot = {{TIM1->CCR1, TIM1->CCR2, TIM1->CCR3, TIM1->CCR4}};
+	return snapshot;
+}
+
+static bool same(const Snapshot& a, const Snapshot& b)
+{
+	return std::memcmp(a.compare, b.compare, sizeof(a.compare)) == 0;
+}
+
+// Update event right after the write, skipped by the fake while UDIS is set
+static void updateAfterWrite(TIM_TypeDef* timer)
+{
+	if(timer != TIM1)
+		return;
+	simTimerUpdateEvent(TIM1);
+	if(latchedN < 64)
+		latched[latchedN++] = active();
+}
+
+// Counts update events that applied neither the old nor the new frame
+static int torn(const Snapshot& before, const Snapshot& after)
+{
+	int count = 0;
+	for(int i = 0; i < latchedN; i++)
+		if(!same(latched[i], before) && !same(latched[i], after))
+			count++;
+	return count;
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t seed = 1;
+	int iterations = 1000;
+	for(int i = 1; i < argc; i++){
+		bool hasValue = i + 1 < argc;
+		if(std::strcmp(argv[i], "-s") == 0 && hasValue)
+			seed = std::strtoull(argv[++i], nullptr, 10);
+		else if(std::strcmp(argv[i], "-n") == 0 && hasValue)
+			iterations = std::atoi(argv[++i]);
+		else{
+			std::fprintf(stderr, "usage: latchcheck [-s seed] [-n iterations]\n");
+			return 1;
+		}
+	}
+
+	Random random(seed);
+	Engine::configureTimer(TIM1, Engine::StandardPwm);
+	Model model;
+	simTimerUpdateEvent(TIM1);
+	simTimerWriteHook(updateAfterWrite);
+
+	int framed = 0, stale = 0, events = 0;
+	for(int i = 0; i < iterations; i++){
+		Snapshot before = active();
+		latchedN = 0;
+		model.update(random.uniform(), math3d::Vector3<float>(random.uniform(-1, 1), random.uniform(-1, 1),
+															  random.uniform(-1, 1)));
+		Snapshot after = preloaded();
+		framed += torn(before, after);
+		stale += same(active(), after) ? 0 : 1;
+		events += latchedN;
+	}
+
+	// Same compare writes without the frame around them
+	Pwm channels[channelN] = {Pwm(TIM1, 1), Pwm(TIM1, 2), Pwm(TIM1, 3), Pwm(TIM1, 4)};
+	int unframed = 0;
+	for(int i = 0; i < iterations; i++){
+		Snapshot before = active();
+		latchedN = 0;
+		for(uint8_t c = 0; c < channelN; c++)
+			channels[c].compare(2000 + (uint32_t)(random.uniform() * 2000));
+		unframed += torn(before, preloaded());
+	}
+	simTimerWriteHook(nullptr);
+
+	bool ok = framed == 0 && stale == 0 && unframed > 0;
+	std::printf("iterations=%d updateEvents=%d tornFramed=%d staleAfterCommit=%d tornUnframed=%d\n", iterations, events,
+				framed, stale, unframed);
+	std::printf("latchcheck %s\n", ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
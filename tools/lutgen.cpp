@@ -0,0 +1,169 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Generates actuator lookup tables for ActuatorTable from calibration
+ * measurements. Every input CSV has a header line followed by rows of
+ * "pulse width in microseconds, measured value" (thrust, angle...). Rows
+ * are sorted by pulse width, measured value must be strictly monotonic.
+ * Lines starting with # are comments.
+ *
+ * Value range is normalized to <0, 1> and inverted, table point k holds
+ * pwm timer ticks producing normalized value k / (points - 1).
+ *
+ * Usage: lutgen [-n points] [-f timerFrequency] name=file.csv... > table.h
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef std::vector<std::pair<double, double> > Samples;
+
+static bool readCsv(const char* path, Samples& samples)
+{
+	FILE* file = std::fopen(path, "r");
+	if(file == nullptr){
+		std::perror(path);
+		return false;
+	}
+
+	char line[256];
+	int number = 0;
+	bool header = true;
+	while(std::fgets(line, sizeof(line), file) != nullptr){
+		number++;
+		// Comments and empty lines
+		if(line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+			continue;
+		// First remaining line names the columns
+		if(header){
+			header = false;
+			continue;
+		}
+
+		double pulse, value;
+		if(std::sscanf(line, " %lf , %lf", &pulse, &value) == 2)
+			samples.push_back(std::make_pair(pulse, value));
+		else
+			std::fprintf(stderr, "%s:%d: ignoring malformed line\n", path, number);
+	}
+	std::fclose(file);
+
+	if(samples.size() < 2){
+		std::fprintf(stderr, "%s: at least two samples are needed\n", path);
+		return false;
+	}
+
+	double direction = samples.back().second - samples.front().second;
+	for(unsigned i = 1; i < samples.size(); i++){
+		if(samples[i].first <= samples[i - 1].first){
+			std::fprintf(stderr, "%s: pulse widths must be increasing\n", path);
+			return false;
+		}
+		if((samples[i].second - samples[i - 1].second) * direction <= 0){
+			std::fprintf(stderr, "%s: measured value must be strictly monotonic\n", path);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Pulse width producing given value, linear between measured samples
+static double invert(const Samples& samples, double value)
+{
+	bool increasing = samples.back().second > samples.front().second;
+	for(unsigned i = 1; i < samples.size(); i++){
+		double low = samples[i - 1].second, high = samples[i].second;
+		bool inside = increasing ? value <= high : value >= high;
+		if(inside || i + 1 == samples.size()){
+			double t = (value - low) / (high - low);
+			return samples[i - 1].first + t * (samples[i].first - samples[i - 1].first);
+		}
+	}
+	return samples.back().first;
+}
+
+static void usage()
+{
+	std::fprintf(stderr, "usage: lutgen [-n points] [-f timerFrequency] name=file.csv... > table.h\n");
+}
+
+int main(int argc, char** argv)
+{
+	int points = 33;
+	double frequency = 2e6;
+	std::vector<std::pair<std::string, std::string> > inputs;
+
+	for(int i = 1; i < argc; i++){
+		const char* eq = std::strchr(argv[i], '=');
+		if(std::strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			points = std::atoi(argv[++i]);
+		else if(std::strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+			frequency = std::atof(argv[++i]);
+		else if(argv[i][0] != '-' && eq != nullptr && eq != argv[i])
+			inputs.push_back(std::make_pair(std::string(argv[i], eq - argv[i]), std::string(eq + 1)));
+		else{
+			usage();
+			return 1;
+		}
+	}
+
+	if(inputs.empty() || points < 2 || points > 65535 || frequency <= 0){
+		usage();
+		return 1;
+	}
+
+	std::printf("// Generated by tools/lutgen.cpp, do not edit by hand.\n");
+	std::printf("// Regenerate with \"make tables\" after changing calibration data.\n\n");
+	std::printf("#ifndef ACTUATORTABLES_H\n#define ACTUATORTABLES_H\n\n#include <stdint.h>\n");
+
+	for(unsigned n = 0; n < inputs.size(); n++){
+		Samples samples;
+		if(!readCsv(inputs[n].second.c_str(), samples))
+			return 1;
+
+		double first = samples.front().second, last = samples.back().second;
+		std::printf("\n// %s, %u samples, pwm timer at %.0f Hz\n", inputs[n].second.c_str(), (unsigned)samples.size(), frequency);
+		std::printf("const uint16_t %sTicks[%d] = {", inputs[n].first.c_str(), points);
+
+		for(int k = 0; k < points; k++){
+			double value = first + (last - first) * k / (points - 1);
+			long ticks = (long)(invert(samples, value) * 1e-6 * frequency + 0.5);
+			if(ticks < 0 || ticks > 65535){
+				std::fprintf(stderr, "%s: pulse width out of 16 bit timer range\n", inputs[n].second.c_str());
+				return 1;
+			}
+			std::printf("%s%s%ld", k ? "," : "", k % 8 ? " " : "\n\t", ticks);
+		}
+		std::printf("\n};\n");
+	}
+
+	std::printf("\n#endif\n");
+	return 0;
+}
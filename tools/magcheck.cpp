@@ -0,0 +1,237 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Host check of magnetometer calibration and heading on synthetic data.
+ * Raw readings are points of a known axis aligned ellipsoid, offset by
+ * hard iron and stretched per axis by soft iron, with the spacing and
+ * residual limit of src/main.cpp:
+ *   - readings from all orientations give a fit that recovers offset and
+ *     scale, corrected readings lie on the unit sphere
+ *   - a level yaw sweep, readings in one plane only, is never accepted
+ *   - heading of a field rotated into the sensor frame at known yaw,
+ *     pitch and roll, tilt taken from the accelerometer angle formulas of
+ *     src/main.cpp, is the yaw
+ *
+ * Usage: magcheck [-s seed]
+ */
+
+#include "ellipsoidCalibration.h"
+#include "magnetometer.h"
+#include "main.h"
+#include "systime.h"
+#include "random.h"
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static int failures = 0;
+
+static void expect(bool ok, const char* format, ...)
+{
+	if(ok)
+		return;
+	va_list args;
+	va_start(args, format);
+	std::printf("FAIL ");
+	std::vprintf(format, args);
+	std::printf("\n");
+	va_end(args);
+	failures++;
+}
+
+using math3d::Vector3;
+
+// Host replacements of the bus and system time, heading and the fit never
+// reach the sensor
+I2C_TypeDef simI2C1;
+
+uint64_t getSystemTime()
+{
+	return 0;
+}
+
+uint32_t LSM303DLHC_TIMEOUT_UserCallback(void)
+{
+	return 0;
+}
+
+void LSM303DLHC_MagInit(LSM303DLHCMag_InitTypeDef*) {}
+void I2C_TransferHandling(I2C_TypeDef*, uint16_t, uint8_t, uint32_t, uint32_t) {}
+void I2C_ClearFlag(I2C_TypeDef*, uint32_t) {}
+void I2C_SendData(I2C_TypeDef*, uint8_t) {}
+
+FlagStatus I2C_GetFlagStatus(I2C_TypeDef*, uint32_t)
+{
+	return RESET;
+}
+
+uint8_t I2C_ReceiveData(I2C_TypeDef*)
+{
+	return 0;
+}
+
+// Same as magCalibration in src/main.cpp
+static const float spacing = 0.05f;
+static const float maxResidual = 0.05f;
+
+// Hard iron offset and soft iron radii in gauss, noise near the 1.3 Ga
+// quantization
+static const Vector3<float> offset(0.12f, -0.08f, 0.2f);
+static const Vector3<float> radius(0.45f, 0.52f, 0.4f);
+static const float noise = 0.002f;
+
+static Vector3<float> reading(Random& random, const Vector3<float>& direction)
+{
+	Vector3<float> value;
+	for(uint8_t i = 0; i < 3; i++)
+		value[i] = offset[i] + radius[i] * direction[i] + (float)random.gaussian(noise);
+	return value;
+}
+
+// Readings go in as the flight loop does, one poll per loop
+static void feed(EllipsoidCalibration& calibration, const Vector3<float>& value)
+{
+	calibration.add(value);
+	calibration.poll();
+}
+
+static void checkFit(Random& random)
+{
+	EllipsoidCalibration calibration(spacing, maxResidual);
+	for(int i = 0; i < 5000 && !calibration.done(); i++){
+		// Uniform direction on the sphere
+		float z = (float)random.uniform(-1, 1);
+		float azimuth = (float)random.uniform(0, 2 * M_PI);
+		float horizontal = std::sqrt(1 - z * z);
+		feed(calibration, reading(random, Vector3<float>(horizontal * std::cos(azimuth), horizontal * std::sin(azimuth), z)));
+	}
+	expect(calibration.done(), "no fit from %u readings in all orientations", calibration.samples());
+	if(!calibration.done())
+		return;
+
+	SensorCorrection correction;
+	calibration.update(correction);
+	for(uint8_t i = 0; i < 3; i++){
+		float center = correction.bias[i] / correction.scale[i];
+		float fitted = 1 / correction.scale[i];
+		expect(std::fabs(center - offset[i]) < 0.005f, "axis %u offset %f, true %f", i, center, offset[i]);
+		expect(std::fabs(fitted / radius[i] - 1) < 0.01f, "axis %u radius %f, true %f", i, fitted, radius[i]);
+	}
+	expect(calibration.residual() < maxResidual, "residual %f", calibration.residual());
+
+	float worst = 0;
+	for(int i = 0; i < 200; i++){
+		float z = (float)random.uniform(-1, 1);
+		float azimuth = (float)random.uniform(0, 2 * M_PI);
+		float horizontal = std::sqrt(1 - z * z);
+		Vector3<float> value = correction.apply(reading(random, Vector3<float>(horizontal * std::cos(azimuth), horizontal * std::sin(azimuth), z)));
+		float error = std::fabs(std::sqrt(value.dotProduct(value)) - 1);
+		worst = error > worst ? error : worst;
+	}
+	expect(worst < 0.03f, "corrected field off the unit sphere by %f", worst);
+}
+
+static void checkPlane(Random& random)
+{
+	// Level craft yawing round and round, field dips 60 degrees
+	EllipsoidCalibration calibration(spacing, maxResidual);
+	float dip = (float)(M_PI / 3);
+	bool passed = false;
+	for(int i = 0; i < 5000; i++){
+		float azimuth = (float)random.uniform(0, 2 * M_PI);
+		Vector3<float> direction(std::cos(dip) * std::cos(azimuth), std::cos(dip) * std::sin(azimuth), -std::sin(dip));
+		calibration.add(reading(random, direction));
+		passed = calibration.poll() || passed;
+	}
+	expect(calibration.samples() >= EllipsoidCalibration::MinSamples, "plane sweep gave only %u readings",
+		   calibration.samples());
+	expect(!passed && !calibration.done(), "fit accepted from a single plane sweep");
+}
+
+// Vector of the world frame in the sensor frame of a craft turned by yaw,
+// then pitched and rolled, rotations about Z, Y and X
+static Vector3<float> toSensor(const Vector3<float>& v, float yaw, float pitch, float roll)
+{
+	Vector3<float> a(std::cos(yaw) * v[0] + std::sin(yaw) * v[1], -std::sin(yaw) * v[0] + std::cos(yaw) * v[1], v[2]);
+	Vector3<float> b(std::cos(pitch) * a[0] - std::sin(pitch) * a[2], a[1], std::sin(pitch) * a[0] + std::cos(pitch) * a[2]);
+	return Vector3<float>(b[0], std::cos(roll) * b[1] + std::sin(roll) * b[2], -std::sin(roll) * b[1] + std::cos(roll) * b[2]);
+}
+
+static void checkHeading()
+{
+	// North along world X, dipping 60 degrees
+	float dip = (float)(M_PI / 3);
+	Vector3<float> field(0.5f * std::cos(dip), 0, -0.5f * std::sin(dip));
+	const float angles[] = {-0.6f, -0.25f, 0, 0.3f, 0.7f};
+	const uint8_t angleN = sizeof(angles) / sizeof(angles[0]);
+
+	float worst = 0, worstYaw = 0, worstPitch = 0, worstRoll = 0;
+	for(int step = -6; step < 6; step++){
+		float yaw = (float)(step * M_PI / 6 + 0.1);
+		for(uint8_t p = 0; p < angleN; p++){
+			for(uint8_t r = 0; r < angleN; r++){
+				// Accelerometer of a still craft reads up
+				Vector3<float> up = toSensor(Vector3<float>(0, 0, 1), yaw, angles[p], angles[r]);
+				float pitch = std::atan2(-up[0], std::sqrt(up[1] * up[1] + up[2] * up[2]));
+				float roll = -std::atan2(up[1], std::sqrt(up[0] * up[0] + up[2] * up[2]));
+
+				float heading = Magnetometer::heading(toSensor(field, yaw, angles[p], angles[r]), pitch, roll);
+				float error = std::fabs(std::remainder(heading - yaw, (float)(2 * M_PI)));
+				if(error > worst){
+					worst = error;
+					worstYaw = yaw;
+					worstPitch = angles[p];
+					worstRoll = angles[r];
+				}
+			}
+		}
+	}
+	expect(worst < 1e-4f, "heading off by %f at yaw %f, pitch %f, roll %f", worst, worstYaw, worstPitch, worstRoll);
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t seed = 1;
+	for(int i = 1; i < argc; i++){
+		if(std::strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = std::strtoull(argv[++i], nullptr, 10);
+		else{
+			std::fprintf(stderr, "usage: magcheck [-s seed]\n");
+			return 1;
+		}
+	}
+
+	Random random(seed);
+	checkFit(random);
+	checkPlane(random);
+	checkHeading();
+
+	std::printf("magcheck %s\n", failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
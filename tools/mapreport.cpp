@@ -0,0 +1,309 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Size and timing report of a firmware build. Sizes come from the GNU ld
+ * map file, every function and variable is in its own input section
+ * thanks to -ffunction-sections and -fdata-sections. Loop stage timing
+ * comes from a profile in the format printed by f3sim -P:
+ *
+ *   name count=N min=X max=Y mean=Z ...
+ *
+ * Worst and mean stage times are summed and compared to the loop budget,
+ * exit status is 2 when the worst case does not fit. A baseline profile,
+ * e.g. from a NO_CCM=1 build, adds the change of every stage.
+ *
+ * Usage: mapreport [-n symbols] [-s section]... [-p profile.txt]
+ *                  [-c baseline.txt] [-b budget] firmware.map
+ *        -s lists every symbol placed in the output section
+ *        budget is in profile units, default is 10 ms loop at 72 MHz
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <map>
+#include <string>
+#include <vector>
+
+struct Section
+{
+	std::string output;
+	std::string name;
+	std::string symbol;
+	std::string object;
+	unsigned long address;
+	unsigned long size;
+};
+
+struct Symbol
+{
+	std::string output;
+	std::string name;
+	unsigned long address;
+};
+
+struct Stage
+{
+	std::string name;
+	double mean;
+	double max;
+};
+
+static std::string demangle(const std::string& name)
+{
+	int status;
+	char* demangled = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+	if(status != 0)
+		return name;
+	std::string result(demangled);
+	std::free(demangled);
+	return result;
+}
+
+// Name of section contents when no symbol is listed, .text.foo -> foo
+static std::string sectionSymbol(const std::string& output, const std::string& name)
+{
+	if(name.size() > output.size() + 1 && name.compare(0, output.size() + 1, output + ".") == 0)
+		return demangle(name.substr(output.size() + 1));
+	return name;
+}
+
+static bool isDebug(const char* output)
+{
+	return std::strncmp(output, ".debug", 6) == 0 || std::strncmp(output, ".stab", 5) == 0 ||
+		   std::strcmp(output, ".comment") == 0 || std::strcmp(output, ".ARM.attributes") == 0;
+}
+
+static bool readMap(const char* path, std::vector<Section>& sections, std::vector<Symbol>& symbols)
+{
+	FILE* file = std::fopen(path, "r");
+	if(file == nullptr){
+		std::perror(path);
+		return false;
+	}
+
+	char line[1024];
+	bool inMemoryMap = false;
+	std::string output, pendingName;
+	while(std::fgets(line, sizeof(line), file) != nullptr){
+		if(!inMemoryMap){
+			inMemoryMap = std::strncmp(line, "Linker script and memory map", 28) == 0;
+			continue;
+		}
+
+		char first[512], object[512];
+		unsigned long address, size;
+
+		// Output section starts in first column, debug information takes no memory
+		if(line[0] == '.' && std::sscanf(line, "%511s", first) == 1){
+			output = isDebug(first) ? "" : first;
+			pendingName.clear();
+			continue;
+		}
+		if(line[0] != ' ' || output.empty())
+			continue;
+
+		// Input section, its name may be alone on the line when too long
+		int n = std::sscanf(line, " %511s 0x%lx 0x%lx %511s", first, &address, &size, object);
+		if(n == 1 && first[0] == '.'){
+			pendingName = first;
+			continue;
+		}
+		if(n == 4 && first[0] == '.'){
+			sections.push_back({output, first, sectionSymbol(output, first), object, address, size});
+			pendingName.clear();
+			continue;
+		}
+		if(!pendingName.empty() && std::sscanf(line, " 0x%lx 0x%lx %511s", &address, &size, object) == 3){
+			sections.push_back({output, pendingName, sectionSymbol(output, pendingName), object, address, size});
+			pendingName.clear();
+			continue;
+		}
+
+		// Symbol at the start of the last input section names its contents,
+		// it may be already demangled and contain spaces
+		int symbolStart;
+		if(std::sscanf(line, " 0x%lx %n", &address, &symbolStart) == 1 &&
+		   std::strchr(line, '=') == nullptr && line[symbolStart] != '\0'){
+			std::string symbol(line + symbolStart);
+			symbol.erase(symbol.find_last_not_of(" \r\n") + 1);
+			symbols.push_back({output, demangle(symbol), address});
+			if(!sections.empty() && sections.back().address == address)
+				sections.back().symbol = symbols.back().name;
+		}
+	}
+	std::fclose(file);
+	return true;
+}
+
+static bool readProfile(const char* path, std::vector<Stage>& stages)
+{
+	FILE* file = std::fopen(path, "r");
+	if(file == nullptr){
+		std::perror(path);
+		return false;
+	}
+
+	char line[1024];
+	while(std::fgets(line, sizeof(line), file) != nullptr){
+		char name[128];
+		unsigned long count, min, max, mean;
+		if(std::sscanf(line, "%127s count=%lu min=%lu max=%lu mean=%lu", name, &count, &min, &max, &mean) == 5 && count > 0)
+			stages.push_back({name, (double)mean, (double)max});
+	}
+	std::fclose(file);
+	return true;
+}
+
+static const Stage* findStage(const std::vector<Stage>& stages, const std::string& name)
+{
+	for(const Stage& s : stages)
+		if(s.name == name)
+			return &s;
+	return nullptr;
+}
+
+static void usage()
+{
+	std::fprintf(stderr, "usage: mapreport [-n symbols] [-s section]... [-p profile.txt] "
+						 "[-c baseline.txt] [-b budget] firmware.map\n");
+}
+
+int main(int argc, char** argv)
+{
+	unsigned symbolN = 30;
+	const char* profilePath = nullptr;
+	const char* baselinePath = nullptr;
+	const char* mapPath = nullptr;
+	std::vector<std::string> listed;
+	double budget = 72e6 * 0.01;
+
+	for(int i = 1; i < argc; i++){
+		if(std::strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			symbolN = std::atoi(argv[++i]);
+		else if(std::strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			listed.push_back(argv[++i]);
+		else if(std::strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+			profilePath = argv[++i];
+		else if(std::strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+			baselinePath = argv[++i];
+		else if(std::strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+			budget = std::atof(argv[++i]);
+		else if(argv[i][0] != '-' && mapPath == nullptr)
+			mapPath = argv[i];
+		else{
+			usage();
+			return 1;
+		}
+	}
+
+	if(mapPath == nullptr || budget <= 0){
+		usage();
+		return 1;
+	}
+
+	std::vector<Section> sections;
+	std::vector<Symbol> symbols;
+	if(!readMap(mapPath, sections, symbols))
+		return 1;
+
+	// Totals per output section and per object file
+	std::map<std::string, unsigned long> outputs, objects;
+	for(const Section& s : sections){
+		outputs[s.output] += s.size;
+		objects[s.object] += s.size;
+	}
+
+	std::printf("Sections\n");
+	for(const auto& o : outputs)
+		if(o.second > 0)
+			std::printf("  %-16s %8lu\n", o.first.c_str(), o.second);
+
+	std::sort(sections.begin(), sections.end(), [](const Section& a, const Section& b){ return a.size > b.size; });
+	std::printf("\nLargest symbols\n");
+	for(unsigned i = 0; i < sections.size() && i < symbolN; i++)
+		std::printf("  %-10s %8lu  %s (%s)\n", sections[i].output.c_str(), sections[i].size,
+					sections[i].symbol.c_str(), sections[i].object.c_str());
+
+	std::vector<std::pair<unsigned long, std::string> > objectSizes;
+	for(const auto& o : objects)
+		objectSizes.push_back(std::make_pair(o.second, o.first));
+	std::sort(objectSizes.rbegin(), objectSizes.rend());
+	std::printf("\nLargest objects\n");
+	for(unsigned i = 0; i < objectSizes.size() && i < symbolN; i++)
+		std::printf("  %8lu  %s\n", objectSizes[i].first, objectSizes[i].second.c_str());
+
+	// Placement check, e.g. that the hot path made it to core coupled RAM.
+	// Input sections with an explicit section attribute hold all functions
+	// of their object, symbols inside them are listed too.
+	std::vector<Section> placed(sections);
+	std::sort(placed.begin(), placed.end(), [](const Section& a, const Section& b){ return a.address < b.address; });
+	for(const std::string& output : listed){
+		std::printf("\nPlaced in %s (%lu bytes)\n", output.c_str(), outputs.count(output) ? outputs[output] : 0);
+		for(const Section& s : placed){
+			if(s.output != output)
+				continue;
+			std::printf("  0x%08lx %6lu  %s (%s)\n", s.address, s.size, s.symbol.c_str(), s.object.c_str());
+			for(const Symbol& sym : symbols)
+				if(sym.output == output && sym.address > s.address && sym.address < s.address + s.size)
+					std::printf("  0x%08lx         %s\n", sym.address, sym.name.c_str());
+		}
+	}
+
+	if(profilePath == nullptr)
+		return 0;
+
+	std::vector<Stage> stages, baseline;
+	if(!readProfile(profilePath, stages) || (baselinePath != nullptr && !readProfile(baselinePath, baseline)))
+		return 1;
+
+	double meanSum = 0, maxSum = 0;
+	std::printf("\nLoop stages (budget %.0f)\n", budget);
+	double baseMeanSum = 0, baseMaxSum = 0;
+	for(const Stage& s : stages){
+		std::printf("  %-14s mean=%10.0f %5.1f%%  max=%10.0f %5.1f%%", s.name.c_str(),
+					s.mean, 100 * s.mean / budget, s.max, 100 * s.max / budget);
+		const Stage* base = findStage(baseline, s.name);
+		if(base != nullptr && base->mean > 0 && base->max > 0){
+			std::printf("  mean %+6.1f%%  max %+6.1f%%", 100 * (s.mean / base->mean - 1), 100 * (s.max / base->max - 1));
+			baseMeanSum += base->mean;
+			baseMaxSum += base->max;
+		}
+		std::printf("\n");
+		meanSum += s.mean;
+		maxSum += s.max;
+	}
+	std::printf("  %-14s mean=%10.0f %5.1f%%  max=%10.0f %5.1f%%", "total",
+				meanSum, 100 * meanSum / budget, maxSum, 100 * maxSum / budget);
+	if(baseMeanSum > 0 && baseMaxSum > 0)
+		std::printf("  mean %+6.1f%%  max %+6.1f%%", 100 * (meanSum / baseMeanSum - 1), 100 * (maxSum / baseMaxSum - 1));
+	std::printf("\n");
+	std::printf("  margin=%.1f%%%s\n", 100 * (1 - maxSum / budget), maxSum > budget ? " OVER BUDGET" : "");
+
+	return maxSum > budget ? 2 : 0;
+}
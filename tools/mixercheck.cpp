@@ -0,0 +1,273 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Host check of the geometry-derived mixer against the branchy motor
+ * adjustments it replaced in Model::update. Tricopter geometry is the
+ * one of src/model.cpp.
+ *
+ * Where no output saturates the old adjustments only lowered motors, so
+ * they also dropped collective thrust. The mixer keeps the mean of the
+ * outputs at throttle and moves the motors symmetrically instead. What
+ * both must share:
+ *   - torque of every command points the same way, the mixer's pitch and
+ *     roll torque are fixed multiples of the old ones without coupling
+ *   - full command on a single axis moves the most loaded motor by
+ *     maneuver fraction of throttle
+ * Desaturation cases follow: attitude spread larger than the whole range
+ * is shrunk to fit without turning the torque, an output beyond either
+ * end shifts collective and leaves motor differences intact.
+ *
+ * Usage: mixercheck
+ */
+
+#include "mixer.h"
+#include "common.h"
+#include "math3d.h"
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+
+enum Engines {Rear, Right, Left, EngineN};
+
+// Same as src/model.cpp
+static const double frontArmAngle = math3d::Pi / 3;
+static const float enginePositions[][2] = {
+	{0.0f, -1.0f},
+	{(float)std::sin(frontArmAngle), (float)std::cos(frontArmAngle)},
+	{(float)-std::sin(frontArmAngle), (float)std::cos(frontArmAngle)}
+};
+
+static const float tolerance = 1e-5f;
+
+static int failures = 0;
+
+static void expect(bool ok, const char* format, ...)
+{
+	if(ok)
+		return;
+	va_list args;
+	va_start(args, format);
+	std::printf("FAIL ");
+	std::vprintf(format, args);
+	std::printf("\n");
+	va_end(args);
+	failures++;
+}
+
+// Model::update before the mixer, rotation in range <-1, 1>
+static void oldModel(float throttle, float pitch, float roll, float maneuverFraction, float* outputs)
+{
+	float rearAdjustment = 0, rightAdjustment = 0, leftAdjustment = 0;
+
+	if(pitch > 0.0f)
+		rearAdjustment += pitch;
+	else if(pitch < 0.0f){
+		rightAdjustment -= pitch;
+		leftAdjustment -= pitch;
+	}
+
+	if(roll > 0.0f){
+		rearAdjustment += roll * 0.5f;
+		rightAdjustment += roll;
+	}
+	else if(roll < 0.0f){
+		rearAdjustment -= roll * 0.5f;
+		leftAdjustment -= roll;
+	}
+
+	outputs[Rear] = limit(throttle * (1 - maneuverFraction * rearAdjustment), 0.0f, 1.0f);
+	outputs[Right] = limit(throttle * (1 - maneuverFraction * rightAdjustment), 0.0f, 1.0f);
+	outputs[Left] = limit(throttle * (1 - maneuverFraction * leftAdjustment), 0.0f, 1.0f);
+}
+
+// Torque around X (pitch) and Y (roll) of motor thrusts
+static void torque(const float* outputs, float& pitch, float& roll)
+{
+	pitch = roll = 0;
+	for(int i = 0; i < EngineN; i++){
+		pitch += enginePositions[i][1] * outputs[i];
+		roll -= enginePositions[i][0] * outputs[i];
+	}
+}
+
+static float mean(const float* outputs)
+{
+	return (outputs[Rear] + outputs[Right] + outputs[Left]) / EngineN;
+}
+
+static float peakChange(const float* outputs, float throttle)
+{
+	float peak = 0;
+	for(int i = 0; i < EngineN; i++)
+		peak = max(peak, std::fabs(outputs[i] - throttle));
+	return peak;
+}
+
+static bool unsaturated(const float* outputs)
+{
+	for(int i = 0; i < EngineN; i++)
+		if(outputs[i] <= 0 || outputs[i] >= 1)
+			return false;
+	return true;
+}
+
+static void checkUnsaturated(float fraction)
+{
+	Mixer mixer(enginePositions, EngineN, fraction);
+	float outputs[EngineN], old[EngineN];
+
+	// Torque gains of the mixer over the old adjustments, from full single axis commands
+	float newPitch, newRoll, oldPitch, oldRoll, unused;
+	mixer.mix(0.5f, 1, 0, outputs);
+	oldModel(0.5f, 1, 0, fraction, old);
+	torque(outputs, newPitch, unused);
+	torque(old, oldPitch, unused);
+	float pitchGain = newPitch / oldPitch;
+	mixer.mix(0.5f, 0, 1, outputs);
+	oldModel(0.5f, 0, 1, fraction, old);
+	torque(outputs, unused, newRoll);
+	torque(old, unused, oldRoll);
+	float rollGain = newRoll / oldRoll;
+	std::printf("fraction=%.2f pitchGain=%.3f rollGain=%.3f\n", fraction, pitchGain, rollGain);
+	expect(pitchGain > 0 && rollGain > 0, "fraction %.2f torque gains %f %f not positive", fraction, pitchGain, rollGain);
+
+	int points = 0;
+	for(int t = 1; t <= 9; t++)
+		for(int p = -10; p <= 10; p++)
+			for(int r = -10; r <= 10; r++){
+				float throttle = t * 0.1f, pitch = p * 0.1f, roll = r * 0.1f;
+				mixer.mix(throttle, pitch, roll, outputs);
+				oldModel(throttle, pitch, roll, fraction, old);
+				if(!unsaturated(outputs) || !unsaturated(old))
+					continue;
+				points++;
+
+				expect(std::fabs(mean(outputs) - throttle) < tolerance, "throttle %.1f pitch %.1f roll %.1f mean %f moved",
+					   throttle, pitch, roll, mean(outputs));
+
+				torque(outputs, newPitch, newRoll);
+				torque(old, oldPitch, oldRoll);
+				expect(std::fabs(newPitch - pitchGain * oldPitch) < tolerance &&
+					   std::fabs(newRoll - rollGain * oldRoll) < tolerance,
+					   "throttle %.1f pitch %.1f roll %.1f torque %f %f, old %f %f", throttle, pitch, roll,
+					   newPitch, newRoll, oldPitch, oldRoll);
+
+				if(p == 0 || r == 0)
+					expect(std::fabs(peakChange(outputs, throttle) - peakChange(old, throttle)) < tolerance,
+						   "throttle %.1f pitch %.1f roll %.1f peak change %f, old %f", throttle, pitch, roll,
+						   peakChange(outputs, throttle), peakChange(old, throttle));
+			}
+	expect(points > 1000, "fraction %.2f only %d unsaturated points", fraction, points);
+}
+
+// Attitude part of outputs without saturation, throttle scaled
+static void attitude(const Mixer& mixer, float throttle, float pitch, float roll, float* parts)
+{
+	// Mid throttle keeps every part of small command inside the range, scaled back afterwards
+	float small = 0.1f;
+	mixer.mix(0.5f, pitch * small, roll * small, parts);
+	for(int i = 0; i < EngineN; i++)
+		parts[i] = (parts[i] - 0.5f) / small * 2 * throttle;
+}
+
+static void checkShrink()
+{
+	// Attitude spread of 1.5 at full command is larger than whole range
+	Mixer mixer(enginePositions, EngineN, 1.5f);
+	float outputs[EngineN], parts[EngineN];
+	float throttle = 0.5f, pitch = 1, roll = 0.6f;
+	mixer.mix(throttle, pitch, roll, outputs);
+	attitude(mixer, throttle, pitch, roll, parts);
+
+	float low = 1, high = 0, partLow = 0, partHigh = 0;
+	for(int i = 0; i < EngineN; i++){
+		low = min(low, outputs[i]);
+		high = max(high, outputs[i]);
+		partLow = min(partLow, parts[i]);
+		partHigh = max(partHigh, parts[i]);
+	}
+	expect(partHigh - partLow > 1, "shrink case spread %f fits", partHigh - partLow);
+	expect(std::fabs(low) < tolerance && std::fabs(high - 1) < tolerance, "shrunk outputs span %f..%f", low, high);
+
+	float shrunkPitch, shrunkRoll, fullPitch, fullRoll;
+	torque(outputs, shrunkPitch, shrunkRoll);
+	torque(parts, fullPitch, fullRoll);
+	expect(std::fabs(shrunkPitch * fullRoll - shrunkRoll * fullPitch) < tolerance && shrunkPitch * fullPitch > 0,
+		   "shrunk torque %f %f turned from %f %f", shrunkPitch, shrunkRoll, fullPitch, fullRoll);
+}
+
+static void checkShift(float fraction, float throttle, float pitch, float roll, bool up)
+{
+	Mixer mixer(enginePositions, EngineN, fraction);
+	float outputs[EngineN], parts[EngineN];
+	mixer.mix(throttle, pitch, roll, outputs);
+	attitude(mixer, throttle, pitch, roll, parts);
+
+	float low = 1, high = 0;
+	for(int i = 0; i < EngineN; i++){
+		low = min(low, outputs[i]);
+		high = max(high, outputs[i]);
+	}
+	expect(up ? std::fabs(high - 1) < tolerance : std::fabs(low) < tolerance,
+		   "throttle %.2f pitch %.1f roll %.1f shifted outputs span %f..%f", throttle, pitch, roll, low, high);
+
+	// Differences between motors are the attitude command itself
+	for(int i = 1; i < EngineN; i++)
+		expect(std::fabs((outputs[i] - outputs[0]) - (parts[i] - parts[0])) < tolerance,
+			   "throttle %.2f pitch %.1f roll %.1f motor %d difference %f, wanted %f", throttle, pitch, roll, i,
+			   outputs[i] - outputs[0], parts[i] - parts[0]);
+
+	float collective = mean(outputs) - (parts[Rear] + parts[Right] + parts[Left]) / EngineN;
+	expect(up ? collective < throttle : collective > throttle, "throttle %.2f collective %f not shifted %s",
+		   throttle, collective, up ? "down" : "up");
+}
+
+int main(int argc, char** argv)
+{
+	if(argc > 1){
+		std::fprintf(stderr, "usage: mixercheck\n");
+		return 1;
+	}
+
+	checkUnsaturated(0.25f);
+	checkUnsaturated(0.5f);
+	checkShrink();
+	// Front motors above full throttle while pitching up, rear below zero with large authority
+	checkShift(0.25f, 0.95f, 1, 0, true);
+	checkShift(0.25f, 0.9f, 0.3f, -1, true);
+	checkShift(1.2f, 0.3f, 1, 0, false);
+	checkShift(1.2f, 0.4f, -0.5f, 1, false);
+
+	// Motors stay off without throttle
+	float outputs[EngineN];
+	Mixer(enginePositions, EngineN, 0.25f).mix(0, 1, -1, outputs);
+	expect(outputs[Rear] == 0 && outputs[Right] == 0 && outputs[Left] == 0, "zero throttle gives %f %f %f",
+		   outputs[Rear], outputs[Right], outputs[Left]);
+
+	std::printf("mixercheck %s\n", failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Host check of Profiler: passes land in their log2 bucket, including
+ * zero and the largest count, count, min, max, total and mean follow the
+ * recorded passes, stages do not share statistics and reset clears them.
+ * A scope records exactly one pass on its own stage when it ends, nested
+ * scopes on other stages included, and the pass lasts at least as long as
+ * the scope on the host clock. Every stage has its own name.
+ *
+ * Usage: profilercheck
+ */
+
+#include "profiler.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+static int failures = 0;
+
+static void expect(bool ok, const char* format, ...)
+{
+	if(ok)
+		return;
+	va_list args;
+	va_start(args, format);
+	std::printf("FAIL ");
+	std::vprintf(format, args);
+	std::printf("\n");
+	va_end(args);
+	failures++;
+}
+
+static void checkBuckets()
+{
+	static const struct
+	{
+		uint32_t cycles;
+		uint8_t bucket;
+	} passes[] = {{0, 0}, {1, 0}, {2, 1}, {3, 1}, {4, 2}, {1023, 9}, {1024, 10}, {0x80000000u, 31}, {0xFFFFFFFFu, 31}};
+	static const int passN = sizeof(passes) / sizeof(passes[0]);
+
+	for(int i = 0; i < passN; i++){
+		Profiler::reset();
+		Profiler::record(Profiler::Control, passes[i].cycles);
+		const Profiler::Stats& stats = Profiler::stats(Profiler::Control);
+		uint32_t counted = 0;
+		for(uint8_t j = 0; j < Profiler::BucketN; j++)
+			counted += stats.histogram[j];
+		expect(stats.histogram[passes[i].bucket] == 1 && counted == 1, "%u cycles not counted in bucket %u only",
+			   passes[i].cycles, passes[i].bucket);
+	}
+}
+
+static void checkStats()
+{
+	Profiler::reset();
+	static const uint32_t passes[] = {700, 300, 1200, 800};
+	uint64_t total = 0;
+	for(int i = 0; i < 4; i++){
+		Profiler::record(Profiler::Fusion, passes[i]);
+		total += passes[i];
+	}
+	Profiler::record(Profiler::Mixing, 5);
+
+	const Profiler::Stats& stats = Profiler::stats(Profiler::Fusion);
+	expect(stats.count == 4 && stats.min == 300 && stats.max == 1200 && stats.total == total,
+		   "fusion count=%u min=%u max=%u total=%llu", stats.count, stats.min, stats.max,
+		   (unsigned long long)stats.total);
+	expect(Profiler::mean(Profiler::Fusion) == 750, "fusion mean %u", Profiler::mean(Profiler::Fusion));
+	expect(Profiler::stats(Profiler::Mixing).count == 1 && Profiler::stats(Profiler::Mixing).max == 5,
+		   "mixing pass is not kept apart from fusion");
+	expect(Profiler::stats(Profiler::Control).count == 0 && Profiler::mean(Profiler::Control) == 0,
+		   "untouched stage has passes");
+
+	Profiler::reset();
+	for(int i = 0; i < Profiler::StageN; i++){
+		const Profiler::Stats& cleared = Profiler::stats((Profiler::Stage)i);
+		uint32_t counted = 0;
+		for(uint8_t j = 0; j < Profiler::BucketN; j++)
+			counted += cleared.histogram[j];
+		expect(cleared.count == 0 && cleared.total == 0 && cleared.max == 0 && cleared.min == 0xFFFFFFFF &&
+			   counted == 0, "%s is not cleared by reset", Profiler::name((Profiler::Stage)i));
+	}
+}
+
+static void checkScope()
+{
+	const uint32_t sleepTime = 2000000;
+
+	Profiler::start();
+	{
+		PROFILE_SCOPE(Telemetry);
+		{
+			PROFILE_SCOPE(Debug);
+			std::this_thread::sleep_for(std::chrono::nanoseconds(sleepTime));
+		}
+		expect(Profiler::stats(Profiler::Debug).count == 1 && Profiler::stats(Profiler::Telemetry).count == 0,
+			   "inner scope did not record on leaving, outer did early");
+	}
+
+	const Profiler::Stats& outer = Profiler::stats(Profiler::Telemetry);
+	const Profiler::Stats& inner = Profiler::stats(Profiler::Debug);
+	expect(outer.count == 1 && inner.count == 1, "scopes recorded %u and %u passes", outer.count, inner.count);
+	expect(inner.max >= sleepTime && outer.max >= inner.max, "scopes lasted %u and %u ns, slept %u ns", outer.max,
+		   inner.max, sleepTime);
+	expect(Profiler::frequency() == 1000000000, "host clock runs at %u Hz", Profiler::frequency());
+}
+
+static void checkNames()
+{
+	for(int i = 0; i < Profiler::StageN; i++){
+		const char* name = Profiler::name((Profiler::Stage)i);
+		expect(name != nullptr && name[0] != 0, "stage %d has no name", i);
+		for(int j = 0; j < i && name != nullptr; j++)
+			expect(std::strcmp(name, Profiler::name((Profiler::Stage)j)) != 0, "stages %d and %d are both %s", j, i,
+				   name);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if(argc > 1){
+		std::fprintf(stderr, "usage: profilercheck\n");
+		return 1;
+	}
+
+	checkBuckets();
+	checkStats();
+	checkScope();
+	checkNames();
+
+	std::printf("profilercheck %s\n", failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Host check of the PPM and SBUS decoders on recorded style traces from
+ * tools/traces. Every trace is decoded twice, once pushed directly and
+ * once through a ring filled and read the way the receivers use their
+ * circular DMA: the counter of remaining transfers runs down and reloads
+ * to the buffer size, the reader drains whatever was written since its
+ * last pass. Both passes must agree and the ring must wrap.
+ *
+ * Traces cover nominal frames across 16 bit timer overflow, PPM glitch,
+ * missed edge and short frame, SBUS start inside a frame, cut frame,
+ * corrupted footer, SBUS2 footer and frame lost and failsafe flags.
+ *
+ * Usage: rccheck [-d traceDirectory]
+ */
+
+#include "ppmDecoder.h"
+#include "sbusDecoder.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static int failures = 0;
+
+static void expect(bool ok, const char* format, ...)
+{
+	if(ok)
+		return;
+	va_list args;
+	va_start(args, format);
+	std::printf("FAIL ");
+	std::vprintf(format, args);
+	std::printf("\n");
+	va_end(args);
+	failures++;
+}
+
+static const char* traceDirectory = "tools/traces";
+
+// Same capture timer as src/rc_receiver.cpp, traces are in its ticks
+static const uint32_t captureFrequency = 2e6;
+// Same buffer size as PpmReceiver and SbusReceiver
+static const uint8_t ringSize = 64;
+
+// Whitespace separated numbers, lines starting with # are comments
+static std::vector<uint16_t> readTrace(const char* name, int base)
+{
+	std::vector<uint16_t> values;
+	char path[256];
+	std::snprintf(path, sizeof(path), "%s/%s", traceDirectory, name);
+	FILE* file = std::fopen(path, "r");
+	if(file == nullptr){
+		expect(false, "cannot open %s", path);
+		return values;
+	}
+
+	char line[256];
+	while(std::fgets(line, sizeof(line), file) != nullptr){
+		if(line[0] == '#')
+			continue;
+		char* position = line;
+		char* end;
+		for(unsigned long value = std::strtoul(position, &end, base); end != position;
+			value = std::strtoul(position, &end, base)){
+			values.push_back(value);
+			position = end;
+		}
+	}
+
+	std::fclose(file);
+	return values;
+}
+
+struct PpmResult
+{
+	uint32_t frames;
+	uint32_t errors;
+	uint8_t channelN;
+	uint16_t channels[PpmDecoder::MaxChannels];
+};
+
+struct SbusResult
+{
+	uint32_t frames;
+	uint32_t errors;
+	uint16_t channels[SbusDecoder::ChannelN];
+	// Flags after each decoded frame, bit 0 frame lost, bit 1 failsafe
+	std::vector<uint8_t> flags;
+};
+
+static void collect(const PpmDecoder& decoder, bool, PpmResult& result)
+{
+	result.frames = decoder.frames();
+	result.errors = decoder.errors();
+	result.channelN = decoder.channelN();
+	for(uint8_t i = 0; i < PpmDecoder::MaxChannels; i++)
+		result.channels[i] = decoder.channel(i);
+}
+
+static void collect(const SbusDecoder& decoder, bool complete, SbusResult& result)
+{
+	result.frames = decoder.frames();
+	result.errors = decoder.errors();
+	for(uint8_t i = 0; i < SbusDecoder::ChannelN; i++)
+		result.channels[i] = decoder.channel(i);
+	if(complete)
+		result.flags.push_back((decoder.frameLost() ? 1 : 0) | (decoder.failsafe() ? 2 : 0));
+}
+
+template<typename Decoder, typename Item, typename Result>
+static void decodeDirect(Decoder decoder, const std::vector<uint16_t>& trace, Result& result)
+{
+	result = Result();
+	for(unsigned i = 0; i < trace.size(); i++)
+		collect(decoder, decoder.push((Item)trace[i]), result);
+}
+
+// Returns number of times the writer wrapped around the ring
+template<typename Decoder, typename Item, typename Result>
+static int decodeRing(Decoder decoder, const std::vector<uint16_t>& trace, Result& result)
+{
+	result = Result();
+	Item ring[ringSize] = {};
+	// Start late in the ring so that even short traces wrap
+	uint16_t remaining = 5;
+	uint8_t readIndex = ringSize - remaining;
+	int wraps = 0;
+
+	unsigned written = 0;
+	for(unsigned pass = 0; written < trace.size(); pass++){
+		// Uneven amounts between reads, including none and almost a full ring
+		unsigned burst = (pass * 37 + 11) % ringSize;
+		for(unsigned i = 0; i < burst && written < trace.size(); i++){
+			ring[ringSize - remaining] = (Item)trace[written++];
+			if(--remaining == 0){
+				remaining = ringSize;
+				wraps++;
+			}
+		}
+
+		uint8_t writeIndex = (ringSize - remaining) % ringSize;
+		while(readIndex != writeIndex){
+			collect(decoder, decoder.push(ring[readIndex]), result);
+			readIndex = (readIndex + 1) % ringSize;
+		}
+	}
+
+	return wraps;
+}
+
+static void checkPpm(const char* name, uint32_t frames, uint32_t errors, uint8_t lastFrame)
+{
+	std::vector<uint16_t> trace = readTrace(name, 10);
+	PpmResult direct, ring;
+	decodeDirect<PpmDecoder, uint16_t>(PpmDecoder(captureFrequency), trace, direct);
+	int wraps = decodeRing<PpmDecoder, uint16_t>(PpmDecoder(captureFrequency), trace, ring);
+
+	expect(direct.frames == frames && direct.errors == errors, "%s decodes %u frames with %u errors, wanted %u and %u",
+		   name, direct.frames, direct.errors, frames, errors);
+	expect(direct.channelN == 8, "%s last frame has %u channels", name, direct.channelN);
+	for(uint8_t i = 0; i < direct.channelN; i++){
+		uint16_t wanted = 2000 + 250 * i + 10 * lastFrame;
+		expect(direct.channels[i] == wanted, "%s channel %u is %u, wanted %u", name, i, direct.channels[i], wanted);
+	}
+
+	expect(wraps > 0, "%s wrapped the ring %d times", name, wraps);
+	expect(ring.frames == direct.frames && ring.errors == direct.errors && ring.channelN == direct.channelN &&
+		   std::memcmp(ring.channels, direct.channels, sizeof(ring.channels)) == 0,
+		   "%s decodes differently through the ring", name);
+}
+
+static void checkSbus(const char* name, uint32_t frames, uint32_t errors, uint8_t lastFrame, const uint8_t* flags)
+{
+	std::vector<uint16_t> trace = readTrace(name, 16);
+	SbusResult direct, ring;
+	decodeDirect<SbusDecoder, uint8_t>(SbusDecoder(), trace, direct);
+	int wraps = decodeRing<SbusDecoder, uint8_t>(SbusDecoder(), trace, ring);
+
+	expect(direct.frames == frames && direct.errors == errors, "%s decodes %u frames with %u errors, wanted %u and %u",
+		   name, direct.frames, direct.errors, frames, errors);
+	for(uint8_t i = 0; i < SbusDecoder::ChannelN; i++){
+		uint16_t wanted = 172 + 100 * i + 3 * lastFrame;
+		expect(direct.channels[i] == wanted, "%s channel %u is %u, wanted %u", name, i, direct.channels[i], wanted);
+	}
+	for(unsigned i = 0; i < direct.flags.size() && i < frames; i++)
+		expect(direct.flags[i] == flags[i], "%s frame %u has frame lost %d failsafe %d", name, i, direct.flags[i] & 1,
+			   direct.flags[i] >> 1);
+
+	expect(wraps > 0, "%s wrapped the ring %d times", name, wraps);
+	expect(ring.frames == direct.frames && ring.errors == direct.errors && ring.flags == direct.flags &&
+		   std::memcmp(ring.channels, direct.channels, sizeof(ring.channels)) == 0,
+		   "%s decodes differently through the ring", name);
+}
+
+int main(int argc, char** argv)
+{
+	for(int i = 1; i < argc; i++){
+		if(std::strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+			traceDirectory = argv[++i];
+		else{
+			std::fprintf(stderr, "usage: rccheck [-d traceDirectory]\n");
+			return 1;
+		}
+	}
+
+	// First frame only synchronizes the decoder
+	checkPpm("ppmNominal.txt", 3, 0, 3);
+	// Glitch and missed edge each drop a frame, short frame is ignored
+	checkPpm("ppmSyncLoss.txt", 3, 2, 6);
+
+	static const uint8_t clear[] = {0, 0, 0};
+	static const uint8_t flagged[] = {0, 1, 3, 2, 0};
+	checkSbus("sbusFlags.txt", 5, 0, 4, flagged);
+	// Cut frame and corrupted footer are errors, leading partial frame is skipped
+	checkSbus("sbusSyncLoss.txt", 3, 2, 4, clear);
+
+	std::printf("rccheck %s\n", failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Stress check of SeqLock as channelFrame uses it. A writer thread
+ * stands in for the capture interrupt and rewrites the whole frame as
+ * fast as it can, a reader thread stands in for the main loop and checks
+ * that every snapshot comes from one complete write: all fields carry
+ * the same write number and numbers never go back.
+ *
+ * Frame has the layout of RcFrame in inc/rc_receiver.h, which cannot be
+ * included without the USART peripheral headers.
+ *
+ * Usage: seqlockcheck [-n writes]
+ */
+
+#include "seqLock.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+static const int channelN = 8;
+
+struct Frame
+{
+	uint32_t captures[channelN];
+	uint64_t timeStamps[channelN];
+	uint64_t time;
+};
+
+static SeqLock<Frame> frame;
+static std::atomic<bool> writing(true);
+
+static void writer(uint32_t writes)
+{
+	for(uint32_t n = 1; n <= writes; n++){
+		Frame& value = frame.beginWrite();
+		// Each field on its own, as the interrupt updates one channel at a time
+		for(int i = 0; i < channelN; i++){
+			value.captures[i] = n * channelN + i;
+			value.timeStamps[i] = (uint64_t)n << 32 | i;
+			// Hand the reader a half written frame now and then, on a single
+			// core this is the only way a read can overlap a write
+			if(n % 1000 == 0 && i == channelN / 2)
+				std::this_thread::yield();
+		}
+		value.time = n;
+		frame.endWrite();
+
+		if(n % 16 == 0)
+			std::this_thread::yield();
+	}
+	writing.store(false);
+}
+
+// Returns write number of consistent snapshot, zero when torn
+static uint32_t writeNumber(const Frame& value)
+{
+	uint32_t n = value.time;
+	for(int i = 0; i < channelN; i++)
+		if(value.captures[i] != n * channelN + i || value.timeStamps[i] != ((uint64_t)n << 32 | i))
+			return 0;
+	return n;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t writes = 200000;
+	for(int i = 1; i < argc; i++){
+		if(std::strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			writes = std::strtoul(argv[++i], nullptr, 10);
+		else{
+			std::fprintf(stderr, "usage: seqlockcheck [-n writes]\n");
+			return 1;
+		}
+	}
+
+	std::thread thread(writer, writes);
+
+	uint32_t reads = 0, torn = 0, backwards = 0, distinct = 0, last = 0;
+	bool done = false;
+	while(!done){
+		// Last read after the writer finished must see the final write
+		done = !writing.load();
+		Frame value = frame.read();
+		reads++;
+
+		uint32_t n = value.time == 0 ? 0 : writeNumber(value);
+		if(value.time != 0 && n == 0)
+			torn++;
+		else if(n < last)
+			backwards++;
+		else if(n != last){
+			distinct++;
+			last = n;
+		}
+		std::this_thread::yield();
+	}
+	thread.join();
+
+	bool ok = torn == 0 && backwards == 0 && last == writes && frame.writes() == writes && distinct > writes / 1000;
+	std::printf("writes=%u reads=%u distinct=%u torn=%u backwards=%u last=%u\n", writes, reads, distinct, torn, backwards,
+				last);
+	std::printf("seqlockcheck %s\n", ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
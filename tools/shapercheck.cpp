@@ -0,0 +1,187 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Host check of RcShaper: deadband holds zero around center and keeps the
+ * output continuous at its edge, the expo curve follows
+ * x (1 - expo) + x^3 expo at a few stick positions within the error of
+ * the lookup table, and interpolation walks from one RC frame to the
+ * next in equal steps that land on the new value after one frame period.
+ *
+ * Usage: shapercheck
+ */
+
+#include "rcShaper.h"
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+
+static int failures = 0;
+
+static void expect(bool ok, const char* format, ...)
+{
+	if(ok)
+		return;
+	va_list args;
+	va_start(args, format);
+	std::printf("FAIL ");
+	std::vprintf(format, args);
+	std::printf("\n");
+	va_end(args);
+	failures++;
+}
+
+// Control loop and RC frame periods of the firmware
+static const float loopPeriod = 1e-3f;
+static const float framePeriod = 20e-3f;
+static const int loopsPerFrame = 20;
+
+static bool near(float value, float wanted, float tolerance)
+{
+	return std::fabs(value - wanted) <= tolerance;
+}
+
+static void checkDeadband()
+{
+	RcShaper shaper(RcShaper::Centered, loopPeriod, framePeriod);
+	shaper.calibration(0.1f, 0.5f, 0.9f);
+	shaper.deadband(0.1f);
+	shaper.rate(2);
+
+	// Band is 0.04 of reading either side of center
+	static const float inside[] = {0.5f, 0.47f, 0.53f, 0.461f, 0.539f};
+	for(unsigned i = 0; i < sizeof(inside) / sizeof(inside[0]); i++)
+		expect(shaper.shape(inside[i]) == 0, "reading %.3f inside deadband gives %f", inside[i], shaper.shape(inside[i]));
+
+	expect(near(shaper.shape(0.545f), 2 * (0.0125f / 0.9f), 1e-5f), "just outside deadband gives %f",
+		   shaper.shape(0.545f));
+	expect(shaper.shape(0.54f) >= 0 && shaper.shape(0.54f) < 1e-5f, "deadband edge jumps to %f", shaper.shape(0.54f));
+	expect(near(shaper.shape(0.9f), 2, 1e-6f) && near(shaper.shape(0.1f), -2, 1e-6f), "full stick gives %f and %f",
+		   shaper.shape(0.9f), shaper.shape(0.1f));
+	expect(near(shaper.shape(1), 2, 1e-6f) && near(shaper.shape(0), -2, 1e-6f), "reading past endpoints is not limited");
+
+	RcShaper throttle(RcShaper::Unipolar, loopPeriod, framePeriod);
+	throttle.calibration(0.1f, 0.5f, 0.9f);
+	throttle.deadband(0.05f);
+	expect(throttle.shape(0.1f) == 0 && throttle.shape(0.12f) == 0, "throttle deadband at bottom gives %f",
+		   throttle.shape(0.12f));
+	expect(near(throttle.shape(0.5f), 0.45f / 0.95f, 1e-5f), "half throttle gives %f", throttle.shape(0.5f));
+
+	// Stick pulled back near its minimum ramps down to exactly zero, which
+	// the firmware takes as standing on the ground. Rounding of the steps
+	// may leave the last one for the loop after the frame period
+	float output = 0;
+	for(int i = 0; i < 2 * loopsPerFrame; i++)
+		output = throttle.process(0.5f);
+	for(int i = 0; i <= loopsPerFrame; i++)
+		output = throttle.process(0.12f);
+	expect(output == 0, "throttle pulled into deadband ends at %g", output);
+}
+
+static void checkExpo()
+{
+	static const float expos[] = {0, 0.3f, 0.7f, 1};
+	static const float sticks[] = {0.125f, 0.25f, 0.3f, 0.5f, 0.61f, 0.75f, 0.9f, 1};
+
+	for(unsigned e = 0; e < sizeof(expos) / sizeof(expos[0]); e++){
+		RcShaper shaper(RcShaper::Centered, loopPeriod, framePeriod);
+		shaper.calibration(0, 0.5f, 1);
+		shaper.expo(expos[e]);
+
+		for(unsigned s = 0; s < sizeof(sticks) / sizeof(sticks[0]); s++){
+			float x = sticks[s];
+			float wanted = x * (1 - expos[e]) + x * x * x * expos[e];
+			// Linear interpolation of x^3 between 17 points is off by at most 3 x h^2 / 4
+			float tolerance = 0.75f * 3 * x * expos[e] / (16 * 16) + 1e-6f;
+			float positive = shaper.shape(0.5f + x / 2);
+			float negative = shaper.shape(0.5f - x / 2);
+			expect(near(positive, wanted, tolerance), "expo %.1f at stick %.3f gives %f, wanted %f", expos[e], x, positive,
+				   wanted);
+			expect(near(negative, -positive, 1e-6f), "expo %.1f at stick -%.3f gives %f, not %f", expos[e], x, negative, -positive);
+		}
+	}
+}
+
+// Output of each loop after reading changes, until it settles
+static void ramp(RcShaper& shaper, float reading, float from, const char* name)
+{
+	float to = shaper.shape(reading);
+	float step = (to - from) / loopsPerFrame;
+	float output = from;
+	int loops = 0;
+	for(; loops < 2 * loopsPerFrame; loops++){
+		float previous = output;
+		output = shaper.process(reading);
+		if(loops < loopsPerFrame - 1)
+			expect(near(output - previous, step, std::fabs(step) * 1e-3f + 1e-6f), "%s step %d is %f, wanted %f", name,
+				   loops, output - previous, step);
+		if(output == to)
+			break;
+	}
+	loops++;
+
+	expect(loops == loopsPerFrame, "%s reaches %f after %d loops, wanted %d", name, to, loops, loopsPerFrame);
+	expect(shaper.process(reading) == to, "%s leaves %f after settling", name, to);
+}
+
+static void checkInterpolation()
+{
+	RcShaper shaper(RcShaper::Centered, loopPeriod, framePeriod);
+	shaper.calibration(0, 0.5f, 1);
+	shaper.rate(3);
+
+	// First frame ramps from zero too
+	expect(shaper.shape(1) == 3 && shaper.shape(0.25f) == -1.5f && shaper.shape(0.5f) == 0, "rate is not applied");
+	ramp(shaper, 1, 0, "zero to full");
+	ramp(shaper, 0.25f, 3, "full to quarter back");
+	ramp(shaper, 0.5f, -1.5f, "back to center");
+
+	// Frame arriving mid-ramp starts a new ramp from where output is
+	float output = 0;
+	for(int i = 0; i < loopsPerFrame / 2; i++)
+		output = shaper.process(0.75f);
+	expect(near(output, 0.75f, 1e-5f), "half ramp to 1.5 is at %f", output);
+	ramp(shaper, 0.6f, output, "mid-ramp to 0.6");
+
+	// Frame period at or below loop period applies frames at once
+	shaper.framePeriod(loopPeriod);
+	expect(shaper.process(1) == 3 && shaper.process(0) == -3, "frames at loop rate are interpolated");
+}
+
+int main(int argc, char** argv)
+{
+	if(argc > 1){
+		std::fprintf(stderr, "usage: shapercheck\n");
+		return 1;
+	}
+
+	checkDeadband();
+	checkExpo();
+	checkInterpolation();
+
+	std::printf("shapercheck %s\n", failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,250 @@
+/*
+* F3-copter - STM32-F3 Discovery based tricopter
+* Copyright (c) 2013 Ivan Sevcik - ivan-sevcik@hotmail.com
+*
+* This software is provided 'as-is', without any express or
+* implied warranty. In no event will the authors be held
+* liable for any damages arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute
+* it freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented;
+*    you must not claim that you wrote the original software.
+*    If you use this software in a product, an acknowledgment
+*    in the product documentation would be appreciated but
+*    is not required.
+*
+* 2. Altered source versions must be plainly marked as such,
+*    and must not be misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any
+*    source distribution.
+*/
+
+/*
+ * Host check of the gyroscope thermal bias table on synthetic data. A still
+ * sensor warms up and cools down slowly while its bias follows a known
+ * curve over temperature, compensated rates go through ThermalBias with the
+ * settings of src/main.cpp:
+ *   - nodes inside the ramp learn, the outer ones stay empty and lookup
+ *     beyond the learned nodes holds the outermost one
+ *   - interpolated bias converges to the curve at nodes and between them,
+ *     within the error of the still period means
+ *   - a dropped still period does not count towards learning
+ *   - nodes survive a save and mount of the configuration store
+ *   - after a reboot at another temperature the stored table is rebuilt
+ *     around the new boot calibration
+ *
+ * Usage: thermalcheck [-s seed]
+ */
+
+#include "thermalBias.h"
+#include "configStore.h"
+#include "random.h"
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static int failures = 0;
+
+static void expect(bool ok, const char* format, ...)
+{
+	if(ok)
+		return;
+	va_list args;
+	va_start(args, format);
+	std::printf("FAIL ");
+	std::vprintf(format, args);
+	std::printf("\n");
+	va_end(args);
+	failures++;
+}
+
+using math3d::Vector3;
+
+// Same as thermalBias in src/main.cpp
+static const float lowestTemperature = -10;
+static const float nodeSpacing = 10;
+static const float maxWeight = 256;
+// Same as src/thermalBias.cpp
+static const int stillSamples = 100;
+
+// Same sensor noise as f3sim, 0.3 deg/s
+static const float gyroNoise = 0.3f * math3d::Pi / 180;
+
+// Ramp between 0 and 50 deg C, 0.02 deg C per still period
+static const float rampLow = 0;
+static const float rampHigh = 50;
+static const float rampStep = 0.02f / stillSamples;
+
+// Bias in rad/s, linear with a little curvature around room temperature
+static Vector3<float> trueBias(float temperature)
+{
+	float t = temperature - 25;
+	return Vector3<float>(0.01f + 4e-4f * t + 2e-6f * t * t, -0.02f - 3e-4f * t + 1e-6f * t * t,
+						  0.005f + 1e-4f * t - 2e-6f * t * t);
+}
+
+static Vector3<float> noisy(Random& random, const Vector3<float>& value, float sigma)
+{
+	return Vector3<float>(value[0] + random.gaussian(sigma), value[1] + random.gaussian(sigma),
+						  value[2] + random.gaussian(sigma));
+}
+
+// Means of still periods are off by 0.3 deg/s / 10, the table averages
+// many of them and interpolation adds little on this curvature
+static const float tolerance = 1e-3f;
+
+// Largest bias error over the ramp at nodes and half way between them,
+// corrected is the bias the sensor correction removes before the table
+static float maxError(const ThermalBias& table, const Vector3<float>& corrected)
+{
+	float worst = 0;
+	for(float temperature = rampLow; temperature <= rampHigh; temperature += nodeSpacing / 2){
+		Vector3<float> error = table.bias(temperature) - (trueBias(temperature) - corrected);
+		for(uint8_t i = 0; i < 3; i++)
+			worst = std::fabs(error[i]) > worst ? std::fabs(error[i]) : worst;
+	}
+	return worst;
+}
+
+// One leg of the ramp, returns completed still periods
+static int ramp(ThermalBias& table, Random& random, float from, float to, const Vector3<float>& corrected)
+{
+	int periods = 0;
+	float step = to > from ? rampStep : -rampStep;
+	int steps = (int)std::lround((to - from) / step);
+	for(int i = 0; i <= steps; i++){
+		float temperature = from + i * step;
+		Vector3<float> rate = noisy(random, trueBias(temperature) - corrected, gyroNoise);
+		periods += table.observe(table.apply(rate, temperature), temperature) ? 1 : 0;
+	}
+	return periods;
+}
+
+static void checkRamp(Random& random, ThermalBias& table)
+{
+	const Vector3<float> uncorrected(0, 0, 0);
+	float initial = maxError(table, uncorrected);
+	int periods = ramp(table, random, rampLow, rampHigh, uncorrected);
+	expect(periods == (int)((rampHigh - rampLow) / (rampStep * stillSamples)), "warm up completed %d still periods",
+		   periods);
+	float warm = maxError(table, uncorrected);
+
+	for(int cycle = 0; cycle < 2; cycle++){
+		ramp(table, random, rampHigh, rampLow, uncorrected);
+		ramp(table, random, rampLow, rampHigh, uncorrected);
+	}
+	float converged = maxError(table, uncorrected);
+
+	expect(warm < initial / 10 && converged < tolerance, "bias error %f empty, %f warm, %f converged", initial, warm,
+		   converged);
+
+	for(uint8_t i = 0; i < ThermalBias::NodeN; i++){
+		float temperature = table.nodeTemperature(i);
+		bool inside = temperature >= rampLow && temperature <= rampHigh;
+		expect(inside ? table.nodeWeight(i) == maxWeight : table.nodeWeight(i) == 0, "node %u at %.0f has weight %f",
+			   i, temperature, table.nodeWeight(i));
+	}
+
+	Vector3<float> cold = table.bias(lowestTemperature) - table.bias(rampLow);
+	Vector3<float> hot = table.bias(table.nodeTemperature(ThermalBias::NodeN - 1)) - table.bias(rampHigh);
+	expect(cold.dotProduct(cold) == 0 && hot.dotProduct(hot) == 0, "lookup beyond learned nodes does not hold them");
+}
+
+static void checkInterrupt(Random& random)
+{
+	ThermalBias table(lowestTemperature, nodeSpacing, maxWeight);
+	bool learned = false;
+	for(int i = 0; i < stillSamples / 2; i++)
+		learned |= table.observe(noisy(random, trueBias(20), gyroNoise), 20);
+	table.interrupt();
+
+	// Still period starts over
+	for(int i = 0; i < stillSamples - 1; i++)
+		learned |= table.observe(noisy(random, trueBias(20), gyroNoise), 20);
+	expect(!learned && table.nodeWeight(3) == 0, "interrupted still period was learned");
+	expect(table.observe(noisy(random, trueBias(20), gyroNoise), 20) && table.nodeWeight(3) > 0,
+		   "full still period after interrupt was not learned");
+}
+
+static void checkStore(const ThermalBias& table)
+{
+	ConfigStore store;
+	store.mount();
+	ThermalBias loaded(lowestTemperature, nodeSpacing, maxWeight);
+	const Vector3<float> uncorrected(0, 0, 0);
+	expect(!loaded.load(store, ConfigStore::GyroThermalBias, uncorrected) && loaded.nodeWeight(3) == 0,
+		   "nodes load from empty store");
+	expect(table.save(store, ConfigStore::GyroThermalBias, uncorrected), "nodes are not saved");
+
+	// Next boot mounts what flash holds
+	ConfigStore boot;
+	boot.mount();
+	bool same = loaded.load(boot, ConfigStore::GyroThermalBias, uncorrected);
+	for(uint8_t i = 0; i < ThermalBias::NodeN; i++){
+		Vector3<float> difference = loaded.nodeBias(i) - table.nodeBias(i);
+		same &= difference.dotProduct(difference) == 0 && loaded.nodeWeight(i) == table.nodeWeight(i);
+	}
+	expect(same, "loaded nodes differ");
+}
+
+// Boot calibration measures the whole bias at power up temperature, the
+// table holds the rest. A reboot at another temperature must not subtract
+// the drift between the two boots twice
+static void checkReboot(Random& random)
+{
+	const Vector3<float> firstBoot = trueBias(10);
+	ThermalBias table(lowestTemperature, nodeSpacing, maxWeight);
+	ramp(table, random, rampLow, rampHigh, firstBoot);
+	for(int cycle = 0; cycle < 2; cycle++){
+		ramp(table, random, rampHigh, rampLow, firstBoot);
+		ramp(table, random, rampLow, rampHigh, firstBoot);
+	}
+	expect(maxError(table, firstBoot) < tolerance, "bias error %f after calibration at 10 deg C",
+		   maxError(table, firstBoot));
+
+	ConfigStore store;
+	store.mount();
+	expect(table.save(store, ConfigStore::GyroThermalBias, firstBoot), "nodes are not saved");
+
+	const Vector3<float> secondBoot = trueBias(40);
+	ConfigStore boot;
+	boot.mount();
+	ThermalBias rebuilt(lowestTemperature, nodeSpacing, maxWeight);
+	expect(rebuilt.load(boot, ConfigStore::GyroThermalBias, secondBoot) && maxError(rebuilt, secondBoot) < tolerance,
+		   "bias error %f after reboot at 40 deg C", maxError(rebuilt, secondBoot));
+
+	// Control, nodes kept as learned against the first calibration
+	ThermalBias stale(lowestTemperature, nodeSpacing, maxWeight);
+	stale.load(boot, ConfigStore::GyroThermalBias, firstBoot);
+	expect(maxError(stale, secondBoot) > 10 * tolerance, "check cannot see a table left on the first calibration");
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t seed = 1;
+	for(int i = 1; i < argc; i++){
+		if(std::strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			seed = std::strtoull(argv[++i], nullptr, 10);
+		else{
+			std::fprintf(stderr, "usage: thermalcheck [-s seed]\n");
+			return 1;
+		}
+	}
+
+	Random random(seed);
+	ThermalBias table(lowestTemperature, nodeSpacing, maxWeight);
+	checkRamp(random, table);
+	checkInterrupt(random);
+	checkStore(table);
+	checkReboot(random);
+
+	std::printf("thermalcheck %s\n", failures == 0 ? "ok" : "FAILED");
+	return failures == 0 ? 0 : 1;
+}